@@ -0,0 +1,92 @@
+# What we calibrated the sensors against. gen_calibration.py fits a line
+# through each sensor's data and turns it into
+#
+#   elet_calibration.h    slope and offset for each sensor, plus the same
+#                         line in fixed point for the arduino
+#
+# To recalibrate, put the new data next to the old, point the sensor at it
+# here, run calibration/gen_calibration.py, read its residual report, and
+# commit the header along with it. elet.h is the only thing that reads the
+# header, and everything else (the server, the client, the sim) gets its
+# calibration from elet.h.
+#
+# Paths are relative to the top of the repo. The name is what the header's
+# defines are called: ELET_CAL_<name>_SLOPE and so on. previous is the
+# (slope, offset) we had before, just so the report can say how much
+# better the new fit is.
+
+# The pressure sensors. The csvs are pressure_sensor_calibrator's output: a
+# raw count and the count run through the old (wrong by 2x) conversion, see
+# pressure_sensor_calibration/README.txt. What the gauge said isn't in the
+# csv, it's in calibration_notes.jpg, written down next to the converted
+# value we saw at the time. So each setpoint here is (gauge psi, roughly the
+# converted value), and the generator lines the csv's flat stretches up
+# with them by the converted value. 0 psi is the sensor sitting open to
+# the air before and after.
+#
+# P2 (blue) was set #1. Its 460 psi entry is scribbled over in the notes,
+# so it's left out. The 40 and 100 psi at the top of that page have no
+# value written next to them; 100 psi comes from the way back down.
+#
+# P1 (yellow) was set #2. Its way back down says ~1080 for 500 psi, but
+# the csv never gets above ~1035, and set #1 says ~1030.
+pressure_sensors = [
+    dict(name="PS_OXYGEN",
+         desc="P1, yellow tape, SN 062716D005",
+         csv="pressure_sensor_calibration/p1_09_32_am.csv",
+         units="psi",
+         raw_range=(0, 1023),
+         previous=(1.222, -250.0),
+         setpoints=[
+             (0, 0), (40, 83), (100, 214), (140, 290), (200, 417),
+             (240, 500), (300, 620), (340, 700), (400, 822), (440, 905),
+             (460, 950), (480, 990), (500, 1030),
+         ]),
+
+    dict(name="PS_FUEL",
+         desc="P2, blue tape, SN 041116D204",
+         csv="pressure_sensor_calibration/p2_09_18_am.csv",
+         units="psi",
+         raw_range=(0, 1023),
+         previous=(1.222, -250.0),
+         setpoints=[
+             (0, 0), (100, 210), (140, 290), (200, 420), (240, 500),
+             (300, 620), (340, 700), (400, 820), (440, 905), (480, 990),
+             (500, 1030),
+         ]),
+]
+
+# a flat stretch is at least this many readings in a row within
+# plateau_counts of where it started
+plateau_len = 5
+plateau_counts = 2
+
+# and it belongs to the setpoint whose converted value is closest, if it's
+# within this many, or this fraction of the value, whichever is bigger
+match_cv = 15
+match_frac = 0.03
+
+# The load cell. load_cell_amp's csv is sample number, the mass on it in
+# lb, and the raw HX711 reading, for the stack of weights going on and
+# coming back off. The mass was typed in by hand after the weight had
+# moved, so the last few readings of each mass are really the next one's,
+# and the 0 lb readings were taken with the 23.6 lb hanger already on. The
+# robust fit throws all of those out.
+load_cells = [
+    dict(name="LOAD_CELL",
+         desc="load cell on the HX711, 11 April 2017",
+         csv="load_cell_amp/4_11_load_cell_calib.csv",
+         units="lbf",
+         raw_column=2,
+         ref_column=1,
+         raw_range=(0, (1 << 24) - 1),
+         # "5.6234*10e-5", which is 10x what was meant
+         previous=(5.6234e-4, -471.15)),
+]
+
+# Tukey's biweight: a point more than this many (MAD-estimated) standard
+# deviations off the line gets no weight at all
+biweight_c = 4.685
+
+# the fixed point conversion gives the reading in 1/fixed_scale units
+fixed_scale = 16
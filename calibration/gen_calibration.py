@@ -0,0 +1,372 @@
+#!/usr/bin/env python
+#
+# fit the sensor calibrations in calibration.py and generate
+# elet_calibration.h from them. Run it from anywhere:
+#
+#   ./calibration/gen_calibration.py          refit, print the residuals,
+#                                             rewrite the header
+#   ./calibration/gen_calibration.py --check  exit non-zero if it's stale
+#
+# Every fit is a straight line, raw reading to units. It starts from the
+# Theil-Sen line (the median of the slopes between every pair of points),
+# which doesn't care about the odd bad reading, and then does iteratively
+# reweighted least squares with Tukey's biweight, so the points that are
+# really off the line (a reading written down against the wrong weight)
+# end up with no say at all, and the rest get an ordinary least squares
+# fit.
+
+from __future__ import division, print_function
+
+import os
+import sys
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+sys.path.insert(0, here)
+
+import calibration
+
+BANNER = ("generated by calibration/gen_calibration.py from "
+          "calibration/calibration.py.\nDon't edit by hand.")
+
+OUTPUT = "elet_calibration.h"
+
+
+class CalibrationError(Exception):
+    pass
+
+
+def read_csv(path, ncols):
+    """the rows of path with ncols numbers in them. Anything else, like the
+    half a line a capture starts with, is skipped."""
+    rows = []
+    with open(os.path.join(root, path)) as f:
+        for line in f:
+            fields = line.split(",")
+            if len(fields) != ncols:
+                continue
+            try:
+                rows.append([float(x) for x in fields])
+            except ValueError:
+                continue
+    return rows
+
+
+def median(xs):
+    xs = sorted(xs)
+    n = len(xs)
+    if not n:
+        raise CalibrationError("median of nothing")
+    if n % 2:
+        return xs[n // 2]
+    return (xs[n // 2 - 1] + xs[n // 2]) / 2
+
+
+def theil_sen(pts):
+    slopes = []
+    for i in range(len(pts)):
+        xi, yi = pts[i]
+        for j in range(i + 1, len(pts)):
+            xj, yj = pts[j]
+            if xj != xi:
+                slopes.append((yj - yi) / (xj - xi))
+    if not slopes:
+        raise CalibrationError("every point has the same raw reading")
+    m = median(slopes)
+    return m, median([y - m * x for x, y in pts])
+
+
+def weighted_fit(pts, ws):
+    sw = sum(ws)
+    if sw <= 0:
+        raise CalibrationError("no points left to fit")
+    # centered, the raw load cell readings are ~9e6 and their squares lose
+    # the digits we want
+    mx = sum(w * x for (x, y), w in zip(pts, ws)) / sw
+    my = sum(w * y for (x, y), w in zip(pts, ws)) / sw
+    sxx = sum(w * (x - mx) ** 2 for (x, y), w in zip(pts, ws))
+    sxy = sum(w * (x - mx) * (y - my) for (x, y), w in zip(pts, ws))
+    if sxx <= 0:
+        raise CalibrationError("every point left has the same raw reading")
+    m = sxy / sxx
+    return m, my - m * mx
+
+
+def robust_fit(pts):
+    """(slope, offset, weights)"""
+    m, b = theil_sen(pts)
+    ws = [1.0] * len(pts)
+    for _ in range(100):
+        res = [y - (m * x + b) for x, y in pts]
+        scale = 1.4826 * median([abs(r) for r in res])
+        if scale == 0:
+            break
+        ws = []
+        for r in res:
+            u = r / (calibration.biweight_c * scale)
+            ws.append((1 - u * u) ** 2 if abs(u) < 1 else 0.0)
+        nm, nb = weighted_fit(pts, ws)
+        done = (abs(nm - m) <= 1e-12 * abs(m)
+                and abs(nb - b) <= 1e-9 * max(abs(b), 1))
+        m, b = nm, nb
+        if done:
+            break
+    return m, b, ws
+
+
+def plateaus(rows, lo, hi):
+    """the flat stretches of a pressure capture: lists of (counts, converted
+    value), in the order they happened"""
+    rows = [r for r in rows if lo <= r[0] <= hi]
+    out = []
+    i = 0
+    while i < len(rows):
+        j = i
+        while (j < len(rows) and abs(rows[j][0] - rows[i][0])
+               <= calibration.plateau_counts):
+            j += 1
+        if j - i >= calibration.plateau_len:
+            out.append(rows[i:j])
+            i = j
+        else:
+            i += 1
+    return out
+
+
+def match_setpoint(setpoints, cv):
+    best = min(setpoints, key=lambda sp: abs(sp[1] - cv))
+    tol = max(calibration.match_cv, calibration.match_frac * best[1])
+    return best if abs(best[1] - cv) <= tol else None
+
+
+def pressure_points(sensor, report):
+    """(raw, psi) and which setpoint each one came from"""
+    lo, hi = sensor["raw_range"]
+    pts = []
+    groups = []
+    for run in plateaus(read_csv(sensor["csv"], 2), lo, hi):
+        cv = sum(r[1] for r in run) / len(run)
+        sp = match_setpoint(sensor["setpoints"], cv)
+        if sp is None:
+            report.append("    %d readings at ~%.0f counts (converted "
+                          "%.0f) match no setpoint, left out"
+                          % (len(run), run[0][0], cv))
+            continue
+        for r in run:
+            pts.append((r[0], float(sp[0])))
+            groups.append(sp[0])
+
+    missing = [sp[0] for sp in sensor["setpoints"] if sp[0] not in groups]
+    if missing:
+        report.append("    no readings found for %s %s" % (
+            ", ".join("%g" % p for p in missing), sensor["units"]))
+    return pts, groups
+
+
+def load_cell_points(cell, report):
+    ncols = max(cell["raw_column"], cell["ref_column"]) + 1
+    lo, hi = cell["raw_range"]
+    pts = []
+    for r in read_csv(cell["csv"], ncols):
+        raw = r[cell["raw_column"]]
+        if lo <= raw <= hi:
+            pts.append((raw, r[cell["ref_column"]]))
+    return pts, [y for x, y in pts]
+
+
+def fixed_eval(fx, raw):
+    bias, pre, mul, shift, add = fx
+    return ((((int(raw) - bias) >> pre) * mul) >> shift) + add
+
+
+def fixed_samples(lo, hi):
+    # every reading for the ADC, a spread of them for the load cell. The
+    # stride is odd so the samples don't all land on the same bits below
+    # the pre-shift.
+    if hi - lo <= 4096:
+        return range(lo, hi + 1)
+    stride = (hi - lo) // 4093 | 1
+    return list(range(lo, hi + 1, stride)) + [hi]
+
+
+def fixed_error(fx, m, b, samples):
+    scale = calibration.fixed_scale
+    return max(abs(fixed_eval(fx, raw) / scale - (m * raw + b))
+               for raw in samples)
+
+
+def fixed_point(m, b, lo, hi):
+    """the line as integer math that fits in an int32_t, so the arduino
+    doesn't need floats: reading * fixed_scale is
+
+        ((((raw - bias) >> pre) * mul) >> shift) + add
+
+    Returns the best (bias, pre, mul, shift, add) and its worst error over
+    the raw range, in units."""
+    scale = calibration.fixed_scale
+    samples = fixed_samples(lo, hi)
+    best = None
+    for pre in range(0, (hi - lo).bit_length()):
+        r_bits = ((hi - lo) >> pre).bit_length()
+        mul_max = (1 << (31 - r_bits)) - 1
+        step = m * scale * (1 << pre)
+        if abs(step) > mul_max:
+            continue
+        shift = 0
+        while shift < 30 and abs(step) * (1 << (shift + 1)) <= mul_max:
+            shift += 1
+        mul = int(round(step * (1 << shift)))
+        if mul == 0:
+            continue
+        # flooring in both shifts loses half a step on average, put it back
+        # in add, then nudge add to whichever is best over the whole range
+        lost = (m * ((1 << pre) - 1) / 2 * scale
+                + (1 - 1 / (1 << shift)) / 2)
+        base = int(round((b + m * lo) * scale + lost))
+        for add in (base - 1, base, base + 1):
+            fx = (lo, pre, mul, shift, add)
+            err = fixed_error(fx, m, b, samples)
+            if best is None or err < best[1] - 1e-9:
+                best = (fx, err)
+    if best is None:
+        raise CalibrationError("no fixed point form of slope %g" % m)
+    return best
+
+
+def fit_sensor(sensor, pts, groups, report):
+    units = sensor["units"]
+    if len(pts) < 2:
+        raise CalibrationError("%s: not enough points to fit"
+                               % sensor["name"])
+    m, b, ws = robust_fit(pts)
+    res = [y - (m * x + b) for x, y in pts]
+    inliers = [r for r, w in zip(res, ws) if w > 0]
+    rms = (sum(r * r for r in inliers) / len(inliers)) ** 0.5
+
+    report.append("    %-8s %5s %7s %12s %10s" % (
+        units, "n", "inliers", "mean raw", "residual"))
+    order = []
+    for g in groups:
+        if g not in order:
+            order.append(g)
+    for g in sorted(order):
+        idx = [i for i, h in enumerate(groups) if h == g]
+        good = [i for i in idx if ws[i] > 0]
+        if not good:
+            report.append("    %-8g %5d %7d %12s %10s" % (
+                g, len(idx), 0, "-", "-"))
+            continue
+        # the means of the points that count, a mean raw reading with the
+        # thrown out ones mixed in isn't the reading at anything
+        mean_raw = sum(pts[i][0] for i in good) / len(good)
+        mean_res = sum(res[i] for i in good) / len(good)
+        report.append("    %-8g %5d %7d %12.1f %10.3f" % (
+            g, len(idx), len(good), mean_raw, mean_res))
+
+    report.append("    %s = %.9g * raw + %.9g, %d of %d points, rms %.3f "
+                  "%s, worst inlier %.3f %s" % (
+                      units, m, b, len(inliers), len(pts), rms, units,
+                      max(abs(r) for r in inliers), units))
+
+    pm, pb = sensor["previous"]
+    prev = [y - (pm * x + pb) for (x, y), w in zip(pts, ws) if w > 0]
+    report.append("    before (%.9g * raw + %.9g): rms %.3f %s over the "
+                  "same points" % (pm, pb, (sum(r * r for r in prev)
+                                            / len(prev)) ** 0.5, units))
+
+    lo, hi = sensor["raw_range"]
+    fx, err = fixed_point(m, b, lo, hi)
+    report.append("    fixed point: bias %d, pre %d, mul %d, shift %d, "
+                  "add %d, off by at most %.4f %s over %d..%d" % (
+                      fx + (err, units, lo, hi)))
+    return dict(name=sensor["name"], desc=sensor["desc"], csv=sensor["csv"],
+                units=units, slope=m, offset=b, rms=rms,
+                nr_inliers=len(inliers), nr_points=len(pts), fixed=fx,
+                fixed_err=err)
+
+
+def fit_all(report):
+    fits = []
+    for ps in calibration.pressure_sensors:
+        report.append("%s (%s), %s:" % (ps["name"], ps["desc"], ps["csv"]))
+        pts, groups = pressure_points(ps, report)
+        fits.append(fit_sensor(ps, pts, groups, report))
+    for lc in calibration.load_cells:
+        report.append("%s (%s), %s:" % (lc["name"], lc["desc"], lc["csv"]))
+        pts, groups = load_cell_points(lc, report)
+        fits.append(fit_sensor(lc, pts, groups, report))
+    return fits
+
+
+def gen_header(fits):
+    scale = calibration.fixed_scale
+    out = ["// " + line for line in BANNER.split("\n")]
+    out += ["",
+            "#ifndef ELET_CALIBRATION_H",
+            "#define ELET_CALIBRATION_H",
+            "",
+            "// each sensor's reading in its units is",
+            "//",
+            "//   raw * ELET_CAL_x_SLOPE + ELET_CAL_x_OFFSET",
+            "//",
+            "// and ELET_CAL_x_FIXED is the same line in integer math, for "
+            "the arduino.",
+            "// It's {bias, pre, mul, shift, add}, and the reading times %d "
+            "is" % scale,
+            "//",
+            "//   ((((raw - bias) >> pre) * mul) >> shift) + add",
+            "//",
+            "// which never overflows an int32_t for a raw reading in the "
+            "sensor's range.",
+            "// See calibration_fixed() in elet.h."]
+    for f in fits:
+        bias, pre, mul, shift, add = f["fixed"]
+        out += ["",
+                "// %s" % f["desc"],
+                "// fit to %s:" % f["csv"],
+                "// %d of %d points, rms %.3f %s, fixed point off by at "
+                "most %.4f %s" % (f["nr_inliers"], f["nr_points"], f["rms"],
+                                  f["units"], f["fixed_err"], f["units"]),
+                "#define ELET_CAL_%s_SLOPE %.9g" % (f["name"], f["slope"]),
+                "#define ELET_CAL_%s_OFFSET %.9g" % (f["name"], f["offset"]),
+                "#define ELET_CAL_%s_FIXED {%dL, %d, %dL, %d, %dL}" % (
+                    f["name"], bias, pre, mul, shift, add)]
+    out += ["",
+            "#define ELET_CAL_FIXED_SCALE %d" % scale,
+            "",
+            "#endif // ELET_CALIBRATION_H"]
+    return "\n".join(out) + "\n"
+
+
+def main():
+    check = "--check" in sys.argv[1:]
+    report = []
+    try:
+        fits = fit_all(report)
+    except (CalibrationError, IOError) as e:
+        print("calibration.py: %s" % e, file=sys.stderr)
+        return 1
+    if not check:
+        print("\n".join(report))
+
+    full = os.path.join(root, OUTPUT)
+    text = gen_header(fits)
+    try:
+        with open(full) as f:
+            old = f.read()
+    except IOError:
+        old = None
+    if old == text:
+        return 0
+    if check:
+        print("%s is stale, rerun %s" % (OUTPUT, sys.argv[0]),
+              file=sys.stderr)
+        return 1
+    with open(full, "w") as f:
+        f.write(text)
+    print("wrote %s" % OUTPUT)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,67 @@
+// how long does the packet CRC take on the arduino? Prints the time per
+// packet for the table-driven CRC in elet.h and, for comparison, avr-libc's
+// bit-twiddling _crc_ccitt_update(), which computes the same CRC.
+
+#include <util/crc16.h>
+
+#include "elet.h"
+
+static uint8_t buf[sizeof(struct message_packet)];
+
+static volatile uint16_t sink;
+
+static void bench(const char *name, size_t len)
+{
+        const int iters = 1000;
+        unsigned long start, table_us, libc_us;
+
+        start = micros();
+        for (int i = 0; i < iters; ++i) {
+                buf[0] = i;
+                sink = elet_crc16_update(ELET_CRC16_INIT, buf, len);
+        }
+        table_us = micros() - start;
+
+        start = micros();
+        for (int i = 0; i < iters; ++i) {
+                uint16_t crc = ELET_CRC16_INIT;
+                buf[0] = i;
+                for (size_t j = 0; j < len; ++j)
+                        crc = _crc_ccitt_update(crc, buf[j]);
+                sink = crc;
+        }
+        libc_us = micros() - start;
+
+        Serial.print(name);
+        Serial.print(F(" ("));
+        Serial.print(len);
+        Serial.print(F(" bytes): table "));
+        Serial.print((float)table_us / iters);
+        Serial.print(F(" us/pkt, _crc_ccitt_update "));
+        Serial.print((float)libc_us / iters);
+        Serial.println(F(" us/pkt"));
+}
+
+void setup()
+{
+        Serial.begin(9600);
+
+        for (size_t i = 0; i < sizeof buf; ++i)
+                buf[i] = i * 37;
+
+        // make sure the two agree before we time anything
+        uint16_t a = elet_crc16_update(ELET_CRC16_INIT, buf, sizeof buf);
+        uint16_t b = ELET_CRC16_INIT;
+        for (size_t i = 0; i < sizeof buf; ++i)
+                b = _crc_ccitt_update(b, buf[i]);
+        if (a != b)
+                Serial.println(F("CRC MISMATCH"));
+
+        bench("data_packet", sizeof(struct data_packet));
+        bench("req_packet", sizeof(struct req_packet));
+        bench("message_packet", sizeof(struct message_packet));
+}
+
+void loop()
+{
+}
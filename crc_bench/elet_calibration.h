@@ -0,0 +1 @@
+../elet_calibration.h
\ No newline at end of file
@@ -9,17 +9,50 @@
 #define ELET_HAVE_UNIX
 #endif
 
-enum valve {
-        OX_ON_OFF = 0,
-        FIRST_VALVE = OX_ON_OFF,
-        OX_BLEED,
-        OX_FLOW,
-        N2_PURGE,
-        N2_ON_OFF,
-        FUEL_FLOW,
-        FUEL_ON_OFF,
-        NR_VALVES,
-};
+#include <stddef.h>
+
+// constant tables that are only ever read go in flash on the arduino, where
+// they have to be read back with the pgm_read_* functions. The mega only
+// has 8 KB of RAM, and anything const that isn't in flash gets copied into
+// it at boot.
+//
+// Strings in flash are elet_str_t, a __FlashStringHelper like F() makes, so
+// Serial.print() knows where to look and nothing else takes them by mistake.
+#ifdef ELET_HAVE_ARDUINO
+#include <avr/pgmspace.h>
+#define ELET_PROGMEM PROGMEM
+#define elet_read_table_u8(p) pgm_read_byte(p)
+#define elet_read_table_u16(p) pgm_read_word(p)
+#define elet_read_table(dst, src, n) memcpy_P(dst, src, n)
+typedef const __FlashStringHelper *elet_str_t;
+#define ELET_STR(p) ((elet_str_t)(p))
+#else
+#define ELET_PROGMEM
+#define elet_read_table_u8(p) (*(p))
+#define elet_read_table_u16(p) (*(p))
+#define elet_read_table(dst, src, n) memcpy(dst, src, n)
+typedef const char *elet_str_t;
+#define ELET_STR(p) (p)
+#endif
+
+// enums, packets and everything else that goes over the wire
+#include "elet_protocol.h"
+
+// the sensor calibrations, fit to the data in the repo by
+// calibration/gen_calibration.py
+#include "elet_calibration.h"
+
+// the pin tables below are constexpr in C++, i.e. on the arduino, so
+// elet_arduino.h can work out things like which IO port a valve is on at
+// compile time. As long as the arduino only ever reads them with an index
+// it knows at compile time, they and the names in them take up no RAM at
+// all; elet_arduino.h keeps copies in flash of the bits it needs to look up
+// at run time.
+#ifdef __cplusplus
+#define ELET_CONSTEXPR constexpr
+#else
+#define ELET_CONSTEXPR const
+#endif
 
 struct valve_properties {
         // the name of this valve
@@ -36,55 +69,55 @@ struct valve_properties {
 };
 
 // 6, 12, 8, 2, 9, 11, 7
-static const struct valve_properties valve_properties[] = {
+static ELET_CONSTEXPR struct valve_properties valve_properties[] = {
         [OX_ON_OFF] = {
-                .name = "oxygen on/off",
-                .short_name = "oxoo",
+                .name = OX_ON_OFF_NAME,
+                .short_name = OX_ON_OFF_SHORT_NAME,
                 .pin = 11,
                 .is_flow = false
         },
         [OX_BLEED] = {
-                .name = "oxygen bleed",
-                .short_name = "oxbl",
+                .name = OX_BLEED_NAME,
+                .short_name = OX_BLEED_SHORT_NAME,
                 .pin = 9,
                 .is_flow = false,
         },
         [OX_FLOW] = {
-                .name = "oxygen flow control",
-                .short_name = "oxfl",
+                .name = OX_FLOW_NAME,
+                .short_name = OX_FLOW_SHORT_NAME,
                 .pin = 2,
                 .is_flow = true
         },
         [N2_PURGE] = {
-                .name = "nitrogen purge",
-                .short_name = "n2pr",
+                .name = N2_PURGE_NAME,
+                .short_name = N2_PURGE_SHORT_NAME,
                 .pin = 7,
                 .is_flow = false
         },
         [N2_ON_OFF] = {
-                .name = "nitrogen on/off",
-                .short_name = "n2oo",
+                .name = N2_ON_OFF_NAME,
+                .short_name = N2_ON_OFF_SHORT_NAME,
                 .pin = 8,
                 .is_flow = false
         },
         [FUEL_FLOW] = {
-                .name = "fuel flow control",
-                .short_name = "fufl",
+                .name = FUEL_FLOW_NAME,
+                .short_name = FUEL_FLOW_SHORT_NAME,
                 .pin = 6,
                 .is_flow = true
         },
         [FUEL_ON_OFF] = {
-                .name = "fuel on/off",
-                .short_name = "fuoo",
+                .name = FUEL_ON_OFF_NAME,
+                .short_name = FUEL_ON_OFF_SHORT_NAME,
                 .pin = 12,
                 .is_flow = false
         }
 };
 
-static inline const char *
+static inline elet_str_t
 valve_name(const enum valve v)
 {
-        return valve_properties[v].name;
+        return valve_to_str(v);
 }
 
 static inline int
@@ -105,13 +138,22 @@ next_valve(enum valve v)
         return (enum valve)((int)v + 1);
 }
 
-enum pressure_sensor {
-        PS_OXYGEN,
-        FIRST_PSENSOR = PS_OXYGEN,
-        PS_FUEL,
-        NR_PSENSORS
+// a calibration line in integer math, see elet_calibration.h
+struct calibration_fixed {
+        int32_t bias;
+        uint8_t pre;
+        int32_t mul;
+        uint8_t shift;
+        int32_t add;
 };
 
+// a raw reading in 1/ELET_CAL_FIXED_SCALE units, without touching floats
+static inline int32_t
+calibration_fixed(const struct calibration_fixed *c, int32_t raw)
+{
+        return ((((raw - c->bias) >> c->pre) * c->mul) >> c->shift) + c->add;
+}
+
 struct pressure_sensor_properties {
         // name of this sensor
         const char *name;
@@ -119,23 +161,28 @@ struct pressure_sensor_properties {
         // pin we use to analogRead from this sensor
         const uint8_t pin;
 
-        // calibration data
+        // calibration data: psi is digital * slope + offset, and fixed is
+        // the same thing in integer math
         const float slope;
         const float offset;
+        const struct calibration_fixed fixed;
 };
 
-static const struct pressure_sensor_properties pressure_sensor_properties[] = {
+static ELET_CONSTEXPR struct pressure_sensor_properties
+pressure_sensor_properties[] = {
         [PS_OXYGEN] = {
-                .name = "oxygen (yellow)",
+                .name = PS_OXYGEN_NAME,
                 .pin = 1,
-                .slope = 1.222,
-                .offset = -250.0
+                .slope = ELET_CAL_PS_OXYGEN_SLOPE,
+                .offset = ELET_CAL_PS_OXYGEN_OFFSET,
+                .fixed = ELET_CAL_PS_OXYGEN_FIXED
         },
         [PS_FUEL] = {
-                .name = "fuel (blue)",
+                .name = PS_FUEL_NAME,
                 .pin = 2,
-                .slope = 1.222,
-                .offset = -250.0
+                .slope = ELET_CAL_PS_FUEL_SLOPE,
+                .offset = ELET_CAL_PS_FUEL_OFFSET,
+                .fixed = ELET_CAL_PS_FUEL_FIXED
         }
 };
 
@@ -150,13 +197,6 @@ struct pressure_reading {
         float analog;
 };
 
-enum thermocouple {
-        TC_OXYGEN,
-        FIRST_THERMOCOUPLE = TC_OXYGEN,
-        TC_WATER,
-        NR_THERMOCOUPLES
-};
-
 struct thermocouple_properties {
         // name of this thermocouple
         const char *name;
@@ -167,15 +207,16 @@ struct thermocouple_properties {
         const int8_t do_pin;
 };
 
-static struct thermocouple_properties thermocouple_properties[] = {
+static ELET_CONSTEXPR struct thermocouple_properties
+thermocouple_properties[] = {
         [TC_OXYGEN] = {
-                .name = "oxygen",
+                .name = TC_OXYGEN_NAME,
                 .clk_pin = 43,
                 .cs_pin = 42, // blue heat shrink
                 .do_pin = 44,
         },
         [TC_WATER] = {
-                .name = "water",
+                .name = TC_WATER_NAME,
                 .clk_pin = 43,
                 .cs_pin = 45, // yellow heat shrink
                 .do_pin = 44,
@@ -197,18 +238,18 @@ struct load_cell_properties {
 
         // load cell calibration data load cell reading in lbf is calculated
         // as load_cell.read() * slope + offset, i.e. as a linear function
-        // of the raw reading.
+        // of the raw reading. fixed is the same thing in integer math.
         float slope;
         float offset;
+        struct calibration_fixed fixed;
 };
 
-static struct load_cell_properties load_cell_props = {
+static ELET_CONSTEXPR struct load_cell_properties load_cell_props = {
         .dout_pin = 39,
         .clk_pin = 38,
-
-        // from slack message from Mike on 12 April 2017
-        .slope = 5.6234*10e-5,
-        .offset = -471.15,
+        .slope = ELET_CAL_LOAD_CELL_SLOPE,
+        .offset = ELET_CAL_LOAD_CELL_OFFSET,
+        .fixed = ELET_CAL_LOAD_CELL_FIXED,
 };
 
 struct igniter {
@@ -237,265 +278,135 @@ struct igniter {
         const uint8_t ignition_sense;
 };
 
-static struct igniter sys_igniter = {
+static ELET_CONSTEXPR struct igniter sys_igniter = {
         .igniter_cont_ctl = 25,
         .igniter_cont_sense = 4,
         .igniter_fire_ctl_be_careful = 5,
         .ignition_sense = 5
 };
 
-enum ignition_status {
-        IGN_SUCCESS,
-        IGN_FAIL_NO_ISENSE_WIRE,
-        IGN_FAIL_BAD_IGNITER,
-        IGN_FAIL_NO_IGNITION,
-        IGN_NUM_STATUSES
+// CRC-16 with the reflected CCITT polynomial (0x8408) and an initial value
+// of 0xffff, i.e. the same thing avr-libc's _crc_ccitt_update() computes a
+// bit at a time. This is the byte-at-a-time table version; it lives in flash
+// on the arduino.
+#define ELET_CRC16_INIT ((uint16_t)0xffff)
+
+static const uint16_t elet_crc16_table[256] ELET_PROGMEM = {
+        0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+        0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+        0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+        0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+        0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+        0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+        0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+        0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+        0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+        0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+        0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+        0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+        0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+        0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+        0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+        0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+        0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+        0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+        0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+        0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+        0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+        0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+        0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+        0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+        0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+        0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+        0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+        0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+        0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+        0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+        0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+        0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78,
 };
 
-static inline const char *
-ignition_status_to_str(const enum ignition_status st)
+static inline uint16_t
+elet_crc16_update(uint16_t crc, const void *buf, size_t len)
 {
-        static const char *map[] = {
-        [IGN_SUCCESS] = "success",
-        [IGN_FAIL_NO_ISENSE_WIRE] =
-                "failed: no ignition sense wire present",
-        [IGN_FAIL_BAD_IGNITER] =
-                "failed: no continuity across igniter",
-        [IGN_FAIL_NO_IGNITION] =
-                "failed: no ignition"
-        };
-
-        if (st < IGN_SUCCESS || st >= IGN_NUM_STATUSES)
-                return "bad ignition status";
-        else
-                return map[st];
-}
-
-// Current state of the entire system. Our state diagram is
-//
-//
-//     SS_DEPRESS 
-//         ^
-//   (7,8) |        (2)
-//         |     ________
-//  (1)    v    /        v
-//  --->  SS_READY       SS_FIRE
-//          ^   ^________/    /
-//     (5,6) \      (3)      / (4)
-//            v             v
-//               SS_SAFING
-//
-// The states have the following semantics and rules:
-//
-//   state       notes
-//  -----------------------------------------------------------------------
-//   SS_READY    This state is the only safe state. In this state it is safe
-//               to approach the engine, but care should still be exercised
-//               in case of other software bugs.
-//
-//               Valves can be be arbitrarily actuated in this state with
-//               the REQ_MOD_VALVE command, but this should be done with
-//               extreme caution, and only in the case of other software
-//               bugs.
-//
-//   SS_FIRE     In this state the engine is firing or attempting to do so.
-//               No one shall approach the engine when it is in this state.
-//
-//   SS_SAFING   In this state the system is shutting the engine off, purging
-//               the engine with nitrogen, and de-pressurizing the oxygen
-//               line. It is not safe to approach the engine in this state,
-//               but this state should be brief.
-//
-//   SS_DEPRESS  In this state we're depressurizing and emptying the fuel
-//               tank. This state is only entered manually, via a REQ_CMD_DEPRESS
-//
-// The state machine has the following transition table:
-//
-//   #    prev       next        reason
-//  -----------------------------------------------------------------------
-//   1    n/a        SS_READY    This is the default state on startup.
-//
-//   2    SS_READY   SS_FIRE     This state transition is triggered by a
-//                               REQ_CMD_START command from the client to the
-//                               system. This state transition represents a
-//                               request to start the engine
-//
-//   3    SS_FIRE    SS_READY    This transition happens when the system is
-//                               told to fire, but there is no continuity
-//                               across the ingiter, so no ignition is
-//                               attempted.
-//
-//   4    SS_FIRE    SS_SAFING   This transition happens when either the burn
-//                               time runs out or someone issues an explicit
-//                               REQ_CMD_STOP.
-//
-//   5    SS_SAFING  SS_READY    This transition happens once automated
-//                               safing is complete.
-//
-//   6    SS_READY   SS_SAFING   This transition happens when someone sends
-//                               a REQ_CMD_STOP while we're in the ready
-//                               state. We might want to do this in the case
-//                               of a power failure or something else weird.
-//
-//   7    SS_READY   SS_DEPRESS  This transitions happens when the arduino
-//                               gets a REQ_CMD_DEPRESS command
-//   
-//   8    SS_DEPRESS SS_READY    This transition when the depressurization
-//                               finishes.
-enum system_state {
-        SS_READY,
-        SS_FIRE,
-        SS_SAFING,
-        SS_DEPRESS,
-        SS_NUM_STATES
-};
+        const uint8_t *p = (const uint8_t *)buf;
 
-// network bullshittery begins here, continue at your own risk
-
-// packet types
-#define PT_DATA ((uint8_t)1)
-#define PT_REQ ((uint8_t)2)
-#define PT_MESSAGE ((uint8_t)3)
-#define PT_HELLO ((uint8_t)4)
-
-// this header is at the start of every packet we send over the wire.
-// Packet parsing code should first parse the length and packet type out of
-// this header, then parse the rest of the packet based on the type. Code
-// should yell when it does not recognize the packet type.
-struct packet_header {
-        // length of this packet in bytes
-        uint16_t len;
-
-        // type of this message. One of the PT_* constants.
-        uint8_t type;
-        uint8_t _pad1;
-
-        // The sequence number of this packet. This field exists so that we
-        // can provide an ordering between sent and recived packets. For
-        // example, when someone issues a PT_REQ packet with a REQ_CMD_START
-        // command (i.e. "start the damn engine"), we want to know when that
-        // command was processed so we can look at the result of the last
-        // ignition in subsequent data packets. However, we don't want to
-        // examine the result-of-last-ignition field until we know for sure
-        // that the command has been processed. This seems like it would be
-        // easy---just wait for the command to send and read the value out
-        // of the next data packet. Howevver, but due to packet buffering
-        // on both ends, "just wait" is not a viable option as the next
-        // data packet may have been sent before we sent our request. Thus
-        // we need a sequence number.
-        //
-        // For packets sent from the server (arduino) to the client (i.e.
-        // PT_DATA and PT_MESSAGE), this number is the sequence number of
-        // the last command processed. For packets sent from the client to
-        // the server (i.e. PT_REQ), this is a sequence number for the
-        // message. The server does not look at it at all, it just pastes
-        // it into all subsequent response headers until a new PT_REQ packet
-        // comes in, then starts using that value.
-        //
-        // Thus it is suggested that the client start with seq = 0 and
-        // increment it by one on every PT_REQ sent to the server. Then the
-        // client should wait until it sees a data packet with seq == seq
-        // of the last command
-        uint32_t seq;
-
-        // this field is the 32 bit millisecond timestamp returned
-        // by millis() at the time this data was gathered. This field is
-        // ignored by the server.
-        uint32_t timestamp;
-};
-
-// this packet is sent from the arduino to the client. It contains the
-// state of the entire system. Be careful when you touch this struct,
-// it's carefully designed to use no padding
-struct data_packet {
-        struct packet_header header;
-
-        // the state of each valve as a bitmap. Index into this bitmap with
-        // integer interpretation of the values of `enum valve`. 0 means
-        // the valve is closed, 1 means the valve is open. For pwm valves,
-        // consult the next two fields to find out how open they are.
-        //
-        // NB: right now we only have 6 valves. If we get more than 8, we
-        // need to change this to a uint16_t
-        uint8_t vlv_states;
-        uint8_t vlv_pwm_ox;
-        uint8_t vlv_pwm_fuel;
-
-        // system state:
-        // * bits 0-2 are the result of the last ignition, packed into 3 bits
-        //   aka an enum ignition_status. (one extra bit in case we add more
-        //   ignition statuses)
-        //
-        // * bits 3-5 are the system state packed into 3 bits aka an enum
-        //   system_state (again, one extra bit in case we add states)
-        //
-        // * bit 6 is the "igniter good" bit. If we have continuity across
-        //   the igniter, this bit is 1, otherwise it is zero. This bit is
-        //   only valid when our system_state is SS_READY, otherwise it is
-        //   zero.
-        //
-        // * bit 7 is reserved/always zero. If a client sees this bit as
-        //   non-zero, it should yell loudly.
-        uint8_t state;
-
-        // data from all of our sensors. IEEE floats.
-        uint16_t pressures[NR_PSENSORS];
-        float temps[NR_THERMOCOUPLES];
-
-        // thrust from the load cell in lbf.
-        uint32_t thrust;
-};
-
-// stop the engine. No arguments
-#define REQ_CMD_STOP ((uint8_t)0)
-
-// start the engine. Argument is the length of the burn in seconds. Must
-// be between 2 and 120
-#define REQ_CMD_START ((uint8_t)1)
-
-#define REQ_CMD_START_MIN_BURN_TIME 2
-#define REQ_CMD_START_MAX_BURN_TIME 120
-
-// do something with a valve. Bits 0-7 of `arg` are which valve (`enum valve`
-// squashed into 8 bits), bits 8-15 are value. 0 means closed, 1 means
-// open for solenoid, and 1-255 mean open to that PWM value for flow ctl
-// valves. If bits 0-7 of arg are 0xff, the rest of the bits are ignored and
-// all valves are turned off.
-//
-// This command is only valid in the SS_DEBUG state.
-#define REQ_MOD_VALVE ((uint8_t)2)
-
-#define REQ_CMD_DEPRESS_MIN_TIMEOUT 15
-#define REQ_CMD_DEPRESS_MAX_TIMEOUT 120
-
-// depressurize the fuel pressure vessel. Argument is drain time in seconds
-#define REQ_CMD_DEPRESS ((uint8_t)3)
+        while (len--)
+                crc = (crc >> 8) ^ elet_read_table_u16(
+                        &elet_crc16_table[(crc ^ *p++) & 0xff]);
+        return crc;
+}
 
-// this packet is sent from the client to the arduino to tell it to do things
-struct req_packet {
-        struct packet_header header;
+#ifdef ELET_HAVE_UNIX
+// on the client we may be chewing through a lot of packets (e.g. replaying
+// logs), so use slicing-by-8 there: table k holds the CRC of a byte followed
+// by k zero bytes, which lets us fold in eight bytes per step.
+static inline const uint16_t *
+elet_crc16_slices(void)
+{
+        static uint16_t slices[8][256];
+        static bool initialized = false;
+
+        if (!initialized) {
+                for (int i = 0; i < 256; ++i)
+                        slices[0][i] = elet_crc16_table[i];
+                for (int k = 1; k < 8; ++k)
+                        for (int i = 0; i < 256; ++i)
+                                slices[k][i] = (slices[k - 1][i] >> 8)
+                                        ^ slices[0][slices[k - 1][i] & 0xff];
+                initialized = true;
+        }
+        return &slices[0][0];
+}
 
-        // the command for this request. one of the REQ_CMD_* constants.
-        uint8_t cmd;
-        uint8_t _pad1[3];
+static inline uint16_t
+elet_crc16_update_fast(uint16_t crc, const void *buf, size_t len)
+{
+        const uint16_t *t = elet_crc16_slices();
+        const uint8_t *p = (const uint8_t *)buf;
+
+        for (; len >= 8; len -= 8, p += 8) {
+                crc ^= p[0] | (p[1] << 8);
+                crc = t[7*256 + (crc & 0xff)] ^ t[6*256 + (crc >> 8)]
+                        ^ t[5*256 + p[2]] ^ t[4*256 + p[3]]
+                        ^ t[3*256 + p[4]] ^ t[2*256 + p[5]]
+                        ^ t[1*256 + p[6]] ^ t[p[7]];
+        }
 
-        // argument See REQ_CMD_* for details
-        uint32_t arg;
-};
+        return elet_crc16_update(crc, p, len);
+}
+#else
+#define elet_crc16_update_fast elet_crc16_update
+#endif
 
-// this packet is sent from the arduino to the client to share diagnostic
-// information in string formats. This packet is sent sparingly due to its
-// space overhead.
-struct message_packet {
-        struct packet_header header;
+// CRC of a whole packet, with the crc field in its header taken to be zero
+static inline uint16_t
+elet_packet_crc(const void *pkt, uint16_t len)
+{
+        const uint8_t *p = (const uint8_t *)pkt;
+        const size_t off = offsetof(struct packet_header, crc);
+        const uint16_t zero = 0;
+        uint16_t crc = ELET_CRC16_INIT;
+
+        crc = elet_crc16_update_fast(crc, p, off);
+        crc = elet_crc16_update_fast(crc, &zero, sizeof zero);
+        return elet_crc16_update_fast(crc, p + off + sizeof zero,
+                                      len - off - sizeof zero);
+}
 
-        // ascii null-terminated string. All bytes after null are undefined.
-        uint8_t data[256];
-};
+// fill in the crc field of a packet. Do this last, after everything else
+// in the packet is filled in.
+static inline void
+elet_seal_packet(struct packet_header *hdr)
+{
+        hdr->crc = elet_packet_crc(hdr, hdr->len);
+}
 
-struct hello_packet {
-        struct packet_header header;
-};
+static inline bool
+elet_packet_crc_ok(const struct packet_header *hdr)
+{
+        return hdr->crc == elet_packet_crc(hdr, hdr->len);
+}
 
 #define ELET_NET_ADDR ((192UL << 24) | (168UL << 16) | (1UL << 8) | 100UL)
 
@@ -6,22 +6,179 @@
 // code on the client, e.g. my laptop.
 
 #include <Ethernet2.h>
+#include <utility/w5500.h>
 #include <Adafruit_MAX31855.h>
 #include <Q2HX711.h>
 
 #include "elet.h"
 
-        
+// the IO port and bit behind every pin number on the mega (ATmega2560), from
+// the mega's pins_arduino.h. digitalWrite() digs these out of flash on
+// every call, along with a check for whether it has to turn off PWM on the
+// pin. We only ever look at this table at compile time, so it doesn't take
+// up any memory.
+enum mega_port {
+        MEGA_PORTA,
+        MEGA_PORTB,
+        MEGA_PORTC,
+        MEGA_PORTD,
+        MEGA_PORTE,
+        MEGA_PORTF,
+        MEGA_PORTG,
+        MEGA_PORTH,
+        MEGA_PORTJ,
+        MEGA_PORTK,
+        MEGA_PORTL,
+        NR_MEGA_PORTS
+};
+
+#define MEGA_PIN(port, bit) (MEGA_PORT##port << 3 | (bit))
+
+static constexpr uint8_t mega_pins[] = {
+        MEGA_PIN(E, 0), MEGA_PIN(E, 1), MEGA_PIN(E, 4), MEGA_PIN(E, 5), // 0
+        MEGA_PIN(G, 5), MEGA_PIN(E, 3), MEGA_PIN(H, 3), MEGA_PIN(H, 4), // 4
+        MEGA_PIN(H, 5), MEGA_PIN(H, 6), MEGA_PIN(B, 4), MEGA_PIN(B, 5), // 8
+        MEGA_PIN(B, 6), MEGA_PIN(B, 7), MEGA_PIN(J, 1), MEGA_PIN(J, 0), // 12
+        MEGA_PIN(H, 1), MEGA_PIN(H, 0), MEGA_PIN(D, 3), MEGA_PIN(D, 2), // 16
+        MEGA_PIN(D, 1), MEGA_PIN(D, 0), MEGA_PIN(A, 0), MEGA_PIN(A, 1), // 20
+        MEGA_PIN(A, 2), MEGA_PIN(A, 3), MEGA_PIN(A, 4), MEGA_PIN(A, 5), // 24
+        MEGA_PIN(A, 6), MEGA_PIN(A, 7), MEGA_PIN(C, 7), MEGA_PIN(C, 6), // 28
+        MEGA_PIN(C, 5), MEGA_PIN(C, 4), MEGA_PIN(C, 3), MEGA_PIN(C, 2), // 32
+        MEGA_PIN(C, 1), MEGA_PIN(C, 0), MEGA_PIN(D, 7), MEGA_PIN(G, 2), // 36
+        MEGA_PIN(G, 1), MEGA_PIN(G, 0), MEGA_PIN(L, 7), MEGA_PIN(L, 6), // 40
+        MEGA_PIN(L, 5), MEGA_PIN(L, 4), MEGA_PIN(L, 3), MEGA_PIN(L, 2), // 44
+        MEGA_PIN(L, 1), MEGA_PIN(L, 0), MEGA_PIN(B, 3), MEGA_PIN(B, 2), // 48
+        MEGA_PIN(B, 1), MEGA_PIN(B, 0), MEGA_PIN(F, 0), MEGA_PIN(F, 1), // 52
+        MEGA_PIN(F, 2), MEGA_PIN(F, 3), MEGA_PIN(F, 4), MEGA_PIN(F, 5), // 56
+        MEGA_PIN(F, 6), MEGA_PIN(F, 7), MEGA_PIN(K, 0), MEGA_PIN(K, 1), // 60
+        MEGA_PIN(K, 2), MEGA_PIN(K, 3), MEGA_PIN(K, 4), MEGA_PIN(K, 5), // 64
+        MEGA_PIN(K, 6), MEGA_PIN(K, 7),                                 // 68
+};
+
+static_assert(sizeof mega_pins == 70, "the mega has 70 pins");
+
+struct port_bit {
+        uint8_t port;
+        uint8_t mask;
+};
+
+static constexpr struct port_bit
+pin_port_bit(uint8_t pin)
+{
+        return {(uint8_t)(mega_pins[pin] >> 3),
+                (uint8_t)(1 << (mega_pins[pin] & 7))};
+}
+
+#define VALVE_PORT_BIT(v) [v] = pin_port_bit(valve_properties[v].pin)
+
+// where each valve is, worked out from the pins in valve_properties at
+// compile time, and kept in flash. Only the solenoids use these, the flow
+// control valves are driven by PWM.
+static constexpr struct port_bit valve_ports[] ELET_PROGMEM = {
+        VALVE_PORT_BIT(OX_ON_OFF),
+        VALVE_PORT_BIT(OX_BLEED),
+        VALVE_PORT_BIT(OX_FLOW),
+        VALVE_PORT_BIT(N2_PURGE),
+        VALVE_PORT_BIT(N2_ON_OFF),
+        VALVE_PORT_BIT(FUEL_FLOW),
+        VALVE_PORT_BIT(FUEL_ON_OFF),
+};
+
+static_assert(sizeof valve_ports / sizeof valve_ports[0] == NR_VALVES,
+              "valve_ports is missing a valve");
+
+// valve bitmaps, e.g. for set_valves(), are a uint8_t
+static_assert(NR_VALVES <= 8, "too many valves for a uint8_t bitmap");
+
+#define VALVE_BIT(v) ((uint8_t)(1 << (v)))
+#define ALL_VALVES ((uint8_t)((1 << NR_VALVES) - 1))
+
+static inline struct port_bit
+valve_port_bit(enum valve v)
+{
+        return {elet_read_table_u8(&valve_ports[v].port),
+                elet_read_table_u8(&valve_ports[v].mask)};
+}
+
+// the rest of what the valve code needs to know about a valve it only finds
+// out about at run time. Reading valve_properties[v] instead would put the
+// whole table in RAM, names and all.
+#define VALVE_PIN(v) [v] = valve_properties[v].pin
+#define VALVE_FLOW_BIT(v) (valve_properties[v].is_flow ? VALVE_BIT(v) : 0)
+
+static constexpr uint8_t valve_pins[] ELET_PROGMEM = {
+        VALVE_PIN(OX_ON_OFF),
+        VALVE_PIN(OX_BLEED),
+        VALVE_PIN(OX_FLOW),
+        VALVE_PIN(N2_PURGE),
+        VALVE_PIN(N2_ON_OFF),
+        VALVE_PIN(FUEL_FLOW),
+        VALVE_PIN(FUEL_ON_OFF),
+};
+
+static_assert(sizeof valve_pins == NR_VALVES, "valve_pins is missing a valve");
+
+static constexpr uint8_t flow_valves = VALVE_FLOW_BIT(OX_ON_OFF)
+        | VALVE_FLOW_BIT(OX_BLEED) | VALVE_FLOW_BIT(OX_FLOW)
+        | VALVE_FLOW_BIT(N2_PURGE) | VALVE_FLOW_BIT(N2_ON_OFF)
+        | VALVE_FLOW_BIT(FUEL_FLOW) | VALVE_FLOW_BIT(FUEL_ON_OFF);
+
+static inline uint8_t valve_pin_P(enum valve v)
+{
+        return elet_read_table_u8(&valve_pins[v]);
+}
+
+static inline bool valve_is_flow_P(enum valve v)
+{
+        return flow_valves & VALVE_BIT(v);
+}
+
+static inline volatile uint8_t *
+mega_port_reg(uint8_t port)
+{
+        switch (port) {
+        case MEGA_PORTA: return &PORTA;
+        case MEGA_PORTB: return &PORTB;
+        case MEGA_PORTC: return &PORTC;
+        case MEGA_PORTD: return &PORTD;
+        case MEGA_PORTE: return &PORTE;
+        case MEGA_PORTF: return &PORTF;
+        case MEGA_PORTG: return &PORTG;
+        case MEGA_PORTH: return &PORTH;
+        case MEGA_PORTJ: return &PORTJ;
+        case MEGA_PORTK: return &PORTK;
+        default: return &PORTL;
+        }
+}
+
+// set and clear bits in a port in one write. Ports H and up are outside of
+// the range sbi/cbi can get at, so this is a read-modify-write, and we keep
+// interrupts off over it so an ISR touching the same port can't sneak in
+// between the read and the write, same as digitalWrite() does.
+static inline void
+mega_port_write(uint8_t port, uint8_t set, uint8_t clear)
+{
+        volatile uint8_t *reg = mega_port_reg(port);
+        uint8_t sreg = SREG;
+
+        cli();
+        *reg = (*reg & ~clear) | set;
+        SREG = sreg;
+}
+
 // 0 == closed, 1 = open for solenoids, 1-255 is PWM for flow ctls
 static uint8_t valve_states[NR_VALVES] = {0};
 
 static inline void
 close_valve(enum valve v)
 {
-        if (valve_is_flow(v))
-                analogWrite(valve_properties[v].pin, 0);
-        else
-                digitalWrite(valve_properties[v].pin, 0);
+        if (valve_is_flow_P(v)) {
+                analogWrite(valve_pin_P(v), 0);
+        } else {
+                const struct port_bit pb = valve_port_bit(v);
+
+                mega_port_write(pb.port, 0, pb.mask);
+        }
 
         valve_states[v] = 0;
 }
@@ -29,20 +186,66 @@ close_valve(enum valve v)
 static inline void
 open_valve(enum valve v)
 {
-        if (valve_is_flow(v)) {
-                analogWrite(valve_properties[v].pin, 255);
+        if (valve_is_flow_P(v)) {
+                analogWrite(valve_pin_P(v), 255);
                 valve_states[v] = 255;
         } else {
-                digitalWrite(valve_properties[v].pin, 1);
+                const struct port_bit pb = valve_port_bit(v);
+
+                mega_port_write(pb.port, pb.mask, 0);
                 valve_states[v] = 1;
         }
 }
 
+// open the valves in the bitmap open and close the ones in close, all at
+// once: every solenoid on the same port changes in the same write, and the
+// ports are written back to back with nothing in between. Flow control
+// valves go fully open or closed with analogWrite() first.
+static inline void
+set_valves(uint8_t open, uint8_t close)
+{
+        uint8_t set[NR_MEGA_PORTS] = {0};
+        uint8_t clear[NR_MEGA_PORTS] = {0};
+
+        for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v)) {
+                const struct port_bit pb = valve_port_bit(v);
+
+                if (!((open | close) & VALVE_BIT(v)))
+                        continue;
+
+                if (valve_is_flow_P(v)) {
+                        if (open & VALVE_BIT(v))
+                                open_valve(v);
+                        else
+                                close_valve(v);
+                } else if (open & VALVE_BIT(v)) {
+                        set[pb.port] |= pb.mask;
+                        valve_states[v] = 1;
+                } else {
+                        clear[pb.port] |= pb.mask;
+                        valve_states[v] = 0;
+                }
+        }
+
+        uint8_t sreg = SREG;
+        cli();
+        for (uint8_t p = 0; p < NR_MEGA_PORTS; ++p) {
+                volatile uint8_t *reg;
+
+                if (!(set[p] | clear[p]))
+                        continue;
+
+                reg = mega_port_reg(p);
+                *reg = (*reg & ~clear[p]) | set[p];
+        }
+        SREG = sreg;
+}
+
 static inline void
 open_valve_to(enum valve v, uint8_t val)
 {
-        if (valve_is_flow(v)) {
-                analogWrite(valve_properties[v].pin, val);
+        if (valve_is_flow_P(v)) {
+                analogWrite(valve_pin_P(v), val);
                 valve_states[v] = val;
         }
 }
@@ -51,22 +254,52 @@ static inline void
 setup_all_valves()
 {
         for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v)) {
-                pinMode(valve_properties[v].pin, OUTPUT);
+                pinMode(valve_pin_P(v), OUTPUT);
+
+                // most of the solenoid pins can do PWM too. The port writes
+                // above only work if the timer isn't driving the pin, which
+                // digitalWrite() makes sure of.
+                if (!valve_is_flow_P(v))
+                        digitalWrite(valve_pin_P(v), LOW);
+
                 valve_states[v] = 0;
                 close_valve(v);
         }
 }
 
+// like the valves, what we look up about a pressure sensor at run time
+#define PSENSOR_PIN(ps) [ps] = pressure_sensor_properties[ps].pin
+#define PSENSOR_CAL(ps) [ps] = pressure_sensor_properties[ps].fixed
+
+static constexpr uint8_t psensor_pins[] ELET_PROGMEM = {
+        PSENSOR_PIN(PS_OXYGEN),
+        PSENSOR_PIN(PS_FUEL),
+};
+
+static constexpr struct calibration_fixed psensor_cals[] ELET_PROGMEM = {
+        PSENSOR_CAL(PS_OXYGEN),
+        PSENSOR_CAL(PS_FUEL),
+};
+
+static_assert(sizeof psensor_pins == NR_PSENSORS,
+              "psensor_pins is missing a sensor");
+
+static inline uint8_t pressure_sensor_pin_P(enum pressure_sensor p)
+{
+        return elet_read_table_u8(&psensor_pins[p]);
+}
+
 static inline struct pressure_reading
 read_pressure(enum pressure_sensor p)
 {
         struct pressure_reading r;
-        const struct pressure_sensor_properties *props =
-                pressure_sensor_properties + (int)p;
+        struct calibration_fixed cal;
+
+        elet_read_table(&cal, &psensor_cals[p], sizeof cal);
+        r.digital = analogRead(pressure_sensor_pin_P(p));
+        r.analog = calibration_fixed(&cal, r.digital)
+                * (1.0f / ELET_CAL_FIXED_SCALE);
 
-        r.digital = analogRead(props->pin);
-        r.analog = props->slope * r.digital + props->offset;
-        
         return r;
 }
 
@@ -101,8 +334,8 @@ static inline long read_load_cell()
 
 static inline float read_load_cell_calibrated()
 {
-        return read_load_cell()*load_cell_props.slope
-                + load_cell_props.offset;
+        return calibration_fixed(&load_cell_props.fixed, read_load_cell())
+                * (1.0f / ELET_CAL_FIXED_SCALE);
 }
 
 static enum ignition_status last_ign_status = IGN_NUM_STATUSES;
@@ -148,7 +381,7 @@ igniter_test_fire()
 
         continuity = igniter_test_continuity();
 
-        Serial.print("igniter continuity was ");
+        Serial.print(F("igniter continuity was "));
         Serial.println(continuity);
 
         // okay we have a bad igniter: no current is flowing through it
@@ -186,4 +419,331 @@ out:
 
 #define FUEL_DRAIN_TIME_SECONDS 120
 
+// the W5500 has 16K of TX memory and 16K of RX memory, and Ethernet2 splits
+// both evenly, 2K a socket. All we ever receive are 24 and 28 byte
+// commands, so 1K of RX is plenty. TX memory is what lets a client fall
+// behind for a moment without losing telemetry, so it goes where the
+// clients are: the W5500 hands out the lowest closed socket, so the first
+// client to connect (normally the commander) gets socket 0, the next one
+// socket 1, and so on. Every socket keeps some, since the listening socket
+// moves up as clients take the ones below it.
+//
+// Ethernet2 already clocks SPI at F_CPU / 2, as fast as the mega goes, and
+// writes a whole buffer in one SPI burst, so there's nothing to win there.
+// What costs is every write() being its own burst and SEND command, see
+// broadcast_packet() in launch_server.ino.
+#define ETH_RX_KB 1
+
+static constexpr uint8_t eth_tx_kb[MAX_SOCK_NUM] ELET_PROGMEM = {
+        4, 4, 2, 2, 1, 1, 1, 1
+};
+
+static constexpr unsigned eth_tx_total(unsigned s)
+{
+        return s == MAX_SOCK_NUM ? 0 : eth_tx_kb[s] + eth_tx_total(s + 1);
+}
+
+static_assert(eth_tx_total(0) <= 16, "the W5500 only has 16K of TX memory");
+static_assert(ETH_RX_KB * MAX_SOCK_NUM <= 16,
+              "the W5500 only has 16K of RX memory");
+
+// bring up the W5500 on ELET_NET_ADDR with the buffers laid out like
+// above. Call this before starting a server, the sizes have to be set
+// before a socket opens.
+static inline void eth_setup()
+{
+        byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED};
+        IPAddress ip((ELET_NET_ADDR & (0xffUL << 24)) >> 24,
+                     (ELET_NET_ADDR & (0xffUL << 16)) >> 16,
+                     (ELET_NET_ADDR & (0xffUL << 8)) >> 8,
+                      ELET_NET_ADDR & (0xffUL));
+
+        Ethernet.begin(mac, ip);
+
+        for (SOCKET s = 0; s < MAX_SOCK_NUM; ++s) {
+                w5500.writeSnRX_SIZE(s, ETH_RX_KB);
+                w5500.writeSnTX_SIZE(s, elet_read_table_u8(&eth_tx_kb[s]));
+        }
+}
+
+// hand a client len bytes if its socket has room for all of them, without
+// waiting for it to drain. Returns len if they went out, 0 if there wasn't
+// room, or -1 if the write came up short because the client is gone.
+static inline int eth_try_write(EthernetClient *client, const void *buf,
+                                uint16_t len)
+{
+        if (w5500.getTXFreeSize(client->getSocketNumber()) < len)
+                return 0;
+
+        if (client->write((const uint8_t *)buf, len) != len)
+                return -1;
+
+        return len;
+}
+
+// streaming readings off the bench, for calibration. Printing floats at
+// 9600 baud gets a handful of points per setpoint; this samples the
+// channels asked for at a fixed rate and sends each sample as a
+// bench_packet, which launch_client/bench_capture.py turns into a CSV.
+//
+// Call bench_stream_begin() from setup() and bench_stream_poll() from
+// loop(), as often as possible and with no delay()s. Type the setpoint,
+// e.g. the gauge pressure or the mass on the load cell, followed by a
+// return, and every sample after that is tagged with it.
+#define BENCH_BAUD 500000
+
+#define BENCH_BIT(ch) ((uint8_t)(1 << (ch)))
+
+struct bench_stream {
+        uint32_t period_us;
+        uint32_t next_us;
+        uint32_t samples;
+
+        // since the last packet that went out
+        uint16_t dropped;
+
+        char line[16];
+        uint8_t line_len;
+
+        // the last sample, so the load cell's reading carries over
+        struct bench_packet pkt;
+};
+
+static struct bench_stream bench;
+
+// channels is a bitmap of BENCH_BIT()s
+static inline void bench_stream_begin(uint8_t channels, uint16_t rate_hz)
+{
+        Serial.begin(BENCH_BAUD);
+
+        memset(&bench, 0, sizeof bench);
+        bench.period_us = 1000000UL / rate_hz;
+        bench.next_us = micros();
+        bench.pkt.header.len = sizeof bench.pkt;
+        bench.pkt.header.type = PT_BENCH;
+        bench.pkt.channels = channels;
+}
+
+static inline void bench_read_setpoint()
+{
+        int c;
+
+        while ((c = Serial.read()) != -1) {
+                if (c == '\r' || c == '\n') {
+                        if (bench.line_len)
+                                bench.pkt.setpoint = atof(bench.line);
+                        bench.line_len = 0;
+                } else if (bench.line_len < sizeof bench.line - 1) {
+                        bench.line[bench.line_len++] = c;
+                }
+                bench.line[bench.line_len] = '\0';
+        }
+}
+
+static inline void bench_stream_poll()
+{
+        struct bench_packet *p = &bench.pkt;
+        uint32_t now;
+
+        bench_read_setpoint();
+
+        now = micros();
+        if ((int32_t)(now - bench.next_us) < 0)
+                return;
+
+        // stay on the same grid even if we're late, and count any samples
+        // we were too late for as dropped
+        bench.next_us += bench.period_us;
+        while ((int32_t)(now - bench.next_us) >= 0) {
+                bench.next_us += bench.period_us;
+                ++bench.samples;
+                if (bench.dropped != 0xffff)
+                        ++bench.dropped;
+        }
+
+        p->us = now;
+        p->fresh = 0;
+        for (enum pressure_sensor ps = FIRST_PSENSOR; ps < NR_PSENSORS;
+             ps = next_pressure_sensor(ps)) {
+                const uint8_t ch = ps == PS_OXYGEN ? BENCH_OX : BENCH_FUEL;
+
+                if (!(p->channels & BENCH_BIT(ch)))
+                        continue;
+                p->pressures[ps] = analogRead(pressure_sensor_pin_P(ps));
+                p->fresh |= BENCH_BIT(ch);
+        }
+
+        // read() waits for a new reading, which would hold up everything
+        // else for up to 100 ms
+        if (p->channels & BENCH_BIT(BENCH_LOAD_CELL)
+            && load_cell.readyToSend()) {
+                p->load_cell = read_load_cell();
+                p->fresh |= BENCH_BIT(BENCH_LOAD_CELL);
+        }
+
+        p->header.seq = bench.samples++;
+        if (Serial.availableForWrite() < (int)sizeof *p) {
+                if (bench.dropped != 0xffff)
+                        ++bench.dropped;
+                return;
+        }
+
+        p->header.timestamp = millis();
+        p->dropped = bench.dropped;
+        elet_seal_packet(&p->header);
+        Serial.write((const uint8_t *)p, sizeof *p);
+        bench.dropped = 0;
+}
+
+// calibrating a flow control valve: set it to a PWM value and wait for the
+// pressure to settle, however long that takes and no longer, then record
+// where it settled and how it got there. Settled means the variance of the
+// last SWEEP_WINDOW samples is under SWEEP_SETTLED_VAR. A slow ramp can
+// have a small variance too, so the two halves of the window also have to
+// agree to within a count. The window that passes still has the end of
+// the transient in it, so the settled value is the mean of the next
+// SWEEP_WINDOW samples after that.
+#define SWEEP_SAMPLE_MS 5
+#define SWEEP_WINDOW 32
+#define SWEEP_SETTLED_VAR 4
+#define SWEEP_TIMEOUT_MS 30000
+
+// samples of the transient to keep, from when the valve moved
+#define SWEEP_TRANSIENT_LEN 128
+
+struct sweep_step {
+        uint8_t pwm;
+
+        // false if it hit SWEEP_TIMEOUT_MS first
+        bool settled;
+
+        // raw counts: just before the valve moved, the farthest from that
+        // it got on the way, and the mean and variance once settled
+        uint16_t start;
+        uint16_t peak;
+        float mean;
+        float var;
+
+        // from the valve moving to 90% of the way to mean, and to settled.
+        // t90_ms is 0 if it didn't move, 0xffff if it got there after the
+        // transient we kept.
+        uint16_t t90_ms;
+        uint16_t settle_ms;
+
+        // SWEEP_SAMPLE_MS apart. 256 bytes, which is a lot of stack on the
+        // mega, so keep the step in a static like flow_sweep does and pass
+        // it around by pointer.
+        uint8_t nr_transient;
+        uint16_t transient[SWEEP_TRANSIENT_LEN];
+};
+
+struct sweep_window {
+        uint16_t c[SWEEP_WINDOW];
+        uint8_t n;
+        uint8_t next;
+        uint32_t sum;
+
+        // 32 * 1023^2 fits
+        uint32_t sumsq;
+};
+
+static inline void sweep_window_add(struct sweep_window *w, uint16_t c)
+{
+        if (w->n == SWEEP_WINDOW) {
+                w->sum -= w->c[w->next];
+                w->sumsq -= (uint32_t)w->c[w->next] * w->c[w->next];
+        } else {
+                ++w->n;
+        }
+        w->c[w->next] = c;
+        w->sum += c;
+        w->sumsq += (uint32_t)c * c;
+        w->next = (w->next + 1) % SWEEP_WINDOW;
+}
+
+static inline bool sweep_window_settled(const struct sweep_window *w)
+{
+        const uint32_t n = SWEEP_WINDOW;
+        int32_t halves = 0;
+
+        if (w->n < SWEEP_WINDOW)
+                return false;
+
+        // n^2 var = n sumsq - sum^2, and 32 * 32 * 1023^2 fits too
+        if (n * w->sumsq - w->sum * w->sum > SWEEP_SETTLED_VAR * n * n)
+                return false;
+
+        for (uint8_t i = 0; i < SWEEP_WINDOW; ++i) {
+                const uint16_t c = w->c[(w->next + i) % SWEEP_WINDOW];
+                halves += i < SWEEP_WINDOW / 2 ? c : -(int32_t)c;
+        }
+        return halves >= -(int32_t)(SWEEP_WINDOW / 2)
+                && halves <= (int32_t)(SWEEP_WINDOW / 2);
+}
+
+static inline uint16_t sweep_sample(struct sweep_step *step, uint8_t pin)
+{
+        delay(SWEEP_SAMPLE_MS);
+
+        const uint16_t c = analogRead(pin);
+
+        if (step->nr_transient < SWEEP_TRANSIENT_LEN)
+                step->transient[step->nr_transient++] = c;
+        if (abs((int)c - step->start) > abs((int)step->peak - step->start))
+                step->peak = c;
+        return c;
+}
+
+// move flow control valve v to pwm and wait for pressure sensor ps to
+// settle
+static inline bool
+sweep_settle(enum valve v, enum pressure_sensor ps, uint8_t pwm,
+             struct sweep_step *step)
+{
+        const uint8_t pin = pressure_sensor_pin_P(ps);
+        struct sweep_window w;
+        unsigned long start_ms;
+
+        memset(step, 0, sizeof *step);
+        memset(&w, 0, sizeof w);
+        step->pwm = pwm;
+        step->start = step->peak = analogRead(pin);
+
+        open_valve_to(v, pwm);
+        start_ms = millis();
+
+        while (!sweep_window_settled(&w)) {
+                if (millis() - start_ms >= SWEEP_TIMEOUT_MS)
+                        break;
+                sweep_window_add(&w, sweep_sample(step, pin));
+        }
+        step->settled = sweep_window_settled(&w);
+        step->settle_ms = millis() - start_ms;
+
+        memset(&w, 0, sizeof w);
+        while (w.n < SWEEP_WINDOW)
+                sweep_window_add(&w, sweep_sample(step, pin));
+
+        step->mean = (float)w.sum / w.n;
+        step->var = ((float)w.sumsq - (float)w.sum * w.sum / w.n) / w.n;
+
+        // how far it went, in tenths of a count
+        const long moved = lround((step->mean - step->start) * 10);
+        if (labs(moved) >= 10) {
+                step->t90_ms = 0xffff;
+                for (uint8_t i = 0; i < step->nr_transient; ++i) {
+                        const long d = ((long)step->transient[i]
+                                        - step->start) * 10;
+
+                        if (moved > 0 ? d * 10 >= moved * 9
+                            : d * 10 <= moved * 9) {
+                                step->t90_ms = (i + 1) * SWEEP_SAMPLE_MS;
+                                break;
+                        }
+                }
+        }
+
+        return step->settled;
+}
+
 #endif // ELET_ARDUINO_H
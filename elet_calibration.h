@@ -0,0 +1,42 @@
+// generated by calibration/gen_calibration.py from calibration/calibration.py.
+// Don't edit by hand.
+
+#ifndef ELET_CALIBRATION_H
+#define ELET_CALIBRATION_H
+
+// each sensor's reading in its units is
+//
+//   raw * ELET_CAL_x_SLOPE + ELET_CAL_x_OFFSET
+//
+// and ELET_CAL_x_FIXED is the same line in integer math, for the arduino.
+// It's {bias, pre, mul, shift, add}, and the reading times 16 is
+//
+//   ((((raw - bias) >> pre) * mul) >> shift) + add
+//
+// which never overflows an int32_t for a raw reading in the sensor's range.
+// See calibration_fixed() in elet.h.
+
+// P1, yellow tape, SN 062716D005
+// fit to pressure_sensor_calibration/p1_09_32_am.csv:
+// 365 of 368 points, rms 1.495 psi, fixed point off by at most 0.0341 psi
+#define ELET_CAL_PS_OXYGEN_SLOPE 1.19341039
+#define ELET_CAL_PS_OXYGEN_OFFSET -247.96618
+#define ELET_CAL_PS_OXYGEN_FIXED {0L, 0, 1251381L, 16, -3967L}
+
+// P2, blue tape, SN 041116D204
+// fit to pressure_sensor_calibration/p2_09_18_am.csv:
+// 398 of 398 points, rms 1.657 psi, fixed point off by at most 0.0329 psi
+#define ELET_CAL_PS_FUEL_SLOPE 1.19300113
+#define ELET_CAL_PS_FUEL_OFFSET -247.470438
+#define ELET_CAL_PS_FUEL_FIXED {0L, 0, 1250952L, 16, -3959L}
+
+// load cell on the HX711, 11 April 2017
+// fit to load_cell_amp/4_11_load_cell_calib.csv:
+// 190 of 314 points, rms 0.173 lbf, fixed point off by at most 0.0625 lbf
+#define ELET_CAL_LOAD_CELL_SLOPE 5.65787289e-05
+#define ELET_CAL_LOAD_CELL_OFFSET -474.312792
+#define ELET_CAL_LOAD_CELL_FIXED {0L, 5, 3797L, 17, -7589L}
+
+#define ELET_CAL_FIXED_SCALE 16
+
+#endif // ELET_CALIBRATION_H
@@ -0,0 +1,1436 @@
+// generated by protocol/gen_protocol.py from protocol/protocol.py.
+// Don't edit by hand.
+
+#ifndef ELET_PROTOCOL_H
+#define ELET_PROTOCOL_H
+
+// the wire format shared by the arduino and the client: enums that go over
+// the wire, packet types and layouts, and accessors for the bitfields in
+// them. Everything here comes from protocol/protocol.py.
+//
+// Include elet.h rather than this, the *_to_str() functions need its
+// ELET_PROGMEM and elet_str_t.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// _Static_assert is C11, and the client tools are C99. For those an array
+// with a negative size does the same job, and redeclaring the same extern
+// array as often as we like is fine.
+#if defined(__cplusplus)
+#define ELET_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define ELET_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#else
+#define ELET_STATIC_ASSERT(cond, msg) \
+        extern char elet_static_assert[(cond) ? 1 : -1]
+#endif
+
+enum valve {
+        OX_ON_OFF = 0,
+        FIRST_VALVE = OX_ON_OFF,
+        OX_BLEED,
+        OX_FLOW,
+        N2_PURGE,
+        N2_ON_OFF,
+        FUEL_FLOW,
+        FUEL_ON_OFF,
+        NR_VALVES
+};
+
+#define OX_ON_OFF_NAME "oxygen on/off"
+#define OX_ON_OFF_SHORT_NAME "oxoo"
+#define OX_BLEED_NAME "oxygen bleed"
+#define OX_BLEED_SHORT_NAME "oxbl"
+#define OX_FLOW_NAME "oxygen flow control"
+#define OX_FLOW_SHORT_NAME "oxfl"
+#define N2_PURGE_NAME "nitrogen purge"
+#define N2_PURGE_SHORT_NAME "n2pr"
+#define N2_ON_OFF_NAME "nitrogen on/off"
+#define N2_ON_OFF_SHORT_NAME "n2oo"
+#define FUEL_FLOW_NAME "fuel flow control"
+#define FUEL_FLOW_SHORT_NAME "fufl"
+#define FUEL_ON_OFF_NAME "fuel on/off"
+#define FUEL_ON_OFF_SHORT_NAME "fuoo"
+
+static inline elet_str_t
+valve_to_str(const enum valve v)
+{
+        static const char names[] ELET_PROGMEM =
+                OX_ON_OFF_NAME "\0"
+                OX_BLEED_NAME "\0"
+                OX_FLOW_NAME "\0"
+                N2_PURGE_NAME "\0"
+                N2_ON_OFF_NAME "\0"
+                FUEL_FLOW_NAME "\0"
+                FUEL_ON_OFF_NAME "\0"
+                "bad valve";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [OX_ON_OFF] = 0,
+                [OX_BLEED] = 14,
+                [OX_FLOW] = 27,
+                [N2_PURGE] = 47,
+                [N2_ON_OFF] = 62,
+                [FUEL_FLOW] = 78,
+                [FUEL_ON_OFF] = 96,
+                [NR_VALVES] = 108,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_VALVES)
+                i = NR_VALVES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+valve_to_short_str(const enum valve v)
+{
+        static const char names[] ELET_PROGMEM =
+                OX_ON_OFF_SHORT_NAME "\0"
+                OX_BLEED_SHORT_NAME "\0"
+                OX_FLOW_SHORT_NAME "\0"
+                N2_PURGE_SHORT_NAME "\0"
+                N2_ON_OFF_SHORT_NAME "\0"
+                FUEL_FLOW_SHORT_NAME "\0"
+                FUEL_ON_OFF_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [OX_ON_OFF] = 0,
+                [OX_BLEED] = 5,
+                [OX_FLOW] = 10,
+                [N2_PURGE] = 15,
+                [N2_ON_OFF] = 20,
+                [FUEL_FLOW] = 25,
+                [FUEL_ON_OFF] = 30,
+                [NR_VALVES] = 35,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_VALVES)
+                i = NR_VALVES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+enum pressure_sensor {
+        PS_OXYGEN = 0,
+        FIRST_PSENSOR = PS_OXYGEN,
+        PS_FUEL,
+        NR_PSENSORS
+};
+
+#define PS_OXYGEN_NAME "oxygen (yellow)"
+#define PS_OXYGEN_SHORT_NAME "ox"
+#define PS_FUEL_NAME "fuel (blue)"
+#define PS_FUEL_SHORT_NAME "fuel"
+
+enum thermocouple {
+        TC_OXYGEN = 0,
+        FIRST_THERMOCOUPLE = TC_OXYGEN,
+        TC_WATER,
+        NR_THERMOCOUPLES
+};
+
+#define TC_OXYGEN_NAME "oxygen"
+#define TC_OXYGEN_SHORT_NAME "ox"
+#define TC_WATER_NAME "water"
+#define TC_WATER_SHORT_NAME "water"
+
+enum ignition_status {
+        IGN_SUCCESS = 0,
+        IGN_FAIL_NO_ISENSE_WIRE,
+        IGN_FAIL_BAD_IGNITER,
+        IGN_FAIL_NO_IGNITION,
+        IGN_NUM_STATUSES
+};
+
+#define IGN_SUCCESS_NAME "success"
+#define IGN_SUCCESS_SHORT_NAME "success"
+#define IGN_FAIL_NO_ISENSE_WIRE_NAME "failed: no ignition sense wire present"
+#define IGN_FAIL_NO_ISENSE_WIRE_SHORT_NAME "no_isense_wire"
+#define IGN_FAIL_BAD_IGNITER_NAME "failed: no continuity across igniter"
+#define IGN_FAIL_BAD_IGNITER_SHORT_NAME "bad_igniter"
+#define IGN_FAIL_NO_IGNITION_NAME "failed: no ignition"
+#define IGN_FAIL_NO_IGNITION_SHORT_NAME "no_ignition"
+
+static inline elet_str_t
+ignition_status_to_str(const enum ignition_status v)
+{
+        static const char names[] ELET_PROGMEM =
+                IGN_SUCCESS_NAME "\0"
+                IGN_FAIL_NO_ISENSE_WIRE_NAME "\0"
+                IGN_FAIL_BAD_IGNITER_NAME "\0"
+                IGN_FAIL_NO_IGNITION_NAME "\0"
+                "bad ignition status";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [IGN_SUCCESS] = 0,
+                [IGN_FAIL_NO_ISENSE_WIRE] = 8,
+                [IGN_FAIL_BAD_IGNITER] = 47,
+                [IGN_FAIL_NO_IGNITION] = 84,
+                [IGN_NUM_STATUSES] = 104,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= IGN_NUM_STATUSES)
+                i = IGN_NUM_STATUSES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+ignition_status_to_short_str(const enum ignition_status v)
+{
+        static const char names[] ELET_PROGMEM =
+                IGN_SUCCESS_SHORT_NAME "\0"
+                IGN_FAIL_NO_ISENSE_WIRE_SHORT_NAME "\0"
+                IGN_FAIL_BAD_IGNITER_SHORT_NAME "\0"
+                IGN_FAIL_NO_IGNITION_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [IGN_SUCCESS] = 0,
+                [IGN_FAIL_NO_ISENSE_WIRE] = 8,
+                [IGN_FAIL_BAD_IGNITER] = 23,
+                [IGN_FAIL_NO_IGNITION] = 35,
+                [IGN_NUM_STATUSES] = 47,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= IGN_NUM_STATUSES)
+                i = IGN_NUM_STATUSES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// the parts of the server's loop() it times, see stats_packet
+enum loop_section {
+        LS_LOOP = 0,
+        FIRST_LOOP_SECTION = LS_LOOP,
+        LS_GATHER,
+        LS_RX,
+        LS_SEND,
+        LS_FIRE,
+        LS_SAFING,
+        LS_DEPRESS,
+        NR_LOOP_SECTIONS
+};
+
+#define LS_LOOP_NAME "all of loop()"
+#define LS_LOOP_SHORT_NAME "loop"
+#define LS_GATHER_NAME "gather_all_data()"
+#define LS_GATHER_SHORT_NAME "gather"
+#define LS_RX_NAME "rx_continue()"
+#define LS_RX_SHORT_NAME "rx"
+#define LS_SEND_NAME "send_packet()"
+#define LS_SEND_SHORT_NAME "send"
+#define LS_FIRE_NAME "continue_fire()"
+#define LS_FIRE_SHORT_NAME "fire"
+#define LS_SAFING_NAME "continue_safing()"
+#define LS_SAFING_SHORT_NAME "safing"
+#define LS_DEPRESS_NAME "continue_depress()"
+#define LS_DEPRESS_SHORT_NAME "depress"
+
+static inline elet_str_t
+loop_section_to_str(const enum loop_section v)
+{
+        static const char names[] ELET_PROGMEM =
+                LS_LOOP_NAME "\0"
+                LS_GATHER_NAME "\0"
+                LS_RX_NAME "\0"
+                LS_SEND_NAME "\0"
+                LS_FIRE_NAME "\0"
+                LS_SAFING_NAME "\0"
+                LS_DEPRESS_NAME "\0"
+                "bad loop section";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [LS_LOOP] = 0,
+                [LS_GATHER] = 14,
+                [LS_RX] = 32,
+                [LS_SEND] = 46,
+                [LS_FIRE] = 60,
+                [LS_SAFING] = 76,
+                [LS_DEPRESS] = 94,
+                [NR_LOOP_SECTIONS] = 113,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_LOOP_SECTIONS)
+                i = NR_LOOP_SECTIONS;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+loop_section_to_short_str(const enum loop_section v)
+{
+        static const char names[] ELET_PROGMEM =
+                LS_LOOP_SHORT_NAME "\0"
+                LS_GATHER_SHORT_NAME "\0"
+                LS_RX_SHORT_NAME "\0"
+                LS_SEND_SHORT_NAME "\0"
+                LS_FIRE_SHORT_NAME "\0"
+                LS_SAFING_SHORT_NAME "\0"
+                LS_DEPRESS_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [LS_LOOP] = 0,
+                [LS_GATHER] = 5,
+                [LS_RX] = 12,
+                [LS_SEND] = 15,
+                [LS_FIRE] = 20,
+                [LS_SAFING] = 25,
+                [LS_DEPRESS] = 32,
+                [NR_LOOP_SECTIONS] = 40,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_LOOP_SECTIONS)
+                i = NR_LOOP_SECTIONS;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// rules the server checks every loop while firing. Any one of them tripping
+// ends the burn, see REQ_CMD_REDLINE.
+enum redline {
+        RL_OX_OVER = 0,
+        FIRST_REDLINE = RL_OX_OVER,
+        RL_FUEL_OVER,
+        RL_OX_UNDER,
+        RL_FUEL_UNDER,
+        RL_THRUST_LOW,
+        RL_OX_STUCK,
+        RL_FUEL_STUCK,
+        RL_THRUST_STUCK,
+        NR_REDLINES
+};
+
+#define RL_OX_OVER_NAME "oxygen over pressure"
+#define RL_OX_OVER_SHORT_NAME "ox_over"
+#define RL_FUEL_OVER_NAME "fuel over pressure"
+#define RL_FUEL_OVER_SHORT_NAME "fuel_over"
+#define RL_OX_UNDER_NAME "oxygen under pressure"
+#define RL_OX_UNDER_SHORT_NAME "ox_under"
+#define RL_FUEL_UNDER_NAME "fuel under pressure"
+#define RL_FUEL_UNDER_SHORT_NAME "fuel_under"
+#define RL_THRUST_LOW_NAME "low thrust"
+#define RL_THRUST_LOW_SHORT_NAME "thrust_low"
+#define RL_OX_STUCK_NAME "oxygen pressure sensor stuck"
+#define RL_OX_STUCK_SHORT_NAME "ox_stuck"
+#define RL_FUEL_STUCK_NAME "fuel pressure sensor stuck"
+#define RL_FUEL_STUCK_SHORT_NAME "fuel_stuck"
+#define RL_THRUST_STUCK_NAME "load cell stuck"
+#define RL_THRUST_STUCK_SHORT_NAME "thrust_stuck"
+
+static inline elet_str_t
+redline_to_str(const enum redline v)
+{
+        static const char names[] ELET_PROGMEM =
+                RL_OX_OVER_NAME "\0"
+                RL_FUEL_OVER_NAME "\0"
+                RL_OX_UNDER_NAME "\0"
+                RL_FUEL_UNDER_NAME "\0"
+                RL_THRUST_LOW_NAME "\0"
+                RL_OX_STUCK_NAME "\0"
+                RL_FUEL_STUCK_NAME "\0"
+                RL_THRUST_STUCK_NAME "\0"
+                "bad redline";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [RL_OX_OVER] = 0,
+                [RL_FUEL_OVER] = 21,
+                [RL_OX_UNDER] = 40,
+                [RL_FUEL_UNDER] = 62,
+                [RL_THRUST_LOW] = 82,
+                [RL_OX_STUCK] = 93,
+                [RL_FUEL_STUCK] = 122,
+                [RL_THRUST_STUCK] = 149,
+                [NR_REDLINES] = 165,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_REDLINES)
+                i = NR_REDLINES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+redline_to_short_str(const enum redline v)
+{
+        static const char names[] ELET_PROGMEM =
+                RL_OX_OVER_SHORT_NAME "\0"
+                RL_FUEL_OVER_SHORT_NAME "\0"
+                RL_OX_UNDER_SHORT_NAME "\0"
+                RL_FUEL_UNDER_SHORT_NAME "\0"
+                RL_THRUST_LOW_SHORT_NAME "\0"
+                RL_OX_STUCK_SHORT_NAME "\0"
+                RL_FUEL_STUCK_SHORT_NAME "\0"
+                RL_THRUST_STUCK_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [RL_OX_OVER] = 0,
+                [RL_FUEL_OVER] = 8,
+                [RL_OX_UNDER] = 18,
+                [RL_FUEL_UNDER] = 27,
+                [RL_THRUST_LOW] = 38,
+                [RL_OX_STUCK] = 49,
+                [RL_FUEL_STUCK] = 58,
+                [RL_THRUST_STUCK] = 69,
+                [NR_REDLINES] = 82,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_REDLINES)
+                i = NR_REDLINES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// what made a valve, the igniter or the state change, see transition_packet
+enum transition_cause {
+        CAUSE_COMMAND = 0,
+        CAUSE_SEQUENCE,
+        CAUSE_REDLINE,
+        NR_TRANSITION_CAUSES
+};
+
+#define CAUSE_COMMAND_NAME "command"
+#define CAUSE_COMMAND_SHORT_NAME "command"
+#define CAUSE_SEQUENCE_NAME "sequence step"
+#define CAUSE_SEQUENCE_SHORT_NAME "sequence"
+#define CAUSE_REDLINE_NAME "redline"
+#define CAUSE_REDLINE_SHORT_NAME "redline"
+
+static inline elet_str_t
+transition_cause_to_str(const enum transition_cause v)
+{
+        static const char names[] ELET_PROGMEM =
+                CAUSE_COMMAND_NAME "\0"
+                CAUSE_SEQUENCE_NAME "\0"
+                CAUSE_REDLINE_NAME "\0"
+                "bad transition cause";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [CAUSE_COMMAND] = 0,
+                [CAUSE_SEQUENCE] = 8,
+                [CAUSE_REDLINE] = 22,
+                [NR_TRANSITION_CAUSES] = 30,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_TRANSITION_CAUSES)
+                i = NR_TRANSITION_CAUSES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+transition_cause_to_short_str(const enum transition_cause v)
+{
+        static const char names[] ELET_PROGMEM =
+                CAUSE_COMMAND_SHORT_NAME "\0"
+                CAUSE_SEQUENCE_SHORT_NAME "\0"
+                CAUSE_REDLINE_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [CAUSE_COMMAND] = 0,
+                [CAUSE_SEQUENCE] = 8,
+                [CAUSE_REDLINE] = 17,
+                [NR_TRANSITION_CAUSES] = 25,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_TRANSITION_CAUSES)
+                i = NR_TRANSITION_CAUSES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// what a bench sketch can stream, see bench_packet
+enum bench_channel {
+        BENCH_OX = 0,
+        FIRST_BENCH_CHANNEL = BENCH_OX,
+        BENCH_FUEL,
+        BENCH_LOAD_CELL,
+        NR_BENCH_CHANNELS
+};
+
+#define BENCH_OX_NAME "oxygen pressure"
+#define BENCH_OX_SHORT_NAME "ox"
+#define BENCH_FUEL_NAME "fuel pressure"
+#define BENCH_FUEL_SHORT_NAME "fuel"
+#define BENCH_LOAD_CELL_NAME "load cell"
+#define BENCH_LOAD_CELL_SHORT_NAME "load_cell"
+
+// the messages the server sends often enough that they're worth a number
+// instead of their text, see message_packet. MSG_TEXT is none of them, the
+// packet's text is the whole message.
+enum message {
+        MSG_TEXT = 0,
+        MSG_BAD_COMMAND,
+        MSG_OBSERVER,
+        MSG_BAD_CRC,
+        MSG_OBSERVER_COMMAND,
+        NR_MESSAGES
+};
+
+#define MSG_TEXT_NAME ""
+#define MSG_TEXT_SHORT_NAME "text"
+#define MSG_BAD_COMMAND_NAME "processed bad command"
+#define MSG_BAD_COMMAND_SHORT_NAME "bad_command"
+#define MSG_OBSERVER_NAME "commander already connected, attached as observer"
+#define MSG_OBSERVER_SHORT_NAME "observer"
+#define MSG_BAD_CRC_NAME "dropped packet with bad crc"
+#define MSG_BAD_CRC_SHORT_NAME "bad_crc"
+#define MSG_OBSERVER_COMMAND_NAME "observers can't send commands"
+#define MSG_OBSERVER_COMMAND_SHORT_NAME "observer_command"
+
+static inline elet_str_t
+message_to_str(const enum message v)
+{
+        static const char names[] ELET_PROGMEM =
+                MSG_TEXT_NAME "\0"
+                MSG_BAD_COMMAND_NAME "\0"
+                MSG_OBSERVER_NAME "\0"
+                MSG_BAD_CRC_NAME "\0"
+                MSG_OBSERVER_COMMAND_NAME "\0"
+                "bad message";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [MSG_TEXT] = 0,
+                [MSG_BAD_COMMAND] = 1,
+                [MSG_OBSERVER] = 23,
+                [MSG_BAD_CRC] = 73,
+                [MSG_OBSERVER_COMMAND] = 101,
+                [NR_MESSAGES] = 131,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_MESSAGES)
+                i = NR_MESSAGES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+message_to_short_str(const enum message v)
+{
+        static const char names[] ELET_PROGMEM =
+                MSG_TEXT_SHORT_NAME "\0"
+                MSG_BAD_COMMAND_SHORT_NAME "\0"
+                MSG_OBSERVER_SHORT_NAME "\0"
+                MSG_BAD_CRC_SHORT_NAME "\0"
+                MSG_OBSERVER_COMMAND_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [MSG_TEXT] = 0,
+                [MSG_BAD_COMMAND] = 5,
+                [MSG_OBSERVER] = 17,
+                [MSG_BAD_CRC] = 26,
+                [MSG_OBSERVER_COMMAND] = 34,
+                [NR_MESSAGES] = 51,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= NR_MESSAGES)
+                i = NR_MESSAGES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// Current state of the entire system. Our state diagram is
+//
+//
+//     SS_DEPRESS
+//         ^
+//   (7,8) |        (2)
+//         |     ________
+//  (1)    v    /        v
+//  --->  SS_READY       SS_FIRE
+//          ^   ^________/    /
+//     (5,6) \      (3)      / (4)
+//            v             v
+//               SS_SAFING
+//
+// The states have the following semantics and rules:
+//
+//   state       notes
+//  -----------------------------------------------------------------------
+//   SS_READY    This state is the only safe state. In this state it is safe
+//               to approach the engine, but care should still be exercised
+//               in case of other software bugs.
+//
+//               Valves can be be arbitrarily actuated in this state with
+//               the REQ_MOD_VALVE command, but this should be done with
+//               extreme caution, and only in the case of other software
+//               bugs.
+//
+//   SS_FIRE     In this state the engine is firing or attempting to do so.
+//               No one shall approach the engine when it is in this state.
+//
+//   SS_SAFING   In this state the system is shutting the engine off, purging
+//               the engine with nitrogen, and de-pressurizing the oxygen
+//               line. It is not safe to approach the engine in this state,
+//               but this state should be brief.
+//
+//   SS_DEPRESS  In this state we're depressurizing and emptying the fuel
+//               tank. This state is only entered manually, via a REQ_CMD_DEPRESS
+//
+// The state machine has the following transition table:
+//
+//   #    prev       next        reason
+//  -----------------------------------------------------------------------
+//   1    n/a        SS_READY    This is the default state on startup.
+//
+//   2    SS_READY   SS_FIRE     This state transition is triggered by a
+//                               REQ_CMD_START command from the client to the
+//                               system. This state transition represents a
+//                               request to start the engine
+//
+//   3    SS_FIRE    SS_READY    This transition happens when the system is
+//                               told to fire, but there is no continuity
+//                               across the ingiter, so no ignition is
+//                               attempted.
+//
+//   4    SS_FIRE    SS_SAFING   This transition happens when either the burn
+//                               time runs out or someone issues an explicit
+//                               REQ_CMD_STOP.
+//
+//   5    SS_SAFING  SS_READY    This transition happens once automated
+//                               safing is complete.
+//
+//   6    SS_READY   SS_SAFING   This transition happens when someone sends
+//                               a REQ_CMD_STOP while we're in the ready
+//                               state. We might want to do this in the case
+//                               of a power failure or something else weird.
+//
+//   7    SS_READY   SS_DEPRESS  This transitions happens when the arduino
+//                               gets a REQ_CMD_DEPRESS command
+//
+//   8    SS_DEPRESS SS_READY    This transition when the depressurization
+//                               finishes.
+enum system_state {
+        SS_READY = 0,
+        SS_FIRE,
+        SS_SAFING,
+        SS_DEPRESS,
+        SS_NUM_STATES
+};
+
+#define SS_READY_NAME "ready"
+#define SS_READY_SHORT_NAME "ready"
+#define SS_FIRE_NAME "firing"
+#define SS_FIRE_SHORT_NAME "fire"
+#define SS_SAFING_NAME "safing"
+#define SS_SAFING_SHORT_NAME "safing"
+#define SS_DEPRESS_NAME "fuel depressurization"
+#define SS_DEPRESS_SHORT_NAME "depress"
+
+static inline elet_str_t
+system_state_to_str(const enum system_state v)
+{
+        static const char names[] ELET_PROGMEM =
+                SS_READY_NAME "\0"
+                SS_FIRE_NAME "\0"
+                SS_SAFING_NAME "\0"
+                SS_DEPRESS_NAME "\0"
+                "bad system state";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [SS_READY] = 0,
+                [SS_FIRE] = 6,
+                [SS_SAFING] = 13,
+                [SS_DEPRESS] = 20,
+                [SS_NUM_STATES] = 42,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= SS_NUM_STATES)
+                i = SS_NUM_STATES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+static inline elet_str_t
+system_state_to_short_str(const enum system_state v)
+{
+        static const char names[] ELET_PROGMEM =
+                SS_READY_SHORT_NAME "\0"
+                SS_FIRE_SHORT_NAME "\0"
+                SS_SAFING_SHORT_NAME "\0"
+                SS_DEPRESS_SHORT_NAME "\0"
+                "bad";
+        static const uint16_t starts[] ELET_PROGMEM = {
+                [SS_READY] = 0,
+                [SS_FIRE] = 6,
+                [SS_SAFING] = 11,
+                [SS_DEPRESS] = 18,
+                [SS_NUM_STATES] = 26,
+        };
+        int i = (int)v;
+
+        if (i < 0 || i >= SS_NUM_STATES)
+                i = SS_NUM_STATES;
+        return ELET_STR(names + elet_read_table_u16(&starts[i]));
+}
+
+// network bullshittery begins here, continue at your own risk
+
+// packet types
+#define PT_DATA ((uint8_t)1)
+#define PT_REQ ((uint8_t)2)
+#define PT_MESSAGE ((uint8_t)3)
+#define PT_HELLO ((uint8_t)4)
+#define PT_SESSION ((uint8_t)5)
+#define PT_EVENT ((uint8_t)6)
+#define PT_STATS ((uint8_t)7)
+#define PT_TRANSITION ((uint8_t)8)
+#define PT_BENCH ((uint8_t)9)
+
+// stop the engine. No arguments
+#define REQ_CMD_STOP ((uint8_t)0)
+
+// start the engine. Argument is the length of the burn in seconds. Must
+// be between REQ_CMD_START_MIN_BURN_TIME and REQ_CMD_START_MAX_BURN_TIME
+#define REQ_CMD_START ((uint8_t)1)
+#define REQ_CMD_START_MIN_BURN_TIME 2
+#define REQ_CMD_START_MAX_BURN_TIME 120
+
+// do something with a valve. The argument is a valve_arg, see below. 0
+// means closed, 1 means open for solenoid, and 1-255 mean open to that
+// PWM value for flow ctl valves. If the valve is 0xff, the value is
+// ignored and all valves are turned off.
+//
+// This command is only valid in the SS_READY state.
+#define REQ_MOD_VALVE ((uint8_t)2)
+
+// depressurize the fuel pressure vessel. Argument is drain time in
+// seconds
+#define REQ_CMD_DEPRESS ((uint8_t)3)
+#define REQ_CMD_DEPRESS_MIN_TIMEOUT 15
+#define REQ_CMD_DEPRESS_MAX_TIMEOUT 120
+
+// set the threshold of one of the redline rules. The argument is a
+// redline_arg. For the over/under pressure and low thrust rules the
+// value is a raw reading, like in a data packet; for the stuck sensor
+// rules it's how many identical readings in a row count as stuck, at
+// most 255. 0 turns the rule off.
+//
+// This command is only valid in the SS_READY state.
+#define REQ_CMD_REDLINE ((uint8_t)4)
+
+// set how often data packets go out in one system state. The argument
+// is a rate_arg. An interval of 0 means every loop. Whatever the
+// interval, a data packet goes out as soon as a valve or the state
+// changes.
+#define REQ_CMD_RATE ((uint8_t)5)
+
+// roles a client can ask for in a PT_HELLO packet. Only one client at a
+// time gets to be the commander, i.e. send PT_REQ packets; everyone else
+// is a read-only observer that just gets telemetry. If a client asks to
+// be the commander while someone else already is, it's attached as an
+// observer and told so with a PT_MESSAGE.
+#define HELLO_ROLE_COMMANDER ((uint8_t)0)
+#define HELLO_ROLE_OBSERVER ((uint8_t)1)
+
+// transition_packet.what for the igniter and the system state. Anything
+// else there is an enum valve.
+#define TR_IGNITER ((uint8_t)254)
+#define TR_STATE ((uint8_t)255)
+
+// buckets in a stats_packet histogram. Bucket 0 counts times under
+// 64 us, and each bucket after that goes 4 times as far as the one
+// before: 256 us, 1 ms, 4 ms, 16 ms, 65 ms, 262 ms, and the last one
+// gets everything longer.
+#define STATS_NR_BINS 8
+
+// diagnostic events, see struct event_packet
+enum event_id {
+        EV_BOOT = 0,
+        EV_STATE,
+        EV_BAD_STEP,
+        EV_CONTINUITY,
+        EV_IGNITION,
+        EV_REQ,
+        EV_REQ_REJECTED,
+        EV_CLIENT_NEW,
+        EV_CLIENT_DEAD,
+        EV_COMMANDER_RESUMED,
+        EV_SHORT_WRITE,
+        EV_REDLINE,
+        EV_REDLINE_SET,
+        EV_FIRE_STEP,
+        EV_SAFING_STEP,
+        EV_DEPRESS_STEP,
+        EV_SEQ_SAVED,
+        EV_RATE_SET,
+        EV_NUM_EVENTS
+};
+
+// accessors for the system state, as sent in data_packet.state and
+// session_packet.state. These work on the raw value in place, there's no
+// unpacked copy to keep in sync.
+
+// the result of the last ignition, aka an enum
+// ignition_status. (one extra bit in case we add more
+// ignition statuses)
+#define ELET_STATE_IGN_STATUS_SHIFT 0
+#define ELET_STATE_IGN_STATUS_MASK 0x7
+
+static inline uint8_t
+elet_state_ign_status(const uint8_t v)
+{
+        return (v >> ELET_STATE_IGN_STATUS_SHIFT) & ELET_STATE_IGN_STATUS_MASK;
+}
+
+static inline uint8_t
+elet_state_set_ign_status(const uint8_t v, const uint8_t f)
+{
+        return (v & ~((uint8_t)ELET_STATE_IGN_STATUS_MASK << ELET_STATE_IGN_STATUS_SHIFT))
+                | ((f & ELET_STATE_IGN_STATUS_MASK) << ELET_STATE_IGN_STATUS_SHIFT);
+}
+
+// the system state, aka an enum system_state (again, one
+// extra bit in case we add states)
+#define ELET_STATE_SYS_STATE_SHIFT 3
+#define ELET_STATE_SYS_STATE_MASK 0x7
+
+static inline uint8_t
+elet_state_sys_state(const uint8_t v)
+{
+        return (v >> ELET_STATE_SYS_STATE_SHIFT) & ELET_STATE_SYS_STATE_MASK;
+}
+
+static inline uint8_t
+elet_state_set_sys_state(const uint8_t v, const uint8_t f)
+{
+        return (v & ~((uint8_t)ELET_STATE_SYS_STATE_MASK << ELET_STATE_SYS_STATE_SHIFT))
+                | ((f & ELET_STATE_SYS_STATE_MASK) << ELET_STATE_SYS_STATE_SHIFT);
+}
+
+// the "igniter good" bit. If we have continuity across the
+// igniter, this bit is 1, otherwise it is zero. This bit is
+// only valid when our system_state is SS_READY, otherwise it
+// is zero.
+#define ELET_STATE_IGNITER_GOOD_SHIFT 6
+#define ELET_STATE_IGNITER_GOOD_MASK 0x1
+
+static inline uint8_t
+elet_state_igniter_good(const uint8_t v)
+{
+        return (v >> ELET_STATE_IGNITER_GOOD_SHIFT) & ELET_STATE_IGNITER_GOOD_MASK;
+}
+
+static inline uint8_t
+elet_state_set_igniter_good(const uint8_t v, const uint8_t f)
+{
+        return (v & ~((uint8_t)ELET_STATE_IGNITER_GOOD_MASK << ELET_STATE_IGNITER_GOOD_SHIFT))
+                | ((f & ELET_STATE_IGNITER_GOOD_MASK) << ELET_STATE_IGNITER_GOOD_SHIFT);
+}
+
+// reserved/always zero. If a client sees this bit as
+// non-zero, it should yell loudly.
+#define ELET_STATE_RESERVED_SHIFT 7
+#define ELET_STATE_RESERVED_MASK 0x1
+
+static inline uint8_t
+elet_state_reserved(const uint8_t v)
+{
+        return (v >> ELET_STATE_RESERVED_SHIFT) & ELET_STATE_RESERVED_MASK;
+}
+
+static inline uint8_t
+elet_state_set_reserved(const uint8_t v, const uint8_t f)
+{
+        return (v & ~((uint8_t)ELET_STATE_RESERVED_MASK << ELET_STATE_RESERVED_SHIFT))
+                | ((f & ELET_STATE_RESERVED_MASK) << ELET_STATE_RESERVED_SHIFT);
+}
+
+static inline uint8_t
+elet_state_pack(const uint8_t ign_status,
+                const uint8_t sys_state,
+                const uint8_t igniter_good)
+{
+        uint8_t v = 0;
+        v = elet_state_set_ign_status(v, ign_status);
+        v = elet_state_set_sys_state(v, sys_state);
+        v = elet_state_set_igniter_good(v, igniter_good);
+        return v;
+}
+
+// accessors for the argument of a REQ_MOD_VALVE request. These work on the raw
+// value in place, there's no unpacked copy to keep in sync.
+
+// which valve, an enum valve squashed into 8 bits, or 0xff
+// for all of them
+#define ELET_VALVE_ARG_VALVE_SHIFT 0
+#define ELET_VALVE_ARG_VALVE_MASK 0xff
+
+static inline uint32_t
+elet_valve_arg_valve(const uint32_t v)
+{
+        return (v >> ELET_VALVE_ARG_VALVE_SHIFT) & ELET_VALVE_ARG_VALVE_MASK;
+}
+
+static inline uint32_t
+elet_valve_arg_set_valve(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_VALVE_ARG_VALVE_MASK << ELET_VALVE_ARG_VALVE_SHIFT))
+                | ((f & ELET_VALVE_ARG_VALVE_MASK) << ELET_VALVE_ARG_VALVE_SHIFT);
+}
+
+// what to set it to
+#define ELET_VALVE_ARG_VALUE_SHIFT 8
+#define ELET_VALVE_ARG_VALUE_MASK 0xff
+
+static inline uint32_t
+elet_valve_arg_value(const uint32_t v)
+{
+        return (v >> ELET_VALVE_ARG_VALUE_SHIFT) & ELET_VALVE_ARG_VALUE_MASK;
+}
+
+static inline uint32_t
+elet_valve_arg_set_value(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_VALVE_ARG_VALUE_MASK << ELET_VALVE_ARG_VALUE_SHIFT))
+                | ((f & ELET_VALVE_ARG_VALUE_MASK) << ELET_VALVE_ARG_VALUE_SHIFT);
+}
+
+static inline uint32_t
+elet_valve_arg_pack(const uint32_t valve, const uint32_t value)
+{
+        uint32_t v = 0;
+        v = elet_valve_arg_set_valve(v, valve);
+        v = elet_valve_arg_set_value(v, value);
+        return v;
+}
+
+// accessors for the argument of a REQ_CMD_REDLINE request. These work on the
+// raw value in place, there's no unpacked copy to keep in sync.
+
+// which rule, an enum redline
+#define ELET_REDLINE_ARG_RULE_SHIFT 0
+#define ELET_REDLINE_ARG_RULE_MASK 0xff
+
+static inline uint32_t
+elet_redline_arg_rule(const uint32_t v)
+{
+        return (v >> ELET_REDLINE_ARG_RULE_SHIFT) & ELET_REDLINE_ARG_RULE_MASK;
+}
+
+static inline uint32_t
+elet_redline_arg_set_rule(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_REDLINE_ARG_RULE_MASK << ELET_REDLINE_ARG_RULE_SHIFT))
+                | ((f & ELET_REDLINE_ARG_RULE_MASK) << ELET_REDLINE_ARG_RULE_SHIFT);
+}
+
+// the new threshold
+#define ELET_REDLINE_ARG_VALUE_SHIFT 8
+#define ELET_REDLINE_ARG_VALUE_MASK 0xffffff
+
+static inline uint32_t
+elet_redline_arg_value(const uint32_t v)
+{
+        return (v >> ELET_REDLINE_ARG_VALUE_SHIFT) & ELET_REDLINE_ARG_VALUE_MASK;
+}
+
+static inline uint32_t
+elet_redline_arg_set_value(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_REDLINE_ARG_VALUE_MASK << ELET_REDLINE_ARG_VALUE_SHIFT))
+                | ((f & ELET_REDLINE_ARG_VALUE_MASK) << ELET_REDLINE_ARG_VALUE_SHIFT);
+}
+
+static inline uint32_t
+elet_redline_arg_pack(const uint32_t rule, const uint32_t value)
+{
+        uint32_t v = 0;
+        v = elet_redline_arg_set_rule(v, rule);
+        v = elet_redline_arg_set_value(v, value);
+        return v;
+}
+
+// accessors for the argument of a REQ_CMD_RATE request. These work on the raw
+// value in place, there's no unpacked copy to keep in sync.
+
+// which state, an enum system_state
+#define ELET_RATE_ARG_STATE_SHIFT 0
+#define ELET_RATE_ARG_STATE_MASK 0xff
+
+static inline uint32_t
+elet_rate_arg_state(const uint32_t v)
+{
+        return (v >> ELET_RATE_ARG_STATE_SHIFT) & ELET_RATE_ARG_STATE_MASK;
+}
+
+static inline uint32_t
+elet_rate_arg_set_state(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_RATE_ARG_STATE_MASK << ELET_RATE_ARG_STATE_SHIFT))
+                | ((f & ELET_RATE_ARG_STATE_MASK) << ELET_RATE_ARG_STATE_SHIFT);
+}
+
+// at least this long between data packets, in ms
+#define ELET_RATE_ARG_INTERVAL_MS_SHIFT 8
+#define ELET_RATE_ARG_INTERVAL_MS_MASK 0xffff
+
+static inline uint32_t
+elet_rate_arg_interval_ms(const uint32_t v)
+{
+        return (v >> ELET_RATE_ARG_INTERVAL_MS_SHIFT) & ELET_RATE_ARG_INTERVAL_MS_MASK;
+}
+
+static inline uint32_t
+elet_rate_arg_set_interval_ms(const uint32_t v, const uint32_t f)
+{
+        return (v & ~((uint32_t)ELET_RATE_ARG_INTERVAL_MS_MASK << ELET_RATE_ARG_INTERVAL_MS_SHIFT))
+                | ((f & ELET_RATE_ARG_INTERVAL_MS_MASK) << ELET_RATE_ARG_INTERVAL_MS_SHIFT);
+}
+
+static inline uint32_t
+elet_rate_arg_pack(const uint32_t state, const uint32_t interval_ms)
+{
+        uint32_t v = 0;
+        v = elet_rate_arg_set_state(v, state);
+        v = elet_rate_arg_set_interval_ms(v, interval_ms);
+        return v;
+}
+
+// this header is at the start of every packet we send over the wire.
+// Packet parsing code should first parse the length and packet type out of
+// this header, then parse the rest of the packet based on the type. Code
+// should yell when it does not recognize the packet type.
+struct packet_header {
+        // length of this packet in bytes
+        uint16_t len;
+
+        // type of this message. One of the PT_* constants.
+        uint8_t type;
+        uint8_t _pad1;
+
+        // The sequence number of this packet. This field exists so that we
+        // can provide an ordering between sent and recived packets. For
+        // example, when someone issues a PT_REQ packet with a REQ_CMD_START
+        // command (i.e. "start the damn engine"), we want to know when that
+        // command was processed so we can look at the result of the last
+        // ignition in subsequent data packets. However, we don't want to
+        // examine the result-of-last-ignition field until we know for sure
+        // that the command has been processed. This seems like it would be
+        // easy---just wait for the command to send and read the value out
+        // of the next data packet. Howevver, but due to packet buffering
+        // on both ends, "just wait" is not a viable option as the next
+        // data packet may have been sent before we sent our request. Thus
+        // we need a sequence number.
+        //
+        // For packets sent from the server (arduino) to the client (i.e.
+        // PT_DATA and PT_MESSAGE), this number is the sequence number of
+        // the last command processed from the commanding client. Observers
+        // see the same number. For packets sent from the client to
+        // the server (i.e. PT_REQ), this is a sequence number for the
+        // message. The server does not look at it at all, it just pastes
+        // it into all subsequent response headers until a new PT_REQ packet
+        // comes in, then starts using that value.
+        //
+        // Thus it is suggested that the client start with seq = 0 and
+        // increment it by one on every PT_REQ sent to the server. Then the
+        // client should wait until it sees a data packet with seq == seq
+        // of the last command
+        uint32_t seq;
+
+        // this field is the 32 bit millisecond timestamp returned
+        // by millis() at the time this data was gathered. This field is
+        // ignored by the server.
+        uint32_t timestamp;
+
+        // CRC of the entire packet (len bytes), computed as if this field
+        // were zero. See elet_packet_crc(). Both ends drop packets that
+        // don't check out.
+        uint16_t crc;
+        uint16_t _pad2;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct packet_header) == 16,
+                   "struct packet_header changed size");
+ELET_STATIC_ASSERT(offsetof(struct packet_header, len) == 0,
+                   "struct packet_header.len moved");
+ELET_STATIC_ASSERT(offsetof(struct packet_header, type) == 2,
+                   "struct packet_header.type moved");
+ELET_STATIC_ASSERT(offsetof(struct packet_header, seq) == 4,
+                   "struct packet_header.seq moved");
+ELET_STATIC_ASSERT(offsetof(struct packet_header, timestamp) == 8,
+                   "struct packet_header.timestamp moved");
+ELET_STATIC_ASSERT(offsetof(struct packet_header, crc) == 12,
+                   "struct packet_header.crc moved");
+
+// this packet is sent from the arduino to the client. It contains the
+// state of the entire system.
+struct data_packet {
+        struct packet_header header;
+
+        // the state of each valve as a bitmap. Index into this bitmap with
+        // integer interpretation of the values of `enum valve`. 0 means
+        // the valve is closed, 1 means the valve is open. For pwm valves,
+        // consult the next two fields to find out how open they are.
+        //
+        // NB: right now we only have 7 valves. If we get more than 8, we
+        // need to change this to a uint16_t
+        uint8_t vlv_states;
+        uint8_t vlv_pwm_ox;
+        uint8_t vlv_pwm_fuel;
+
+        // system state, see the state bitfield accessors
+        uint8_t state;
+
+        // data from all of our sensors. Raw ADC readings.
+        uint16_t pressures[NR_PSENSORS];
+
+        // thermocouple temperatures, IEEE floats.
+        float temps[NR_THERMOCOUPLES];
+
+        // thrust from the load cell, raw reading.
+        uint32_t thrust;
+
+        // number of packets the server has thrown away because their CRC
+        // didn't match
+        uint16_t crc_errors;
+        uint16_t _pad1;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct data_packet) == 40,
+                   "struct data_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, header) == 0,
+                   "struct data_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, vlv_states) == 16,
+                   "struct data_packet.vlv_states moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, vlv_pwm_ox) == 17,
+                   "struct data_packet.vlv_pwm_ox moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, vlv_pwm_fuel) == 18,
+                   "struct data_packet.vlv_pwm_fuel moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, state) == 19,
+                   "struct data_packet.state moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, pressures) == 20,
+                   "struct data_packet.pressures moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, temps) == 24,
+                   "struct data_packet.temps moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, thrust) == 32,
+                   "struct data_packet.thrust moved");
+ELET_STATIC_ASSERT(offsetof(struct data_packet, crc_errors) == 36,
+                   "struct data_packet.crc_errors moved");
+
+// this packet is sent from the client to the arduino to tell it to do things
+struct req_packet {
+        struct packet_header header;
+
+        // the command for this request. one of the REQ_CMD_* constants.
+        uint8_t cmd;
+        uint8_t _pad1[3];
+
+        // argument See REQ_CMD_* for details
+        uint32_t arg;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct req_packet) == 24,
+                   "struct req_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct req_packet, header) == 0,
+                   "struct req_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct req_packet, cmd) == 16,
+                   "struct req_packet.cmd moved");
+ELET_STATIC_ASSERT(offsetof(struct req_packet, arg) == 20,
+                   "struct req_packet.arg moved");
+
+// this packet is sent from the arduino to the client to share diagnostic
+// information in string formats. It's only as long as its text, and the
+// common messages are just an id with no text at all.
+struct message_packet {
+        struct packet_header header;
+
+        // one of the MSG_* messages. The text, if there is any, goes after
+        // it.
+        uint8_t id;
+
+        // ascii, not null-terminated: it's header.len - MESSAGE_PACKET_MIN_LEN
+        // bytes long, and the packet ends there.
+        uint8_t text[255];
+};
+
+ELET_STATIC_ASSERT(sizeof(struct message_packet) == 272,
+                   "struct message_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct message_packet, header) == 0,
+                   "struct message_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct message_packet, id) == 16,
+                   "struct message_packet.id moved");
+ELET_STATIC_ASSERT(offsetof(struct message_packet, text) == 17,
+                   "struct message_packet.text moved");
+
+// the shortest a message_packet can be, with none of its text
+#define MESSAGE_PACKET_MIN_LEN offsetof(struct message_packet, text)
+
+// this packet is sent from the arduino to the clients, and on its serial
+// port, for every diagnostic event it logs. It's the compact sibling of
+// PT_MESSAGE: an event id and two numbers, and the host turns that into
+// text. See `events` in protocol/protocol.py.
+struct event_packet {
+        struct packet_header header;
+
+        // micros() when the event happened. The header timestamp is when
+        // it was sent, which can be a good while later.
+        uint32_t us;
+
+        // one of the EV_* events
+        uint8_t id;
+
+        // number of events that were thrown away since the last one sent
+        // this way, because the event ring filled up first. Saturates.
+        uint8_t dropped;
+        uint16_t arg0;
+        uint32_t arg1;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct event_packet) == 28,
+                   "struct event_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, header) == 0,
+                   "struct event_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, us) == 16,
+                   "struct event_packet.us moved");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, id) == 20,
+                   "struct event_packet.id moved");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, dropped) == 21,
+                   "struct event_packet.dropped moved");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, arg0) == 22,
+                   "struct event_packet.arg0 moved");
+ELET_STATIC_ASSERT(offsetof(struct event_packet, arg1) == 24,
+                   "struct event_packet.arg1 moved");
+
+// this packet is sent from the arduino to the clients every so often, one
+// for each part of loop() it times that ran since the last time. The
+// numbers start over after every packet.
+struct stats_packet {
+        struct packet_header header;
+
+        // an enum loop_section
+        uint8_t section;
+        uint8_t _pad1[3];
+
+        // how many times it ran
+        uint32_t count;
+        uint32_t min_us;
+        uint32_t max_us;
+        uint32_t sum_us;
+
+        // how many times took how long, see STATS_NR_BINS. Saturates.
+        uint16_t hist[STATS_NR_BINS];
+};
+
+ELET_STATIC_ASSERT(sizeof(struct stats_packet) == 52,
+                   "struct stats_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, header) == 0,
+                   "struct stats_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, section) == 16,
+                   "struct stats_packet.section moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, count) == 20,
+                   "struct stats_packet.count moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, min_us) == 24,
+                   "struct stats_packet.min_us moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, max_us) == 28,
+                   "struct stats_packet.max_us moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, sum_us) == 32,
+                   "struct stats_packet.sum_us moved");
+ELET_STATIC_ASSERT(offsetof(struct stats_packet, hist) == 36,
+                   "struct stats_packet.hist moved");
+
+// this packet is sent from the arduino to the clients every time a valve,
+// the igniter or the system state changes, stamped with micros() at the
+// moment it changed. The data packets only show the valves as of the last
+// sample, so this is the one to look at for when something happened and
+// why.
+struct transition_packet {
+        struct packet_header header;
+
+        // micros() when it changed. The header timestamp is when this was
+        // sent.
+        uint32_t us;
+
+        // an enum valve, TR_IGNITER or TR_STATE
+        uint8_t what;
+
+        // 0 or 1 for solenoids and the igniter, the PWM value for flow
+        // control valves, an enum system_state for TR_STATE
+        uint8_t old_value;
+        uint8_t new_value;
+
+        // an enum transition_cause
+        uint8_t cause;
+
+        // the enum system_state it happened in. For CAUSE_SEQUENCE, that's the
+        // sequence.
+        uint8_t state;
+
+        // number of transitions thrown away since the last one sent, because
+        // they came faster than we could send them. Saturates.
+        uint8_t dropped;
+        uint8_t _pad2[2];
+
+        // for CAUSE_COMMAND the seq of the command, for CAUSE_SEQUENCE the step,
+        // and for CAUSE_REDLINE the enum redline that tripped
+        uint32_t arg;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct transition_packet) == 32,
+                   "struct transition_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, header) == 0,
+                   "struct transition_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, us) == 16,
+                   "struct transition_packet.us moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, what) == 20,
+                   "struct transition_packet.what moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, old_value) == 21,
+                   "struct transition_packet.old_value moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, new_value) == 22,
+                   "struct transition_packet.new_value moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, cause) == 23,
+                   "struct transition_packet.cause moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, state) == 24,
+                   "struct transition_packet.state moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, dropped) == 25,
+                   "struct transition_packet.dropped moved");
+ELET_STATIC_ASSERT(offsetof(struct transition_packet, arg) == 28,
+                   "struct transition_packet.arg moved");
+
+// this packet is what the bench sketches stream out of their serial port
+// while calibrating sensors, one per sample, see bench_stream_begin() in
+// elet_arduino.h. launch_client/bench_capture.py turns them into a CSV.
+struct bench_packet {
+        struct packet_header header;
+
+        // micros() when it was sampled
+        uint32_t us;
+
+        // the last number typed into the serial port, e.g. the pressure on the
+        // gauge or the mass on the load cell
+        float setpoint;
+
+        // bitmap of the enum bench_channels being streamed
+        uint8_t channels;
+
+        // bitmap of the channels read for this sample. The load cell only has
+        // a new reading 10 or 80 times a second; when it doesn't, the last one
+        // is repeated and its bit is clear.
+        uint8_t fresh;
+
+        // number of samples thrown away since the last one sent, because the
+        // serial port couldn't keep up. Saturates.
+        uint16_t dropped;
+
+        // raw ADC readings
+        uint16_t pressures[NR_PSENSORS];
+
+        // raw load cell reading
+        uint32_t load_cell;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct bench_packet) == 36,
+                   "struct bench_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, header) == 0,
+                   "struct bench_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, us) == 16,
+                   "struct bench_packet.us moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, setpoint) == 20,
+                   "struct bench_packet.setpoint moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, channels) == 24,
+                   "struct bench_packet.channels moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, fresh) == 25,
+                   "struct bench_packet.fresh moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, dropped) == 26,
+                   "struct bench_packet.dropped moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, pressures) == 28,
+                   "struct bench_packet.pressures moved");
+ELET_STATIC_ASSERT(offsetof(struct bench_packet, load_cell) == 32,
+                   "struct bench_packet.load_cell moved");
+
+// this packet is sent from the client to the arduino when it connects. The
+// server doesn't send any telemetry to a client until it has said hello.
+//
+// A client that loses its connection can reconnect and pick up where it
+// left off by putting the token from the last PT_SESSION packet it got in
+// `session`. If the token matches, the data packets the client missed in
+// the meantime are resent.
+//
+// The session token goes to everyone, so it can't be what lets a commander
+// back in. A commander also sends back the `commander` token only it was
+// given. If that matches, the server keeps the command sequence going
+// instead of restarting it at the seq in this header, and the commander
+// takes over from its own stale socket.
+struct hello_packet {
+        struct packet_header header;
+
+        // one of the HELLO_ROLE_* constants
+        uint8_t role;
+        uint8_t _pad1[3];
+
+        // session token to resume, or 0 to start a new session
+        uint32_t session;
+
+        // timestamp of the last data packet this client got. When
+        // resuming, buffered data packets newer than this are resent.
+        uint32_t last_timestamp;
+
+        // commander token from the last PT_SESSION packet, to take command
+        // back, or 0
+        uint32_t commander;
+};
+
+ELET_STATIC_ASSERT(sizeof(struct hello_packet) == 32,
+                   "struct hello_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct hello_packet, header) == 0,
+                   "struct hello_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct hello_packet, role) == 16,
+                   "struct hello_packet.role moved");
+ELET_STATIC_ASSERT(offsetof(struct hello_packet, session) == 20,
+                   "struct hello_packet.session moved");
+ELET_STATIC_ASSERT(offsetof(struct hello_packet, last_timestamp) == 24,
+                   "struct hello_packet.last_timestamp moved");
+ELET_STATIC_ASSERT(offsetof(struct hello_packet, commander) == 28,
+                   "struct hello_packet.commander moved");
+
+// this packet is sent from the arduino to a client in response to every
+// PT_HELLO. The seq in its header is the seq of the last command processed,
+// just like a data packet.
+struct session_packet {
+        struct packet_header header;
+
+        // identifies this boot of the arduino. A client that sees this
+        // change knows the arduino reset.
+        uint32_t session;
+
+        // 1 if the client's session token matched and it was resumed,
+        // otherwise 0
+        uint8_t resumed;
+
+        // packed exactly like data_packet.state
+        uint8_t state;
+
+        // how far into the current sequence (fire, safing, depress) we are.
+        // Always 0 in SS_READY.
+        uint8_t seq_step;
+
+        // number of buffered data packets the client missed. They follow this
+        // packet over the next few loops, along with any newer ones, before
+        // anything else is broadcast to it.
+        uint8_t backlog;
+
+        // the commander's token for taking command back after a reconnect,
+        // see hello_packet. 0 for observers, only the commander gets it.
+        uint32_t commander;
+
+        // how often data goes out in SS_READY, see REQ_CMD_RATE. A client
+        // expects the gaps there to be that long, and EV_RATE_SET events tell
+        // it when that changes.
+        uint16_t ready_ms;
+        uint8_t _pad2[2];
+};
+
+ELET_STATIC_ASSERT(sizeof(struct session_packet) == 32,
+                   "struct session_packet changed size");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, header) == 0,
+                   "struct session_packet.header moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, session) == 16,
+                   "struct session_packet.session moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, resumed) == 20,
+                   "struct session_packet.resumed moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, state) == 21,
+                   "struct session_packet.state moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, seq_step) == 22,
+                   "struct session_packet.seq_step moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, backlog) == 23,
+                   "struct session_packet.backlog moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, commander) == 24,
+                   "struct session_packet.commander moved");
+ELET_STATIC_ASSERT(offsetof(struct session_packet, ready_ms) == 28,
+                   "struct session_packet.ready_ms moved");
+
+#endif // ELET_PROTOCOL_H
@@ -9,35 +9,35 @@ void setup() {
   
   Serial.begin(9600);
 
-  Serial.println("###################################################");
-  Serial.println("####### flow control valve calibration test #######");
-  Serial.println("###################################################");
-  Serial.println("");
+  Serial.println(F("###################################################"));
+  Serial.println(F("####### flow control valve calibration test #######"));
+  Serial.println(F("###################################################"));
+  Serial.println(F(""));
 
   // ask the user for a pwm value. Set the timeout to a while so they aren't rushed
   Serial.setTimeout(1000L*60L*60L);
   int pwm_val = -1;
   for (;;) {
-    Serial.print("Please pick a pwm value in [0,255]: ");
+    Serial.print(F("Please pick a pwm value in [0,255]: "));
     long val = Serial.parseInt();
     if (val < 0 || val > 255) {
       Serial.print(val);
-      Serial.println("is out of range");
+      Serial.println(F("is out of range"));
     } else {
       pwm_val = val;
       break;
     }
   }
 
-  Serial.println("");
-  Serial.print("opening to ");
+  Serial.println(F(""));
+  Serial.print(F("opening to "));
   Serial.println(pwm_val);
 
   const int pin = valve_pin(testing_valve);
   pinMode(pin, OUTPUT);
   analogWrite(pin, pwm_val);
-  Serial.println("valve open. Pressure data follows");
-  Serial.println("digital value, un-calibrated PSI");
+  Serial.println(F("valve open. Pressure data follows"));
+  Serial.println(F("digital value, un-calibrated PSI"));
 }
 
 static float digital_to_psi(int digital)
@@ -51,7 +51,7 @@ static float digital_to_psi(int digital)
 void loop() {
   int pressure = analogRead(FUEL_PRESSURE_PIN);
   Serial.print(pressure);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.println(digital_to_psi(pressure));
   delay(1000);
 }
@@ -0,0 +1 @@
+../../elet.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../elet_protocol.h
\ No newline at end of file
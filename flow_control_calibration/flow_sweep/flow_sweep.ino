@@ -0,0 +1,114 @@
+#include "elet_arduino.h"
+
+// sweep a flow control valve through pwm_bins, up and then back down to
+// see any hysteresis, waiting at each one only until the pressure settles
+// (see sweep_settle()). Prints a CSV line per step:
+//
+//   step, up or down, pwm, settled (y/n), start counts, peak counts,
+//   settled counts, variance, t90 ms, settle ms
+//
+// then a transient line with the counts every SWEEP_SAMPLE_MS after the
+// valve moved, the hysteresis at each pwm value, and how long it all took.
+//
+// Set the valve and its sensor below. The ox flow valve is measured
+// upstream, with the ox on/off valve open; the fuel flow valve downstream
+// of a pressurized tank.
+
+static const enum valve v = OX_FLOW;
+static const enum pressure_sensor ps = PS_OXYGEN;
+
+static const uint8_t pwm_bins[] = {
+        0, 17, 34, 51, 68, 76, 85, 93, 102, 110, 119, 127, 136, 144, 153,
+        161, 170, 178, 187, 195, 204, 221, 238, 255,
+};
+
+#define NR_BINS (sizeof pwm_bins / sizeof pwm_bins[0])
+
+// what each bin got when this was done by hand, going by the readings half
+// a second apart in ox_flow_ctl_ez/screenlog.0
+#define FIXED_DELAY_MS 60000UL
+
+static struct sweep_step step;
+static float up_mean[NR_BINS];
+
+static void print_step(bool up)
+{
+        Serial.print(F("step, "));
+        Serial.print(up ? "up, " : "down, ");
+        Serial.print(step.pwm);
+        Serial.print(step.settled ? ", y, " : ", n, ");
+        Serial.print(step.start);
+        Serial.print(F(", "));
+        Serial.print(step.peak);
+        Serial.print(F(", "));
+        Serial.print(step.mean);
+        Serial.print(F(", "));
+        Serial.print(step.var);
+        Serial.print(F(", "));
+        Serial.print(step.t90_ms);
+        Serial.print(F(", "));
+        Serial.println(step.settle_ms);
+
+        Serial.print(F("transient, "));
+        Serial.print(up ? "up, " : "down, ");
+        Serial.print(step.pwm);
+        for (uint8_t i = 0; i < step.nr_transient; ++i) {
+                Serial.print(i ? " " : ", ");
+                Serial.print(step.transient[i]);
+        }
+        Serial.println();
+}
+
+void setup()
+{
+        unsigned long start_ms;
+        unsigned nr_steps = 0;
+
+        Serial.begin(115200);
+        setup_all_valves();
+
+        // start from empty, then feed the line
+        open_valve(OX_BLEED);
+        delay(1000);
+        close_valve(OX_BLEED);
+        if (v == OX_FLOW) {
+                open_valve(OX_ON_OFF);
+        } else {
+                open_valve(N2_ON_OFF);
+                open_valve(FUEL_ON_OFF);
+        }
+        delay(500);
+
+        start_ms = millis();
+        for (unsigned i = 0; i < NR_BINS; ++i, ++nr_steps) {
+                sweep_settle(v, ps, pwm_bins[i], &step);
+                up_mean[i] = step.mean;
+                print_step(true);
+        }
+        for (unsigned i = NR_BINS - 1; i-- > 0; ++nr_steps) {
+                sweep_settle(v, ps, pwm_bins[i], &step);
+                print_step(false);
+
+                Serial.print(F("hysteresis, "));
+                Serial.print(pwm_bins[i]);
+                Serial.print(F(", "));
+                Serial.println(up_mean[i] - step.mean);
+        }
+
+        const unsigned long took_ms = millis() - start_ms;
+        setup_all_valves();
+
+        Serial.print(F("sweep of "));
+        Serial.print(nr_steps);
+        Serial.print(F(" steps took "));
+        Serial.print(took_ms / 1000.0);
+        Serial.print(F(" s, a fixed "));
+        Serial.print(FIXED_DELAY_MS / 1000);
+        Serial.print(F(" s a step would have taken "));
+        Serial.print(nr_steps * FIXED_DELAY_MS / 1000);
+        Serial.println(F(" s"));
+}
+
+void loop()
+{
+}
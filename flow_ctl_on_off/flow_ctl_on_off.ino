@@ -7,9 +7,9 @@ void setup() {
 void loop() {
   // put your main code here, to run repeatedly:
   analogWrite(11, 0);
-  Serial.println("valve is closed");
+  Serial.println(F("valve is closed"));
   delay(4000);
   analogWrite(11, 255);
-  Serial.println("valve is open");
+  Serial.println(F("valve is open"));
   delay(4000);
 }
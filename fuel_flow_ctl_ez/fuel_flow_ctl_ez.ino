@@ -13,12 +13,12 @@ void setup() {
 
   Serial.begin(9600);
 
-  Serial.println("##########################################################");
-  Serial.println("####### flow control valve calibration test (FUEL) #######");
-  Serial.println("##########################################################");
-  Serial.println("");
+  Serial.println(F("##########################################################"));
+  Serial.println(F("####### flow control valve calibration test (FUEL) #######"));
+  Serial.println(F("##########################################################"));
+  Serial.println(F(""));
 
-  Serial.println("test name, pwm value, digital pressure, analog pressure");
+  Serial.println(F("test name, pwm value, digital pressure, analog pressure"));
 
   close_valve(v);
 }
@@ -43,11 +43,11 @@ void serialEvent() {
 
 void loop() {
   struct pressure_reading r = read_pressure(PS_FUEL);
-  Serial.print("fuel, ");
+  Serial.print(F("fuel, "));
   Serial.print(pwm_bins[bin_idx]);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.print(r.digital);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.println(r.analog);
   delay(500);
 }
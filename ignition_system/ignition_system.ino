@@ -6,12 +6,12 @@ void setup() {
 }
 
 void loop() {
-  Serial.println("about to test fire, press any key to continue");
+  Serial.println(F("about to test fire, press any key to continue"));
   Serial.setTimeout(1000UL * 60UL * 60UL);
   while (Serial.read() == -1)
     ;
 
   enum ignition_status stat = igniter_test_fire();
-  Serial.print("Ignition status was ");
+  Serial.print(F("Ignition status was "));
   Serial.println(ignition_status_to_str(stat));
 }
@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+#
+# turn what a bench sketch streams (see bench_stream_begin() in
+# elet_arduino.h) into a CSV, and when it's done, say how many samples
+# there were at each setpoint and how noisy they were.
+#
+#   ./bench_capture.py [/dev/ttyACM0 | capture] > out.csv
+#
+# Runs until the port closes or ^C. A channel that wasn't read for a
+# sample, like the load cell between conversions, is left empty. Anything
+# that isn't a bench packet with a good CRC is skipped a byte at a time,
+# like serial_events.py does.
+
+from __future__ import print_function
+
+import math
+import os
+import struct
+import sys
+import termios
+import tty
+
+import elet_protocol
+
+# BENCH_BAUD in elet_arduino.h
+BAUD = 500000
+
+BENCH_LEN = struct.calcsize(elet_protocol.PACKETS[elet_protocol.PT_BENCH][1])
+
+CHANNELS = elet_protocol.BENCH_CHANNEL_SHORT_NAMES
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, "B%d" % BAUD)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def samples(fd):
+    """yield the fields of every bench packet we read"""
+    buf = bytearray()
+    while True:
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            return
+        buf += chunk
+
+        while len(buf) >= elet_protocol.HEADER.size:
+            length, typ, _ = elet_protocol.HEADER.unpack_from(buf)
+            if typ != elet_protocol.PT_BENCH or length != BENCH_LEN:
+                del buf[0]
+                continue
+            if len(buf) < length:
+                break
+            if not elet_protocol.packet_crc_ok(buf):
+                del buf[0]
+                continue
+
+            name, pkt = elet_protocol.decode_packet(bytes(buf[:length]))
+            del buf[:length]
+            yield pkt
+
+
+def readings(pkt):
+    """the raw reading of each channel, None if it wasn't read"""
+    vals = [pkt["pressures"][elet_protocol.PS_OXYGEN],
+            pkt["pressures"][elet_protocol.PS_FUEL],
+            pkt["load_cell"]]
+    return [v if pkt["fresh"] & (1 << ch) else None
+            for ch, v in enumerate(vals)]
+
+
+class Stat(object):
+    def __init__(self):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+
+    # Welford's, the sums of squares of raw load cell readings get big
+    def add(self, x):
+        self.n += 1
+        d = x - self.mean
+        self.mean += d / self.n
+        self.m2 += d * (x - self.mean)
+
+    def stddev(self):
+        return math.sqrt(self.m2 / (self.n - 1)) if self.n > 1 else 0.0
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "/dev/ttyACM0"
+    out = sys.stdout
+    setpoints = []
+    stats = {}
+    nr_samples = 0
+    dropped = 0
+
+    out.write("us, setpoint, " + ", ".join(CHANNELS) + "\n")
+    try:
+        for pkt in samples(open_port(path)):
+            vals = readings(pkt)
+            setpoint = pkt["setpoint"]
+            out.write("%u, %g, %s\n" % (
+                pkt["us"], setpoint,
+                ", ".join("" if v is None else str(v) for v in vals)))
+
+            if setpoint not in stats:
+                setpoints.append(setpoint)
+                stats[setpoint] = [Stat() for _ in CHANNELS]
+            for st, v in zip(stats[setpoint], vals):
+                if v is not None:
+                    st.add(v)
+            nr_samples += 1
+            dropped += pkt["dropped"]
+    except KeyboardInterrupt:
+        pass
+    out.flush()
+
+    print("%d samples, %d dropped" % (nr_samples, dropped), file=sys.stderr)
+    for setpoint in setpoints:
+        desc = ["%s %d at %.2f +- %.2f" % (name, st.n, st.mean, st.stddev())
+                for name, st in zip(CHANNELS, stats[setpoint]) if st.n]
+        print("setpoint %g: %s" % (setpoint, ", ".join(desc)),
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
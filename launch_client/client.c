@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,10 +11,15 @@
 #include <unistd.h>
 
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <netinet/ip.h>
+#include <arpa/inet.h>
 
 #include "../elet.h"
+#include "elet_log.h"
+#include "pkt_ring.h"
+#include "run_stats.h"
 
 // exit, possibly with a message
 static void __attribute__((noreturn)) die(const char *reason, int err)
@@ -26,63 +32,411 @@ static void __attribute__((noreturn)) die(const char *reason, int err)
         }
 }
 
-static uint32_t process_packet(const uint8_t *pkt, int logfd,
-                               enum system_state *sys_state)
+// how long we wait for each attempt to connect to the arduino when we're
+// trying to get a dropped connection back, and how long we wait before the
+// next one if the arduino refused us outright
+#define RECONNECT_TIMEOUT_MS 100
+#define RECONNECT_RETRY_MS 10
+
+// what we know about our connection to the arduino
+struct link_state {
+        // session token from the last PT_SESSION packet, 0 if we never got
+        // one. We send it back when we reconnect to resume the session.
+        uint32_t session;
+
+        // the commander token from the last PT_SESSION packet, what lets us
+        // take command back when we reconnect. 0 if we're observing.
+        uint32_t commander;
+
+        // timestamp of the newest data packet we've seen
+        uint32_t last_data_ts;
+
+        // how often the arduino sends data in SS_READY, from the
+        // PT_SESSION packet and then any EV_RATE_SET events
+        uint16_t ready_ms;
+
+        // when we noticed the connection was gone, or 0 if we're not
+        // waiting on a reconnect
+        uint64_t drop_ns;
+
+        // someone said stop while the connection was gone. It goes out as
+        // soon as we're back; any other command is dropped, it'd be stale
+        // by then.
+        bool stop_pending;
+
+        // packets we threw away because their CRC didn't match
+        unsigned long crc_errors;
+
+        // EV_REQ and EV_REQ_REJECTED events we've seen, i.e. commands the
+        // arduino has gotten around to, good or bad
+        unsigned long reqs_heard;
+};
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+                die("clock_gettime", errno);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the watchdog. If the arduino hangs mid-burn we want to hear about it
+// right away, not whenever someone notices the numbers stopped moving. A
+// timerfd ticks a few times per deadline, and on each tick we check for:
+//
+//   - gap: no packets at all for longer than the deadline
+//   - timestamp: packets are coming, but the arduino's clock in them hasn't
+//     moved, so its loop isn't running
+//   - command: we sent a command and haven't heard anything about it, i.e.
+//     no EV_REQ event and the seq hasn't come back
+//
+// In SS_READY the arduino only sends data every so often (see
+// REQ_CMD_RATE), so the deadline there is that long on top of the usual
+// one.
+#define WATCHDOG_DEFAULT_MS 50
+
+// ticks per deadline, so an alarm goes off at most a fifth of a deadline
+// late
+#define WATCHDOG_TICKS 5
+
+// gaps between packets, in power of two ms bins: under 1 ms, 1-2 ms, 2-4 ms
+// and so on, the last one everything from 256 ms up
+#define WATCHDOG_NR_BINS 10
+
+// how often the gap histogram goes in the log
+#define WATCHDOG_LOG_MS 10000
+
+enum watchdog_alarm {
+        WD_GAP,
+        WD_TIMESTAMP,
+        WD_COMMAND,
+        NR_WATCHDOG_ALARMS
+};
+
+static const char *const watchdog_alarm_names[NR_WATCHDOG_ALARMS] = {
+        [WD_GAP] = "gap",
+        [WD_TIMESTAMP] = "timestamp",
+        [WD_COMMAND] = "command",
+};
+
+struct watchdog {
+        int tfd;
+        uint64_t deadline_ns;
+
+        // send a stop when an alarm goes off mid-burn
+        bool auto_stop;
+
+        uint64_t last_pkt_ns;
+
+        // the newest arduino timestamp, and when it last went forward
+        uint32_t last_ts;
+        uint64_t ts_moved_ns;
+
+        // the command we haven't heard about yet: when we sent it (0 if
+        // there isn't one), its seq, and link_state.reqs_heard back then
+        uint64_t cmd_ns;
+        uint32_t cmd_seq;
+        unsigned long cmd_heard;
+
+        // when each alarm went off, 0 if it isn't going
+        uint64_t alarm_ns[NR_WATCHDOG_ALARMS];
+
+        // gaps since the histogram last went in the log
+        unsigned long gaps[WATCHDOG_NR_BINS];
+        uint64_t max_gap_ns;
+        uint64_t logged_ns;
+};
+
+static void watchdog_start(struct watchdog *wd, unsigned deadline_ms,
+                           bool auto_stop)
+{
+        const uint64_t now = now_ns();
+        const uint64_t tick_ns = deadline_ms * 1000000ULL / WATCHDOG_TICKS;
+        struct itimerspec its;
+
+        memset(wd, 0, sizeof *wd);
+        wd->deadline_ns = deadline_ms * 1000000ULL;
+        wd->auto_stop = auto_stop;
+        wd->last_pkt_ns = now;
+        wd->ts_moved_ns = now;
+        wd->logged_ns = now;
+
+        wd->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (wd->tfd == -1)
+                die("timerfd_create", errno);
+
+        memset(&its, 0, sizeof its);
+        its.it_interval.tv_sec = tick_ns / 1000000000ULL;
+        its.it_interval.tv_nsec = tick_ns % 1000000000ULL;
+        its.it_value = its.it_interval;
+        if (timerfd_settime(wd->tfd, 0, &its, NULL) == -1)
+                die("timerfd_settime", errno);
+}
+
+// we got a packet stamped ts
+static void watchdog_packet(struct watchdog *wd, uint32_t ts, uint32_t seq,
+                            const struct link_state *link)
+{
+        const uint64_t now = now_ns();
+        const uint64_t gap_ms = (now - wd->last_pkt_ns) / 1000000;
+        int bin = 0;
+
+        while (bin < WATCHDOG_NR_BINS - 1 && gap_ms >= 1ULL << bin)
+                ++bin;
+        ++wd->gaps[bin];
+        if (now - wd->last_pkt_ns > wd->max_gap_ns)
+                wd->max_gap_ns = now - wd->last_pkt_ns;
+        wd->last_pkt_ns = now;
+
+        // resent packets are older than what we have
+        if ((int32_t)(ts - wd->last_ts) > 0) {
+                wd->last_ts = ts;
+                wd->ts_moved_ns = now;
+        }
+
+        if (wd->cmd_ns && (link->reqs_heard != wd->cmd_heard
+                           || seq >= wd->cmd_seq))
+                wd->cmd_ns = 0;
+}
+
+// we sent command seq
+static void watchdog_sent(struct watchdog *wd, uint32_t seq,
+                          const struct link_state *link)
+{
+        if (wd->cmd_ns)
+                return;
+
+        wd->cmd_ns = now_ns();
+        wd->cmd_seq = seq;
+        wd->cmd_heard = link->reqs_heard;
+}
+
+// an alarm is going off if going, or it stopped. Returns true if it just
+// went off.
+static bool watchdog_set(struct watchdog *wd, enum watchdog_alarm a,
+                         bool going, uint64_t since_ns, int logfd)
+{
+        const uint64_t now = now_ns();
+        const char *name = watchdog_alarm_names[a];
+
+        if (going && !wd->alarm_ns[a]) {
+                wd->alarm_ns[a] = now;
+                fprintf(stderr, "\aWATCHDOG: %s, nothing for %.0f ms\n",
+                        name, (now - since_ns) / 1e6);
+                dprintf(logfd, "watchdog, %u, %s, %.3f\n", wd->last_ts, name,
+                        (now - since_ns) / 1e6);
+                return true;
+        }
+
+        if (!going && wd->alarm_ns[a]) {
+                fprintf(stderr, "watchdog: %s cleared after %.0f ms\n", name,
+                        (now - wd->alarm_ns[a]) / 1e6);
+                dprintf(logfd, "watchdog_clear, %u, %s, %.3f\n", wd->last_ts,
+                        name, (now - wd->alarm_ns[a]) / 1e6);
+                wd->alarm_ns[a] = 0;
+        }
+        return false;
+}
+
+// the timer went off. Returns true if we should stop the engine, i.e. the
+// arduino just went quiet mid-burn and we're supposed to do something
+// about it.
+static bool watchdog_tick(struct watchdog *wd, enum system_state sys_state,
+                          const struct link_state *link, int logfd)
+{
+        const uint64_t now = now_ns();
+        uint64_t deadline = wd->deadline_ns;
+        uint64_t expirations;
+        bool fired = false;
+
+        if (read(wd->tfd, &expirations, sizeof expirations) == -1
+            && errno != EAGAIN)
+                die("read timerfd", errno);
+
+        if (sys_state == SS_READY)
+                deadline += link->ready_ms * 1000000ULL;
+
+        const bool gap = now - wd->last_pkt_ns > deadline;
+        fired |= watchdog_set(wd, WD_GAP, gap, wd->last_pkt_ns, logfd);
+        fired |= watchdog_set(wd, WD_TIMESTAMP,
+                              !gap && now - wd->ts_moved_ns > deadline,
+                              wd->ts_moved_ns, logfd);
+
+        // not worth a stop of its own, the stop might be what's lost
+        watchdog_set(wd, WD_COMMAND, wd->cmd_ns && now - wd->cmd_ns > deadline,
+                     wd->cmd_ns, logfd);
+
+        // gaps, time, max ms, then the histogram bins
+        if (now - wd->logged_ns >= WATCHDOG_LOG_MS * 1000000ULL) {
+                dprintf(logfd, "gaps, %u, %.3f", wd->last_ts,
+                        wd->max_gap_ns / 1e6);
+                for (int i = 0; i < WATCHDOG_NR_BINS; ++i)
+                        dprintf(logfd, ", %lu", wd->gaps[i]);
+                dprintf(logfd, "\n");
+
+                memset(wd->gaps, 0, sizeof wd->gaps);
+                wd->max_gap_ns = 0;
+                wd->logged_ns = now;
+        }
+
+        return fired && wd->auto_stop && sys_state == SS_FIRE;
+}
+
+static uint32_t process_packet(const struct pkt_view *pkt, int logfd,
+                               enum system_state *sys_state,
+                               struct link_state *link,
+                               struct run_stats *run)
 {
-        struct packet_header *hdr = (struct packet_header *)pkt;
-        uint32_t seq = hdr->seq;
+        const uint8_t type = elet_view_header_type(pkt);
+        const uint16_t len = pkt->len;
+        uint32_t seq = elet_view_header_seq(pkt);
+
+        // the packet got mangled somewhere. The length must have been fine
+        // since we found the next header, but nothing else can be trusted,
+        // so skip it
+        if (!pkt_view_crc_ok(pkt)) {
+                ++link->crc_errors;
+                fprintf(stderr, "%s: bad crc on packet type %x, %lu so far\n",
+                        __func__, type, link->crc_errors);
+                dprintf(logfd, "crcfail, %lu, 0x%x, %hu\n", link->crc_errors,
+                        type, len);
+                return 0;
+        }
 
-        if (hdr->type == PT_DATA) {
-                struct data_packet *dpkt = (struct data_packet *)pkt;
-                if (hdr->len != sizeof *dpkt) {
+        if (type == PT_DATA) {
+                if (len != sizeof(struct data_packet)) {
                         fprintf(stderr, "%s: bad data header len %hu\n",
-                                __func__, hdr->len);
+                                __func__, len);
                         goto die_bad_packet;
                 }
 
+                const uint8_t state = elet_view_data_state(pkt);
+                const uint32_t ts = elet_view_header_timestamp(pkt);
+
                 // we expect this bit to be zero
-                if (dpkt->state & 0x80)
+                if (elet_state_reserved(state))
                         fprintf(stderr, "BAD: corrupted bit in dpkt->state\n", EIO);
                 
+                *sys_state = (enum system_state)elet_state_sys_state(state);
+
+                elet_log_data_packet(logfd, pkt);
+
+                // the numbers for the run are ready as soon as safing is
+                // done
+                if (run_stats_add(run, ts, elet_state_sys_state(state),
+                                  elet_view_data_pressures(pkt, PS_OXYGEN),
+                                  elet_view_data_pressures(pkt, PS_FUEL),
+                                  elet_view_data_thrust(pkt))) {
+                        fprintf(stderr, "run finished: ");
+                        run_stats_print(stderr, run);
+                        run_stats_log(logfd, run);
+                        run_stats_reset(run);
+                }
+
+                // packets resent after a reconnect can be older than what
+                // we already have
+                if ((int32_t)(ts - link->last_data_ts) > 0)
+                        link->last_data_ts = ts;
+
+                // first data since we lost the connection
+                if (link->drop_ns) {
+                        double ms = (now_ns() - link->drop_ns) / 1e6;
+
+                        fprintf(stderr, "reconnected, data after %.1f ms\n",
+                                ms);
+                        dprintf(logfd, "reconnect, %u, %u, %.3f\n",
+                                ts, seq, ms);
+                        link->drop_ns = 0;
+                }
+
+        } else if (type == PT_SESSION) {
+                if (len != sizeof(struct session_packet)) {
+                        fprintf(stderr, "%s: bad session header len %hu\n",
+                                __func__, len);
+                        goto die_bad_packet;
+                }
+
+                const uint32_t session = elet_view_session_session(pkt);
+
+                // the arduino only makes up a new session token when it
+                // boots
+                if (link->session && session != link->session)
+                        fprintf(stderr, "arduino reset!\n");
+                else if (elet_view_session_resumed(pkt))
+                        fprintf(stderr, "resumed session at step %u, "
+                                "%u packets of backlog\n",
+                                elet_view_session_seq_step(pkt),
+                                elet_view_session_backlog(pkt));
+
+                link->session = session;
+                link->commander = elet_view_session_commander(pkt);
+                link->ready_ms = elet_view_session_ready_ms(pkt);
                 *sys_state = (enum system_state)
-                        ((dpkt->state & (0x7 << 3)) >> 3);
-
-                // data, timestamp, seq, solenoid states, ox pwm state, fuel pwm state,
-                // last ignition status, state, igniter good, ps1, ps2, t1,
-                // t2, thrust.
-                // 
-                // See comments in struct data_packet for bit twiddling
-                // explanation.
-                dprintf(logfd,
-                        "data, %u, %u, 0x%x, %u, %u, 0x%x, 0x%x, %d, %hu, %hu, %f, %f, %u\n",
-                        dpkt->header.timestamp,
-                        seq,
-                        dpkt->vlv_states,
-                        dpkt->vlv_pwm_ox,
-                        dpkt->vlv_pwm_fuel,
-                        dpkt->state & 0x7,
-                        (dpkt->state & (0x7 << 3)) >> 3, 
-                        (dpkt->state & (0x1 << 6)) >> 6,
-                        dpkt->pressures[0],
-                        dpkt->pressures[1],
-                        dpkt->temps[0],
-                        dpkt->temps[1],
-                        dpkt->thrust);
-
-        } else if (hdr->type == PT_MESSAGE) {
-                struct message_packet *mpkt = (struct message_packet *)pkt;
-                if (hdr->len != sizeof *mpkt) {
+                        elet_state_sys_state(elet_view_session_state(pkt));
+
+                elet_log_session_packet(logfd, pkt);
+
+        } else if (type == PT_MESSAGE) {
+                // only as long as its text
+                if (len < MESSAGE_PACKET_MIN_LEN
+                    || len > sizeof(struct message_packet)) {
                         fprintf(stderr, "%s: bad message header len %hu\n",
-                                __func__, hdr->len);
+                                __func__, len);
+                        goto die_bad_packet;
+                }
+
+                elet_log_message_packet(logfd, pkt);
+
+        } else if (type == PT_EVENT) {
+                char text[128];
+
+                if (len != sizeof(struct event_packet)) {
+                        fprintf(stderr, "%s: bad event header len %hu\n",
+                                __func__, len);
                         goto die_bad_packet;
                 }
 
-                dprintf(logfd, "message, %u, %u, %s\n",
-                        mpkt->header.timestamp, seq, mpkt->data);
+                elet_log_event_packet(logfd, pkt);
+
+                if (elet_view_event_id(pkt) == EV_REQ
+                    || elet_view_event_id(pkt) == EV_REQ_REJECTED)
+                        ++link->reqs_heard;
+
+                // whoever asked, the gaps in SS_READY just changed
+                if (elet_view_event_id(pkt) == EV_RATE_SET
+                    && elet_view_event_arg0(pkt) == SS_READY)
+                        link->ready_ms = elet_view_event_arg1(pkt);
+
+                elet_event_format(text, sizeof text, elet_view_event_id(pkt),
+                                  elet_view_event_arg0(pkt),
+                                  elet_view_event_arg1(pkt));
+                if (elet_view_event_dropped(pkt))
+                        fprintf(stderr, "arduino: (%u events lost)\n",
+                                elet_view_event_dropped(pkt));
+                fprintf(stderr, "arduino: %s\n", text);
+
+        } else if (type == PT_STATS) {
+                if (len != sizeof(struct stats_packet)) {
+                        fprintf(stderr, "%s: bad stats header len %hu\n",
+                                __func__, len);
+                        goto die_bad_packet;
+                }
+
+                elet_log_stats_packet(logfd, pkt);
+
+        } else if (type == PT_TRANSITION) {
+                if (len != sizeof(struct transition_packet)) {
+                        fprintf(stderr, "%s: bad transition header len %hu\n",
+                                __func__, len);
+                        goto die_bad_packet;
+                }
+
+                elet_log_transition_packet(logfd, pkt);
 
         } else {
                 fprintf(stderr, "%s: invalid packet type %x\n", __func__,
-                        hdr->type);
+                        type);
 
                 goto die_bad_packet;
         }
@@ -93,9 +447,9 @@ die_bad_packet:
         die("bad packet", EINVAL);
 }
 
-static uint32_t process_command(const char *buf, size_t size,
-                                uint32_t last_seq,
-                                enum system_state sys_state, int sd)
+static uint32_t process_command(const char *buf, uint32_t last_seq,
+                                enum system_state sys_state, int sd,
+                                struct link_state *link)
 {
         uint32_t sent_seq = last_seq + 1;
         struct req_packet pkt;
@@ -184,6 +538,91 @@ static uint32_t process_command(const char *buf, size_t size,
 
                 goto send_pkt;
 
+        // redline <rule> <value>, see REQ_CMD_REDLINE
+        } else if (strncmp(buf, "redline ", strlen("redline ")) == 0) {
+                enum redline rule = NR_REDLINES;
+
+                if (sys_state != SS_READY) {
+                        fprintf(stderr,
+                                "%s: can't change redlines while the engine is running\n",
+                                __func__);
+                        goto bad_command;
+                }
+
+                buf += strlen("redline ");
+                for (enum redline r = FIRST_REDLINE; r < NR_REDLINES;
+                     r = (enum redline)(r + 1)) {
+                        const char *sname = redline_to_short_str(r);
+                        size_t len = strlen(sname);
+
+                        if (strncmp(buf, sname, len) == 0
+                            && buf[len] == ' ') {
+                                rule = r;
+                                buf += len + 1;
+                                break;
+                        }
+                }
+
+                if (rule == NR_REDLINES)
+                        goto bad_command;
+
+                char *end = NULL;
+                errno = 0;
+                long val = strtol(buf, &end, 10);
+                if (errno || end == buf || *end != '\0')
+                        goto bad_command;
+
+                // it has to fit in the 24 bits of redline_arg.value
+                if (val < 0 || val > 0xffffff)
+                        goto bad_command;
+
+                pkt.cmd = REQ_CMD_REDLINE;
+                pkt.arg = elet_redline_arg_pack(rule, (uint32_t)val);
+
+                fprintf(stderr, "setting redline %s to %ld\n",
+                        redline_to_str(rule), val);
+
+                goto send_pkt;
+
+        // rate <state> <ms>, see REQ_CMD_RATE
+        } else if (strncmp(buf, "rate ", strlen("rate ")) == 0) {
+                enum system_state state = SS_NUM_STATES;
+
+                buf += strlen("rate ");
+                for (enum system_state st = SS_READY; st < SS_NUM_STATES;
+                     st = (enum system_state)(st + 1)) {
+                        const char *sname = system_state_to_short_str(st);
+                        size_t len = strlen(sname);
+
+                        if (strncmp(buf, sname, len) == 0
+                            && buf[len] == ' ') {
+                                state = st;
+                                buf += len + 1;
+                                break;
+                        }
+                }
+
+                if (state == SS_NUM_STATES)
+                        goto bad_command;
+
+                char *end = NULL;
+                errno = 0;
+                long ms = strtol(buf, &end, 10);
+                if (errno || end == buf || *end != '\0')
+                        goto bad_command;
+
+                // it has to fit in the 16 bits of rate_arg.interval_ms
+                if (ms < 0 || ms > 0xffff)
+                        goto bad_command;
+
+                pkt.cmd = REQ_CMD_RATE;
+                pkt.arg = elet_rate_arg_pack(state, (uint32_t)ms);
+
+                fprintf(stderr, "sending data every %ld ms in %s\n", ms,
+                        system_state_to_str(state));
+
+                goto send_pkt;
+
         // valve manipulation
         } else if (strncmp(buf, "v ", 2) == 0) {
 
@@ -198,7 +637,7 @@ static uint32_t process_command(const char *buf, size_t size,
                 pkt.cmd = REQ_MOD_VALVE;
 
                 if (strcmp(buf, "off") == 0) {
-                        pkt.arg = 0xff;
+                        pkt.arg = elet_valve_arg_pack(0xff, 0);
                 } else {
                         enum valve which_valve = NR_VALVES;
 
@@ -243,19 +682,13 @@ static uint32_t process_command(const char *buf, size_t size,
                         if (*buf != '\0')
                                 goto bad_command;
 
-                        // fill in the arg field of the packet
-                        uint32_t arg = 0;
-
-                        arg |= (uint32_t)which_valve & 0xff;
-
-                        // do what the command asked for
+                        // do what the command asked for. off is 0, on is
+                        // all the way open
+                        uint32_t val = 0;
                         if (on)
-                                arg |= valve_is_flow(which_valve) ? 0xff00
-                                        : 0x100;
-                        // else turn the valve off, which means set bits
-                        // 8-15 to 0, which they already are
-                        
-                        pkt.arg = arg;
+                                val = valve_is_flow(which_valve) ? 0xff : 1;
+
+                        pkt.arg = elet_valve_arg_pack(which_valve, val);
                 }
 
                 fprintf(stderr, "modding a valve\n");
@@ -272,6 +705,20 @@ send_pkt:
         // http://stackoverflow.com/q/8384388/3775803
         ;
 
+        // we're reconnecting, see reconnect_poll()
+        if (sd == -1) {
+                if (pkt.cmd == REQ_CMD_STOP) {
+                        link->stop_pending = true;
+                        fprintf(stderr, "not connected, stopping as soon "
+                                "as we're back\n");
+                } else {
+                        fprintf(stderr, "not connected, dropping command\n");
+                }
+                return -1U;
+        }
+
+        elet_seal_packet(&pkt.header);
+
         size_t sent = 0;
         size_t remaining = sizeof pkt;
         for (int i = 0; i < 1000; ++i) {
@@ -316,23 +763,166 @@ send_pkt:
         die("failed to write to socket after 1000 tries, giving up", EIO);
 }
 
-static void say_hello(int sd)
+// say hello so the server picks us up. If we've talked to this server
+// before, ask to resume our session. Returns false if the connection is
+// already dead.
+static bool say_hello(int sd, uint8_t role, uint32_t seq,
+                      const struct link_state *link)
 {
         struct hello_packet pkt;
         memset(&pkt, 0, sizeof pkt);
         pkt.header.len = sizeof pkt;
         pkt.header.type = PT_HELLO;
-        pkt.header.seq = 1;
-
+        pkt.header.seq = seq;
+        pkt.role = role;
+        pkt.session = link->session;
+        pkt.last_timestamp = link->last_data_ts;
+        pkt.commander = link->commander;
+        elet_seal_packet(&pkt.header);
+
+        // the socket is brand new, so this can't be a short write
         ssize_t ret = write(sd, &pkt, sizeof pkt);
-        if (ret == -1)
-                die("failed to say hello", errno);
-        else if (ret != sizeof pkt)
-                die("failed to write whole hello packet", EIO);
+        return ret == sizeof pkt;
+}
+
+// start connecting to the server. The socket we return is non-blocking,
+// and it's connected once poll says it's writable and connect_done() says
+// it worked. Returns -1 if the connect failed outright.
+static int connect_start(const struct sockaddr_in *addr)
+{
+        int sd, flags, err;
+
+        // grab a socket
+        sd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sd == -1)
+                die("socket failed", errno);
+
+        // set socket as non-blocking
+        flags = fcntl(sd, F_GETFL);
+        if (flags == -1)
+                die("fcntl(sd, F_GETFL) failed", errno);
+
+        err = fcntl(sd, F_SETFL, flags|O_NONBLOCK);
+        if (err == -1)
+                die("fcntl(sd, F_SETFL) failed", errno);
+
+        // connect to the server (arduino)
+        err = connect(sd, (const struct sockaddr *)addr, sizeof *addr);
+        if (err == -1 && errno != EINPROGRESS) {
+                close(sd);
+                return -1;
+        }
+
+        return sd;
+}
+
+// the connect on sd finished, did it work?
+static bool connect_done(int sd)
+{
+        int err;
+        socklen_t errlen = sizeof err;
+
+        return getsockopt(sd, SOL_SOCKET, SO_ERROR, &err, &errlen) == 0
+                && err == 0;
+}
+
+// connect to the server, however long that takes. Returns -1 if we
+// couldn't.
+static int connect_to_server(const struct sockaddr_in *addr)
+{
+        struct pollfd pfd;
+        int sd;
+
+        sd = connect_start(addr);
+        if (sd == -1)
+                return -1;
+
+        pfd.fd = sd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) != 1 || !connect_done(sd)) {
+                close(sd);
+                return -1;
+        }
+
+        return sd;
 }
 
 static int global_sd = -1;
 
+// getting a dropped connection back. It's one more thing the main loop
+// polls for, so the watchdog and stdin don't wait on it: the time it takes
+// is just a gap in the data as far as the watchdog is concerned.
+struct reconnect {
+        // the connect in progress, -1 if there isn't one
+        int sd;
+
+        // when it started, or if there isn't one, when the next one can
+        uint64_t start_ns;
+};
+
+// start the next connect. If it fails outright, wait a bit before the
+// one after, so we don't spin.
+static void reconnect_try(struct reconnect *rc,
+                          const struct sockaddr_in *addr, uint64_t now)
+{
+        rc->sd = connect_start(addr);
+        rc->start_ns = now;
+        if (rc->sd == -1)
+                rc->start_ns += RECONNECT_RETRY_MS * 1000000ULL;
+}
+
+// we lost the connection on sd. Start getting it back.
+static void reconnect_start(struct reconnect *rc, int sd,
+                            const struct sockaddr_in *addr,
+                            struct link_state *link)
+{
+        close(sd);
+        global_sd = -1;
+
+        link->drop_ns = now_ns();
+        fprintf(stderr, "lost connection to the arduino, reconnecting\n");
+
+        reconnect_try(rc, addr, link->drop_ns);
+}
+
+// see how getting the connection back is going. revents is what poll said
+// about rc->sd. Once we're connected, ask to resume where we left off and
+// return the new socket; until then, return -1.
+static int reconnect_poll(struct reconnect *rc, short revents,
+                          const struct sockaddr_in *addr, uint8_t role,
+                          uint32_t seq, struct link_state *link)
+{
+        const uint64_t now = now_ns();
+
+        if (rc->sd != -1) {
+                if (revents && connect_done(rc->sd)
+                    && say_hello(rc->sd, role, seq, link)) {
+                        int sd = rc->sd;
+
+                        rc->sd = -1;
+                        global_sd = sd;
+                        return sd;
+                }
+
+                // same as a connect that fails outright
+                if (revents) {
+                        close(rc->sd);
+                        rc->sd = -1;
+                        rc->start_ns = now + RECONNECT_RETRY_MS * 1000000ULL;
+                } else if (now - rc->start_ns
+                           >= RECONNECT_TIMEOUT_MS * 1000000ULL) {
+                        close(rc->sd);
+                        rc->sd = -1;
+                }
+        }
+
+        if (rc->sd == -1 && now >= rc->start_ns)
+                reconnect_try(rc, addr, now);
+
+        return -1;
+}
+
 void sigint_handler(int sig)
 {
         (void)sig;
@@ -345,48 +935,82 @@ int main(int argc, char **argv)
 {
         int err, sd, flags, ret, logfd;
         struct sockaddr_in addr;
+        struct link_state link;
+        struct run_stats run;
+        struct watchdog wd;
+        struct reconnect rc;
+        int argi = 1;
+
+        // observers get telemetry but can't send commands, so any number
+        // of people can watch a run while one person drives it
+        bool observer = false;
+
+        int watchdog_ms = WATCHDOG_DEFAULT_MS;
+        bool auto_stop = false;
+
+        while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+                if (strcmp(argv[argi], "--observe") == 0) {
+                        observer = true;
+                } else if (strcmp(argv[argi], "--watchdog") == 0
+                           && argi + 1 < argc) {
+                        watchdog_ms = atoi(argv[++argi]);
+                        if (watchdog_ms <= 0)
+                                goto usage;
+                } else if (strcmp(argv[argi], "--auto-stop") == 0) {
+                        auto_stop = true;
+                } else {
+                        goto usage;
+                }
+                ++argi;
+        }
+
+        // only the commander can stop anything
+        if (auto_stop && observer)
+                goto usage;
+
+        const uint8_t role = observer ? HELLO_ROLE_OBSERVER
+                : HELLO_ROLE_COMMANDER;
+
+        // define the server address. It's the arduino unless someone says
+        // otherwise, e.g. to talk to a simulated one.
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(ELET_NET_ADDR);
+        addr.sin_port = htons(ELET_NET_PORT);
+
+        if (argi < argc
+            && inet_pton(AF_INET, argv[argi++], &addr.sin_addr) != 1)
+                goto usage;
+
+        if (argi < argc)
+                addr.sin_port = htons(atoi(argv[argi++]));
 
-        (void)argc;
-        (void)argv;
+        if (argi != argc)
+                goto usage;
 
         // open a logfile
         logfd = open("run.log", O_CREAT|O_RDWR|O_APPEND, S_IRUSR|S_IWUSR);
         if (logfd == -1)
                 die("failed to open logfd", errno);
 
-        // grab a socket
-        sd = socket(AF_INET, SOCK_STREAM, 0);
-        if (sd == -1)
-                die("socket failed", errno);
-
-        // put the socket in a global so a signal handler can close it on
-        // Ctrl-C
-        global_sd = sd;
         if (signal(SIGINT, sigint_handler) == SIG_ERR)
                 die("signal", errno);
 
-        // define the server address
-        memset(&addr, 0, sizeof addr);
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = htonl(ELET_NET_ADDR);
-        addr.sin_port = htons(ELET_NET_PORT);
-
         // connect to the server (arduino)
-        err = connect(sd, (struct sockaddr *)&addr, sizeof addr);
-        if (err == -1)
+        sd = connect_to_server(&addr);
+        if (sd == -1)
                 die("connect failed", errno);
 
-        // send the hello packet so the sever picks us up
-        say_hello(sd);
-
-        // set socket as non-blocking
-        flags = fcntl(sd, F_GETFL);
-        if (flags == -1)
-                die("fcntl(sd, F_GETFL) failed", errno);
+        // put the socket in a global so a signal handler can close it on
+        // Ctrl-C
+        global_sd = sd;
 
-        err = fcntl(sd, F_SETFL, flags|O_NONBLOCK);
-        if (err == -1)
-                die("fcntl(sd, F_SETFL) failed", errno);
+        // send the hello packet so the sever picks us up. The "hello"
+        // packet has seq = 1
+        memset(&link, 0, sizeof link);
+        run_stats_reset(&run);
+        if (!say_hello(sd, role, 1, &link))
+                die("failed to say hello", errno);
 
         // set stdin as non-blocking
         flags = fcntl(STDIN_FILENO, F_GETFL);
@@ -397,34 +1021,31 @@ int main(int argc, char **argv)
         if (err == -1)
                 die("fcntl(stdin, F_SETFL) failed", errno);
 
-        // setup buffers. one for reading from socket, one for reading from
-        // command line
+        // setup buffers. a ring for reading from socket, one for reading
+        // from command line. The ring is big enough for the burst of
+        // backlog the server sends when we resume a session.
         const size_t bsize = 1024;
-        uint8_t *pkt_buf = calloc(1, bsize);
+        struct pkt_ring pkt_ring;
         char *cmd_buf = calloc(1, bsize);
-        if (!pkt_buf || !cmd_buf)
+        if (!pkt_ring_init(&pkt_ring, 4096) || !cmd_buf)
                 die("calloc failed", ENOMEM);
 
         // buffer indexes/sizes. idx's are the index of the first freee byte
         // in the buffer; space's are the space left in each buffer.
-        size_t pkt_idx = 0;
-        size_t pkt_space = bsize;
         size_t cmd_idx = 0;
         size_t cmd_space = bsize;
 
-        struct packet_header *hdr = NULL;
-
         uint32_t seq_acked = 0; 
         uint32_t seq_sent = 1; // the "hello" packet we sent has seq = 1
 
-        // if we don't here from the server for 2 seconds, something bad
-        // happened. (this won't necessarily catch death if someone is
-        // typing things on the command line constantly.
-        const int timeout_ms = -1; // XXX: change me
-
         // the state we think the arduino system is in;
         enum system_state sys_state = SS_READY;
 
+        // noticing the arduino went quiet is the watchdog's job, so poll
+        // can wait as long as it likes, unless we're reconnecting
+        watchdog_start(&wd, watchdog_ms, auto_stop);
+        rc.sd = -1;
+
         for (;;) {
                 const short events = POLLIN;
                 const short bad_revents = POLLERR | POLLHUP | POLLNVAL;
@@ -435,16 +1056,37 @@ int main(int argc, char **argv)
                                 .events = events,
                                 .revents = 0
                         },
+                        // the connect in progress if we're reconnecting,
+                        // if any
+                        {
+                                .fd = sd != -1 ? sd : rc.sd,
+                                .events = sd != -1 ? events : POLLOUT,
+                                .revents = 0
+                        },
                         {
-                                .fd = sd,
+                                .fd = wd.tfd,
                                 .events = events,
                                 .revents = 0
                         }
                 };
                 
-                ret = poll(fds, (sizeof fds)/(sizeof fds[0]), timeout_ms);
-                if (ret == 0)
-                        die("poll timeout exceeded!", EIO);
+                ret = poll(fds, (sizeof fds)/(sizeof fds[0]),
+                           sd != -1 ? -1 : RECONNECT_RETRY_MS);
+                if (ret == -1 && errno != EINTR)
+                        die("poll", errno);
+
+                // the watchdog says the arduino went quiet mid-burn, and
+                // we were told to stop the engine if it did
+                if ((fds[2].revents & events)
+                    && watchdog_tick(&wd, sys_state, &link, logfd)) {
+                        fprintf(stderr, "watchdog: sending stop\n");
+                        uint32_t s = process_command("stop", seq_sent,
+                                                     sys_state, sd, &link);
+                        if (s != -1U) {
+                                seq_sent = s;
+                                watchdog_sent(&wd, s, &link);
+                        }
+                }
 
                 // something happend on stdin!
                 if (fds[0].revents & (events|bad_revents)) {
@@ -476,11 +1118,19 @@ int main(int argc, char **argv)
                                 // okay we got a newline--process the command
                                 // (but null-terminate it first, to be nice)
                                 cmd_buf[i] = '\0';
-                                uint32_t s = process_command(cmd_buf, i,
-                                                             seq_sent,
-                                                             sys_state, sd);
-                                if (s != -1U)
-                                        seq_sent = s;
+                                if (observer) {
+                                        fprintf(stderr,
+                                                "observing, ignoring command\n");
+                                } else {
+                                        uint32_t s = process_command(cmd_buf,
+                                                                     seq_sent,
+                                                                     sys_state, sd,
+                                                                     &link);
+                                        if (s != -1U) {
+                                                seq_sent = s;
+                                                watchdog_sent(&wd, s, &link);
+                                        }
+                                }
 
                                 // skip past the newline char so i now
                                 // indexes the first byte of the next
@@ -504,59 +1154,91 @@ int main(int argc, char **argv)
                         }
                 }
 
+                // the connection's gone, see if it's back yet. If
+                // someone said stop in the meantime, that's the first
+                // thing it hears.
+                if (sd == -1) {
+                        sd = reconnect_poll(&rc, fds[1].revents, &addr, role,
+                                            seq_sent, &link);
+                        if (sd != -1 && link.stop_pending) {
+                                link.stop_pending = false;
+                                uint32_t s = process_command("stop", seq_sent,
+                                                             sys_state, sd,
+                                                             &link);
+                                if (s != -1U) {
+                                        seq_sent = s;
+                                        watchdog_sent(&wd, s, &link);
+                                }
+                        }
+
                 // something happened on our socket!
-                if (fds[1].revents & (events|bad_revents)) {
-                        if (fds[1].revents & bad_revents)
-                                die("something bad happened on socket", EIO);
+                } else if (fds[1].revents & (events|bad_revents)) {
+                        ssize_t ret = -1;
 
                         // this shouldn't happen unless my code is buggy
-                        if (cmd_space == 0)
+                        if (pkt_ring_free(&pkt_ring) == 0)
                                 die("packet buffer full", ENOMEM);
 
-                        ssize_t ret = read(sd, pkt_buf + pkt_idx, pkt_space);
+                        if (!(fds[1].revents & bad_revents))
+                                ret = pkt_ring_read_fd(&pkt_ring, sd);
+
+                        // the connection died (or the arduino hung up on
+                        // us). Start getting it back, and throw away
+                        // whatever partial packet we had, the server will
+                        // resend it.
+                        if (ret == 0 || (ret == -1 && errno != EAGAIN)) {
+                                reconnect_start(&rc, sd, &addr, &link);
+                                sd = -1;
+                                pkt_ring_reset(&pkt_ring);
+                                continue;
+                        }
+
                         if (ret == -1)
-                                die("failed to read from socket", errno);
-
-                        pkt_idx += ret;
-                        pkt_space -= ret;
-
-                        if (pkt_idx >= sizeof *hdr)
-                                // this technically violates strict aliasing,
-                                // but we allocated pkt_buf with calloc,
-                                // it's sufficiently alligned
-                                hdr = (struct packet_header *)pkt_buf;
-
-                        if (hdr) {
-                                uint16_t len = hdr->len;
-
-                                // we read this whole packet
-                                if (pkt_idx >= len) {
-                                        uint32_t s = process_packet(pkt_buf,
-                                                                    logfd,
-                                                                    &sys_state);
-
-                                        // uh-oh, the arduino sent back
-                                        // a seq number less than what
-                                        // we've seen so far: this probably
-                                        // means it reset. This is probs bad
-                                        if (s < seq_acked || s == 0) {
-                                                fprintf(stderr,
-                                                        "arduino reset!\n");
-                                        }
+                                continue;
 
-                                        seq_acked = s;
+                        // process every whole packet we have. After a
+                        // reconnect the server sends a burst of them.
+                        struct pkt_view pkt;
+                        while (pkt_ring_peek(&pkt_ring, &pkt)) {
+                                // a length this far off means we lost our
+                                // place in the stream, and there's no
+                                // finding it again
+                                if (pkt.len < sizeof(struct packet_header)
+                                    || pkt.len > pkt_ring.size)
+                                        die("bad packet length", EINVAL);
+
+                                // we haven't read this whole packet yet
+                                if (pkt_ring_used(&pkt_ring) < pkt.len)
+                                        break;
 
-                                        memmove(pkt_buf, pkt_buf + len,
-                                                bsize - len);
-                                        
-                                        memset(pkt_buf + (pkt_idx - len), 0,
-                                               bsize - (pkt_idx - len));
+                                const unsigned long crc_errors =
+                                        link.crc_errors;
+                                uint32_t s = process_packet(&pkt, logfd,
+                                                            &sys_state, &link,
+                                                            &run);
+
+                                // nothing in a packet with a bad crc can be
+                                // trusted, including its timestamp
+                                if (link.crc_errors == crc_errors)
+                                        watchdog_packet(&wd,
+                                                        elet_view_header_timestamp(&pkt),
+                                                        s, &link);
+
+                                // arduino resets are detected by the
+                                // session token changing, see
+                                // process_packet(). Within a session the
+                                // seq only goes up, except in resent
+                                // packets.
+                                if (s > seq_acked)
+                                        seq_acked = s;
 
-                                        hdr = NULL;
-                                        pkt_idx -= len;
-                                        pkt_space += len;
-                                }
+                                pkt_ring_consume(&pkt_ring, pkt.len);
                         }
                 }
         }
+
+usage:
+        fprintf(stderr, "usage: %s [--observe] [--watchdog ms] [--auto-stop] "
+                "[addr [port]]\n", argv[0]);
+        exit(1);
 }
@@ -0,0 +1,82 @@
+// how much does checking packet CRCs cost on the client? Times the
+// byte-at-a-time table CRC (what the arduino runs) against slicing-by-8
+// (what the client runs) on packets of the sizes we actually send.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../elet.h"
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the textbook bit-at-a-time version, to check the fast ones against
+static uint16_t crc16_bitwise(const uint8_t *p, size_t len)
+{
+        uint16_t crc = ELET_CRC16_INIT;
+
+        while (len--) {
+                crc ^= *p++;
+                for (int i = 0; i < 8; ++i)
+                        crc = crc & 1 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+        return crc;
+}
+
+// keep the compiler from throwing the work away
+static volatile uint16_t sink;
+
+static void bench(const char *name, size_t len)
+{
+        const int iters = 2000000;
+        uint8_t *buf = malloc(len);
+        uint64_t start;
+        double slow_ns, fast_ns;
+
+        for (size_t i = 0; i < len; ++i)
+                buf[i] = rand();
+
+        uint16_t want = crc16_bitwise(buf, len);
+        if (elet_crc16_update(ELET_CRC16_INIT, buf, len) != want
+            || elet_crc16_update_fast(ELET_CRC16_INIT, buf, len) != want) {
+                fprintf(stderr, "%s: crc mismatch\n", name);
+                exit(1);
+        }
+
+        start = now_ns();
+        for (int i = 0; i < iters; ++i) {
+                buf[0] = i;
+                sink = elet_crc16_update(ELET_CRC16_INIT, buf, len);
+        }
+        slow_ns = (double)(now_ns() - start) / iters;
+
+        start = now_ns();
+        for (int i = 0; i < iters; ++i) {
+                buf[0] = i;
+                sink = elet_crc16_update_fast(ELET_CRC16_INIT, buf, len);
+        }
+        fast_ns = (double)(now_ns() - start) / iters;
+
+        printf("%-16s %4zu bytes  table %7.1f ns/pkt  slice-by-8 %7.1f ns/pkt"
+               "  (%.0f MB/s)\n", name, len, slow_ns, fast_ns,
+               len / fast_ns * 1e3);
+
+        free(buf);
+}
+
+int main(void)
+{
+        bench("data_packet", sizeof(struct data_packet));
+        bench("req_packet", sizeof(struct req_packet));
+        bench("message_packet", sizeof(struct message_packet));
+        return 0;
+}
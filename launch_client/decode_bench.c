@@ -0,0 +1,284 @@
+// what does decoding packets through views cost compared to casting the
+// buffer to packet structs? Rebuilds the packet stream the arduino sent
+// from recorded run.logs (see run_log.h), then pushes it through
+//
+//   cast  what the client used to do: a linear buffer, memmove each packet
+//         to the front and cast it to a struct
+//   view  what it does now: a ring buffer, packets at whatever offset they
+//         landed at (wrapping included), fields read through elet_view.h
+//
+// Both decode every field of every packet and must agree on every value.
+//
+// usage: decode_bench [-c chunk] [-r ring size] run.log...
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "elet_view.h"
+#include "run_log.h"
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void __attribute__((noreturn)) die(const char *why)
+{
+        fprintf(stderr, "%s\n", why);
+        exit(1);
+}
+
+// the byte stream, as it came off the socket
+static struct pkt_stream stream;
+
+// fold a value into a running hash, so both ways have to get every field
+// exactly right to agree
+static inline uint64_t mix(uint64_t h, uint64_t v)
+{
+        return (h ^ v) * 0x100000001b3ULL;
+}
+
+static inline uint64_t mix_f(uint64_t h, float f)
+{
+        uint32_t x;
+        memcpy(&x, &f, sizeof x);
+        return mix(h, x);
+}
+
+static uint64_t decode_cast(const uint8_t *pkt, bool check_crc)
+{
+        const struct packet_header *hdr = (const struct packet_header *)pkt;
+        uint64_t h = mix(mix(hdr->type, hdr->seq), hdr->timestamp);
+
+        if (check_crc && !elet_packet_crc_ok(hdr))
+                die("cast: bad crc");
+
+        if (hdr->type == PT_DATA) {
+                const struct data_packet *d = (const struct data_packet *)pkt;
+                h = mix(h, d->vlv_states);
+                h = mix(h, d->vlv_pwm_ox);
+                h = mix(h, d->vlv_pwm_fuel);
+                h = mix(h, elet_state_ign_status(d->state));
+                h = mix(h, elet_state_sys_state(d->state));
+                h = mix(h, elet_state_igniter_good(d->state));
+                for (int i = 0; i < NR_PSENSORS; ++i)
+                        h = mix(h, d->pressures[i]);
+                for (int i = 0; i < NR_THERMOCOUPLES; ++i)
+                        h = mix_f(h, d->temps[i]);
+                h = mix(h, d->thrust);
+                h = mix(h, d->crc_errors);
+        } else if (hdr->type == PT_SESSION) {
+                const struct session_packet *s =
+                        (const struct session_packet *)pkt;
+                h = mix(h, s->session);
+                h = mix(h, s->resumed);
+                h = mix(h, s->state);
+                h = mix(h, s->seq_step);
+                h = mix(h, s->backlog);
+        } else if (hdr->type == PT_MESSAGE) {
+                const struct message_packet *m =
+                        (const struct message_packet *)pkt;
+                h = mix(h, m->id);
+                h = mix(h, hdr->len - MESSAGE_PACKET_MIN_LEN);
+        }
+        return h;
+}
+
+static uint64_t decode_view(const struct pkt_view *v, bool check_crc)
+{
+        const uint8_t type = elet_view_header_type(v);
+        uint64_t h = mix(mix(type, elet_view_header_seq(v)),
+                         elet_view_header_timestamp(v));
+
+        if (check_crc && !pkt_view_crc_ok(v))
+                die("view: bad crc");
+
+        if (type == PT_DATA) {
+                const uint8_t state = elet_view_data_state(v);
+                h = mix(h, elet_view_data_vlv_states(v));
+                h = mix(h, elet_view_data_vlv_pwm_ox(v));
+                h = mix(h, elet_view_data_vlv_pwm_fuel(v));
+                h = mix(h, elet_state_ign_status(state));
+                h = mix(h, elet_state_sys_state(state));
+                h = mix(h, elet_state_igniter_good(state));
+                for (int i = 0; i < NR_PSENSORS; ++i)
+                        h = mix(h, elet_view_data_pressures(v, i));
+                for (int i = 0; i < NR_THERMOCOUPLES; ++i)
+                        h = mix_f(h, elet_view_data_temps(v, i));
+                h = mix(h, elet_view_data_thrust(v));
+                h = mix(h, elet_view_data_crc_errors(v));
+        } else if (type == PT_SESSION) {
+                h = mix(h, elet_view_session_session(v));
+                h = mix(h, elet_view_session_resumed(v));
+                h = mix(h, elet_view_session_state(v));
+                h = mix(h, elet_view_session_seq_step(v));
+                h = mix(h, elet_view_session_backlog(v));
+        } else if (type == PT_MESSAGE) {
+                char text[sizeof(((struct message_packet *)0)->text)];
+                h = mix(h, elet_view_message_id(v));
+                h = mix(h, elet_view_message_text(v, text));
+        }
+        return h;
+}
+
+// the old client loop: read into the end of a linear buffer, handle every
+// whole packet at the front, memmove the rest down
+static uint64_t run_cast(size_t chunk, bool check_crc, size_t *npkts)
+{
+        const size_t bsize = 1024;
+        static uint8_t *buf;
+        size_t idx = 0;
+        uint64_t h = 0;
+
+        if (!buf && !(buf = calloc(1, bsize)))
+                die("out of memory");
+
+        for (size_t off = 0; off < stream.len; ) {
+                size_t n = chunk;
+                if (n > bsize - idx)
+                        n = bsize - idx;
+                if (n > stream.len - off)
+                        n = stream.len - off;
+                memcpy(buf + idx, stream.buf + off, n);
+                idx += n;
+                off += n;
+
+                while (idx >= sizeof(struct packet_header)) {
+                        uint16_t len = ((struct packet_header *)buf)->len;
+                        if (idx < len)
+                                break;
+                        h = mix(h, decode_cast(buf, check_crc));
+                        ++*npkts;
+                        memmove(buf, buf + len, idx - len);
+                        idx -= len;
+                }
+        }
+        return h;
+}
+
+// the ring is set up once, its size rounded up to a power of two
+static struct pkt_ring ring;
+
+static uint64_t run_view(size_t chunk, size_t ring_size, bool check_crc,
+                         size_t *npkts, size_t *nwrapped)
+{
+        struct pkt_view v;
+        uint64_t h = 0;
+
+        if (!ring.buf && !pkt_ring_init(&ring, ring_size))
+                die("out of memory");
+        pkt_ring_reset(&ring);
+
+        for (size_t off = 0; off < stream.len; ) {
+                size_t n = chunk;
+                if (n > pkt_ring_free(&ring))
+                        n = pkt_ring_free(&ring);
+                if (n > stream.len - off)
+                        n = stream.len - off;
+                pkt_ring_write(&ring, stream.buf + off, n);
+                off += n;
+
+                while (pkt_ring_peek(&ring, &v)) {
+                        if (pkt_ring_used(&ring) < v.len)
+                                break;
+                        h = mix(h, decode_view(&v, check_crc));
+                        ++*npkts;
+                        if ((v.start & (ring.size - 1)) + v.len > ring.size)
+                                ++*nwrapped;
+                        pkt_ring_consume(&ring, v.len);
+                }
+        }
+        return h;
+}
+
+static volatile uint64_t sink;
+
+static void bench(size_t chunk, size_t ring_size, bool check_crc)
+{
+        size_t cast_pkts = 0, view_pkts = 0, wrapped = 0;
+        uint64_t cast_h, view_h, start;
+        double cast_ns, view_ns;
+        int reps = 0;
+
+        // check they agree before timing anything
+        cast_h = run_cast(chunk, check_crc, &cast_pkts);
+        view_h = run_view(chunk, ring_size, check_crc, &view_pkts, &wrapped);
+        if (cast_h != view_h || cast_pkts != stream.npkts
+            || view_pkts != stream.npkts)
+                die("cast and view decoded different things");
+
+        start = now_ns();
+        do {
+                size_t n = 0;
+                sink = run_cast(chunk, check_crc, &n);
+                ++reps;
+        } while (now_ns() - start < 300000000ULL);
+        cast_ns = (double)(now_ns() - start) / ((double)reps * stream.npkts);
+
+        reps = 0;
+        start = now_ns();
+        do {
+                size_t n = 0, w = 0;
+                sink = run_view(chunk, ring_size, check_crc, &n, &w);
+                ++reps;
+        } while (now_ns() - start < 300000000ULL);
+        view_ns = (double)(now_ns() - start) / ((double)reps * stream.npkts);
+
+        printf("chunk %5zu  ring %5zu  crc %-3s  cast %6.1f ns/pkt  "
+               "view %6.1f ns/pkt  (%zu of %zu pkts wrapped)\n",
+               chunk, ring.size, check_crc ? "yes" : "no", cast_ns, view_ns,
+               wrapped, stream.npkts);
+}
+
+int main(int argc, char **argv)
+{
+        size_t chunk = 0, ring_size = 4096;
+        int i = 1;
+
+        for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+                if (strcmp(argv[i], "-c") == 0)
+                        chunk = strtoul(argv[i + 1], NULL, 10);
+                else if (strcmp(argv[i], "-r") == 0)
+                        ring_size = strtoul(argv[i + 1], NULL, 10);
+                else
+                        goto usage;
+        }
+        if (i >= argc)
+                goto usage;
+        if (ring_size < sizeof(struct message_packet))
+                die("ring too small to hold a packet");
+
+        for (; i < argc; ++i)
+                if (pkt_stream_load(&stream, argv[i]) < 0)
+                        die("can't read log");
+        if (!stream.npkts)
+                die("no packets in those logs");
+
+        printf("%zu packets, %zu bytes\n", stream.npkts, stream.len);
+
+        // the arduino's writes usually arrive whole, but TCP is free to
+        // chop them up however it likes, so try some odd sizes too
+        if (chunk) {
+                bench(chunk, ring_size, false);
+                bench(chunk, ring_size, true);
+        } else {
+                const size_t chunks[] = { 40, 97, 512, 1460 };
+                for (size_t c = 0; c < sizeof chunks / sizeof chunks[0]; ++c) {
+                        bench(chunks[c], ring_size, false);
+                        bench(chunks[c], ring_size, true);
+                }
+        }
+        return 0;
+
+usage:
+        fprintf(stderr, "usage: %s [-c chunk] [-r ring size] run.log...\n",
+                argv[0]);
+        return 1;
+}
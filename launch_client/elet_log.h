@@ -0,0 +1,204 @@
+// generated by protocol/gen_protocol.py from protocol/protocol.py.
+// Don't edit by hand.
+
+#ifndef ELET_LOG_H
+#define ELET_LOG_H
+
+// run.log line formatters. post.py and friends parse these lines with
+// parse_log_line() from elet_protocol.py, which is generated from the same
+// description, so the two can't drift apart.
+
+#include <stdio.h>
+
+#include "elet_view.h"
+
+// data, time, seq, valve states, ox pwm, fuel pwm, ign stat, state, igniter
+// good, ox pressure, fuel pressure, ox temp, water temp, thrust, crc errors
+static inline int
+elet_log_data_packet(int fd, const struct pkt_view *p)
+{
+        return dprintf(fd, "data, %u, %u, 0x%x, %u, %u, 0x%x, 0x%x, %d, %hu, %hu, %f, %f, %u, %hu\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       elet_view_data_vlv_states(p),
+                       elet_view_data_vlv_pwm_ox(p),
+                       elet_view_data_vlv_pwm_fuel(p),
+                       elet_state_ign_status(elet_view_data_state(p)),
+                       elet_state_sys_state(elet_view_data_state(p)),
+                       elet_state_igniter_good(elet_view_data_state(p)),
+                       elet_view_data_pressures(p, PS_OXYGEN),
+                       elet_view_data_pressures(p, PS_FUEL),
+                       elet_view_data_temps(p, TC_OXYGEN),
+                       elet_view_data_temps(p, TC_WATER),
+                       elet_view_data_thrust(p),
+                       elet_view_data_crc_errors(p));
+}
+
+// message, time, seq, msg
+static inline int
+elet_log_message_packet(int fd, const struct pkt_view *p)
+{
+        char text[sizeof(((struct message_packet *)0)->text) + 1];
+        const char *id = message_to_str(
+                (enum message)elet_view_message_id(p));
+
+        text[elet_view_message_text(p, text)] = '\0';
+
+        return dprintf(fd, "message, %u, %u, %s%s%s\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       id,
+                       *id && *text ? ": " : "",
+                       text);
+}
+
+// event, time, seq, us, id, dropped, arg0, arg1
+static inline int
+elet_log_event_packet(int fd, const struct pkt_view *p)
+{
+        return dprintf(fd, "event, %u, %u, %u, %u, %u, %u, %u\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       elet_view_event_us(p),
+                       elet_view_event_id(p),
+                       elet_view_event_dropped(p),
+                       elet_view_event_arg0(p),
+                       elet_view_event_arg1(p));
+}
+
+// stats, time, seq, section, count, min us, max us, sum us, hist0, hist1,
+// hist2, hist3, hist4, hist5, hist6, hist7
+static inline int
+elet_log_stats_packet(int fd, const struct pkt_view *p)
+{
+        return dprintf(fd, "stats, %u, %u, %u, %u, %u, %u, %u, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       elet_view_stats_section(p),
+                       elet_view_stats_count(p),
+                       elet_view_stats_min_us(p),
+                       elet_view_stats_max_us(p),
+                       elet_view_stats_sum_us(p),
+                       elet_view_stats_hist(p, 0),
+                       elet_view_stats_hist(p, 1),
+                       elet_view_stats_hist(p, 2),
+                       elet_view_stats_hist(p, 3),
+                       elet_view_stats_hist(p, 4),
+                       elet_view_stats_hist(p, 5),
+                       elet_view_stats_hist(p, 6),
+                       elet_view_stats_hist(p, 7));
+}
+
+// transition, time, seq, us, what, old, new, cause, state, dropped, arg
+static inline int
+elet_log_transition_packet(int fd, const struct pkt_view *p)
+{
+        return dprintf(fd, "transition, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       elet_view_transition_us(p),
+                       elet_view_transition_what(p),
+                       elet_view_transition_old_value(p),
+                       elet_view_transition_new_value(p),
+                       elet_view_transition_cause(p),
+                       elet_view_transition_state(p),
+                       elet_view_transition_dropped(p),
+                       elet_view_transition_arg(p));
+}
+
+// session, time, seq, session, resumed, ign stat, state, step, backlog
+static inline int
+elet_log_session_packet(int fd, const struct pkt_view *p)
+{
+        return dprintf(fd, "session, %u, %u, 0x%x, %u, 0x%x, 0x%x, %u, %u\n",
+                       elet_view_header_timestamp(p),
+                       elet_view_header_seq(p),
+                       elet_view_session_session(p),
+                       elet_view_session_resumed(p),
+                       elet_state_ign_status(elet_view_session_state(p)),
+                       elet_state_sys_state(elet_view_session_state(p)),
+                       elet_view_session_seq_step(p),
+                       elet_view_session_backlog(p));
+}
+
+// turn an event from an event_packet into text. Returns what snprintf
+// would.
+static inline int
+elet_event_format(char *buf, size_t n, uint8_t id, uint16_t arg0,
+                  uint32_t arg1)
+{
+        switch (id) {
+        case EV_BOOT:
+                return snprintf(buf, n, "launch server up, session 0x%lx",
+                                (unsigned long)arg1);
+        case EV_STATE:
+                return snprintf(buf, n, "state %s -> %s",
+                                system_state_to_str((enum system_state)arg0),
+                                system_state_to_str((enum system_state)arg1));
+        case EV_BAD_STEP:
+                return snprintf(buf, n, "got weird %s step %lu",
+                                system_state_to_str((enum system_state)arg0),
+                                (unsigned long)arg1);
+        case EV_CONTINUITY:
+                return snprintf(buf, n, "igniter continuity %lu",
+                                (unsigned long)arg1);
+        case EV_IGNITION:
+                return snprintf(buf, n, "ignition %s",
+                                ignition_status_to_str((enum ignition_status)arg0));
+        case EV_REQ:
+                return snprintf(buf, n, "command %u, arg %lu",
+                                (unsigned)arg0,
+                                (unsigned long)arg1);
+        case EV_REQ_REJECTED:
+                return snprintf(buf, n, "rejected command %u, arg %lu",
+                                (unsigned)arg0,
+                                (unsigned long)arg1);
+        case EV_CLIENT_NEW:
+                return snprintf(buf, n, "new client on socket %u",
+                                (unsigned)arg0);
+        case EV_CLIENT_DEAD:
+                return snprintf(buf, n, "dropped client on socket %u",
+                                (unsigned)arg0);
+        case EV_COMMANDER_RESUMED:
+                return snprintf(buf, n, "commander resumed on socket %u",
+                                (unsigned)arg0);
+        case EV_SHORT_WRITE:
+                return snprintf(buf, n, "socket %u: short write of a %lu byte packet",
+                                (unsigned)arg0,
+                                (unsigned long)arg1);
+        case EV_REDLINE:
+                return snprintf(buf, n, "redline %s tripped, reading %lu",
+                                redline_to_str((enum redline)arg0),
+                                (unsigned long)arg1);
+        case EV_REDLINE_SET:
+                return snprintf(buf, n, "redline %s set to %lu",
+                                redline_to_str((enum redline)arg0),
+                                (unsigned long)arg1);
+        case EV_FIRE_STEP:
+                return snprintf(buf, n, "fire step %u ran %ld us late",
+                                (unsigned)arg0,
+                                (long)(int32_t)arg1);
+        case EV_SAFING_STEP:
+                return snprintf(buf, n, "safing step %u ran %ld us late",
+                                (unsigned)arg0,
+                                (long)(int32_t)arg1);
+        case EV_DEPRESS_STEP:
+                return snprintf(buf, n, "depress step %u ran %ld us late",
+                                (unsigned)arg0,
+                                (long)(int32_t)arg1);
+        case EV_SEQ_SAVED:
+                return snprintf(buf, n, "%s finished %lu ms early",
+                                system_state_to_str((enum system_state)arg0),
+                                (unsigned long)arg1);
+        case EV_RATE_SET:
+                return snprintf(buf, n, "%s data every %lu ms",
+                                system_state_to_str((enum system_state)arg0),
+                                (unsigned long)arg1);
+        default:
+                return snprintf(buf, n, "unknown event %u, args %u %lu",
+                                (unsigned)id, (unsigned)arg0,
+                                (unsigned long)arg1);
+        }
+}
+
+#endif // ELET_LOG_H
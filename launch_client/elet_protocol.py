@@ -0,0 +1,671 @@
+# generated by protocol/gen_protocol.py from protocol/protocol.py.
+# Don't edit by hand.
+
+"""names, run.log parsing and binary packet decoding for the elet protocol"""
+
+import struct
+
+VALVE_SHORT_NAMES = [
+    'oxoo',
+    'oxbl',
+    'oxfl',
+    'n2pr',
+    'n2oo',
+    'fufl',
+    'fuoo',
+]
+VALVE_NAMES = [
+    'oxygen on/off',
+    'oxygen bleed',
+    'oxygen flow control',
+    'nitrogen purge',
+    'nitrogen on/off',
+    'fuel flow control',
+    'fuel on/off',
+]
+OX_ON_OFF = 0
+OX_BLEED = 1
+OX_FLOW = 2
+N2_PURGE = 3
+N2_ON_OFF = 4
+FUEL_FLOW = 5
+FUEL_ON_OFF = 6
+NR_VALVES = 7
+
+PRESSURE_SENSOR_SHORT_NAMES = [
+    'ox',
+    'fuel',
+]
+PRESSURE_SENSOR_NAMES = [
+    'oxygen (yellow)',
+    'fuel (blue)',
+]
+PS_OXYGEN = 0
+PS_FUEL = 1
+NR_PSENSORS = 2
+
+THERMOCOUPLE_SHORT_NAMES = [
+    'ox',
+    'water',
+]
+THERMOCOUPLE_NAMES = [
+    'oxygen',
+    'water',
+]
+TC_OXYGEN = 0
+TC_WATER = 1
+NR_THERMOCOUPLES = 2
+
+IGNITION_STATUS_SHORT_NAMES = [
+    'success',
+    'no_isense_wire',
+    'bad_igniter',
+    'no_ignition',
+]
+IGNITION_STATUS_NAMES = [
+    'success',
+    'failed: no ignition sense wire present',
+    'failed: no continuity across igniter',
+    'failed: no ignition',
+    'no ignition attempted',
+]
+IGN_SUCCESS = 0
+IGN_FAIL_NO_ISENSE_WIRE = 1
+IGN_FAIL_BAD_IGNITER = 2
+IGN_FAIL_NO_IGNITION = 3
+IGN_NUM_STATUSES = 4
+
+LOOP_SECTION_SHORT_NAMES = [
+    'loop',
+    'gather',
+    'rx',
+    'send',
+    'fire',
+    'safing',
+    'depress',
+]
+LOOP_SECTION_NAMES = [
+    'all of loop()',
+    'gather_all_data()',
+    'rx_continue()',
+    'send_packet()',
+    'continue_fire()',
+    'continue_safing()',
+    'continue_depress()',
+]
+LS_LOOP = 0
+LS_GATHER = 1
+LS_RX = 2
+LS_SEND = 3
+LS_FIRE = 4
+LS_SAFING = 5
+LS_DEPRESS = 6
+NR_LOOP_SECTIONS = 7
+
+REDLINE_SHORT_NAMES = [
+    'ox_over',
+    'fuel_over',
+    'ox_under',
+    'fuel_under',
+    'thrust_low',
+    'ox_stuck',
+    'fuel_stuck',
+    'thrust_stuck',
+]
+REDLINE_NAMES = [
+    'oxygen over pressure',
+    'fuel over pressure',
+    'oxygen under pressure',
+    'fuel under pressure',
+    'low thrust',
+    'oxygen pressure sensor stuck',
+    'fuel pressure sensor stuck',
+    'load cell stuck',
+]
+RL_OX_OVER = 0
+RL_FUEL_OVER = 1
+RL_OX_UNDER = 2
+RL_FUEL_UNDER = 3
+RL_THRUST_LOW = 4
+RL_OX_STUCK = 5
+RL_FUEL_STUCK = 6
+RL_THRUST_STUCK = 7
+NR_REDLINES = 8
+
+TRANSITION_CAUSE_SHORT_NAMES = [
+    'command',
+    'sequence',
+    'redline',
+]
+TRANSITION_CAUSE_NAMES = [
+    'command',
+    'sequence step',
+    'redline',
+]
+CAUSE_COMMAND = 0
+CAUSE_SEQUENCE = 1
+CAUSE_REDLINE = 2
+NR_TRANSITION_CAUSES = 3
+
+BENCH_CHANNEL_SHORT_NAMES = [
+    'ox',
+    'fuel',
+    'load_cell',
+]
+BENCH_CHANNEL_NAMES = [
+    'oxygen pressure',
+    'fuel pressure',
+    'load cell',
+]
+BENCH_OX = 0
+BENCH_FUEL = 1
+BENCH_LOAD_CELL = 2
+NR_BENCH_CHANNELS = 3
+
+MESSAGE_SHORT_NAMES = [
+    'text',
+    'bad_command',
+    'observer',
+    'bad_crc',
+    'observer_command',
+]
+MESSAGE_NAMES = [
+    '',
+    'processed bad command',
+    'commander already connected, attached as observer',
+    'dropped packet with bad crc',
+    "observers can't send commands",
+]
+MSG_TEXT = 0
+MSG_BAD_COMMAND = 1
+MSG_OBSERVER = 2
+MSG_BAD_CRC = 3
+MSG_OBSERVER_COMMAND = 4
+NR_MESSAGES = 5
+
+SYSTEM_STATE_SHORT_NAMES = [
+    'ready',
+    'fire',
+    'safing',
+    'depress',
+]
+SYSTEM_STATE_NAMES = [
+    'ready',
+    'firing',
+    'safing',
+    'fuel depressurization',
+    "num states (shouldn't happen)",
+]
+SS_READY = 0
+SS_FIRE = 1
+SS_SAFING = 2
+SS_DEPRESS = 3
+SS_NUM_STATES = 4
+
+PT_DATA = 1
+PT_REQ = 2
+PT_MESSAGE = 3
+PT_HELLO = 4
+PT_SESSION = 5
+PT_EVENT = 6
+PT_STATS = 7
+PT_TRANSITION = 8
+PT_BENCH = 9
+REQ_CMD_STOP = 0
+REQ_CMD_START = 1
+REQ_CMD_START_MIN_BURN_TIME = 2
+REQ_CMD_START_MAX_BURN_TIME = 120
+REQ_MOD_VALVE = 2
+REQ_CMD_DEPRESS = 3
+REQ_CMD_DEPRESS_MIN_TIMEOUT = 15
+REQ_CMD_DEPRESS_MAX_TIMEOUT = 120
+REQ_CMD_REDLINE = 4
+REQ_CMD_RATE = 5
+HELLO_ROLE_COMMANDER = 0
+HELLO_ROLE_OBSERVER = 1
+TR_IGNITER = 254
+TR_STATE = 255
+STATS_NR_BINS = 8
+
+EVENT_NAMES = [
+    'EV_BOOT',
+    'EV_STATE',
+    'EV_BAD_STEP',
+    'EV_CONTINUITY',
+    'EV_IGNITION',
+    'EV_REQ',
+    'EV_REQ_REJECTED',
+    'EV_CLIENT_NEW',
+    'EV_CLIENT_DEAD',
+    'EV_COMMANDER_RESUMED',
+    'EV_SHORT_WRITE',
+    'EV_REDLINE',
+    'EV_REDLINE_SET',
+    'EV_FIRE_STEP',
+    'EV_SAFING_STEP',
+    'EV_DEPRESS_STEP',
+    'EV_SEQ_SAVED',
+    'EV_RATE_SET',
+]
+EV_BOOT = 0
+EV_STATE = 1
+EV_BAD_STEP = 2
+EV_CONTINUITY = 3
+EV_IGNITION = 4
+EV_REQ = 5
+EV_REQ_REJECTED = 6
+EV_CLIENT_NEW = 7
+EV_CLIENT_DEAD = 8
+EV_COMMANDER_RESUMED = 9
+EV_SHORT_WRITE = 10
+EV_REDLINE = 11
+EV_REDLINE_SET = 12
+EV_FIRE_STEP = 13
+EV_SAFING_STEP = 14
+EV_DEPRESS_STEP = 15
+EV_SEQ_SAVED = 16
+EV_RATE_SET = 17
+EV_NUM_EVENTS = 18
+
+# event id -> (printf format, (arg0 kind, arg1 kind))
+EVENT_FORMATS = [
+    ('launch server up, session 0x%lx', (None, 'int')),
+    ('state %s -> %s', ('system_state', 'system_state')),
+    ('got weird %s step %lu', ('system_state', 'int')),
+    ('igniter continuity %lu', (None, 'int')),
+    ('ignition %s', ('ignition_status', None)),
+    ('command %u, arg %lu', ('int', 'int')),
+    ('rejected command %u, arg %lu', ('int', 'int')),
+    ('new client on socket %u', ('int', None)),
+    ('dropped client on socket %u', ('int', None)),
+    ('commander resumed on socket %u', ('int', None)),
+    ('socket %u: short write of a %lu byte packet', ('int', 'int')),
+    ('redline %s tripped, reading %lu', ('redline', 'int')),
+    ('redline %s set to %lu', ('redline', 'int')),
+    ('fire step %u ran %ld us late', ('int', 'sint')),
+    ('safing step %u ran %ld us late', ('int', 'sint')),
+    ('depress step %u ran %ld us late', ('int', 'sint')),
+    ('%s finished %lu ms early', ('system_state', 'int')),
+    ('%s data every %lu ms', ('system_state', 'int')),
+]
+
+
+
+def state_ign_status(v):
+    return (v >> 0) & 0x7
+
+
+def state_sys_state(v):
+    return (v >> 3) & 0x7
+
+
+def state_igniter_good(v):
+    return (v >> 6) & 0x1
+
+
+def state_reserved(v):
+    return (v >> 7) & 0x1
+
+
+def valve_arg_valve(v):
+    return (v >> 0) & 0xff
+
+
+def valve_arg_value(v):
+    return (v >> 8) & 0xff
+
+
+def redline_arg_rule(v):
+    return (v >> 0) & 0xff
+
+
+def redline_arg_value(v):
+    return (v >> 8) & 0xffffff
+
+
+def rate_arg_state(v):
+    return (v >> 0) & 0xff
+
+
+def rate_arg_interval_ms(v):
+    return (v >> 8) & 0xffff
+
+
+# tag -> [(column name, kind)] for every line the client logs a packet as
+LOG_COLUMNS = {
+    'data': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('valve states', 'hex'),
+        ('ox pwm', 'int'),
+        ('fuel pwm', 'int'),
+        ('ign stat', 'hex'),
+        ('state', 'hex'),
+        ('igniter good', 'int'),
+        ('ox pressure', 'int'),
+        ('fuel pressure', 'int'),
+        ('ox temp', 'float'),
+        ('water temp', 'float'),
+        ('thrust', 'int'),
+        ('crc errors', 'int'),
+    ],
+    'message': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('msg', 'str'),
+    ],
+    'event': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('us', 'int'),
+        ('id', 'int'),
+        ('dropped', 'int'),
+        ('arg0', 'int'),
+        ('arg1', 'int'),
+    ],
+    'stats': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('section', 'int'),
+        ('count', 'int'),
+        ('min us', 'int'),
+        ('max us', 'int'),
+        ('sum us', 'int'),
+        ('hist0', 'int'),
+        ('hist1', 'int'),
+        ('hist2', 'int'),
+        ('hist3', 'int'),
+        ('hist4', 'int'),
+        ('hist5', 'int'),
+        ('hist6', 'int'),
+        ('hist7', 'int'),
+    ],
+    'transition': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('us', 'int'),
+        ('what', 'int'),
+        ('old', 'int'),
+        ('new', 'int'),
+        ('cause', 'int'),
+        ('state', 'int'),
+        ('dropped', 'int'),
+        ('arg', 'int'),
+    ],
+    'session': [
+        ('time', 'int'),
+        ('seq', 'int'),
+        ('session', 'hex'),
+        ('resumed', 'int'),
+        ('ign stat', 'hex'),
+        ('state', 'hex'),
+        ('step', 'int'),
+        ('backlog', 'int'),
+    ],
+}
+
+
+def _parse_col(kind, s):
+    if kind == 'int':
+        # some old logs have e.g. thrust as a float in lbf
+        try:
+            return int(s)
+        except ValueError:
+            return float(s)
+    if kind == 'hex':
+        return int(s, 16)
+    if kind == 'float':
+        return float(s)
+    return s[1:] if s.startswith(' ') else s
+
+
+def parse_log_line(line):
+    """parse one run.log line, already split on commas (e.g. by
+    csv.reader). Returns (tag, {column name: value}), or (tag, None)
+    for lines that aren't a logged packet"""
+    if not line:
+        return None, None
+    tag = line[0]
+    cols = LOG_COLUMNS.get(tag)
+    if cols is None:
+        return tag, None
+
+    fields = line[1:]
+    # a string column is last and may itself contain commas
+    if cols[-1][1] == 'str' and len(fields) > len(cols):
+        fields = fields[:len(cols) - 1] \
+            + [','.join(fields[len(cols) - 1:])]
+    # logs from older clients are missing columns that were added on
+    # the end since, those just aren't in the dict
+    if len(fields) > len(cols):
+        raise ValueError('%s line has %d columns, expected %d'
+                         % (tag, len(fields), len(cols)))
+
+    return tag, dict((name, _parse_col(kind, f))
+                     for (name, kind), f in zip(cols, fields))
+
+
+# packet type -> (struct name, struct format, [(field, count)])
+PACKETS = {
+    PT_DATA: ('data_packet', '<HBBIIHHBBBB2H2fIHH', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('vlv_states', 1),
+        ('vlv_pwm_ox', 1),
+        ('vlv_pwm_fuel', 1),
+        ('state', 1),
+        ('pressures', 2),
+        ('temps', 2),
+        ('thrust', 1),
+        ('crc_errors', 1),
+        ('_pad1', 1),
+    ]),
+    PT_REQ: ('req_packet', '<HBBIIHHB3BI', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('cmd', 1),
+        ('_pad1', 3),
+        ('arg', 1),
+    ]),
+    PT_MESSAGE: ('message_packet', '<HBBIIHHB255s', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('id', 1),
+        ('text', 0),
+    ]),
+    PT_EVENT: ('event_packet', '<HBBIIHHIBBHI', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('us', 1),
+        ('id', 1),
+        ('dropped', 1),
+        ('arg0', 1),
+        ('arg1', 1),
+    ]),
+    PT_STATS: ('stats_packet', '<HBBIIHHB3BIIII8H', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('section', 1),
+        ('_pad1', 3),
+        ('count', 1),
+        ('min_us', 1),
+        ('max_us', 1),
+        ('sum_us', 1),
+        ('hist', 8),
+    ]),
+    PT_TRANSITION: ('transition_packet', '<HBBIIHHIBBBBBB2BI', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('us', 1),
+        ('what', 1),
+        ('old_value', 1),
+        ('new_value', 1),
+        ('cause', 1),
+        ('state', 1),
+        ('dropped', 1),
+        ('_pad2', 2),
+        ('arg', 1),
+    ]),
+    PT_BENCH: ('bench_packet', '<HBBIIHHIfBBH2HI', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('us', 1),
+        ('setpoint', 1),
+        ('channels', 1),
+        ('fresh', 1),
+        ('dropped', 1),
+        ('pressures', 2),
+        ('load_cell', 1),
+    ]),
+    PT_HELLO: ('hello_packet', '<HBBIIHHB3BIII', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('role', 1),
+        ('_pad1', 3),
+        ('session', 1),
+        ('last_timestamp', 1),
+        ('commander', 1),
+    ]),
+    PT_SESSION: ('session_packet', '<HBBIIHHIBBBBIH2B', [
+        ('len', 1),
+        ('type', 1),
+        ('_pad1', 1),
+        ('seq', 1),
+        ('timestamp', 1),
+        ('crc', 1),
+        ('_pad2', 1),
+        ('session', 1),
+        ('resumed', 1),
+        ('state', 1),
+        ('seq_step', 1),
+        ('backlog', 1),
+        ('commander', 1),
+        ('ready_ms', 1),
+        ('_pad2', 2),
+    ]),
+}
+
+# packet type -> shortest length, for packets that are only as long as what's
+# used of their last field
+VAR_LEN = {
+    PT_MESSAGE: 17,
+}
+
+HEADER = struct.Struct('<HBB')
+
+
+def decode_packet(buf, offset=0):
+    """decode the packet at buf[offset:]. Returns (struct name, {field: value}),
+    arrays come back as lists and byte arrays as bytes. Padding is dropped.
+    Raises ValueError on unknown packet types or bad lengths"""
+    length, typ, _ = HEADER.unpack_from(buf, offset)
+    if typ not in PACKETS:
+        raise ValueError('unknown packet type %d' % typ)
+
+    name, fmt, fields = PACKETS[typ]
+    st = struct.Struct(fmt)
+    min_len = VAR_LEN.get(typ, st.size)
+    if length < min_len or length > st.size:
+        raise ValueError('%s with length %d, expected %d'
+                         % (name, length, st.size))
+
+    # what a short packet doesn't have decodes as zeros, and gets cut off
+    # below
+    pkt = bytes(buf[offset:offset + length])
+    vals = st.unpack(pkt + b'\0' * (st.size - len(pkt)))
+    out = {}
+    i = 0
+    for field, count in fields:
+        if count == 0 or count == 1:
+            v = vals[i]
+            i += 1
+        else:
+            v = list(vals[i:i + count])
+            i += count
+        if not field.startswith('_pad'):
+            out[field] = v
+    if typ in VAR_LEN:
+        out[fields[-1][0]] = out[fields[-1][0]][:length - min_len]
+    return name, out
+
+
+
+def format_event(id, arg0, arg1):
+    """the text for an event from an event_packet"""
+    if id >= len(EVENT_FORMATS):
+        return 'unknown event %u, args %u %u' % (id, arg0, arg1)
+    fmt, kinds = EVENT_FORMATS[id]
+    args = []
+    for kind, a, bits in zip(kinds, (arg0, arg1), (16, 32)):
+        if kind is None:
+            continue
+        if kind == 'int':
+            args.append(a)
+        elif kind == 'sint':
+            args.append(a - (1 << bits) if a >> (bits - 1) else a)
+        else:
+            names = globals()[kind.upper() + '_NAMES']
+            args.append(names[a] if a < len(names)
+                        else 'bad ' + kind.replace('_', ' '))
+    return fmt % tuple(args)
+
+
+def crc16(buf, crc=0xffff):
+    """elet_crc16_update() from elet.h, a bit at a time"""
+    for b in bytearray(buf):
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def packet_crc_ok(buf, offset=0):
+    """elet_packet_crc_ok() for the packet at buf[offset:]"""
+    length = HEADER.unpack_from(buf, offset)[0]
+    pkt = bytearray(buf[offset:offset + length])
+    if len(pkt) != length or length < 16:
+        return False
+    want = pkt[12] | pkt[13] << 8
+    pkt[12:14] = b'\0\0'
+    return crc16(pkt) == want
+
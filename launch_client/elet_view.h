@@ -0,0 +1,345 @@
+// generated by protocol/gen_protocol.py from protocol/protocol.py.
+// Don't edit by hand.
+
+#ifndef ELET_VIEW_H
+#define ELET_VIEW_H
+
+// getters for the fields of packets sitting in a pkt_ring, see pkt_ring.h.
+// They don't check the packet type or length, do that first.
+
+#include "pkt_ring.h"
+
+static inline uint16_t
+elet_view_header_len(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct packet_header, len));
+}
+
+static inline uint8_t
+elet_view_header_type(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct packet_header, type));
+}
+
+static inline uint32_t
+elet_view_header_seq(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct packet_header, seq));
+}
+
+static inline uint32_t
+elet_view_header_timestamp(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct packet_header, timestamp));
+}
+
+static inline uint16_t
+elet_view_header_crc(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct packet_header, crc));
+}
+
+static inline uint8_t
+elet_view_data_vlv_states(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct data_packet, vlv_states));
+}
+
+static inline uint8_t
+elet_view_data_vlv_pwm_ox(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct data_packet, vlv_pwm_ox));
+}
+
+static inline uint8_t
+elet_view_data_vlv_pwm_fuel(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct data_packet, vlv_pwm_fuel));
+}
+
+static inline uint8_t
+elet_view_data_state(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct data_packet, state));
+}
+
+static inline uint16_t
+elet_view_data_pressures(const struct pkt_view *v, size_t i)
+{
+        return pkt_view_u16(v, offsetof(struct data_packet, pressures)
+                  + i * sizeof(uint16_t));
+}
+
+static inline float
+elet_view_data_temps(const struct pkt_view *v, size_t i)
+{
+        return pkt_view_f32(v, offsetof(struct data_packet, temps)
+                  + i * sizeof(float));
+}
+
+static inline uint32_t
+elet_view_data_thrust(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct data_packet, thrust));
+}
+
+static inline uint16_t
+elet_view_data_crc_errors(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct data_packet, crc_errors));
+}
+
+static inline uint8_t
+elet_view_req_cmd(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct req_packet, cmd));
+}
+
+static inline uint32_t
+elet_view_req_arg(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct req_packet, arg));
+}
+
+static inline uint8_t
+elet_view_message_id(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct message_packet, id));
+}
+
+static inline size_t
+elet_view_message_text(const struct pkt_view *v, void *dst)
+{
+        size_t n = v->len - MESSAGE_PACKET_MIN_LEN;
+
+        if (n > 255)
+                n = 255;
+        pkt_view_copy(v, offsetof(struct message_packet, text), dst, n);
+        return n;
+}
+
+static inline uint32_t
+elet_view_event_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct event_packet, us));
+}
+
+static inline uint8_t
+elet_view_event_id(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct event_packet, id));
+}
+
+static inline uint8_t
+elet_view_event_dropped(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct event_packet, dropped));
+}
+
+static inline uint16_t
+elet_view_event_arg0(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct event_packet, arg0));
+}
+
+static inline uint32_t
+elet_view_event_arg1(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct event_packet, arg1));
+}
+
+static inline uint8_t
+elet_view_stats_section(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct stats_packet, section));
+}
+
+static inline uint32_t
+elet_view_stats_count(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct stats_packet, count));
+}
+
+static inline uint32_t
+elet_view_stats_min_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct stats_packet, min_us));
+}
+
+static inline uint32_t
+elet_view_stats_max_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct stats_packet, max_us));
+}
+
+static inline uint32_t
+elet_view_stats_sum_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct stats_packet, sum_us));
+}
+
+static inline uint16_t
+elet_view_stats_hist(const struct pkt_view *v, size_t i)
+{
+        return pkt_view_u16(v, offsetof(struct stats_packet, hist)
+                  + i * sizeof(uint16_t));
+}
+
+static inline uint32_t
+elet_view_transition_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct transition_packet, us));
+}
+
+static inline uint8_t
+elet_view_transition_what(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, what));
+}
+
+static inline uint8_t
+elet_view_transition_old_value(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, old_value));
+}
+
+static inline uint8_t
+elet_view_transition_new_value(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, new_value));
+}
+
+static inline uint8_t
+elet_view_transition_cause(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, cause));
+}
+
+static inline uint8_t
+elet_view_transition_state(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, state));
+}
+
+static inline uint8_t
+elet_view_transition_dropped(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct transition_packet, dropped));
+}
+
+static inline uint32_t
+elet_view_transition_arg(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct transition_packet, arg));
+}
+
+static inline uint32_t
+elet_view_bench_us(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct bench_packet, us));
+}
+
+static inline float
+elet_view_bench_setpoint(const struct pkt_view *v)
+{
+        return pkt_view_f32(v, offsetof(struct bench_packet, setpoint));
+}
+
+static inline uint8_t
+elet_view_bench_channels(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct bench_packet, channels));
+}
+
+static inline uint8_t
+elet_view_bench_fresh(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct bench_packet, fresh));
+}
+
+static inline uint16_t
+elet_view_bench_dropped(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct bench_packet, dropped));
+}
+
+static inline uint16_t
+elet_view_bench_pressures(const struct pkt_view *v, size_t i)
+{
+        return pkt_view_u16(v, offsetof(struct bench_packet, pressures)
+                  + i * sizeof(uint16_t));
+}
+
+static inline uint32_t
+elet_view_bench_load_cell(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct bench_packet, load_cell));
+}
+
+static inline uint8_t
+elet_view_hello_role(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct hello_packet, role));
+}
+
+static inline uint32_t
+elet_view_hello_session(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct hello_packet, session));
+}
+
+static inline uint32_t
+elet_view_hello_last_timestamp(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct hello_packet, last_timestamp));
+}
+
+static inline uint32_t
+elet_view_hello_commander(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct hello_packet, commander));
+}
+
+static inline uint32_t
+elet_view_session_session(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct session_packet, session));
+}
+
+static inline uint8_t
+elet_view_session_resumed(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct session_packet, resumed));
+}
+
+static inline uint8_t
+elet_view_session_state(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct session_packet, state));
+}
+
+static inline uint8_t
+elet_view_session_seq_step(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct session_packet, seq_step));
+}
+
+static inline uint8_t
+elet_view_session_backlog(const struct pkt_view *v)
+{
+        return pkt_view_u8(v, offsetof(struct session_packet, backlog));
+}
+
+static inline uint32_t
+elet_view_session_commander(const struct pkt_view *v)
+{
+        return pkt_view_u32(v, offsetof(struct session_packet, commander));
+}
+
+static inline uint16_t
+elet_view_session_ready_ms(const struct pkt_view *v)
+{
+        return pkt_view_u16(v, offsetof(struct session_packet, ready_ms));
+}
+
+#endif // ELET_VIEW_H
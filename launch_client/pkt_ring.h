@@ -0,0 +1,265 @@
+#ifndef PKT_RING_H
+#define PKT_RING_H
+
+// a ring buffer for the bytes we read off the socket, and views of the
+// packets in it.
+//
+// Packets can start at any offset in the ring and wrap around the end of
+// it, so nothing here ever casts a pointer into the buffer to a packet
+// struct. Instead a view pulls each field out by offset, copying just the
+// bytes of that field and converting them from little endian, which is what
+// the arduino sends. The field getters for each packet type are generated,
+// see elet_view.h.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/uio.h>
+
+#include "../elet.h"
+
+struct pkt_ring {
+        uint8_t *buf;
+
+        // size of buf in bytes. Always a power of two, so offsets wrap
+        // with a mask
+        size_t size;
+
+        // free running counts of bytes consumed and bytes filled. There
+        // are wr - rd bytes in the ring, starting at buf[rd & (size - 1)]
+        size_t rd;
+        size_t wr;
+};
+
+// a packet sitting in a ring. Only valid until the ring is consumed past it
+struct pkt_view {
+        const struct pkt_ring *ring;
+
+        // offset of the first byte of the packet, same units as rd and wr
+        size_t start;
+
+        // length of the packet, from its header
+        uint16_t len;
+};
+
+static inline bool
+pkt_ring_init(struct pkt_ring *r, size_t size)
+{
+        // round up to a power of two
+        size_t sz = 1;
+        while (sz < size)
+                sz <<= 1;
+
+        r->buf = (uint8_t *)calloc(1, sz);
+        r->size = sz;
+        r->rd = 0;
+        r->wr = 0;
+        return r->buf != NULL;
+}
+
+static inline void
+pkt_ring_reset(struct pkt_ring *r)
+{
+        r->rd = 0;
+        r->wr = 0;
+}
+
+static inline size_t
+pkt_ring_used(const struct pkt_ring *r)
+{
+        return r->wr - r->rd;
+}
+
+static inline size_t
+pkt_ring_free(const struct pkt_ring *r)
+{
+        return r->size - pkt_ring_used(r);
+}
+
+// read as much as will fit from fd. Returns what read(2) would
+static inline ssize_t
+pkt_ring_read_fd(struct pkt_ring *r, int fd)
+{
+        const size_t mask = r->size - 1;
+        const size_t at = r->wr & mask;
+        const size_t space = pkt_ring_free(r);
+        struct iovec iov[2];
+        int niov = 1;
+
+        // the free space may wrap around the end of the buffer
+        iov[0].iov_base = r->buf + at;
+        iov[0].iov_len = space;
+        if (at + space > r->size) {
+                iov[0].iov_len = r->size - at;
+                iov[1].iov_base = r->buf;
+                iov[1].iov_len = space - iov[0].iov_len;
+                niov = 2;
+        }
+
+        ssize_t ret = readv(fd, iov, niov);
+        if (ret > 0)
+                r->wr += ret;
+        return ret;
+}
+
+// write as much of what's in the ring to fd as it will take, and consume
+// it. Returns what write(2) would
+static inline ssize_t
+pkt_ring_write_fd(struct pkt_ring *r, int fd)
+{
+        const size_t mask = r->size - 1;
+        const size_t at = r->rd & mask;
+        const size_t used = pkt_ring_used(r);
+        struct iovec iov[2];
+        int niov = 1;
+
+        // the data may wrap around the end of the buffer
+        iov[0].iov_base = r->buf + at;
+        iov[0].iov_len = used;
+        if (at + used > r->size) {
+                iov[0].iov_len = r->size - at;
+                iov[1].iov_base = r->buf;
+                iov[1].iov_len = used - iov[0].iov_len;
+                niov = 2;
+        }
+
+        ssize_t ret = writev(fd, iov, niov);
+        if (ret > 0)
+                r->rd += ret;
+        return ret;
+}
+
+// copy n bytes into the ring. Returns false if they don't fit
+static inline bool
+pkt_ring_write(struct pkt_ring *r, const void *src, size_t n)
+{
+        const size_t mask = r->size - 1;
+        const size_t at = r->wr & mask;
+        const size_t first = n < r->size - at ? n : r->size - at;
+
+        if (n > pkt_ring_free(r))
+                return false;
+
+        memcpy(r->buf + at, src, first);
+        memcpy(r->buf, (const uint8_t *)src + first, n - first);
+        r->wr += n;
+        return true;
+}
+
+static inline void
+pkt_ring_consume(struct pkt_ring *r, size_t n)
+{
+        r->rd += n;
+}
+
+// copy n bytes at offset off of a packet out of the ring. The common case
+// of not wrapping is a single fixed size memcpy, which the compiler turns
+// into a plain load for the small fields.
+static inline void
+pkt_view_copy(const struct pkt_view *v, size_t off, void *dst, size_t n)
+{
+        const struct pkt_ring *r = v->ring;
+        const size_t at = (v->start + off) & (r->size - 1);
+
+        if (at + n <= r->size) {
+                memcpy(dst, r->buf + at, n);
+        } else {
+                const size_t first = r->size - at;
+                memcpy(dst, r->buf + at, first);
+                memcpy((uint8_t *)dst + first, r->buf, n - first);
+        }
+}
+
+static inline uint8_t
+pkt_view_u8(const struct pkt_view *v, size_t off)
+{
+        const struct pkt_ring *r = v->ring;
+        return r->buf[(v->start + off) & (r->size - 1)];
+}
+
+// these put the value together a byte at a time so they don't care what
+// endianness we are. On a little endian machine the compiler sees through
+// it and does a single load.
+static inline uint16_t
+pkt_view_u16(const struct pkt_view *v, size_t off)
+{
+        uint8_t b[2];
+        pkt_view_copy(v, off, b, sizeof b);
+        return (uint16_t)(b[0] | b[1] << 8);
+}
+
+static inline uint32_t
+pkt_view_u32(const struct pkt_view *v, size_t off)
+{
+        uint8_t b[4];
+        pkt_view_copy(v, off, b, sizeof b);
+        return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16
+                | (uint32_t)b[3] << 24;
+}
+
+static inline float
+pkt_view_f32(const struct pkt_view *v, size_t off)
+{
+        uint32_t x = pkt_view_u32(v, off);
+        float f;
+        memcpy(&f, &x, sizeof f);
+        return f;
+}
+
+// look at the packet at the front of the ring. Returns false if we don't
+// have a whole header yet. Otherwise fills in v, and the caller should
+// check v->len against pkt_ring_used() to see if the rest of the packet is
+// here.
+static inline bool
+pkt_ring_peek(const struct pkt_ring *r, struct pkt_view *v)
+{
+        if (pkt_ring_used(r) < sizeof(struct packet_header))
+                return false;
+
+        v->ring = r;
+        v->start = r->rd;
+        v->len = pkt_view_u16(v, offsetof(struct packet_header, len));
+        return true;
+}
+
+// crc n bytes of a packet, in at most two pieces if it wraps
+static inline uint16_t
+pkt_view_crc_range(const struct pkt_view *v, uint16_t crc, size_t off,
+                   size_t n)
+{
+        const struct pkt_ring *r = v->ring;
+        const size_t at = (v->start + off) & (r->size - 1);
+
+        if (at + n <= r->size)
+                return elet_crc16_update_fast(crc, r->buf + at, n);
+
+        crc = elet_crc16_update_fast(crc, r->buf + at, r->size - at);
+        return elet_crc16_update_fast(crc, r->buf, n - (r->size - at));
+}
+
+// elet_packet_crc_ok() for a packet in a ring
+static inline bool
+pkt_view_crc_ok(const struct pkt_view *v)
+{
+        const struct pkt_ring *r = v->ring;
+        const size_t at = v->start & (r->size - 1);
+        const size_t off = offsetof(struct packet_header, crc);
+        const uint16_t zero = 0;
+        uint16_t crc = ELET_CRC16_INIT;
+
+        // most packets don't wrap, and those are just a normal packet
+        if (at + v->len <= r->size)
+                return elet_packet_crc(r->buf + at, v->len)
+                        == pkt_view_u16(v, off);
+
+        crc = pkt_view_crc_range(v, crc, 0, off);
+        crc = elet_crc16_update_fast(crc, &zero, sizeof zero);
+        crc = pkt_view_crc_range(v, crc, off + sizeof zero,
+                                 v->len - off - sizeof zero);
+        return crc == pkt_view_u16(v, off);
+}
+
+#endif // PKT_RING_H
@@ -5,6 +5,8 @@ import sys
 import matplotlib.pyplot as plt
 import numpy
 
+import elet_protocol
+
 fname = "run.log"
 
 if len(sys.argv) > 2:
@@ -14,22 +16,17 @@ if len(sys.argv) > 2:
 if len(sys.argv) == 2:
     fname = sys.argv[1]
 
-# from elet.h, `enum valve` definition
-valve_names = ["oxoo", "oxbl", "oxfl", "n2pr", "n2oo", "fufl", "fuoo"]
+valve_names = elet_protocol.VALVE_SHORT_NAMES
 nr_valves = len(valve_names)
 is_pwm = lambda x: x == "oxfl" or x == "fufl"
 
-# from elet.h `enum ignition_status` definition
-ign_stats = ["success",
-             "failed: no ignition sense wire present",
-             "failed: no continuity across igniter",
-             "failed: no ignition",
-             "no ignition attempted"]
-
-state_names = ["ready", "firing", "safing", "fuel depressurization",
-               "num states (shouldn't happen)"]
+ign_stats = elet_protocol.IGNITION_STATUS_NAMES
+state_names = elet_protocol.SYSTEM_STATE_NAMES
 
 messages = []
+events = []
+transitions = []
+stats = []
 data = []
 times = []
 ox_pressure = []
@@ -39,23 +36,63 @@ load = []
 with open(fname, 'rb') as fd:
     reader = csv.reader(fd)
     for line in reader:
-        if line[0] == "data":
-            data.append({"time" : int(line[1]),
-                         "valve states" : int(line[3], 16),
-                         "ox pwm" : int(line[4]),
-                         "fuel pwm" : int(line[5]),
-                         "ign stat" : int(line[6], 16),
-                         "state" : int(line[7], 16)})
-            # 9, 10
-            times.append(int(line[1])/1000.0)
-            ox_pressure.append(int(line[9]))
-            fuel_pressure.append(int(line[10]))
-            load.append(int(line[-1]))
-
-        if data[0] == "message":
-            messages.append({"time", int(line[1]),
-                             "msg", line[3]})
-            
+        tag, cols = elet_protocol.parse_log_line(line)
+        if tag == "data":
+            data.append(cols)
+            times.append(cols["time"]/1000.0)
+            ox_pressure.append(cols["ox pressure"])
+            fuel_pressure.append(cols["fuel pressure"])
+            load.append(cols["thrust"])
+
+        if tag == "message":
+            messages.append(cols)
+
+        if tag == "event":
+            events.append(cols)
+
+        if tag == "stats":
+            stats.append(cols)
+
+        if tag == "transition":
+            transitions.append(cols)
+
+# the server tells us exactly when each valve and state changed. Old logs
+# don't have that, so for those we have to work it out from the data
+# packets, which only see a change when the next one goes out.
+def print_transition(t):
+    what = t["what"]
+    old = t["old"]
+    new = t["new"]
+    if t["dropped"]:
+        print "(%d transitions lost)" % t["dropped"]
+
+    if what == elet_protocol.TR_STATE:
+        desc = "state changed from %s to %s" % (state_names[old],
+                                                state_names[new])
+    elif what == elet_protocol.TR_IGNITER:
+        desc = "IGNITER " + ("ON" if new else "OFF")
+    elif what < nr_valves and is_pwm(valve_names[what]):
+        desc = "%s pwm %d to %d" % (valve_names[what].upper(), old, new)
+    elif what < nr_valves:
+        desc = "%s %s" % (valve_names[what].upper(), "ON" if new else "OFF")
+    else:
+        desc = "unknown transition %d" % what
+
+    cause = t["cause"]
+    if cause == elet_protocol.CAUSE_COMMAND:
+        why = "command %d" % t["arg"]
+    elif cause == elet_protocol.CAUSE_SEQUENCE:
+        why = "%s step %d" % (state_names[t["state"]], t["arg"])
+    elif cause == elet_protocol.CAUSE_REDLINE:
+        why = "redline " + elet_protocol.REDLINE_NAMES[t["arg"]]
+    else:
+        why = "cause %d" % cause
+
+    print "%.6f" % (t["us"] / 1e6), desc, "(" + why + ")"
+
+for t in transitions:
+    print_transition(t)
+
 for i,line in enumerate(data):
     if i == 0:
         continue
@@ -63,6 +100,16 @@ for i,line in enumerate(data):
     last_line = data[i-1]
 
     ts = line["time"]/1000.0
+
+    # print out if ignition status changed
+    istat = line["ign stat"]
+    listat = last_line["ign stat"]
+    if istat != listat:
+        print ts, "ignition status:", ign_stats[istat]
+
+    if transitions:
+        continue
+
     # print out any and all valve state changes
     vs = line["valve states"]
     lvs = last_line["valve states"]
@@ -94,11 +141,43 @@ for i,line in enumerate(data):
         print ts, "state changed from",state_names[lss],"to",\
             state_names[ss]
 
-    # print out if ignition status changed
-    istat = line["ign stat"]
-    listat = last_line["ign stat"]
-    if istat != listat:
-        print ts, "ignition status:", ign_stats[istat]
-
 for m in messages:
     print m["time"], m["msg"]
+
+for e in events:
+    print e["time"], elet_protocol.format_event(e["id"], e["arg0"], e["arg1"])
+
+# how far past their deadlines the sequence steps ran, in microseconds
+step_ids = (elet_protocol.EV_FIRE_STEP, elet_protocol.EV_SAFING_STEP,
+            elet_protocol.EV_DEPRESS_STEP)
+late = [e["arg1"] - (1 << 32) if e["arg1"] >> 31 else e["arg1"]
+        for e in events if e["id"] in step_ids]
+if late:
+    print len(late), "sequence steps, worst", max(late, key=abs), "us late"
+
+# how much turnaround time the pressure checks saved over the fixed waits
+saved = [e for e in events if e["id"] == elet_protocol.EV_SEQ_SAVED]
+for e in saved:
+    print elet_protocol.SYSTEM_STATE_NAMES[e["arg0"]], "finished", \
+        e["arg1"], "ms early"
+if saved:
+    print "saved", sum(e["arg1"] for e in saved) / 1000.0, "s over", \
+        len(saved), "sequences"
+
+# how long the parts of the server's loop() took over the whole run
+section_names = elet_protocol.LOOP_SECTION_NAMES
+totals = {}
+for st in stats:
+    t = totals.setdefault(st["section"], {"count": 0, "sum": 0, "max": 0,
+                                          "hist": [0] * elet_protocol.STATS_NR_BINS})
+    t["count"] += st["count"]
+    t["sum"] += st["sum us"]
+    t["max"] = max(t["max"], st["max us"])
+    for i in range(elet_protocol.STATS_NR_BINS):
+        t["hist"][i] += st["hist%d" % i]
+
+for sec in sorted(totals):
+    t = totals[sec]
+    print "%-20s %8d runs, mean %8.1f us, max %8d us, histogram %s" % (
+        section_names[sec], t["count"], float(t["sum"]) / t["count"],
+        t["max"], " ".join(str(h) for h in t["hist"]))
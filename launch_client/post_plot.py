@@ -5,6 +5,8 @@ import sys
 import matplotlib.pyplot as plt
 import numpy
 
+import elet_protocol
+
 fname = "run.log"
 
 if len(sys.argv) > 2:
@@ -14,21 +16,6 @@ if len(sys.argv) > 2:
 if len(sys.argv) == 2:
     fname = sys.argv[1]
 
-# from elet.h, `enum valve` definition
-valve_names = ["oxoo", "oxbl", "oxfl", "n2pr", "n2oo", "fufl", "fuoo"]
-nr_valves = len(valve_names)
-is_pwm = lambda x: x == "oxfl" or x == "fufl"
-
-# from elet.h `enum ignition_status` definition
-ign_stats = ["success",
-             "failed: no ignition sense wire present",
-             "failed: no continuity across igniter",
-             "failed: no ignition",
-             "no ignition attempted"]
-
-state_names = ["ready", "firing", "safing", "fuel depressurization",
-               "num states (shouldn't happen)"]
-
 messages = []
 data = []
 times = []
@@ -39,22 +26,16 @@ load = []
 with open(fname, 'rb') as fd:
     reader = csv.reader(fd)
     for line in reader:
-        if line[0] == "data":
-            data.append({"time" : int(line[1]),
-                         "valve states" : int(line[3], 16),
-                         "ox pwm" : int(line[4]),
-                         "fuel pwm" : int(line[5]),
-                         "ign stat" : int(line[6], 16),
-                         "state" : int(line[7], 16)})
-            # 9, 10
-            times.append(int(line[1])/1000.0)
-            ox_pressure.append((int(line[9]) - 200)*1000.0/819.2)
-            fuel_pressure.append((int(line[10]) - 200)*1000.0/819.2)
-            load.append(int(line[-1]))
-
-        if data[0] == "message":
-            messages.append({"time", int(line[1]),
-                             "msg", line[3]})
+        tag, cols = elet_protocol.parse_log_line(line)
+        if tag == "data":
+            data.append(cols)
+            times.append(cols["time"]/1000.0)
+            ox_pressure.append((cols["ox pressure"] - 200)*1000.0/819.2)
+            fuel_pressure.append((cols["fuel pressure"] - 200)*1000.0/819.2)
+            load.append(cols["thrust"])
+
+        if tag == "message":
+            messages.append(cols)
             
 plt.subplot(2, 1, 1)
 ox, = plt.plot(times, ox_pressure)
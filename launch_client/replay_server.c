@@ -0,0 +1,728 @@
+// a stand-in arduino for load testing the client. Serves a recorded run
+// (any run.log, or a binary capture, see run_log.h) to real clients over
+// tcp, the way launch_server.ino would have sent it:
+//
+//   - the first client to say hello as commander gets to command, the rest
+//     observe. Observers that send a REQ get "observers can't send
+//     commands", packets with a bad crc get "dropped packet with bad crc",
+//     and anything that isn't a REQ or HELLO gets the connection closed.
+//   - every packet goes out with header.seq set to the last command we
+//     took: the commander's hello, unless it took command back with the
+//     commander token only it was sent, and then
+//     every REQ from the commander. Every REQ is "processed" by logging an
+//     EV_REQ event, like the arduino does.
+//   - a resumed session gets the data packets it missed, out of a backlog
+//     as long as the arduino's.
+//
+// The recording's own session packets are left out, we make up our own.
+// Playback starts when the first client says hello. Timestamps are
+// rewritten so they keep going up across laps and recordings, with gaps of
+// more than a second (e.g. between two recordings) squashed to 10 ms.
+//
+// usage: replay_server [-a addr] [-p port] [-s speed] [-n laps]
+//                      [-P at_ms:ms] [-S at_ms:ms] rec...
+//
+//   -a  address to listen on, 127.0.0.1 by default
+//   -p  port, ELET_NET_PORT by default
+//   -s  1 plays it back as recorded, 10 ten times as fast, max as fast as
+//       the slowest client will take it
+//   -n  how many times to play it through, 0 for forever. 1 by default.
+//   -P  at_ms into the playback, hang for ms like a wedged arduino: nothing
+//       goes out and nothing gets read. Then carry on where we left off.
+//   -S  at_ms into the playback, stall for ms: packets keep going out, but
+//       their timestamps stop moving and commands are ignored, like an
+//       arduino whose loop is stuck while something keeps sending.
+//
+// -P and -S are for testing the client's watchdog. at_ms is wall time from
+// when the first client said hello.
+//
+// Packets/s and bytes/s go to stderr every second. At 1x and Nx, a client
+// that can't keep up loses packets, and we say so.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../elet.h"
+#include "pkt_ring.h"
+#include "run_log.h"
+
+// like the arduino, which keeps one of its W5500's sockets for listening
+#define MAX_CLIENTS 7
+
+// BACKLOG_LEN in launch_server.ino
+#define BACKLOG_LEN 32
+
+// what we'll queue up for a client that isn't reading. More than a second
+// of data at the arduino's rate.
+#define CLIENT_RING_SIZE (1 << 16)
+
+// recorded gaps longer than this are squashed to GAP_MS
+#define MAX_GAP_MS 1000
+#define GAP_MS 10
+
+static void __attribute__((noreturn)) die(const char *reason, int err)
+{
+        if (reason) {
+                fprintf(stderr, "%s: %s\n", reason, strerror(err));
+                exit(1);
+        } else {
+                exit(0);
+        }
+}
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+                die("clock_gettime", errno);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct client_slot {
+        // -1 if the slot is free
+        int fd;
+
+        bool said_hello;
+        bool commander;
+
+        // a REQ or HELLO on its way in
+        uint8_t rx[sizeof(struct hello_packet)];
+        size_t nread;
+
+        // what we've sent that it hasn't read yet
+        struct pkt_ring out;
+
+        // packets it lost because it wasn't keeping up
+        unsigned long dropped;
+};
+
+static struct client_slot clients[MAX_CLIENTS];
+
+// the recording, with the session packets left out. due_ms is when each
+// packet goes out, counting from the first one.
+static struct pkt_stream stream;
+static size_t *offsets;
+static uint32_t *due_ms;
+static size_t npkts;
+static uint32_t lap_ms;
+static uint32_t first_ts;
+
+static uint32_t pkt_seq;
+static uint32_t session_token;
+
+// see commander_token in launch_server.ino
+static uint32_t commander_token;
+static uint8_t last_state;
+
+// the last data packets we sent, as we sent them
+static struct data_packet backlog[BACKLOG_LEN];
+static unsigned backlog_next;
+static unsigned backlog_count;
+
+// for the stats line
+static unsigned long sent_pkts;
+static unsigned long long sent_bytes;
+
+// -P and -S. len_ms is 0 if there isn't one.
+struct fault {
+        unsigned long at_ms;
+        unsigned long len_ms;
+};
+
+static struct fault pause_fault;
+static struct fault stall_fault;
+
+// we're in the -S stall, and the timestamp everything goes out with
+static bool stalled;
+static uint32_t stall_ts;
+
+static void usage(void)
+{
+        fprintf(stderr, "usage: replay_server [-a addr] [-p port] "
+                "[-s speed|max] [-n laps] [-P at_ms:ms] [-S at_ms:ms] "
+                "recording...\n");
+        exit(1);
+}
+
+static void parse_fault(struct fault *f, const char *arg)
+{
+        if (sscanf(arg, "%lu:%lu", &f->at_ms, &f->len_ms) != 2)
+                usage();
+}
+
+// pick out the packets we're going to send and work out when each one
+// goes
+static void index_stream(void)
+{
+        uint32_t prev_ts = 0, at = 0;
+
+        offsets = malloc(stream.npkts * sizeof *offsets);
+        due_ms = malloc(stream.npkts * sizeof *due_ms);
+        if (!offsets || !due_ms)
+                die("malloc", ENOMEM);
+
+        for (size_t off = 0; off < stream.len; ) {
+                struct packet_header hdr;
+
+                memcpy(&hdr, stream.buf + off, sizeof hdr);
+                if (hdr.type != PT_SESSION) {
+                        if (npkts) {
+                                uint32_t gap = hdr.timestamp - prev_ts;
+                                at += gap > MAX_GAP_MS ? GAP_MS : gap;
+                        } else {
+                                first_ts = hdr.timestamp;
+                        }
+                        prev_ts = hdr.timestamp;
+
+                        offsets[npkts] = off;
+                        due_ms[npkts] = at;
+                        ++npkts;
+                }
+                off += hdr.len;
+        }
+
+        lap_ms = at + GAP_MS;
+}
+
+static bool enqueue(struct client_slot *slot, const void *pkt, size_t len)
+{
+        if (!pkt_ring_write(&slot->out, pkt, len)) {
+                ++slot->dropped;
+                return false;
+        }
+        return true;
+}
+
+// like the arduino's: one of the MSG_* messages, and text after it or NULL
+static void send_message(struct client_slot *slot, uint32_t ts,
+                         enum message id, const char *text)
+{
+        struct message_packet mpkt;
+        const size_t n = text ? strnlen(text, sizeof mpkt.text) : 0;
+
+        memset(&mpkt, 0, sizeof mpkt);
+        mpkt.header.len = MESSAGE_PACKET_MIN_LEN + n;
+        mpkt.header.type = PT_MESSAGE;
+        mpkt.header.seq = pkt_seq;
+        mpkt.header.timestamp = ts;
+        mpkt.id = id;
+        memcpy(mpkt.text, text, n);
+        elet_seal_packet(&mpkt.header);
+
+        enqueue(slot, &mpkt, mpkt.header.len);
+}
+
+static void drop_client(struct client_slot *slot)
+{
+        if (slot->dropped)
+                fprintf(stderr, "client %d dropped %lu packets\n",
+                        (int)(slot - clients), slot->dropped);
+        fprintf(stderr, "client %d gone\n", (int)(slot - clients));
+
+        close(slot->fd);
+        slot->fd = -1;
+        slot->said_hello = false;
+        slot->commander = false;
+        slot->nread = 0;
+        slot->dropped = 0;
+        pkt_ring_reset(&slot->out);
+}
+
+// never 0, see new_token() in launch_server.ino
+static uint32_t new_token(void)
+{
+        uint32_t t = (uint32_t)now_ns() ^ (uint32_t)getpid() << 16;
+
+        return t ? t : 1;
+}
+
+static struct client_slot *find_commander(void)
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].fd != -1 && clients[i].commander)
+                        return &clients[i];
+        return NULL;
+}
+
+// see send_session() in launch_server.ino
+static void send_session(struct client_slot *slot, bool resumed,
+                         uint32_t last_timestamp, uint32_t ts)
+{
+        struct session_packet spkt;
+        unsigned first = (backlog_next + BACKLOG_LEN - backlog_count)
+                % BACKLOG_LEN;
+        unsigned skip = backlog_count;
+
+        if (resumed)
+                for (skip = 0; skip < backlog_count; ++skip) {
+                        struct data_packet *d =
+                                &backlog[(first + skip) % BACKLOG_LEN];
+                        if ((int32_t)(d->header.timestamp - last_timestamp) > 0)
+                                break;
+                }
+
+        memset(&spkt, 0, sizeof spkt);
+        spkt.header.len = sizeof spkt;
+        spkt.header.type = PT_SESSION;
+        spkt.header.seq = pkt_seq;
+        spkt.header.timestamp = ts;
+        spkt.session = session_token;
+        spkt.resumed = resumed;
+        spkt.state = last_state;
+        spkt.backlog = backlog_count - skip;
+        spkt.commander = slot->commander ? commander_token : 0;
+        // we don't set the rate, the log does, but we never leave a gap
+        // longer than this
+        spkt.ready_ms = MAX_GAP_MS;
+        elet_seal_packet(&spkt.header);
+
+        enqueue(slot, &spkt, sizeof spkt);
+
+        for (unsigned i = skip; i < backlog_count; ++i)
+                enqueue(slot, &backlog[(first + i) % BACKLOG_LEN],
+                        sizeof backlog[0]);
+}
+
+// see handle_hello_packet() in launch_server.ino
+static void handle_hello(struct client_slot *slot,
+                         const struct hello_packet *pkt, uint32_t ts)
+{
+        bool resumed = pkt->session == session_token;
+        bool takeback = resumed && commander_token
+                && pkt->commander == commander_token;
+        struct client_slot *cmdr = find_commander();
+
+        slot->said_hello = true;
+
+        if (pkt->role == HELLO_ROLE_COMMANDER && cmdr != slot) {
+                if (cmdr && takeback) {
+                        fprintf(stderr, "commander resumed on client %d\n",
+                                (int)(slot - clients));
+                        drop_client(cmdr);
+                        cmdr = NULL;
+                }
+
+                if (cmdr) {
+                        send_message(slot, ts, MSG_OBSERVER, NULL);
+                } else {
+                        slot->commander = true;
+                        if (!takeback) {
+                                commander_token = new_token();
+                                pkt_seq = pkt->header.seq;
+                        }
+                }
+        }
+
+        fprintf(stderr, "client %d said hello as %s%s\n",
+                (int)(slot - clients),
+                slot->commander ? "commander" : "observer",
+                resumed ? ", resumed" : "");
+        send_session(slot, resumed, pkt->last_timestamp, ts);
+}
+
+// we don't run an engine, so every command "works". Tell everyone we got
+// it, like the arduino's EV_REQ.
+static void handle_req(const struct req_packet *pkt, uint32_t ts)
+{
+        struct event_packet epkt;
+
+        pkt_seq = pkt->header.seq;
+
+        memset(&epkt, 0, sizeof epkt);
+        epkt.header.len = sizeof epkt;
+        epkt.header.type = PT_EVENT;
+        epkt.header.seq = pkt_seq;
+        epkt.header.timestamp = ts;
+        epkt.us = ts * 1000;
+        epkt.id = EV_REQ;
+        epkt.arg0 = pkt->cmd;
+        epkt.arg1 = pkt->arg;
+        elet_seal_packet(&epkt.header);
+
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].fd != -1 && clients[i].said_hello)
+                        enqueue(&clients[i], &epkt, sizeof epkt);
+}
+
+// see rx_continue() in launch_server.ino
+static void client_readable(struct client_slot *slot, uint32_t ts)
+{
+        struct packet_header *hdr = (struct packet_header *)slot->rx;
+        ssize_t ret;
+
+        ret = read(slot->fd, slot->rx + slot->nread,
+                   sizeof slot->rx - slot->nread);
+        if (ret == 0 || (ret == -1 && errno != EAGAIN && errno != EINTR)) {
+                drop_client(slot);
+                return;
+        }
+        if (ret == -1)
+                return;
+
+        slot->nread += ret;
+        if (slot->nread < sizeof *hdr)
+                return;
+
+        if ((hdr->type != PT_REQ || hdr->len != sizeof(struct req_packet))
+            && (hdr->type != PT_HELLO
+                || hdr->len != sizeof(struct hello_packet))) {
+                fprintf(stderr, "client %d sent junk\n",
+                        (int)(slot - clients));
+                drop_client(slot);
+                return;
+        }
+
+        if (slot->nread < hdr->len)
+                return;
+
+        if (!elet_packet_crc_ok(hdr))
+                send_message(slot, ts, MSG_BAD_CRC, NULL);
+        else if (stalled)
+                fprintf(stderr, "stalled, ignoring packet from client %d\n",
+                        (int)(slot - clients));
+        else if (hdr->type == PT_HELLO)
+                handle_hello(slot, (struct hello_packet *)slot->rx, ts);
+        else if (!slot->commander)
+                send_message(slot, ts, MSG_OBSERVER_COMMAND, NULL);
+        else
+                handle_req((struct req_packet *)slot->rx, ts);
+
+        // a REQ is shorter than the buffer, so part of the next packet may
+        // have come in with it
+        slot->nread -= hdr->len;
+        memmove(slot->rx, slot->rx + hdr->len, slot->nread);
+}
+
+static void accept_client(int lfd)
+{
+        int fd = accept(lfd, NULL, NULL);
+
+        if (fd == -1)
+                return;
+
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+                if (clients[i].fd != -1)
+                        continue;
+
+                if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1)
+                        die("fcntl", errno);
+                clients[i].fd = fd;
+                fprintf(stderr, "new client %d\n", i);
+                return;
+        }
+
+        fprintf(stderr, "no free slots, turning a client away\n");
+        close(fd);
+}
+
+// is there room for a packet of len bytes for everyone who said hello? We
+// wait for this at max speed.
+static bool all_have_room(size_t len)
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].fd != -1 && clients[i].said_hello
+                    && pkt_ring_free(&clients[i].out) < len)
+                        return false;
+        return true;
+}
+
+static bool anyone_listening(void)
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].fd != -1 && clients[i].said_hello)
+                        return true;
+        return false;
+}
+
+// send packet i of the recording to everyone who said hello, stamped with
+// ts and the current seq
+static void send_recorded(size_t i, uint32_t ts)
+{
+        union {
+                struct packet_header hdr;
+                struct data_packet d;
+                struct message_packet m;
+                struct event_packet e;
+                struct stats_packet s;
+                struct transition_packet t;
+        } pkt;
+        struct packet_header hdr;
+
+        memcpy(&hdr, stream.buf + offsets[i], sizeof hdr);
+        memcpy(&pkt, stream.buf + offsets[i], hdr.len);
+        pkt.hdr.seq = pkt_seq;
+        pkt.hdr.timestamp = ts;
+        elet_seal_packet(&pkt.hdr);
+
+        if (hdr.type == PT_DATA) {
+                last_state = pkt.d.state;
+                backlog[backlog_next] = pkt.d;
+                backlog_next = (backlog_next + 1) % BACKLOG_LEN;
+                if (backlog_count < BACKLOG_LEN)
+                        ++backlog_count;
+        }
+
+        for (int c = 0; c < MAX_CLIENTS; ++c)
+                if (clients[c].fd != -1 && clients[c].said_hello
+                    && enqueue(&clients[c], &pkt, hdr.len)) {
+                        ++sent_pkts;
+                        sent_bytes += hdr.len;
+                }
+}
+
+int main(int argc, char **argv)
+{
+        struct sockaddr_in addr;
+        const char *addr_str = "127.0.0.1";
+        int port = ELET_NET_PORT;
+        double speed = 1;
+        unsigned long laps = 1;
+        int opt, lfd, one = 1;
+
+        while ((opt = getopt(argc, argv, "a:p:s:n:P:S:")) != -1) {
+                switch (opt) {
+                case 'a':
+                        addr_str = optarg;
+                        break;
+                case 'p':
+                        port = atoi(optarg);
+                        break;
+                case 's':
+                        speed = strcmp(optarg, "max") ? atof(optarg) : 0;
+                        if (speed < 0)
+                                usage();
+                        break;
+                case 'n':
+                        laps = strtoul(optarg, NULL, 0);
+                        break;
+                case 'P':
+                        parse_fault(&pause_fault, optarg);
+                        break;
+                case 'S':
+                        parse_fault(&stall_fault, optarg);
+                        break;
+                default:
+                        usage();
+                }
+        }
+        if (optind == argc)
+                usage();
+
+        for (int i = optind; i < argc; ++i) {
+                long n = pkt_stream_load(&stream, argv[i]);
+                if (n < 0)
+                        die(argv[i], errno ? errno : ENOMEM);
+                fprintf(stderr, "%s: %ld packets\n", argv[i], n);
+        }
+
+        index_stream();
+        if (npkts == 0)
+                die("nothing to play back", EINVAL);
+        fprintf(stderr, "%zu packets, %.1f s a lap\n", npkts, lap_ms / 1e3);
+
+        // a dead client shows up as an error from write()
+        signal(SIGPIPE, SIG_IGN);
+
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+                clients[i].fd = -1;
+                if (!pkt_ring_init(&clients[i].out, CLIENT_RING_SIZE))
+                        die("pkt_ring_init", ENOMEM);
+        }
+
+        session_token = new_token();
+
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, addr_str, &addr.sin_addr) != 1)
+                die("bad address", EINVAL);
+
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (lfd == -1)
+                die("socket", errno);
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (bind(lfd, (const struct sockaddr *)&addr, sizeof addr) == -1)
+                die("bind", errno);
+        if (listen(lfd, MAX_CLIENTS) == -1)
+                die("listen", errno);
+        if (speed)
+                fprintf(stderr, "serving on %s:%d at %gx\n", addr_str, port,
+                        speed);
+        else
+                fprintf(stderr, "serving on %s:%d at max speed\n", addr_str,
+                        port);
+
+        // where we are in the playback. start_ns is 0 until someone says
+        // hello.
+        size_t cur = 0;
+        unsigned long lap = 0;
+        uint64_t start_ns = 0, stats_ns = now_ns(), run_ns;
+        unsigned long last_pkts = 0;
+        unsigned long long last_bytes = 0;
+        bool done = false;
+
+        for (;;) {
+                struct pollfd fds[MAX_CLIENTS + 1];
+                uint64_t now = now_ns();
+                uint32_t ts = first_ts + lap * lap_ms + due_ms[cur];
+                int timeout_ms = -1;
+
+                if (!start_ns && anyone_listening())
+                        start_ns = now;
+
+                if (start_ns && pause_fault.len_ms
+                    && now - start_ns >= pause_fault.at_ms * 1000000ULL) {
+                        struct timespec pause;
+
+                        fprintf(stderr, "hanging for %lu ms\n",
+                                pause_fault.len_ms);
+                        pause.tv_sec = pause_fault.len_ms / 1000;
+                        pause.tv_nsec = pause_fault.len_ms % 1000 * 1000000;
+                        while (nanosleep(&pause, &pause) == -1)
+                                if (errno != EINTR)
+                                        die("nanosleep", errno);
+
+                        // pick up the playback where we left it
+                        start_ns += pause_fault.len_ms * 1000000ULL;
+                        pause_fault.len_ms = 0;
+                        now = now_ns();
+                }
+
+                if (start_ns && stall_fault.len_ms) {
+                        const uint64_t at = stall_fault.at_ms * 1000000ULL;
+                        const uint64_t end = at
+                                + stall_fault.len_ms * 1000000ULL;
+                        const bool in = now - start_ns >= at
+                                && now - start_ns < end;
+
+                        if (in && !stalled) {
+                                fprintf(stderr, "stalling for %lu ms\n",
+                                        stall_fault.len_ms);
+                                stall_ts = ts;
+                        } else if (!in && stalled) {
+                                fprintf(stderr, "stall over\n");
+                                stall_fault.len_ms = 0;
+                        }
+                        stalled = in;
+                }
+
+                // send everything that's due
+                while (start_ns && !done) {
+                        struct packet_header hdr;
+                        uint64_t at_ms = (uint64_t)lap * lap_ms + due_ms[cur];
+
+                        memcpy(&hdr, stream.buf + offsets[cur], sizeof hdr);
+                        if (speed) {
+                                uint64_t due = start_ns
+                                        + (uint64_t)(at_ms * 1e6 / speed);
+                                if (due > now) {
+                                        timeout_ms = (due - now) / 1000000;
+                                        break;
+                                }
+                        } else if (!all_have_room(hdr.len)) {
+                                break;
+                        }
+
+                        ts = stalled ? stall_ts : first_ts + at_ms;
+                        send_recorded(cur, ts);
+                        if (++cur == npkts) {
+                                cur = 0;
+                                if (++lap == laps)
+                                        done = true;
+                        }
+                }
+
+                // and once it's all out, we're done
+                if (done) {
+                        bool drained = true;
+                        for (int i = 0; i < MAX_CLIENTS; ++i)
+                                if (clients[i].fd != -1
+                                    && pkt_ring_used(&clients[i].out))
+                                        drained = false;
+                        if (drained) {
+                                run_ns = now_ns() - start_ns;
+                                break;
+                        }
+                }
+
+                if (now - stats_ns >= 1000000000ULL) {
+                        double s = (now - stats_ns) / 1e9;
+                        fprintf(stderr, "%.0f pkts/s, %.0f bytes/s\n",
+                                (sent_pkts - last_pkts) / s,
+                                (sent_bytes - last_bytes) / s);
+                        last_pkts = sent_pkts;
+                        last_bytes = sent_bytes;
+                        stats_ns = now;
+                }
+                if (timeout_ms == -1 || timeout_ms > 1000)
+                        timeout_ms = 1000;
+
+                int nfds = 0;
+                fds[nfds].fd = lfd;
+                fds[nfds++].events = POLLIN;
+                for (int i = 0; i < MAX_CLIENTS; ++i) {
+                        if (clients[i].fd == -1)
+                                continue;
+                        fds[nfds].fd = clients[i].fd;
+                        fds[nfds].events = POLLIN;
+                        if (pkt_ring_used(&clients[i].out))
+                                fds[nfds].events |= POLLOUT;
+                        ++nfds;
+                }
+
+                if (poll(fds, nfds, timeout_ms) == -1) {
+                        if (errno == EINTR)
+                                continue;
+                        die("poll", errno);
+                }
+
+                if (fds[0].revents & POLLIN)
+                        accept_client(lfd);
+
+                for (int i = 1; i < nfds; ++i) {
+                        struct client_slot *slot = NULL;
+
+                        for (int c = 0; c < MAX_CLIENTS; ++c)
+                                if (clients[c].fd == fds[i].fd)
+                                        slot = &clients[c];
+                        if (!slot)
+                                continue;
+
+                        if (fds[i].revents & POLLOUT) {
+                                ssize_t ret = pkt_ring_write_fd(&slot->out,
+                                                                slot->fd);
+                                if (ret == -1 && errno != EAGAIN) {
+                                        drop_client(slot);
+                                        continue;
+                                }
+                        }
+                        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                                client_readable(slot, ts);
+                }
+        }
+
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].fd != -1)
+                        drop_client(&clients[i]);
+
+        double s = run_ns / 1e9;
+        fprintf(stderr, "sent %lu packets, %llu bytes in %.2f s: "
+                "%.0f pkts/s, %.0f bytes/s\n", sent_pkts, sent_bytes, s,
+                sent_pkts / s, sent_bytes / s);
+        return 0;
+}
@@ -0,0 +1,441 @@
+// redo the engineering units for a whole campaign of logs at once, after a
+// calibration in elet.h gets fixed: change it, rebuild this, and run it on
+// the directory of logs.
+//
+// For each name.log (a run.log or a capture) this writes name.csv, the
+// data packets in psi, lbf and degrees, and name.txt, the run_stats.h
+// summary of each run in it.
+//
+// The csv has the load cell's reading as it is, but the summaries measure
+// thrust over its zero, see run_stats.h. To check one by hand, take the
+// zero off the csv's lbf and add up the rows between the times the
+// summary says it was burning.
+//
+// Logs are spread over a pool of threads, biggest first. Each thread has a
+// deque of its own, works from the back of it, and when it runs dry takes
+// from the front of someone else's, so one long run doesn't hold up the
+// rest. Inputs are mmapped, and the output is written as it goes.
+//
+// usage: reprocess [-j threads] [-o outdir] dir|file...
+//
+//   -j  how many threads, one per core by default
+//   -o  where the results go, reprocessed/ by default
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../elet.h"
+#include "run_log.h"
+#include "run_stats.h"
+
+#define MAX_THREADS 64
+#define OUT_BUF_SIZE (1 << 20)
+
+struct job {
+        char *path;
+        off_t size;
+};
+
+// one thread's work. The owner pops from the back, thieves from the front.
+struct deque {
+        pthread_mutex_t lock;
+        struct job **jobs;
+        size_t head;
+        size_t tail;
+};
+
+struct worker {
+        pthread_t thread;
+        int id;
+        struct deque dq;
+
+        unsigned long files;
+        unsigned long steals;
+        unsigned long long bytes;
+        unsigned long failed;
+};
+
+static struct worker workers[MAX_THREADS];
+static int nr_workers;
+static const char *out_dir = "reprocessed";
+
+static void __attribute__((noreturn)) usage(void)
+{
+        fprintf(stderr, "usage: reprocess [-j threads] [-o outdir] "
+                "dir|file...\n");
+        exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct job *deque_pop(struct deque *dq)
+{
+        struct job *j = NULL;
+
+        pthread_mutex_lock(&dq->lock);
+        if (dq->head != dq->tail)
+                j = dq->jobs[--dq->tail];
+        pthread_mutex_unlock(&dq->lock);
+        return j;
+}
+
+static struct job *deque_steal(struct deque *dq)
+{
+        struct job *j = NULL;
+
+        pthread_mutex_lock(&dq->lock);
+        if (dq->head != dq->tail)
+                j = dq->jobs[dq->head++];
+        pthread_mutex_unlock(&dq->lock);
+        return j;
+}
+
+// nobody adds work once the threads are going, so when every deque is
+// empty we're done
+static struct job *next_job(struct worker *w)
+{
+        struct job *j = deque_pop(&w->dq);
+
+        for (int i = 1; !j && i < nr_workers; ++i) {
+                j = deque_steal(&workers[(w->id + i) % nr_workers].dq);
+                if (j)
+                        ++w->steals;
+        }
+        return j;
+}
+
+static FILE *open_out(const char *path, const char *ext, char *buf)
+{
+        const char *base = strrchr(path, '/');
+        const char *dot;
+        char out[4096];
+        FILE *f;
+
+        base = base ? base + 1 : path;
+        dot = strrchr(base, '.');
+        snprintf(out, sizeof out, "%s/%.*s%s", out_dir,
+                 dot ? (int)(dot - base) : (int)strlen(base), base, ext);
+
+        f = fopen(out, "w");
+        if (!f) {
+                fprintf(stderr, "%s: %s\n", out, strerror(errno));
+                return NULL;
+        }
+        setvbuf(f, buf, _IOFBF, OUT_BUF_SIZE);
+        return f;
+}
+
+static void data_row(FILE *csv, const struct data_packet *d)
+{
+        fprintf(csv, "%.3f, %s, 0x%x, %u, %u, %.2f, %.2f, %.2f, %.2f, "
+                "%.2f\n", d->header.timestamp / 1e3,
+                system_state_to_short_str((enum system_state)
+                                          elet_state_sys_state(d->state)),
+                d->vlv_states, d->vlv_pwm_ox, d->vlv_pwm_fuel,
+                run_stats_psi(PS_OXYGEN, d->pressures[PS_OXYGEN]),
+                run_stats_psi(PS_FUEL, d->pressures[PS_FUEL]),
+                run_stats_lbf(d->thrust), d->temps[TC_OXYGEN],
+                d->temps[TC_WATER]);
+}
+
+static void summarize(FILE *txt, struct run_stats *run, int nr)
+{
+        fprintf(txt, "run %d:\n", nr);
+        run_stats_print(txt, run);
+        if (run->burn_seen)
+                fprintf(txt, "    burning from %.3f to %.3f s\n",
+                        run->burn_start_ts / 1e3, run->burn_end_ts / 1e3);
+        run_stats_reset(run);
+}
+
+// one packet, straight out of the log
+static void process_packet(FILE *csv, FILE *txt, struct run_stats *run,
+                           int *nr_runs, const void *pkt)
+{
+        struct data_packet d;
+
+        if (((const struct packet_header *)pkt)->type != PT_DATA)
+                return;
+
+        memcpy(&d, pkt, sizeof d);
+        data_row(csv, &d);
+        if (run_stats_add(run, d.header.timestamp,
+                          elet_state_sys_state(d.state),
+                          d.pressures[PS_OXYGEN], d.pressures[PS_FUEL],
+                          d.thrust))
+                summarize(txt, run, ++*nr_runs);
+}
+
+// run.logs a line at a time, captures a packet at a time, the same way
+// pkt_stream_load() tells them apart
+static int process(struct job *j, char *csv_buf, char *txt_buf)
+{
+        struct run_stats run;
+        const uint8_t *map;
+        FILE *csv = NULL, *txt = NULL;
+        int nr_runs = 0, ret = -1;
+        bool binary = false;
+        size_t len = j->size;
+        int fd;
+
+        fd = open(j->path, O_RDONLY);
+        if (fd == -1) {
+                fprintf(stderr, "%s: %s\n", j->path, strerror(errno));
+                return -1;
+        }
+        map = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+        close(fd);
+        if (map == MAP_FAILED) {
+                fprintf(stderr, "%s: %s\n", j->path, strerror(errno));
+                return -1;
+        }
+        madvise((void *)map, len, MADV_SEQUENTIAL);
+
+        csv = open_out(j->path, ".csv", csv_buf);
+        txt = open_out(j->path, ".txt", txt_buf);
+        if (!csv || !txt)
+                goto out;
+
+        fprintf(csv, "time, state, valves, ox pwm, fuel pwm, ox psi, "
+                "fuel psi, lbf, ox temp, water temp\n");
+        run_stats_reset(&run);
+
+        for (size_t i = 0; i < len && i < 64; ++i)
+                if (pkt_looks_good(map + i, (len < 64 ? len : 64) - i))
+                        binary = true;
+
+        for (size_t off = 0; off < len; ) {
+                union {
+                        struct data_packet d;
+                        struct session_packet s;
+                        struct message_packet m;
+                        struct event_packet e;
+                        struct stats_packet st;
+                        struct transition_packet t;
+                } pkt;
+
+                if (binary) {
+                        if (!pkt_looks_good(map + off, len - off)) {
+                                ++off;
+                                continue;
+                        }
+                        process_packet(csv, txt, &run, &nr_runs, map + off);
+                        off += map[off] | map[off + 1] << 8;
+                        continue;
+                }
+
+                const uint8_t *nl = memchr(map + off, '\n', len - off);
+                size_t n = (nl ? (size_t)(nl - map) + 1 : len) - off;
+                char line[1024];
+
+                // the same cut off fgets() would make in pkt_stream_load()
+                memcpy(line, map + off, n < sizeof line ? n : sizeof line - 1);
+                line[n < sizeof line ? n : sizeof line - 1] = '\0';
+                off += n;
+
+                if (run_log_parse_line(line, &pkt))
+                        process_packet(csv, txt, &run, &nr_runs, &pkt);
+        }
+
+        // a log that stops before it gets back to ready
+        if (run.fired)
+                summarize(txt, &run, ++nr_runs);
+        if (!nr_runs)
+                fprintf(txt, "no runs\n");
+        ret = 0;
+out:
+        if (csv && fclose(csv) != 0)
+                ret = -1;
+        if (txt && fclose(txt) != 0)
+                ret = -1;
+        if (map)
+                munmap((void *)map, len);
+        return ret;
+}
+
+static void *worker_main(void *arg)
+{
+        struct worker *w = arg;
+        char *csv_buf = malloc(OUT_BUF_SIZE);
+        char *txt_buf = malloc(OUT_BUF_SIZE);
+        struct job *j;
+
+        if (!csv_buf || !txt_buf) {
+                fprintf(stderr, "worker %d: out of memory\n", w->id);
+                exit(1);
+        }
+
+        while ((j = next_job(w)) != NULL) {
+                if (process(j, csv_buf, txt_buf) < 0) {
+                        ++w->failed;
+                        continue;
+                }
+                ++w->files;
+                w->bytes += j->size;
+        }
+
+        free(csv_buf);
+        free(txt_buf);
+        return NULL;
+}
+
+static struct job *jobs;
+static size_t nr_jobs;
+
+static void add_job(const char *path)
+{
+        struct stat st;
+
+        if (stat(path, &st) == -1) {
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                exit(1);
+        }
+
+        jobs = realloc(jobs, (nr_jobs + 1) * sizeof *jobs);
+        if (!jobs) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+        }
+        jobs[nr_jobs].path = strdup(path);
+        jobs[nr_jobs].size = st.st_size;
+        ++nr_jobs;
+}
+
+// every .log in it
+static void add_dir(const char *path)
+{
+        DIR *dir = opendir(path);
+        struct dirent *de;
+
+        if (!dir) {
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                exit(1);
+        }
+        while ((de = readdir(dir)) != NULL) {
+                const char *dot = strrchr(de->d_name, '.');
+                char full[4096];
+
+                if (!dot || strcmp(dot, ".log") != 0)
+                        continue;
+                snprintf(full, sizeof full, "%s/%s", path, de->d_name);
+                add_job(full);
+        }
+        closedir(dir);
+}
+
+static int cmp_size(const void *a, const void *b)
+{
+        const struct job *x = a, *y = b;
+
+        return x->size < y->size ? 1 : x->size > y->size ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+        unsigned long long bytes = 0;
+        unsigned long files = 0, failed = 0, steals = 0;
+        uint64_t start;
+        int opt;
+
+        nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+        while ((opt = getopt(argc, argv, "j:o:")) != -1) {
+                switch (opt) {
+                case 'j':
+                        nr_workers = atoi(optarg);
+                        break;
+                case 'o':
+                        out_dir = optarg;
+                        break;
+                default:
+                        usage();
+                }
+        }
+        if (optind == argc || nr_workers < 1)
+                usage();
+        if (nr_workers > MAX_THREADS)
+                nr_workers = MAX_THREADS;
+
+        for (int i = optind; i < argc; ++i) {
+                struct stat st;
+
+                if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode))
+                        add_dir(argv[i]);
+                else
+                        add_job(argv[i]);
+        }
+        if (!nr_jobs) {
+                fprintf(stderr, "no logs\n");
+                return 1;
+        }
+        if (mkdir(out_dir, 0755) == -1 && errno != EEXIST) {
+                fprintf(stderr, "%s: %s\n", out_dir, strerror(errno));
+                return 1;
+        }
+
+        // deal them out biggest first, so each deque ends with its
+        // smallest, which are the ones left to steal
+        qsort(jobs, nr_jobs, sizeof *jobs, cmp_size);
+        if ((size_t)nr_workers > nr_jobs)
+                nr_workers = nr_jobs;
+        for (int i = 0; i < nr_workers; ++i) {
+                workers[i].id = i;
+                pthread_mutex_init(&workers[i].dq.lock, NULL);
+                workers[i].dq.jobs = malloc(nr_jobs * sizeof(struct job *));
+                if (!workers[i].dq.jobs) {
+                        fprintf(stderr, "out of memory\n");
+                        return 1;
+                }
+        }
+        for (size_t i = 0; i < nr_jobs; ++i) {
+                struct deque *dq = &workers[i % nr_workers].dq;
+
+                memmove(dq->jobs + 1, dq->jobs, dq->tail * sizeof *dq->jobs);
+                dq->jobs[0] = &jobs[i];
+                ++dq->tail;
+        }
+
+        // the crc tables are built on first use, which isn't thread safe
+        elet_crc16_slices();
+
+        start = now_ns();
+        for (int i = 0; i < nr_workers; ++i)
+                if (pthread_create(&workers[i].thread, NULL, worker_main,
+                                   &workers[i]) != 0) {
+                        fprintf(stderr, "pthread_create failed\n");
+                        return 1;
+                }
+        for (int i = 0; i < nr_workers; ++i) {
+                pthread_join(workers[i].thread, NULL);
+                files += workers[i].files;
+                failed += workers[i].failed;
+                steals += workers[i].steals;
+                bytes += workers[i].bytes;
+        }
+
+        const double secs = (now_ns() - start) / 1e9;
+        fprintf(stderr, "%lu logs, %.1f MB in %.3f s, %.1f MB/s on %d "
+                "threads, %lu stolen\n", files, bytes / 1e6, secs,
+                bytes / 1e6 / secs, nr_workers, steals);
+        if (failed)
+                fprintf(stderr, "%lu failed\n", failed);
+        return failed ? 1 : 0;
+}
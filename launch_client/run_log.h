@@ -0,0 +1,315 @@
+#ifndef RUN_LOG_H
+#define RUN_LOG_H
+
+// turn recordings of a run back into the byte stream the arduino sent.
+//
+// A recording is either a run.log, whose lines we parse back into the
+// packets they were logged from, or a binary capture: packets back to
+// back, the way they came off the socket or the serial port. Anything in a
+// capture that isn't a packet with a good crc is skipped a byte at a time,
+// like serial_events.py does.
+//
+// Packets come back with their original seq and timestamp, sealed with a
+// fresh crc.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../elet.h"
+
+struct pkt_stream {
+        uint8_t *buf;
+        size_t len;
+        size_t cap;
+
+        // number of packets in buf
+        size_t npkts;
+};
+
+// returns false if we ran out of memory
+static inline bool
+pkt_stream_append(struct pkt_stream *s, const void *pkt, size_t len)
+{
+        if (s->len + len > s->cap) {
+                size_t cap = s->cap ? s->cap * 2 : 1 << 20;
+                uint8_t *buf = (uint8_t *)realloc(s->buf, cap);
+                if (!buf)
+                        return false;
+                s->buf = buf;
+                s->cap = cap;
+        }
+        memcpy(s->buf + s->len, pkt, len);
+        s->len += len;
+        ++s->npkts;
+        return true;
+}
+
+// one line of a run.log. Returns the length of the packet it was logged
+// from, now in pkt, or 0 if it isn't a packet line.
+static inline size_t
+run_log_parse_line(char *line, void *pkt)
+{
+        unsigned ts, seq, vlv, ox, fuel, ign, st, sess, resumed;
+        unsigned step, backlog, us, id, dropped, arg0, arg1;
+        unsigned section, count, min_us, max_us, sum_us, hist[8];
+        unsigned what, old_value, new_value, cause, state;
+        int good, msg_at = 0;
+        unsigned short p0, p1, crc_errors = 0;
+        float t0, t1;
+        double thrust;
+
+        if (sscanf(line, "data, %u, %u, 0x%x, %u, %u, 0x%x, 0x%x, "
+                   "%d, %hu, %hu, %f, %f, %lf, %hu", &ts, &seq, &vlv,
+                   &ox, &fuel, &ign, &st, &good, &p0, &p1, &t0, &t1,
+                   &thrust, &crc_errors) >= 13) {
+                struct data_packet *d = (struct data_packet *)pkt;
+
+                memset(d, 0, sizeof *d);
+                d->header.len = sizeof *d;
+                d->header.type = PT_DATA;
+                d->header.seq = seq;
+                d->header.timestamp = ts;
+                d->vlv_states = vlv;
+                d->vlv_pwm_ox = ox;
+                d->vlv_pwm_fuel = fuel;
+                d->state = elet_state_pack(ign, st, good);
+                d->pressures[PS_OXYGEN] = p0;
+                d->pressures[PS_FUEL] = p1;
+                d->temps[TC_OXYGEN] = t0;
+                d->temps[TC_WATER] = t1;
+                d->thrust = (uint32_t)thrust;
+                d->crc_errors = crc_errors;
+                elet_seal_packet(&d->header);
+                return sizeof *d;
+        }
+
+        if (sscanf(line, "session, %u, %u, 0x%x, %u, 0x%x, 0x%x, %u, %u",
+                   &ts, &seq, &sess, &resumed, &ign, &st, &step,
+                   &backlog) == 8) {
+                struct session_packet *s = (struct session_packet *)pkt;
+
+                memset(s, 0, sizeof *s);
+                s->header.len = sizeof *s;
+                s->header.type = PT_SESSION;
+                s->header.seq = seq;
+                s->header.timestamp = ts;
+                s->session = sess;
+                s->resumed = resumed;
+                s->state = elet_state_pack(ign, st, 0);
+                s->seq_step = step;
+                s->backlog = backlog;
+                elet_seal_packet(&s->header);
+                return sizeof *s;
+        }
+
+        if (sscanf(line, "event, %u, %u, %u, %u, %u, %u, %u", &ts, &seq, &us,
+                   &id, &dropped, &arg0, &arg1) == 7) {
+                struct event_packet *e = (struct event_packet *)pkt;
+
+                memset(e, 0, sizeof *e);
+                e->header.len = sizeof *e;
+                e->header.type = PT_EVENT;
+                e->header.seq = seq;
+                e->header.timestamp = ts;
+                e->us = us;
+                e->id = id;
+                e->dropped = dropped;
+                e->arg0 = arg0;
+                e->arg1 = arg1;
+                elet_seal_packet(&e->header);
+                return sizeof *e;
+        }
+
+        if (sscanf(line, "stats, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u, "
+                   "%u, %u, %u, %u", &ts, &seq, &section, &count, &min_us,
+                   &max_us, &sum_us, &hist[0], &hist[1], &hist[2], &hist[3],
+                   &hist[4], &hist[5], &hist[6], &hist[7]) == 15) {
+                struct stats_packet *s = (struct stats_packet *)pkt;
+
+                memset(s, 0, sizeof *s);
+                s->header.len = sizeof *s;
+                s->header.type = PT_STATS;
+                s->header.seq = seq;
+                s->header.timestamp = ts;
+                s->section = section;
+                s->count = count;
+                s->min_us = min_us;
+                s->max_us = max_us;
+                s->sum_us = sum_us;
+                for (int i = 0; i < STATS_NR_BINS; ++i)
+                        s->hist[i] = hist[i];
+                elet_seal_packet(&s->header);
+                return sizeof *s;
+        }
+
+        if (sscanf(line, "transition, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u",
+                   &ts, &seq, &us, &what, &old_value, &new_value, &cause,
+                   &state, &dropped, &arg1) == 10) {
+                struct transition_packet *t = (struct transition_packet *)pkt;
+
+                memset(t, 0, sizeof *t);
+                t->header.len = sizeof *t;
+                t->header.type = PT_TRANSITION;
+                t->header.seq = seq;
+                t->header.timestamp = ts;
+                t->us = us;
+                t->what = what;
+                t->old_value = old_value;
+                t->new_value = new_value;
+                t->cause = cause;
+                t->state = state;
+                t->dropped = dropped;
+                t->arg = arg1;
+                elet_seal_packet(&t->header);
+                return sizeof *t;
+        }
+
+        if (sscanf(line, "message, %u, %u, %n", &ts, &seq, &msg_at) >= 2
+            && msg_at) {
+                struct message_packet *m = (struct message_packet *)pkt;
+
+                // the log has the text of whatever id it was, so it comes
+                // back as just text
+                line[strcspn(line, "\n")] = '\0';
+                const size_t n = strnlen(line + msg_at, sizeof m->text);
+
+                memset(m, 0, sizeof *m);
+                m->header.len = MESSAGE_PACKET_MIN_LEN + n;
+                m->header.type = PT_MESSAGE;
+                m->header.seq = seq;
+                m->header.timestamp = ts;
+                m->id = MSG_TEXT;
+                memcpy(m->text, line + msg_at, n);
+                elet_seal_packet(&m->header);
+                return m->header.len;
+        }
+
+        return 0;
+}
+
+// how long a packet of this type is, 0 if there's no such type. A message
+// can be shorter, see pkt_len_ok().
+static inline size_t
+pkt_type_len(uint8_t type)
+{
+        switch (type) {
+        case PT_DATA:
+                return sizeof(struct data_packet);
+        case PT_SESSION:
+                return sizeof(struct session_packet);
+        case PT_MESSAGE:
+                return sizeof(struct message_packet);
+        case PT_EVENT:
+                return sizeof(struct event_packet);
+        case PT_STATS:
+                return sizeof(struct stats_packet);
+        case PT_TRANSITION:
+                return sizeof(struct transition_packet);
+        default:
+                return 0;
+        }
+}
+
+// could a packet of this type be len bytes long?
+static inline bool
+pkt_len_ok(uint8_t type, size_t len)
+{
+        if (type == PT_MESSAGE)
+                return len >= MESSAGE_PACKET_MIN_LEN
+                        && len <= sizeof(struct message_packet);
+        return len == pkt_type_len(type);
+}
+
+// does a packet start at p, with n bytes to go?
+static inline bool
+pkt_looks_good(const uint8_t *p, size_t n)
+{
+        struct packet_header hdr;
+
+        if (n < sizeof hdr)
+                return false;
+        memcpy(&hdr, p, sizeof hdr);
+        return pkt_len_ok(hdr.type, hdr.len) && hdr.len <= n
+                && elet_packet_crc(p, hdr.len) == hdr.crc;
+}
+
+// add the packets in a recording to s. Returns how many there were, or -1
+// if we couldn't read it.
+static inline long
+pkt_stream_load(struct pkt_stream *s, const char *fname)
+{
+        FILE *f = fopen(fname, "rb");
+        size_t before = s->npkts;
+        uint8_t head[64];
+        size_t nhead;
+
+        if (!f)
+                return -1;
+
+        // a text log starts with a packet line, a capture starts with a
+        // packet, give or take some junk
+        nhead = fread(head, 1, sizeof head, f);
+        rewind(f);
+
+        bool binary = false;
+        for (size_t i = 0; i < nhead; ++i)
+                if (pkt_looks_good(head + i, nhead - i))
+                        binary = true;
+
+        if (!binary) {
+                char line[1024];
+                union {
+                        struct data_packet d;
+                        struct session_packet s;
+                        struct message_packet m;
+                        struct event_packet e;
+                        struct stats_packet st;
+                        struct transition_packet t;
+                } pkt;
+
+                while (fgets(line, sizeof line, f)) {
+                        size_t len = run_log_parse_line(line, &pkt);
+                        if (len && !pkt_stream_append(s, &pkt, len))
+                                goto fail;
+                }
+        } else {
+                struct pkt_stream raw;
+                uint8_t chunk[4096];
+                size_t n;
+
+                memset(&raw, 0, sizeof raw);
+
+                while ((n = fread(chunk, 1, sizeof chunk, f)) != 0)
+                        if (!pkt_stream_append(&raw, chunk, n)) {
+                                free(raw.buf);
+                                goto fail;
+                        }
+
+                for (size_t off = 0; off < raw.len; ) {
+                        if (!pkt_looks_good(raw.buf + off, raw.len - off)) {
+                                ++off;
+                                continue;
+                        }
+
+                        uint16_t len = raw.buf[off] | raw.buf[off + 1] << 8;
+                        if (!pkt_stream_append(s, raw.buf + off, len)) {
+                                free(raw.buf);
+                                goto fail;
+                        }
+                        off += len;
+                }
+                free(raw.buf);
+        }
+
+        fclose(f);
+        return s->npkts - before;
+
+fail:
+        fclose(f);
+        return -1;
+}
+
+#endif // RUN_LOG_H
@@ -0,0 +1,288 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+// the numbers we want out of a test, kept up to date as the data packets
+// come in instead of worked out from run.log afterwards: total impulse, peak
+// thrust, how long it burned, and the feed pressures and thrust in each
+// state. Each sample is O(1), and the whole thing is a fixed size struct.
+//
+// Readings are converted with the calibrations in elet.h. A sample holds
+// until the next one, and the time in between counts towards the state the
+// earlier one was in. Integrals are trapezoids.
+//
+// The load cell doesn't read 0 at rest: the rig and whatever is bolted to it
+// weigh something, and the amp drifts from day to day (anywhere from 5 to
+// 70 lbf in the logs we have). So thrust is measured from a zero, the mean
+// reading in SS_READY before the fire, and only counts as a burn in SS_FIRE
+// and SS_SAFING.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../elet.h"
+
+// thrust over this counts as burning, lbf over the zero
+#define RUN_STATS_BURN_LBF 5.0
+
+// one reading over some stretch of time
+struct run_stat {
+        double min;
+        double max;
+
+        // the reading times seconds, for the mean
+        double integral;
+};
+
+struct state_stats {
+        unsigned long samples;
+        double secs;
+        struct run_stat ox_psi;
+        struct run_stat fuel_psi;
+        struct run_stat lbf;
+};
+
+struct run_stats {
+        // the newest sample
+        bool have_last;
+        uint32_t last_ts;
+        uint8_t last_state;
+        double last_ox_psi;
+        double last_fuel_psi;
+        double last_lbf;
+
+        // we've been in SS_FIRE since the last reset, so going back to
+        // SS_READY finishes a run
+        bool fired;
+
+        // the load cell's reading at rest, lbf. Taken when the fire
+        // starts, see run_stats_zero().
+        double zero_lbf;
+
+        // while burning: lbf s over the zero, and the feed pressures
+        double impulse;
+        double burn_secs;
+        struct run_stat burn_ox_psi;
+        struct run_stat burn_fuel_psi;
+
+        // over the zero, in SS_FIRE and SS_SAFING
+        double peak_lbf;
+        uint32_t peak_ts;
+
+        // first and last samples RUN_STATS_BURN_LBF over the zero, valid if
+        // burn_seen
+        bool burn_seen;
+        uint32_t burn_start_ts;
+        uint32_t burn_end_ts;
+
+        struct state_stats states[SS_NUM_STATES];
+};
+
+static inline void run_stat_reset(struct run_stat *s)
+{
+        s->min = INFINITY;
+        s->max = -INFINITY;
+        s->integral = 0;
+}
+
+static inline void run_stats_reset(struct run_stats *r)
+{
+        memset(r, 0, sizeof *r);
+        run_stat_reset(&r->burn_ox_psi);
+        run_stat_reset(&r->burn_fuel_psi);
+        for (int i = 0; i < SS_NUM_STATES; ++i) {
+                run_stat_reset(&r->states[i].ox_psi);
+                run_stat_reset(&r->states[i].fuel_psi);
+                run_stat_reset(&r->states[i].lbf);
+        }
+}
+
+// a reading moved from a to b over dt seconds
+static inline void
+run_stat_add(struct run_stat *s, double a, double b, double dt)
+{
+        s->min = a < s->min ? a : s->min;
+        s->min = b < s->min ? b : s->min;
+        s->max = a > s->max ? a : s->max;
+        s->max = b > s->max ? b : s->max;
+        s->integral += (a + b) / 2 * dt;
+}
+
+static inline double run_stat_mean(const struct run_stat *s, double secs)
+{
+        return secs > 0 ? s->integral / secs : NAN;
+}
+
+static inline double run_stats_psi(enum pressure_sensor ps, uint16_t counts)
+{
+        return counts * pressure_sensor_properties[ps].slope
+                + pressure_sensor_properties[ps].offset;
+}
+
+static inline double run_stats_lbf(uint32_t thrust)
+{
+        // the load cell's reading is signed, it just goes out unsigned
+        return (int32_t)thrust * (double)load_cell_props.slope
+                + load_cell_props.offset;
+}
+
+// can the engine be making thrust in state?
+static inline bool run_stats_burning(uint8_t state)
+{
+        return state == SS_FIRE || state == SS_SAFING;
+}
+
+// the fire is starting and lbf is what the load cell says right now. The
+// zero is the mean in SS_READY up to here, or if we never saw SS_READY
+// (the log starts mid-sequence), this reading, the best we have.
+static inline double run_stats_zero(const struct run_stats *r, double lbf)
+{
+        const struct state_stats *ready = &r->states[SS_READY];
+
+        return ready->secs > 0 ? run_stat_mean(&ready->lbf, ready->secs) : lbf;
+}
+
+// add the raw readings from a data packet. Samples that aren't newer than
+// the last one, like the ones resent after a reconnect, are ignored.
+// Returns true if this one finished a run, i.e. it's the first one back in
+// SS_READY after a fire. Summarize it then, before the next reset.
+static inline bool
+run_stats_add(struct run_stats *r, uint32_t ts, uint8_t state,
+              uint16_t ox_counts, uint16_t fuel_counts, uint32_t thrust)
+{
+        const double ox = run_stats_psi(PS_OXYGEN, ox_counts);
+        const double fuel = run_stats_psi(PS_FUEL, fuel_counts);
+        const double lbf = run_stats_lbf(thrust);
+
+        if (state >= SS_NUM_STATES)
+                return false;
+        if (r->have_last && (int32_t)(ts - r->last_ts) <= 0)
+                return false;
+
+        if (r->have_last) {
+                const double dt = (uint32_t)(ts - r->last_ts) / 1e3;
+                struct state_stats *st = &r->states[r->last_state];
+
+                st->secs += dt;
+                run_stat_add(&st->ox_psi, r->last_ox_psi, ox, dt);
+                run_stat_add(&st->fuel_psi, r->last_fuel_psi, fuel, dt);
+                run_stat_add(&st->lbf, r->last_lbf, lbf, dt);
+
+                if (r->fired && run_stats_burning(r->last_state)
+                    && r->last_lbf - r->zero_lbf > RUN_STATS_BURN_LBF) {
+                        r->burn_secs += dt;
+                        r->impulse += ((r->last_lbf + lbf) / 2
+                                       - r->zero_lbf) * dt;
+                        run_stat_add(&r->burn_ox_psi, r->last_ox_psi, ox,
+                                     dt);
+                        run_stat_add(&r->burn_fuel_psi, r->last_fuel_psi,
+                                     fuel, dt);
+                }
+        }
+
+        const bool done = r->fired && state == SS_READY
+                && r->last_state != SS_READY;
+
+        if (state == SS_FIRE && !r->fired) {
+                r->zero_lbf = run_stats_zero(r, lbf);
+                r->fired = true;
+        }
+
+        ++r->states[state].samples;
+        if (r->fired && run_stats_burning(state)) {
+                if (lbf - r->zero_lbf > r->peak_lbf) {
+                        r->peak_lbf = lbf - r->zero_lbf;
+                        r->peak_ts = ts;
+                }
+                if (lbf - r->zero_lbf > RUN_STATS_BURN_LBF) {
+                        if (!r->burn_seen)
+                                r->burn_start_ts = ts;
+                        r->burn_seen = true;
+                        r->burn_end_ts = ts;
+                }
+        }
+
+        r->have_last = true;
+        r->last_ts = ts;
+        r->last_state = state;
+        r->last_ox_psi = ox;
+        r->last_fuel_psi = fuel;
+        r->last_lbf = lbf;
+
+        return done;
+}
+
+static inline double run_stats_burn_duration(const struct run_stats *r)
+{
+        return r->burn_seen ? (r->burn_end_ts - r->burn_start_ts) / 1e3 : 0;
+}
+
+// the summary, for people. Thrust in every state is over the zero.
+static inline void run_stats_print(FILE *f, const struct run_stats *r)
+{
+        const double z = r->zero_lbf;
+
+        fprintf(f, "impulse %.1f lbf s, peak %.1f lbf at %u ms, burned "
+                "%.2f s, feed %.1f psi ox, %.1f psi fuel, zero %.1f lbf\n",
+                r->impulse, r->peak_lbf, r->peak_ts,
+                run_stats_burn_duration(r),
+                run_stat_mean(&r->burn_ox_psi, r->burn_secs),
+                run_stat_mean(&r->burn_fuel_psi, r->burn_secs), z);
+
+        for (int i = 0; i < SS_NUM_STATES; ++i) {
+                const struct state_stats *st = &r->states[i];
+
+                if (!st->secs)
+                        continue;
+                fprintf(f, "    %-22s %7.2f s: ox %6.1f psi (%.1f-%.1f), "
+                        "fuel %6.1f psi (%.1f-%.1f), thrust %6.1f lbf "
+                        "(%.1f-%.1f)\n",
+                        system_state_to_str((enum system_state)i), st->secs,
+                        run_stat_mean(&st->ox_psi, st->secs),
+                        st->ox_psi.min, st->ox_psi.max,
+                        run_stat_mean(&st->fuel_psi, st->secs),
+                        st->fuel_psi.min, st->fuel_psi.max,
+                        run_stat_mean(&st->lbf, st->secs) - z,
+                        st->lbf.min - z, st->lbf.max - z);
+        }
+}
+
+// and for run.log:
+//
+//   summary, time, impulse, peak lbf, peak time, burn s, ox psi, fuel psi,
+//       zero lbf
+//   summary_state, time, state, secs, samples, ox mean, ox min, ox max,
+//       fuel mean, fuel min, fuel max, lbf mean, lbf min, lbf max
+//
+// the pressures in the summary line are the means while burning, and lbf
+// is over the zero everywhere, like run_stats_print()
+static inline void run_stats_log(int fd, const struct run_stats *r)
+{
+        const double z = r->zero_lbf;
+
+        dprintf(fd, "summary, %u, %.3f, %.3f, %u, %.3f, %.3f, %.3f, %.3f\n",
+                r->last_ts, r->impulse, r->peak_lbf, r->peak_ts,
+                run_stats_burn_duration(r),
+                run_stat_mean(&r->burn_ox_psi, r->burn_secs),
+                run_stat_mean(&r->burn_fuel_psi, r->burn_secs), z);
+
+        for (int i = 0; i < SS_NUM_STATES; ++i) {
+                const struct state_stats *st = &r->states[i];
+
+                if (!st->secs)
+                        continue;
+                dprintf(fd, "summary_state, %u, %d, %.3f, %lu, %.3f, %.3f, "
+                        "%.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n",
+                        r->last_ts, i, st->secs, st->samples,
+                        run_stat_mean(&st->ox_psi, st->secs),
+                        st->ox_psi.min, st->ox_psi.max,
+                        run_stat_mean(&st->fuel_psi, st->secs),
+                        st->fuel_psi.min, st->fuel_psi.max,
+                        run_stat_mean(&st->lbf, st->secs) - z,
+                        st->lbf.min - z, st->lbf.max - z);
+        }
+}
+
+#endif // RUN_STATS_H
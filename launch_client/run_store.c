@@ -0,0 +1,831 @@
+// a store for every run of the campaign, so questions like "what was the
+// peak ox pressure in SS_FIRE, across all runs" take milliseconds instead
+// of a rescan of every log.
+//
+// Runs go in with ingest: run.logs and binary captures (anything
+// run_log.h reads), and calibration CSVs. Each one is cut into chunks of
+// CHUNK_ROWS rows, and each column of a chunk is stored on its own as
+// zigzagged deltas from the row before, as varints. Telemetry barely moves
+// from one sample to the next, so most values take a byte.
+//
+// The index has the chunk directory, with the min and max of every column
+// and which states each chunk has rows in, and a line of metadata for each
+// run: when it was ingested (logs don't say when they were recorded), how
+// long it burned by run_stats.h's reckoning, how it ended and which
+// sequences it ran. Queries go through the index first and only
+// decode the chunks, and the columns of those chunks, that could change
+// the answer: for max, the chunks with the biggest max first, stopping as
+// soon as no chunk left could beat what we have.
+//
+// The store is a directory of two files, index and data, in this
+// machine's byte order. Data is only ever appended to, the index is
+// rewritten on each ingest.
+//
+// usage: run_store [-d dir] ingest file...
+//        run_store [-d dir] list
+//        run_store [-d dir] query [-s state] [-r] max|min|mean|count column
+//
+//   -d  the store, run_store.d by default
+//   -s  only rows in this state: ready, fire, safing or depress
+//   -r  the answer for each run, instead of across all of them
+//
+// Columns of runs are time (ms), state, valves, ox_pwm, fuel_pwm, ox and
+// fuel (pressure sensor counts), thrust (raw load cell), ox_temp and
+// water_temp, and ox_psi, fuel_psi and lbf, which are ox, fuel and thrust
+// with the calibrations in elet.h. Calibration CSVs have columns c0, c1 and
+// so on.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../elet.h"
+#include "run_log.h"
+#include "run_stats.h"
+
+// 2: burn_s is thrust over the zero, not the time in SS_FIRE
+#define STORE_MAGIC "ELETRUN2"
+#define CHUNK_ROWS 4096
+#define MAX_COLS 10
+
+enum run_kind {
+        KIND_LOG,
+        KIND_CSV,
+};
+
+// the columns of a run
+enum log_col {
+        COL_TIME,
+        COL_STATE,
+        COL_VALVES,
+        COL_OX_PWM,
+        COL_FUEL_PWM,
+        COL_OX,
+        COL_FUEL,
+        COL_THRUST,
+
+        // thousandths of a degree
+        COL_OX_TEMP,
+        COL_WATER_TEMP,
+
+        NR_LOG_COLS
+};
+
+struct run_meta {
+        char name[64];
+        char ingested[12];
+        char result[32];
+        char sequences[32];
+        uint8_t kind;
+        uint8_t ncols;
+
+        // bit per enum system_state it has rows in
+        uint8_t states;
+        uint8_t _pad;
+        uint32_t rows;
+        uint32_t first_chunk;
+        uint32_t nchunks;
+
+        // thrust over the load cell's zero, summed over every run in it
+        double burn_s;
+};
+
+struct chunk_meta {
+        uint32_t run;
+        uint32_t rows;
+        uint64_t off;
+        uint8_t states;
+        uint8_t _pad[3];
+
+        // column i is bytes col_off[i] to col_off[i + 1] from off
+        uint32_t col_off[MAX_COLS + 1];
+        int64_t min[MAX_COLS];
+        int64_t max[MAX_COLS];
+};
+
+static const char *store_dir = "run_store.d";
+
+static struct run_meta *runs;
+static uint32_t nruns;
+static struct chunk_meta *chunks;
+static uint32_t nchunks;
+
+static void __attribute__((noreturn)) die(const char *reason, int err)
+{
+        fprintf(stderr, "%s: %s\n", reason, strerror(err));
+        exit(1);
+}
+
+static void __attribute__((noreturn)) usage(void)
+{
+        fprintf(stderr, "usage: run_store [-d dir] ingest file...\n"
+                "       run_store [-d dir] list\n"
+                "       run_store [-d dir] query [-s state] [-r] "
+                "max|min|mean|count column\n");
+        exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static char *store_path(const char *file)
+{
+        static char path[4096];
+
+        snprintf(path, sizeof path, "%s/%s", store_dir, file);
+        return path;
+}
+
+static void load_index(void)
+{
+        char magic[8];
+        FILE *f = fopen(store_path("index"), "rb");
+
+        if (!f) {
+                if (errno == ENOENT)
+                        return;
+                die(store_path("index"), errno);
+        }
+
+        if (fread(magic, sizeof magic, 1, f) != 1
+            || memcmp(magic, STORE_MAGIC, sizeof magic) != 0
+            || fread(&nruns, sizeof nruns, 1, f) != 1
+            || fread(&nchunks, sizeof nchunks, 1, f) != 1)
+                die("bad index", EINVAL);
+
+        runs = malloc(nruns * sizeof *runs + 1);
+        chunks = malloc(nchunks * sizeof *chunks + 1);
+        if (!runs || !chunks)
+                die("malloc", ENOMEM);
+        if (fread(runs, sizeof *runs, nruns, f) != nruns
+            || fread(chunks, sizeof *chunks, nchunks, f) != nchunks)
+                die("short index", EINVAL);
+        fclose(f);
+}
+
+// write it somewhere else and move it into place, so a crash leaves the
+// old one
+static void save_index(void)
+{
+        char tmp[4096];
+        FILE *f;
+
+        snprintf(tmp, sizeof tmp, "%s.new", store_path("index"));
+        f = fopen(tmp, "wb");
+        if (!f)
+                die(tmp, errno);
+        if (fwrite(STORE_MAGIC, 8, 1, f) != 1
+            || fwrite(&nruns, sizeof nruns, 1, f) != 1
+            || fwrite(&nchunks, sizeof nchunks, 1, f) != 1
+            || fwrite(runs, sizeof *runs, nruns, f) != nruns
+            || fwrite(chunks, sizeof *chunks, nchunks, f) != nchunks
+            || fclose(f) != 0)
+                die(tmp, errno);
+        if (rename(tmp, store_path("index")) == -1)
+                die("rename", errno);
+}
+
+// ingesting
+
+// the rows of the chunk we're building
+static int64_t rows[MAX_COLS][CHUNK_ROWS];
+static uint32_t nrows;
+static uint8_t row_states;
+
+// the encoded chunk. A varint is at most 10 bytes.
+static uint8_t chunk_buf[MAX_COLS * CHUNK_ROWS * 10];
+
+// thousandths, rounded
+static int64_t scaled(double v)
+{
+        return (int64_t)(v * 1000 + (v < 0 ? -0.5 : 0.5));
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v)
+{
+        size_t n = 0;
+
+        while (v >= 0x80) {
+                p[n++] = (uint8_t)v | 0x80;
+                v >>= 7;
+        }
+        p[n++] = (uint8_t)v;
+        return n;
+}
+
+static void flush_chunk(FILE *data, struct run_meta *run)
+{
+        struct chunk_meta *c;
+        size_t len = 0;
+
+        if (!nrows)
+                return;
+
+        chunks = realloc(chunks, (nchunks + 1) * sizeof *chunks);
+        if (!chunks)
+                die("realloc", ENOMEM);
+        c = &chunks[nchunks];
+        memset(c, 0, sizeof *c);
+        c->run = run - runs;
+        c->rows = nrows;
+        c->states = row_states;
+
+        for (int col = 0; col < run->ncols; ++col) {
+                int64_t prev = 0;
+
+                c->col_off[col] = len;
+                c->min[col] = c->max[col] = rows[col][0];
+                for (uint32_t i = 0; i < nrows; ++i) {
+                        const int64_t v = rows[col][i];
+                        const int64_t d = v - prev;
+
+                        len += put_varint(chunk_buf + len,
+                                          ((uint64_t)d << 1) ^ (d >> 63));
+                        prev = v;
+                        if (v < c->min[col])
+                                c->min[col] = v;
+                        if (v > c->max[col])
+                                c->max[col] = v;
+                }
+        }
+        c->col_off[run->ncols] = len;
+
+        if (fseek(data, 0, SEEK_END) == -1)
+                die("fseek", errno);
+        c->off = ftell(data);
+        if (fwrite(chunk_buf, 1, len, data) != len)
+                die("write data", errno);
+
+        if (!run->nchunks)
+                run->first_chunk = nchunks;
+        ++run->nchunks;
+        ++nchunks;
+        nrows = 0;
+        row_states = 0;
+}
+
+static void add_row(FILE *data, struct run_meta *run, const int64_t *row)
+{
+        for (int col = 0; col < run->ncols; ++col)
+                rows[col][nrows] = row[col];
+        if (run->kind == KIND_LOG && row[COL_STATE] < SS_NUM_STATES) {
+                row_states |= 1 << row[COL_STATE];
+                run->states |= 1 << row[COL_STATE];
+        }
+        ++run->rows;
+        if (++nrows == CHUNK_ROWS)
+                flush_chunk(data, run);
+}
+
+static void ingest_log(FILE *data, struct run_meta *run, const char *fname)
+{
+        struct pkt_stream s = {0};
+        struct run_stats rs;
+        int64_t row[MAX_COLS];
+        uint8_t last_state = SS_NUM_STATES;
+        bool stopped = false;
+        int redline = -1;
+
+        if (pkt_stream_load(&s, fname) < 0)
+                die(fname, errno ? errno : ENOMEM);
+        run_stats_reset(&rs);
+
+        run->kind = KIND_LOG;
+        run->ncols = NR_LOG_COLS;
+
+        for (size_t off = 0; off < s.len; ) {
+                struct packet_header hdr;
+
+                memcpy(&hdr, s.buf + off, sizeof hdr);
+                if (hdr.type == PT_DATA) {
+                        struct data_packet d;
+                        memcpy(&d, s.buf + off, sizeof d);
+
+                        row[COL_TIME] = hdr.timestamp;
+                        row[COL_STATE] = elet_state_sys_state(d.state);
+                        row[COL_VALVES] = d.vlv_states;
+                        row[COL_OX_PWM] = d.vlv_pwm_ox;
+                        row[COL_FUEL_PWM] = d.vlv_pwm_fuel;
+                        row[COL_OX] = d.pressures[PS_OXYGEN];
+                        row[COL_FUEL] = d.pressures[PS_FUEL];
+                        row[COL_THRUST] = (int32_t)d.thrust;
+                        row[COL_OX_TEMP] = scaled(d.temps[TC_OXYGEN]);
+                        row[COL_WATER_TEMP] = scaled(d.temps[TC_WATER]);
+
+                        // not the time in SS_FIRE, which has the
+                        // seconds of lead-in before ignition in it
+                        if (run_stats_add(&rs, hdr.timestamp,
+                                          row[COL_STATE],
+                                          d.pressures[PS_OXYGEN],
+                                          d.pressures[PS_FUEL], d.thrust)) {
+                                run->burn_s += run_stats_burn_duration(&rs);
+                                run_stats_reset(&rs);
+                        }
+                        last_state = row[COL_STATE];
+
+                        add_row(data, run, row);
+                } else if (hdr.type == PT_EVENT) {
+                        struct event_packet e;
+                        memcpy(&e, s.buf + off, sizeof e);
+
+                        if (e.id == EV_REDLINE && redline == -1)
+                                redline = e.arg0;
+                        if (e.id == EV_REQ && e.arg0 == REQ_CMD_STOP
+                            && last_state == SS_FIRE)
+                                stopped = true;
+                }
+                off += hdr.len;
+        }
+        flush_chunk(data, run);
+        free(s.buf);
+
+        // a log that stops before it gets back to ready
+        if (rs.fired)
+                run->burn_s += run_stats_burn_duration(&rs);
+
+        if (redline >= 0)
+                snprintf(run->result, sizeof run->result, "redline %s",
+                         redline_to_short_str((enum redline)redline));
+        else if (stopped)
+                snprintf(run->result, sizeof run->result, "stopped");
+        else if ((run->states & 1 << SS_FIRE) && run->burn_s > 0)
+                snprintf(run->result, sizeof run->result, "burned");
+        else if (run->states & 1 << SS_FIRE)
+                snprintf(run->result, sizeof run->result, "no thrust");
+        else
+                snprintf(run->result, sizeof run->result, "no fire");
+
+        for (int st = SS_FIRE; st < SS_NUM_STATES; ++st) {
+                size_t n = strlen(run->sequences);
+
+                if (!(run->states & 1 << st))
+                        continue;
+                snprintf(run->sequences + n, sizeof run->sequences - n,
+                         "%s%s", n ? "+" : "",
+                         system_state_to_short_str((enum system_state)st));
+        }
+        if (!run->sequences[0])
+                snprintf(run->sequences, sizeof run->sequences, "none");
+}
+
+// lines of numbers. The first line with more than one of them says how
+// many columns there are, anything else is skipped.
+static void ingest_csv(FILE *data, struct run_meta *run, const char *fname)
+{
+        FILE *f = fopen(fname, "r");
+        char line[1024];
+
+        if (!f)
+                die(fname, errno);
+
+        run->kind = KIND_CSV;
+        snprintf(run->result, sizeof run->result, "calibration");
+        snprintf(run->sequences, sizeof run->sequences, "none");
+
+        while (fgets(line, sizeof line, f)) {
+                int64_t row[MAX_COLS];
+                char *p = line, *end;
+                int n = 0;
+
+                for (;;) {
+                        double v = strtod(p, &end);
+                        if (end == p || n == MAX_COLS)
+                                break;
+                        row[n++] = scaled(v);
+                        p = end + strspn(end, " \t");
+                        if (*p != ',')
+                                break;
+                        ++p;
+                }
+
+                if (!run->ncols && n > 1)
+                        run->ncols = n;
+                if (n == run->ncols)
+                        add_row(data, run, row);
+        }
+        flush_chunk(data, run);
+        fclose(f);
+}
+
+static int cmd_ingest(int argc, char **argv)
+{
+        const time_t now = time(NULL);
+        FILE *data;
+
+        if (argc == 0)
+                usage();
+        if (mkdir(store_dir, 0755) == -1 && errno != EEXIST)
+                die(store_dir, errno);
+        load_index();
+        data = fopen(store_path("data"), "ab");
+        if (!data)
+                die(store_path("data"), errno);
+
+        for (int i = 0; i < argc; ++i) {
+                const char *base = strrchr(argv[i], '/');
+                const char *dot;
+                struct run_meta *run;
+                struct stat st;
+                char name[64];
+                bool dup = false;
+
+                base = base ? base + 1 : argv[i];
+                dot = strrchr(base, '.');
+                snprintf(name, sizeof name, "%.*s",
+                         dot ? (int)(dot - base) : (int)strlen(base), base);
+
+                for (uint32_t r = 0; r < nruns; ++r)
+                        if (strcmp(runs[r].name, name) == 0)
+                                dup = true;
+                if (dup) {
+                        fprintf(stderr, "%s: already have %s, skipping\n",
+                                argv[i], name);
+                        continue;
+                }
+                if (stat(argv[i], &st) == -1)
+                        die(argv[i], errno);
+
+                runs = realloc(runs, (nruns + 1) * sizeof *runs);
+                if (!runs)
+                        die("realloc", ENOMEM);
+                run = &runs[nruns++];
+                memset(run, 0, sizeof *run);
+                strcpy(run->name, name);
+                strftime(run->ingested, sizeof run->ingested, "%Y-%m-%d",
+                         localtime(&now));
+
+                if (dot && strcmp(dot, ".csv") == 0)
+                        ingest_csv(data, run, argv[i]);
+                else
+                        ingest_log(data, run, argv[i]);
+
+                fprintf(stderr, "%s: %u rows in %u chunks\n", name,
+                        run->rows, run->nchunks);
+        }
+
+        if (fclose(data) != 0)
+                die(store_path("data"), errno);
+        save_index();
+        return 0;
+}
+
+static int cmd_list(void)
+{
+        load_index();
+
+        printf("%-36s %-10s %8s %6s %7s  %-20s %s\n", "run", "ingested",
+               "rows", "chunks", "burn s", "result", "sequences");
+        for (uint32_t r = 0; r < nruns; ++r) {
+                const struct run_meta *run = &runs[r];
+
+                printf("%-36s %-10s %8u %6u %7.2f  %-20s %s\n", run->name,
+                       run->ingested, run->rows, run->nchunks, run->burn_s,
+                       run->result, run->sequences);
+        }
+        return 0;
+}
+
+// querying
+
+struct query_col {
+        const char *name;
+        uint8_t kind;
+        uint8_t col;
+
+        // what the stored value means: value * slope + offset
+        double slope;
+        double offset;
+};
+
+static const struct query_col query_cols[] = {
+        {"time", KIND_LOG, COL_TIME, 1, 0},
+        {"state", KIND_LOG, COL_STATE, 1, 0},
+        {"valves", KIND_LOG, COL_VALVES, 1, 0},
+        {"ox_pwm", KIND_LOG, COL_OX_PWM, 1, 0},
+        {"fuel_pwm", KIND_LOG, COL_FUEL_PWM, 1, 0},
+        {"ox", KIND_LOG, COL_OX, 1, 0},
+        {"fuel", KIND_LOG, COL_FUEL, 1, 0},
+        {"thrust", KIND_LOG, COL_THRUST, 1, 0},
+        {"ox_temp", KIND_LOG, COL_OX_TEMP, 1.0 / 1000, 0},
+        {"water_temp", KIND_LOG, COL_WATER_TEMP, 1.0 / 1000, 0},
+};
+
+static bool find_col(const char *name, struct query_col *q)
+{
+        for (size_t i = 0; i < sizeof query_cols / sizeof query_cols[0]; ++i)
+                if (strcmp(name, query_cols[i].name) == 0) {
+                        *q = query_cols[i];
+                        return true;
+                }
+
+        q->kind = KIND_LOG;
+        if (strcmp(name, "ox_psi") == 0 || strcmp(name, "fuel_psi") == 0) {
+                enum pressure_sensor ps = name[0] == 'o' ? PS_OXYGEN
+                        : PS_FUEL;
+
+                q->col = ps == PS_OXYGEN ? COL_OX : COL_FUEL;
+                q->slope = pressure_sensor_properties[ps].slope;
+                q->offset = pressure_sensor_properties[ps].offset;
+        } else if (strcmp(name, "lbf") == 0) {
+                q->col = COL_THRUST;
+                q->slope = load_cell_props.slope;
+                q->offset = load_cell_props.offset;
+        } else if (name[0] == 'c' && name[1] >= '0' && name[1] <= '9'
+                   && !name[2]) {
+                q->kind = KIND_CSV;
+                q->col = name[1] - '0';
+                q->slope = 1.0 / 1000;
+                q->offset = 0;
+        } else {
+                return false;
+        }
+        q->name = name;
+        return true;
+}
+
+static const uint8_t *data_map;
+static unsigned long chunks_read;
+
+static void decode_col(const struct chunk_meta *c, int col, int64_t *out)
+{
+        const uint8_t *p = data_map + c->off + c->col_off[col];
+        int64_t prev = 0;
+
+        for (uint32_t i = 0; i < c->rows; ++i) {
+                uint64_t v = 0;
+                int shift = 0;
+
+                do {
+                        v |= (uint64_t)(*p & 0x7f) << shift;
+                        shift += 7;
+                } while (*p++ & 0x80);
+
+                prev += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+                out[i] = prev;
+        }
+}
+
+struct answer {
+        unsigned long count;
+        double sum;
+
+        // for max and min, the best value (as stored) and where it was
+        bool found;
+        int64_t best;
+        uint32_t chunk;
+        uint32_t row;
+};
+
+enum agg {
+        AGG_MAX,
+        AGG_MIN,
+        AGG_MEAN,
+        AGG_COUNT,
+};
+
+// the chunks of runs [first, last) that could have matching rows
+static uint32_t candidates(uint32_t first, uint32_t last,
+                           const struct query_col *q, int state,
+                           uint32_t *out)
+{
+        uint32_t n = 0;
+
+        for (uint32_t r = first; r < last; ++r) {
+                const struct run_meta *run = &runs[r];
+
+                if (run->kind != q->kind || q->col >= run->ncols)
+                        continue;
+                for (uint32_t i = 0; i < run->nchunks; ++i) {
+                        const uint32_t ci = run->first_chunk + i;
+
+                        if (state < 0 || chunks[ci].states & 1 << state)
+                                out[n++] = ci;
+                }
+        }
+        return n;
+}
+
+// for sorting candidates by how good the best they could have is, in
+// stored units. For min, everything is flipped around so it's a max too.
+static const struct query_col *sort_q;
+static int sort_sign;
+
+static int64_t chunk_bound(uint32_t ci)
+{
+        const struct chunk_meta *c = &chunks[ci];
+        return sort_sign > 0 ? c->max[sort_q->col] : -c->min[sort_q->col];
+}
+
+static int cmp_bound(const void *a, const void *b)
+{
+        const int64_t x = chunk_bound(*(const uint32_t *)a);
+        const int64_t y = chunk_bound(*(const uint32_t *)b);
+
+        return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void answer(enum agg agg, const struct query_col *q, int state,
+                   uint32_t *cand, uint32_t n, struct answer *ans)
+{
+        static int64_t vals[CHUNK_ROWS], states[CHUNK_ROWS];
+        const int sign = agg == AGG_MIN ? -1 : 1;
+
+        memset(ans, 0, sizeof *ans);
+
+        // slope is never 0, and if it's negative the stored max is the
+        // real min
+        sort_q = q;
+        sort_sign = q->slope < 0 ? -sign : sign;
+        if (agg == AGG_MAX || agg == AGG_MIN)
+                qsort(cand, n, sizeof *cand, cmp_bound);
+
+        for (uint32_t i = 0; i < n; ++i) {
+                const struct chunk_meta *c = &chunks[cand[i]];
+
+                // in order of bound, so nothing from here on can win
+                if ((agg == AGG_MAX || agg == AGG_MIN) && ans->found
+                    && chunk_bound(cand[i]) <= sort_sign * ans->best)
+                        break;
+
+                // every row counts, no need to look
+                if (agg == AGG_COUNT
+                    && (state < 0 || c->states == 1 << state)) {
+                        ans->count += c->rows;
+                        continue;
+                }
+
+                ++chunks_read;
+                decode_col(c, q->col, vals);
+                if (state >= 0 && c->states != 1 << state)
+                        decode_col(c, COL_STATE, states);
+
+                for (uint32_t row = 0; row < c->rows; ++row) {
+                        const int64_t v = vals[row];
+
+                        if (state >= 0 && c->states != 1 << state
+                            && states[row] != state)
+                                continue;
+
+                        ++ans->count;
+                        ans->sum += v;
+                        if (!ans->found
+                            || sort_sign * v > sort_sign * ans->best) {
+                                ans->found = true;
+                                ans->best = v;
+                                ans->chunk = cand[i];
+                                ans->row = row;
+                        }
+                }
+        }
+}
+
+static void print_answer(enum agg agg, const struct query_col *q,
+                         const struct answer *ans, const char *what)
+{
+        static int64_t times[CHUNK_ROWS];
+
+        printf("%-36s ", what);
+        if (agg == AGG_COUNT) {
+                printf("%lu\n", ans->count);
+                return;
+        }
+        if (!ans->count) {
+                printf("no rows\n");
+                return;
+        }
+        if (agg == AGG_MEAN) {
+                printf("%.3f\n", ans->sum / ans->count * q->slope
+                       + q->offset);
+                return;
+        }
+
+        const struct chunk_meta *c = &chunks[ans->chunk];
+        printf("%.3f", ans->best * q->slope + q->offset);
+        if (runs[c->run].kind == KIND_LOG) {
+                decode_col(c, COL_TIME, times);
+                printf(" at %lld ms in %s", (long long)times[ans->row],
+                       runs[c->run].name);
+        } else {
+                printf(" in %s", runs[c->run].name);
+        }
+        printf("\n");
+}
+
+static int cmd_query(int argc, char **argv)
+{
+        static const char *const agg_names[] = {
+                [AGG_MAX] = "max",
+                [AGG_MIN] = "min",
+                [AGG_MEAN] = "mean",
+                [AGG_COUNT] = "count",
+        };
+        struct query_col q;
+        struct answer ans;
+        bool per_run = false;
+        int state = -1, agg = -1, fd;
+        struct stat st;
+        uint32_t *cand;
+        uint64_t start;
+        int i = 0;
+
+        for (; i < argc && argv[i][0] == '-'; ++i) {
+                if (strcmp(argv[i], "-r") == 0) {
+                        per_run = true;
+                } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        ++i;
+                        for (int s = SS_READY; s < SS_NUM_STATES; ++s)
+                                if (strcmp(argv[i], system_state_to_short_str(
+                                                   (enum system_state)s)) == 0)
+                                        state = s;
+                        if (state < 0)
+                                usage();
+                } else {
+                        usage();
+                }
+        }
+        if (argc - i != 2)
+                usage();
+        for (int a = AGG_MAX; a <= AGG_COUNT; ++a)
+                if (strcmp(argv[i], agg_names[a]) == 0)
+                        agg = a;
+        if (agg < 0 || !find_col(argv[i + 1], &q))
+                usage();
+
+        start = now_ns();
+        load_index();
+        if (!nchunks) {
+                fprintf(stderr, "nothing in %s\n", store_dir);
+                return 1;
+        }
+
+        fd = open(store_path("data"), O_RDONLY);
+        if (fd == -1 || fstat(fd, &st) == -1)
+                die(store_path("data"), errno);
+        data_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data_map == MAP_FAILED)
+                die("mmap", errno);
+
+        cand = malloc(nchunks * sizeof *cand);
+        if (!cand)
+                die("malloc", ENOMEM);
+
+        if (per_run) {
+                for (uint32_t r = 0; r < nruns; ++r) {
+                        uint32_t n = candidates(r, r + 1, &q, state, cand);
+
+                        if (runs[r].kind != q.kind)
+                                continue;
+                        answer((enum agg)agg, &q, state, cand, n, &ans);
+                        print_answer((enum agg)agg, &q, &ans, runs[r].name);
+                }
+        } else {
+                uint32_t n = candidates(0, nruns, &q, state, cand);
+                char what[64];
+
+                snprintf(what, sizeof what, "%s %s%s%s", agg_names[agg],
+                         q.name, state >= 0 ? " in " : "",
+                         state >= 0 ? system_state_to_short_str(
+                                 (enum system_state)state) : "");
+                answer((enum agg)agg, &q, state, cand, n, &ans);
+                print_answer((enum agg)agg, &q, &ans, what);
+        }
+
+        fprintf(stderr, "%lu of %u chunks read in %.2f ms\n", chunks_read,
+                nchunks, (now_ns() - start) / 1e6);
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        int i = 1;
+
+        if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+                store_dir = argv[i + 1];
+                i += 2;
+        }
+        if (i == argc)
+                usage();
+
+        if (strcmp(argv[i], "ingest") == 0)
+                return cmd_ingest(argc - i - 1, argv + i + 1);
+        if (strcmp(argv[i], "list") == 0 && i + 1 == argc)
+                return cmd_list();
+        if (strcmp(argv[i], "query") == 0)
+                return cmd_query(argc - i - 1, argv + i + 1);
+        usage();
+}
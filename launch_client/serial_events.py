@@ -0,0 +1,77 @@
+#!/usr/bin/env python
+#
+# print the launch server's diagnostics from its serial port. The arduino
+# doesn't print text anymore, it sends the same PT_EVENT packets the clients
+# get (see drain_events() in launch_server.ino), and this turns them back
+# into text.
+#
+#   ./serial_events.py [/dev/ttyACM0]
+#
+# Anything that isn't an event packet with a good CRC, e.g. whatever was in
+# flight when we opened the port, is skipped a byte at a time until we're
+# lined up with the packets again.
+
+from __future__ import print_function
+
+import os
+import struct
+import sys
+import termios
+import tty
+
+import elet_protocol
+
+# SERIAL_BAUD in launch_server.ino
+BAUD = 500000
+
+EVENT_LEN = struct.calcsize(elet_protocol.PACKETS[elet_protocol.PT_EVENT][1])
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, "B%d" % BAUD)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def events(fd):
+    """yield the fields of every event packet we read"""
+    buf = bytearray()
+    while True:
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            return
+        buf += chunk
+
+        while len(buf) >= elet_protocol.HEADER.size:
+            length, typ, _ = elet_protocol.HEADER.unpack_from(buf)
+            if typ != elet_protocol.PT_EVENT or length != EVENT_LEN:
+                del buf[0]
+                continue
+            if len(buf) < length:
+                break
+            if not elet_protocol.packet_crc_ok(buf):
+                del buf[0]
+                continue
+
+            name, pkt = elet_protocol.decode_packet(bytes(buf[:length]))
+            del buf[:length]
+            yield pkt
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "/dev/ttyACM0"
+    for ev in events(open_port(path)):
+        if ev["dropped"]:
+            print("(%d events lost)" % ev["dropped"])
+        print("%10.6f %s" % (ev["us"] / 1e6, elet_protocol.format_event(
+            ev["id"], ev["arg0"], ev["arg1"])))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
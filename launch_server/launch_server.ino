@@ -7,100 +7,905 @@ static unsigned long state_start_ms = 0;
 
 static uint32_t pkt_seq = 0;
 
+// identifies this boot of the arduino to clients, so a client that drops
+// can tell whether it's safe to resume. Never 0, that means "new session".
+static uint32_t session_token;
+
+// what the commander has to say to take command back from its own stale
+// socket. Only the commander is ever told it, unlike session_token, which
+// every observer gets too. Made up each time someone new takes command, 0
+// until then.
+static uint32_t commander_token;
+
 static struct data_packet data_pkt;
 
+// at least how many ms go by between data packets in each state, 0 for
+// every loop. Sitting in SS_READY is most of every run, and at the full
+// loop rate it's most of every log too, so it gets a lower rate than the
+// sequences. Set with REQ_CMD_RATE.
+static uint16_t data_interval_ms[SS_NUM_STATES] = {
+        100,    // SS_READY
+        0,      // SS_FIRE
+        0,      // SS_SAFING
+        0,      // SS_DEPRESS
+};
+
+// when the last data packet went out, and what it said about the valves
+// and the state. Any change to those goes out right away, whatever the
+// rate.
+static unsigned long last_data_ms = 0;
+static uint8_t last_vlv_states = 0;
+static uint8_t last_vlv_pwm_ox = 0;
+static uint8_t last_vlv_pwm_fuel = 0;
+static uint8_t last_state = 0;
+
+// packets we threw away because their CRC didn't check out. This goes out
+// in every data packet.
+static uint16_t crc_errors = 0;
+
+// the last few data packets we built. A client that drops and reconnects
+// gets the ones it missed resent, so there's no hole in the log. Data goes
+// out every loop, ~10 ms, while firing, so this covers ~320 ms of a cable
+// glitch mid-burn, and ~3 s in SS_READY. It's 1280 bytes of SRAM.
+#define BACKLOG_LEN 32
+
+static struct data_packet backlog[BACKLOG_LEN];
+static uint8_t backlog_next = 0;
+static uint8_t backlog_count = 0;
+
+// how often we look for new clients. server.available() costs a handful of
+// SPI transactions so we don't do it every loop, but a client that drops
+// mid-run has to be able to get back in quickly.
+#define ACCEPT_INTERVAL_MS 20
+
 // we read a packet in parts, since it might take some time to transmit, so
 // we record the partial packet here.
 struct rx_state {
-        uint8_t buf[sizeof (struct req_packet)];
+        uint8_t buf[max(sizeof (struct req_packet),
+                        sizeof (struct hello_packet))];
         size_t nread;
 };
 
-static struct rx_state rx_state;
+// Every connected client gets one of these. At most one client is the
+// commander, which may send PT_REQ packets; the rest are read-only observers
+// that just get telemetry. Each client reads its own partial packets. The
+// W5500 gives every socket its own TX buffer, and that is the per-client TX
+// queue: we only ever hand a socket a packet it has room for, so a slow or
+// wedged client loses samples instead of stalling the control loop.
+struct client_slot {
+        EthernetClient client;
+        struct rx_state rx;
 
-static void server_eth_setup()
+        // this slot has a live client in it
+        bool in_use;
+
+        // this client said hello, so it wants telemetry
+        bool said_hello;
+
+        // this client is allowed to send commands
+        bool commander;
+
+        // this client resumed and is still getting the data packets it
+        // missed, see resend_backlog(). Until it has all of them it gets
+        // no broadcasts, so its data stays in order.
+        bool catching_up;
+
+        // the timestamp of the newest data packet it has
+        uint32_t resend_ts;
+};
+
+// the W5500 always keeps one socket listening for new connections, so this
+// is as many clients as we can possibly have at once
+#define MAX_CLIENTS (MAX_SOCK_NUM - 1)
+
+static struct client_slot clients[MAX_CLIENTS];
+
+// diagnostics. Printing things as they happen stalls the whole loop as soon
+// as the 64 byte serial TX buffer fills, which at 9600 baud was ~40 ms a
+// line, right on state transitions. Instead log_event() drops an id and two
+// numbers in a ring, and drain_events() sends them out as PT_EVENT packets
+// whenever the serial port and the clients have room. The host turns them
+// into text, see `events` in protocol/protocol.py.
+#define SERIAL_BAUD 500000
+
+// a power of two that divides 256, so the free running uint8_t cursors
+// below wrap cleanly
+#define EVENT_RING_LEN 16
+
+struct event {
+        uint32_t us;
+        uint32_t arg1;
+        uint16_t arg0;
+        uint8_t id;
+};
+
+static struct event event_ring[EVENT_RING_LEN];
+static uint8_t event_wr = 0;
+
+// the serial port and the clients drain the ring at their own pace. If the
+// ring fills up, whichever is behind loses the oldest events.
+struct event_reader {
+        uint8_t rd;
+
+        // events lost since the last one we sent. Saturates.
+        uint8_t dropped;
+};
+
+static struct event_reader serial_events;
+static struct event_reader net_events;
+
+static void event_reader_make_room(struct event_reader *r)
+{
+        if ((uint8_t)(event_wr - r->rd) < EVENT_RING_LEN)
+                return;
+
+        ++r->rd;
+        if (r->dropped < 0xff)
+                ++r->dropped;
+}
+
+// log an event that happened at us, rather than now
+static void log_event_at(uint32_t us, enum event_id id, uint16_t arg0,
+                         uint32_t arg1)
+{
+        struct event *ev = &event_ring[event_wr % EVENT_RING_LEN];
+
+        event_reader_make_room(&serial_events);
+        event_reader_make_room(&net_events);
+
+        ev->us = us;
+        ev->id = id;
+        ev->arg0 = arg0;
+        ev->arg1 = arg1;
+        ++event_wr;
+}
+
+static void log_event(enum event_id id, uint16_t arg0, uint32_t arg1)
 {
-        byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED};
-        IPAddress ip((ELET_NET_ADDR & (0xffUL << 24)) >> 24,
-                     (ELET_NET_ADDR & (0xffUL << 16)) >> 16,
-                     (ELET_NET_ADDR & (0xffUL << 8)) >> 8,
-                      ELET_NET_ADDR & (0xffUL));
+        log_event_at(micros(), id, arg0, arg1);
+}
+
+// valve, igniter and state changes, as they happen, for transition
+// packets. Sequence steps change valves from the timer 5 ISR, so unlike the
+// event ring this one is only ever touched with interrupts off. Same
+// wrapping rules as EVENT_RING_LEN.
+#define TRANSITION_RING_LEN 16
+
+struct transition {
+        uint32_t us;
+        uint32_t arg;
+        uint8_t what;
+        uint8_t old_value;
+        uint8_t new_value;
+        uint8_t cause;
+        uint8_t state;
+};
+
+static struct transition transition_ring[TRANSITION_RING_LEN];
+static uint8_t transition_wr = 0;
+static uint8_t transition_rd = 0;
+
+// transitions lost since the last one sent. Saturates.
+static uint8_t transitions_dropped = 0;
+
+// the igniter isn't in valve_states, so we keep track of it ourselves
+static uint8_t igniter_on = 0;
+
+// interrupts must be off
+static void log_transition_locked(uint32_t us, uint8_t what,
+                                  uint8_t old_value, uint8_t new_value,
+                                  uint8_t cause, uint32_t arg)
+{
+        struct transition *t = &transition_ring[transition_wr
+                                                % TRANSITION_RING_LEN];
+
+        if ((uint8_t)(transition_wr - transition_rd) >= TRANSITION_RING_LEN) {
+                ++transition_rd;
+                if (transitions_dropped < 0xff)
+                        ++transitions_dropped;
+        }
+
+        t->us = us;
+        t->arg = arg;
+        t->what = what;
+        t->old_value = old_value;
+        t->new_value = new_value;
+        t->cause = cause;
+        t->state = sys_state;
+        ++transition_wr;
+}
+
+// log every valve that isn't where it was in before. Interrupts must be
+// off.
+static void log_valve_transitions_locked(const uint8_t *before, uint32_t us,
+                                         uint8_t cause, uint32_t arg)
+{
+        for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v))
+                if (valve_states[v] != before[v])
+                        log_transition_locked(us, v, before[v],
+                                              valve_states[v], cause, arg);
+}
+
+// the same, from loop()
+static void log_valve_transitions(const uint8_t *before, uint8_t cause,
+                                  uint32_t arg)
+{
+        const uint32_t us = micros();
+        uint8_t sreg = SREG;
+
+        cli();
+        log_valve_transitions_locked(before, us, cause, arg);
+        SREG = sreg;
+}
+
+// valve actions on a timer. Sequence steps used to happen whenever loop()
+// next noticed their time had come, so each one was late by however long
+// the loop was busy (a load cell read, a slow socket), and since each wait
+// started when the last step was noticed, the lateness piled up over a
+// sequence. Now a sequence arms its next valve action ahead of time with an
+// absolute micros() deadline, and a timer 5 compare match runs it right
+// then, whatever loop() is doing. loop() finds out afterwards.
+//
+// Nothing else here uses timer 5. Its PWM pins (44-46) are thermocouple
+// pins we only ever digitalWrite(), which is fine with TCCR5A cleared.
+
+// the igniter rides along in the valve bitmaps of an action
+#define IGNITER_BIT 0x80
+static_assert(!(ALL_VALVES & IGNITER_BIT), "the igniter bit is a valve");
+
+// an action that turns the igniter on turns it back off this much later,
+// from the ISR, so a busy loop() can't leave it on
+#define IGNITER_PULSE_US 100000UL
+
+// timer 5 runs at the CPU clock / 64: 4 us a tick at 16 MHz, the same as
+// micros()
+#define SCHED_US_PER_TICK (64 / (F_CPU / 1000000UL))
+
+// the furthest ahead we set the compare register, well short of the 16 bit
+// counter wrapping. A deadline further out takes a few matches to get to.
+#define SCHED_MAX_TICKS 0xf000
+
+static volatile struct {
+        // an action is waiting for its deadline
+        bool armed;
+
+        // the action after the one that ran is the end of an igniter pulse,
+        // which nobody waits on
+        bool igniter_off;
+
+        uint32_t deadline;
+        uint8_t open;
+        uint8_t close;
+
+        // flow control valves in open go to this instead of all the way
+        // open, unless it's 0
+        uint8_t pwm;
+
+        // the step of the running sequence this is
+        uint8_t step;
+
+        // an action ran at ran_at, and was due at ran_deadline. Cleared
+        // when loop() has had a look.
+        bool done;
+        uint32_t ran_at;
+        uint32_t ran_deadline;
+} sched;
+
+// interrupts are off for this one too, it's only ever run by
+// sched_run_if_due()
+static void run_action(uint8_t open, uint8_t close, uint8_t pwm)
+{
+        const uint8_t was_on = igniter_on;
+        uint8_t before[NR_VALVES];
+
+        memcpy(before, valve_states, sizeof before);
+
+        if (close & IGNITER_BIT) {
+                digitalWrite(sys_igniter.igniter_fire_ctl_be_careful, LOW);
+                igniter_on = 0;
+        }
+
+        if (pwm) {
+                for (enum valve v = FIRST_VALVE; v < NR_VALVES;
+                     v = next_valve(v)) {
+                        if (!valve_is_flow_P(v) || !(open & VALVE_BIT(v)))
+                                continue;
+
+                        open_valve_to(v, pwm);
+                        open &= ~VALVE_BIT(v);
+                }
+        }
+
+        set_valves(open & ALL_VALVES, close & ALL_VALVES);
+        const uint32_t us = micros();
+
+        if (open & IGNITER_BIT) {
+                digitalWrite(sys_igniter.igniter_fire_ctl_be_careful, HIGH);
+                igniter_on = 1;
+        }
+
+        log_valve_transitions_locked(before, us, CAUSE_SEQUENCE, sched.step);
+        if (igniter_on != was_on)
+                log_transition_locked(us, TR_IGNITER, was_on, igniter_on,
+                                      CAUSE_SEQUENCE, sched.step);
+}
+
+// interrupts have to be off for this and the next one: OCR5A and TCNT5 are
+// 16 bit registers, and the ISR uses them too
+static void sched_set_compare(uint32_t us)
+{
+        uint32_t ticks = us / SCHED_US_PER_TICK;
+
+        if (ticks > SCHED_MAX_TICKS)
+                ticks = SCHED_MAX_TICKS;
+
+        // a match on the count we're at, or the next one, might be gone by
+        // the time OCR5A is written, and then we'd wait for the counter to
+        // come all the way around
+        if (ticks < 2)
+                ticks = 2;
+
+        OCR5A = TCNT5 + ticks;
+        TIFR5 = _BV(OCF5A);
+        TIMSK5 |= _BV(OCIE5A);
+}
+
+// run the armed action if it's due, or set up the timer to come back when
+// it will be
+static void sched_run_if_due()
+{
+        const uint32_t now = micros();
+        const int32_t left = sched.deadline - now;
+
+        // timer 5 and micros() tick at the same rate but not in step, so
+        // anything within a tick is due
+        if (left >= (int32_t)SCHED_US_PER_TICK) {
+                sched_set_compare(left);
+                return;
+        }
+
+        run_action(sched.open, sched.close, sched.pwm);
+
+        if (!sched.igniter_off) {
+                sched.ran_at = now;
+                sched.ran_deadline = sched.deadline;
+                sched.done = true;
+        }
+
+        if (sched.open & IGNITER_BIT) {
+                sched.open = 0;
+                sched.close = IGNITER_BIT;
+                sched.pwm = 0;
+                sched.igniter_off = true;
+                sched.deadline += IGNITER_PULSE_US;
+                sched_set_compare(sched.deadline - now);
+                return;
+        }
+
+        TIMSK5 &= ~_BV(OCIE5A);
+        sched.armed = false;
+}
+
+ISR(TIMER5_COMPA_vect)
+{
+        if (sched.armed)
+                sched_run_if_due();
+        else
+                TIMSK5 &= ~_BV(OCIE5A);
+}
+
+static void sched_setup()
+{
+        // normal mode, CPU clock / 64
+        TCCR5A = 0;
+        TCCR5B = _BV(CS51) | _BV(CS50);
+        TIMSK5 = 0;
+}
 
-        Ethernet.begin(mac, ip);
+// run an action at deadline (a micros() time). If that's now or already
+// gone, it runs before this returns. Only one action is armed at a time.
+// step is the sequence step it's for.
+static void sched_arm(uint32_t deadline, uint8_t open, uint8_t close,
+                      uint8_t pwm, uint8_t step)
+{
+        uint8_t sreg = SREG;
+        cli();
+        sched.deadline = deadline;
+        sched.open = open;
+        sched.close = close;
+        sched.pwm = pwm;
+        sched.step = step;
+        sched.igniter_off = false;
+        sched.done = false;
+        sched.armed = true;
+        sched_run_if_due();
+        SREG = sreg;
+}
+
+// forget the armed action, if there is one. This never leaves the igniter
+// on, since the end of its pulse might be what was armed. cause and arg
+// are why, for the transition packets.
+static void sched_cancel(uint8_t cause, uint32_t arg)
+{
+        uint8_t sreg = SREG;
+        cli();
+        TIMSK5 &= ~_BV(OCIE5A);
+        sched.armed = false;
+        sched.done = false;
+
+        digitalWrite(sys_igniter.igniter_fire_ctl_be_careful, LOW);
+        if (igniter_on) {
+                igniter_on = 0;
+                log_transition_locked(micros(), TR_IGNITER, 1, 0, cause, arg);
+        }
+        SREG = sreg;
+}
+
+static void server_eth_setup()
+{
+        eth_setup();
         server.begin();
 }
 
-static void reset_rx_state()
+static void reset_rx_state(struct rx_state *rx)
 {
-        rx_state.nread = 0;
+        rx->nread = 0;
+}
+
+// an unconnected analog pin is noisy, and micros() varies a little from
+// boot to boot and a lot between clients, so together they're different
+// every time. Never 0.
+static uint32_t new_token()
+{
+        uint32_t t = ((uint32_t)analogRead(0) << 20) ^ micros();
+
+        return t ? t : 1;
 }
 
 void setup()
 {
-        Serial.begin(9600);
+        Serial.begin(SERIAL_BAUD);
 
         server_eth_setup();
         setup_all_valves();
         setup_igniter();
-        reset_rx_state();
+        sched_setup();
 
         memset(&data_pkt, 0, sizeof data_pkt);
         data_pkt.header.len = sizeof data_pkt;
         data_pkt.header.type = PT_DATA;
 
-        Serial.println("#################################################################");
-        Serial.println("######################### LAUNCH SERVER #########################");
-        Serial.println("#################################################################");
+        session_token = new_token();
 
-        // XXX: what do we do when we don't want a serial console?
+        log_event(EV_BOOT, 0, session_token);
 }
 
 // I don't really know what to do when the client dies, but we're gonna call
 // this function.
 static void
-handle_dead_client(EthernetClient *client)
+handle_dead_client(struct client_slot *slot)
 {
-        Serial.println("handling dead client");
-        
+        log_event(EV_CLIENT_DEAD, slot->client.getSocketNumber(), 0);
+
         // XXX: do we want to call stop if the client is dead?
-        client->flush();
-        client->stop();
-        reset_rx_state();
-        pkt_seq = 0;
+        slot->client.flush();
+        slot->client.stop();
+        reset_rx_state(&slot->rx);
+
+        // we don't reset pkt_seq here: if this was the commander, it will
+        // probably be back shortly and resume the session, and it needs the
+        // seq to keep going from where it was.
+        slot->in_use = false;
+        slot->said_hello = false;
+        slot->commander = false;
+        slot->catching_up = false;
+}
+
+static struct client_slot *find_commander()
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].in_use && clients[i].commander)
+                        return &clients[i];
+        return NULL;
+}
+
+// how long the parts of loop() take, see stats_packet. The clients get
+// what we have every STATS_INTERVAL_MS, and then it starts over.
+#define STATS_INTERVAL_MS 1000
+
+struct section_stats {
+        uint32_t count;
+        uint32_t min_us;
+        uint32_t max_us;
+        uint32_t sum_us;
+        uint16_t hist[STATS_NR_BINS];
+};
+
+static struct section_stats loop_stats[NR_LOOP_SECTIONS];
+
+// section s ran from start (a micros() time) until now
+static void record_time(enum loop_section s, uint32_t start)
+{
+        const uint32_t us = micros() - start;
+        struct section_stats *st = &loop_stats[s];
+        uint8_t bin = 0;
+
+        if (st->count == 0 || us < st->min_us)
+                st->min_us = us;
+        if (us > st->max_us)
+                st->max_us = us;
+        st->sum_us += us;
+        ++st->count;
+
+        for (uint32_t edge = 64; bin < STATS_NR_BINS - 1 && us >= edge;
+             edge <<= 2)
+                ++bin;
+        if (st->hist[bin] < 0xffff)
+                ++st->hist[bin];
+}
+
+// returns whether the packet went out
+static bool send_packet(struct client_slot *slot, const void *pkt,
+                        unsigned len)
+{
+        const uint32_t start = micros();
+        EthernetClient *client = &slot->client;
+
+        // if this client isn't keeping up and its socket's TX buffer is
+        // full, writing now would block the whole loop until it drains, so
+        // eth_try_write() drops this packet for this client only. If we
+        // failed to transmit an entire packet, the client died. Try to do
+        // something sensible.
+        int ret = eth_try_write(client, pkt, len);
+        if (ret == -1) {
+                log_event(EV_SHORT_WRITE, client->getSocketNumber(), len);
+                handle_dead_client(slot);
+        }
+
+        record_time(LS_SEND, start);
+        return ret > 0;
+}
+
+// what we've broadcast this loop that hasn't gone out yet. Every write to a
+// socket is its own SPI burst and SEND command, plus a TX free size check,
+// whatever its size, so everything a loop broadcasts goes to each client in
+// one write at the end of it. A client that's behind loses the whole loop's
+// worth instead of some of it.
+//
+// send_message() builds its packets in here too, so they don't go on the
+// stack, which is why it's as big as one.
+#define TX_BATCH_LEN sizeof(struct message_packet)
+
+alignas(struct message_packet) static uint8_t tx_batch[TX_BATCH_LEN];
+static uint16_t tx_batch_len = 0;
+
+static void flush_broadcasts()
+{
+        if (tx_batch_len == 0)
+                return;
+
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].in_use && clients[i].said_hello
+                    && !clients[i].catching_up)
+                        send_packet(&clients[i], tx_batch, tx_batch_len);
+        tx_batch_len = 0;
+}
+
+// send the same packet to every client that has said hello, at the end of
+// the loop at the latest
+static void broadcast_packet(const void *pkt, unsigned len)
+{
+        if (tx_batch_len + len > sizeof tx_batch)
+                flush_broadcasts();
+
+        memcpy(tx_batch + tx_batch_len, pkt, len);
+        tx_batch_len += len;
+}
+
+// id is one of the MSG_* messages, which the client knows the text of.
+// text is a string in flash, i.e. F("..."), that goes after it, or NULL.
+// The packet is only as long as the text, so the MSG_* ones are 17 bytes.
+static void send_message(struct client_slot *slot, enum message id,
+                         const __FlashStringHelper *text)
+{
+        struct message_packet *mpkt = (struct message_packet *)tx_batch;
+        size_t n = 0;
+
+        // whatever's been broadcast so far was first, so it goes first
+        flush_broadcasts();
+
+        if (text) {
+                strncpy_P((char *)mpkt->text, (const char *)text,
+                          sizeof mpkt->text);
+                n = strnlen((const char *)mpkt->text, sizeof mpkt->text);
+        }
+
+        memset(&mpkt->header, 0, sizeof mpkt->header);
+        mpkt->header.len = MESSAGE_PACKET_MIN_LEN + n;
+        mpkt->header.type = PT_MESSAGE;
+        mpkt->header.seq = pkt_seq;
+        mpkt->header.timestamp = millis();
+        mpkt->id = id;
+        elet_seal_packet(&mpkt->header);
+
+        send_packet(slot, mpkt, mpkt->header.len);
+}
+
+static bool anyone_listening()
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].in_use && clients[i].said_hello)
+                        return true;
+        return false;
+}
 
-        Serial.println("finished handling dead client");
+// build the packet for the oldest event r hasn't sent yet, and move r past
+// it
+static void next_event_packet(struct event_reader *r,
+                              struct event_packet *epkt)
+{
+        const struct event *ev = &event_ring[r->rd % EVENT_RING_LEN];
+
+        memset(&epkt->header, 0, sizeof epkt->header);
+        epkt->header.len = sizeof *epkt;
+        epkt->header.type = PT_EVENT;
+        epkt->header.seq = pkt_seq;
+        epkt->header.timestamp = millis();
+        epkt->us = ev->us;
+        epkt->id = ev->id;
+        epkt->dropped = r->dropped;
+        epkt->arg0 = ev->arg0;
+        epkt->arg1 = ev->arg1;
+        elet_seal_packet(&epkt->header);
+
+        ++r->rd;
+        r->dropped = 0;
 }
 
+static unsigned long last_stats_ms = 0;
+
+// send the clients a stats packet for every section that ran since the last
+// time, and start over
+static void send_stats()
+{
+        struct stats_packet spkt;
+
+        if (millis() - last_stats_ms < STATS_INTERVAL_MS)
+                return;
+        last_stats_ms = millis();
+
+        for (uint8_t s = FIRST_LOOP_SECTION; s < NR_LOOP_SECTIONS; ++s) {
+                const struct section_stats *st = &loop_stats[s];
+
+                if (st->count == 0)
+                        continue;
+
+                memset(&spkt, 0, sizeof spkt);
+                spkt.header.len = sizeof spkt;
+                spkt.header.type = PT_STATS;
+                spkt.header.seq = pkt_seq;
+                spkt.header.timestamp = millis();
+                spkt.section = s;
+                spkt.count = st->count;
+                spkt.min_us = st->min_us;
+                spkt.max_us = st->max_us;
+                spkt.sum_us = st->sum_us;
+                memcpy(spkt.hist, st->hist, sizeof spkt.hist);
+                elet_seal_packet(&spkt.header);
+
+                broadcast_packet(&spkt, sizeof spkt);
+        }
+
+        memset(loop_stats, 0, sizeof loop_stats);
+}
+
+// send out as many logged events as we can without blocking. The serial
+// port gets exactly the packets the clients get.
+static void drain_events()
+{
+        struct event_packet epkt;
+
+        while (serial_events.rd != event_wr
+               && Serial.availableForWrite() >= (int)sizeof epkt) {
+                next_event_packet(&serial_events, &epkt);
+                Serial.write((const uint8_t *)&epkt, sizeof epkt);
+        }
+
+        // hang on to events until someone is around to hear them, so e.g.
+        // the boot event makes it to the first client. A client that's
+        // behind just drops these like any other packet, see send_packet().
+        if (!anyone_listening())
+                return;
+
+        while (net_events.rd != event_wr) {
+                next_event_packet(&net_events, &epkt);
+                broadcast_packet(&epkt, sizeof epkt);
+        }
+}
+
+// send out logged transitions, oldest first. These only go to clients.
+// Like events, they wait for someone to be listening.
+static void drain_transitions()
+{
+        struct transition_packet tpkt;
+        struct transition t;
+
+        if (!anyone_listening())
+                return;
+
+        memset(&tpkt, 0, sizeof tpkt);
+        tpkt.header.len = sizeof tpkt;
+        tpkt.header.type = PT_TRANSITION;
+
+        for (;;) {
+                uint8_t sreg = SREG;
+                cli();
+                if (transition_rd == transition_wr) {
+                        SREG = sreg;
+                        break;
+                }
+                t = transition_ring[transition_rd++ % TRANSITION_RING_LEN];
+                tpkt.dropped = transitions_dropped;
+                transitions_dropped = 0;
+                SREG = sreg;
+
+                tpkt.header.seq = pkt_seq;
+                tpkt.header.timestamp = millis();
+                tpkt.us = t.us;
+                tpkt.what = t.what;
+                tpkt.old_value = t.old_value;
+                tpkt.new_value = t.new_value;
+                tpkt.cause = t.cause;
+                tpkt.state = t.state;
+                tpkt.arg = t.arg;
+                elet_seal_packet(&tpkt.header);
+
+                broadcast_packet(&tpkt, sizeof tpkt);
+        }
+}
+
+
+// the step each sequence is at. Only the one for sys_state means anything.
+static int fire_state = 0;
+static int safing_state = 0;
+static int depress_state = 0;
+
+// when the last step of the running sequence was due. The wait before each
+// step is from there, not from when the last step actually ran.
+static uint32_t seq_base;
+
+// how much sooner than its fixed waits the running sequence is finishing,
+// see seq_step_until_empty()
+static uint32_t seq_saved_ms;
+
+// cause and arg are what made it change, see transition_packet
 static void
-update_sys_state(enum system_state ss)
+update_sys_state(enum system_state ss, uint8_t cause, uint32_t arg)
 {
+        uint8_t sreg = SREG;
+
+        log_event(EV_STATE, sys_state, ss);
+
+        cli();
+        log_transition_locked(micros(), TR_STATE, sys_state, ss, cause, arg);
+        SREG = sreg;
+
+        // whatever sequence we were in is over, even if it didn't finish
+        sched_cancel(cause, arg);
+        fire_state = 0;
+        safing_state = 0;
+        depress_state = 0;
+        seq_base = micros();
+        seq_saved_ms = 0;
+
         sys_state = ss;
         state_start_ms = millis();
+}
 
-        Serial.print("updating system state to ");
-        Serial.println(sys_state);
+static uint8_t current_seq_step()
+{
+        switch (sys_state) {
+        case SS_FIRE:
+                return fire_state;
+        case SS_SAFING:
+                return safing_state;
+        case SS_DEPRESS:
+                return depress_state;
+        default:
+                return 0;
+        }
 }
 
-static void send_packet(EthernetClient *client, const void *_pkt, unsigned len)
+static enum event_id current_step_event()
 {
-        unsigned sent = 0;
-        unsigned remaining = len;
-        const uint8_t *pkt = (const uint8_t *)_pkt;
+        switch (sys_state) {
+        case SS_FIRE:
+                return EV_FIRE_STEP;
+        case SS_SAFING:
+                return EV_SAFING_STEP;
+        default:
+                return EV_DEPRESS_STEP;
+        }
+}
 
-        while (remaining != 0) {
-                unsigned ret = client->write(pkt + sent, remaining);
-                remaining -= ret;
-                sent += ret;
+// the current step of a sequence: open the valves in open and close the
+// ones in close, after_ms after the last step was due. Arms the action the
+// first time through, and returns true once it has run, logging how late
+// it was.
+static bool seq_step(uint32_t after_ms, uint8_t open, uint8_t close,
+                     uint8_t pwm)
+{
+        if (!sched.armed && !sched.done)
+                sched_arm(seq_base + after_ms * 1000UL, open, close, pwm,
+                          current_seq_step());
+
+        if (!sched.done)
+                return false;
+
+        sched.done = false;
+        seq_base = sched.ran_deadline;
+        log_event_at(sched.ran_at, current_step_event(), current_seq_step(),
+                     sched.ran_at - sched.ran_deadline);
+        return true;
+}
+
+// the bleed down steps of safing and depress wait a fixed time for a tank to
+// empty, but once its pressure has read under SEQ_EMPTY_PSI for
+// SEQ_SETTLE_MS straight it's as empty as it's going to get. The
+// calibration puts 0 psi at ~208 counts with ~1.19 psi a count, and a
+// sensor at rest wanders a couple of counts either way (the logs have them
+// as low as ~198), so this has to be a few counts clear of zero.
+#define SEQ_EMPTY_PSI 5
+#define SEQ_SETTLE_MS 2000
+
+// psi in raw counts, for a pressure sensor's calibration. A recalibration
+// moves the counts, not the pressure.
+#define PSI_COUNTS(cal, psi) \
+        ((uint16_t)(((psi) - ELET_CAL_##cal##_OFFSET) \
+                    / ELET_CAL_##cal##_SLOPE + 0.5))
+
+static const uint16_t seq_empty_counts[NR_PSENSORS] ELET_PROGMEM = {
+        [PS_OXYGEN] = PSI_COUNTS(PS_OXYGEN, SEQ_EMPTY_PSI),
+        [PS_FUEL] = PSI_COUNTS(PS_FUEL, SEQ_EMPTY_PSI),
+};
+
+// when the pressure first read empty, and 0 while it isn't
+static unsigned long seq_empty_since;
+
+// seq_step(), but done early once the pressure on ps has settled under
+// SEQ_EMPTY_PSI. after_ms is the longest we'll wait.
+static bool seq_step_until_empty(uint32_t after_ms, enum pressure_sensor ps,
+                                 uint8_t open, uint8_t close, uint8_t pwm)
+{
+        if (!sched.armed && !sched.done) {
+                sched_arm(seq_base + after_ms * 1000UL, open, close, pwm,
+                          current_seq_step());
+                seq_empty_since = 0;
         }
 
-        // oops, we failed to transmit an entire packet because the client
-        // died. Try to do something sensible.
-        if (remaining != 0) {
-                Serial.println("Failed to send entire packet");
-                handle_dead_client(client);
+        if (sched.armed) {
+                unsigned long now = millis();
+
+                if (data_pkt.pressures[ps]
+                    >= elet_read_table_u16(&seq_empty_counts[ps])) {
+                        seq_empty_since = 0;
+                } else if (!seq_empty_since) {
+                        // 0 means not empty, so don't start at 0
+                        seq_empty_since = now | 1;
+                } else if (now - seq_empty_since >= SEQ_SETTLE_MS) {
+                        // run it now instead, and the steps after it
+                        // follow on from here
+                        uint32_t bound = seq_base + after_ms * 1000UL;
+                        uint32_t us = micros();
+
+                        sched_arm(us, open, close, pwm, current_seq_step());
+                        if ((int32_t)(bound - us) > 0)
+                                seq_saved_ms += (bound - us) / 1000;
+                }
         }
-}
 
+        return seq_step(after_ms, open, close, pwm);
+}
 
 // close n2 on off
 // close fuel on off
@@ -110,7 +915,7 @@ static void send_packet(EthernetClient *client, const void *_pkt, unsigned len)
 // close ox on off
 // close ox flow
 //
-// wait 1 seconds
+// wait 1 second
 // open ox bleed
 //
 // wait 3 seconds
@@ -119,65 +924,69 @@ static void send_packet(EthernetClient *client, const void *_pkt, unsigned len)
 // wait 7 seconds
 // close ox bleed
 // close fuel flow
-static void continue_safing(unsigned long time)
-{
-        static unsigned long state_start = 0;
-        static int safing_state = 0;
 
-        unsigned long time_this_state = state_start == 0 ? time
-                : time - state_start;
+// step 0. n2 on/off and purge are on the same port, so the purge opens in
+// the very same write that closes the feed
+#define SAFING_STEP0_OPEN VALVE_BIT(N2_PURGE)
+#define SAFING_STEP0_CLOSE (VALVE_BIT(N2_ON_OFF) | VALVE_BIT(FUEL_FLOW))
 
+static void continue_safing()
+{
         switch (safing_state) {
         case 0:
-                close_valve(N2_ON_OFF);
-                close_valve(FUEL_FLOW);
-                open_valve(N2_PURGE);
+                if (!seq_step(0, SAFING_STEP0_OPEN, SAFING_STEP0_CLOSE, 0))
+                        return;
                 goto out_next_safing_state;
 
         case 1:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, 0, VALVE_BIT(OX_ON_OFF)
+                              | VALVE_BIT(OX_FLOW), 0))
                         return;
-                close_valve(OX_ON_OFF);
-                close_valve(OX_FLOW);
                 goto out_next_safing_state;
 
         case 2:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, VALVE_BIT(OX_BLEED), 0, 0))
                         return;
-                open_valve(OX_BLEED);
                 goto out_next_safing_state;
 
         case 3:
-                if (time_this_state < 3000)
+                if (!seq_step(3000, 0, VALVE_BIT(N2_PURGE), 0))
                         return;
-                close_valve(N2_PURGE);
                 goto out_next_safing_state;
 
+        // or sooner, once the ox tank has bled down
         case 4:
-                if (time_this_state < 7000)
+                if (!seq_step_until_empty(7000, PS_OXYGEN, 0,
+                                          VALVE_BIT(OX_BLEED)
+                                          | VALVE_BIT(FUEL_FLOW), 0))
                         return;
-                close_valve(OX_BLEED);
-                close_valve(FUEL_FLOW);
+                log_event(EV_SEQ_SAVED, SS_SAFING, seq_saved_ms);
                 goto out_end_state;
 
         default:
-                Serial.println("got weird safing_state");
+                log_event(EV_BAD_STEP, SS_SAFING, safing_state);
                 goto out_end_state;
         }
 
 out_next_safing_state:
         ++safing_state;
-        state_start = time;
         return;
         
 out_end_state:
-        state_start = 0;
-        safing_state = 0;
-        update_sys_state(SS_READY);
+        update_sys_state(SS_READY, CAUSE_SEQUENCE, safing_state);
 }
 
 static unsigned long fire_timeout;
 
+// how far open the flow valves are while the lines fill, before the
+// igniter fires and they go all the way
+static uint8_t fire_ox_pwm = 119;
+static uint8_t fire_fuel_pwm = 110;
+
+// the step where the engine is burning: the igniter has fired and the flow
+// valves are all the way open
+#define FIRE_BURN_STEP 9
+
 // test igniter
 //
 // open n2 on off
@@ -201,26 +1010,25 @@ static unsigned long fire_timeout;
 // wait 1 second
 // fire igniter
 //
-// wait 1 second
+// wait 200 ms
 // test success
 // open ox flow
 // open fuel flow
-static void continue_fire(unsigned long time)
+//
+// wait for the burn time, then safing step 0
+static void continue_fire()
 {
-        static unsigned long state_start = 0;
-        static int fire_state = 0;
         enum system_state next_state = SS_NUM_STATES;
         int continuity;
 
-        unsigned long time_this_state = state_start == 0 ? time
-                : time - state_start;
+        uint8_t before[NR_VALVES];
 
         switch (fire_state) {
         // step 0: close all valves, test the igniter
         case 0:
-                for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v))
-                        if (valve_states[v] != 0)
-                                close_valve(v);
+                memcpy(before, valve_states, sizeof before);
+                set_valves(0, ALL_VALVES);
+                log_valve_transitions(before, CAUSE_SEQUENCE, 0);
 
                 // test the ignition sensor to make sure its present
                 /*
@@ -233,68 +1041,65 @@ static void continue_fire(unsigned long time)
                 */
 
                 continuity = igniter_test_continuity();
+                log_event(EV_CONTINUITY, 0, continuity);
 
                 if (continuity == 0) {
                         last_ign_status = IGN_FAIL_BAD_IGNITER;
+                        log_event(EV_IGNITION, last_ign_status, 0);
                         next_state = SS_READY;
                         goto out_end_state;
                 }
-                break;
+
+                // the continuity test takes a while, time the rest from
+                // when it's done. Step 1 is right away, so go straight on
+                // to it instead of waiting for the next loop.
+                seq_base = micros();
+                ++fire_state;
+                // fall through
 
         case 1:
-                open_valve(N2_ON_OFF);
+                if (!seq_step(0, VALVE_BIT(N2_ON_OFF), 0, 0))
+                        return;
                 break;
                 
         case 2:
-                if (time_this_state < 5000)
+                if (!seq_step(5000, VALVE_BIT(OX_FLOW) | VALVE_BIT(N2_PURGE),
+                              0, fire_ox_pwm))
                         return;
-
-                open_valve_to(OX_FLOW, 119);
-                open_valve(N2_PURGE);
                 break;
 
         case 3:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, VALVE_BIT(OX_ON_OFF), 0, 0))
                         return;
-
-                open_valve(OX_ON_OFF);
                 break;
 
         case 4:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, VALVE_BIT(FUEL_ON_OFF), 0, 0))
                         return;
-
-                open_valve(FUEL_ON_OFF);
                 break;
 
         case 5:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, VALVE_BIT(FUEL_FLOW), 0, fire_fuel_pwm))
                         return;
-
-                open_valve_to(FUEL_FLOW, 110);
                 break;
 
         case 6:
-                if (time_this_state < 1000)
+                if (!seq_step(1000, 0, VALVE_BIT(N2_PURGE), 0))
                         return;
-
-                close_valve(N2_PURGE);
+                break;
 
         case 7:
-                if (time_this_state < 1000)
+                // fire the igniter. The timer turns it back off after
+                // IGNITER_PULSE_US
+                if (!seq_step(1000, IGNITER_BIT, 0, 0))
                         return;
-
-                // fire the igniter. Don't give up the CPU here because
-                // we really want to turn this off quickly
-                digitalWrite(sys_igniter.igniter_fire_ctl_be_careful, HIGH);
-                delay(100);
-                digitalWrite(sys_igniter.igniter_fire_ctl_be_careful, LOW);
                 break;
 
         case 8:
                 // "it doesn't have to be precise, it's all bullshit anyways"
                 // - Mike Chaffee, our lord and savior Jeezaus
-                if (time_this_state < 200)
+                if (!seq_step(200, VALVE_BIT(OX_FLOW) | VALVE_BIT(FUEL_FLOW),
+                              0, 0))
                         return;
 
                 /*
@@ -313,106 +1118,228 @@ static void continue_fire(unsigned long time)
                 }
                 */
 
-                open_valve(OX_FLOW);
-                open_valve(FUEL_FLOW);
                 last_ign_status = IGN_SUCCESS;
+                log_event(EV_IGNITION, last_ign_status, 0);
                 goto out_next_fire_state;
 
-        case 9:
-                if (time_this_state < fire_timeout)
+        case FIRE_BURN_STEP:
+                // the burn ends on the timer too: its last step is safing's
+                // first, and safing picks up after it
+                if (!seq_step(fire_timeout, SAFING_STEP0_OPEN,
+                              SAFING_STEP0_CLOSE, 0))
                         return;
-                next_state = SS_SAFING;
-                goto out_end_state;
+                goto out_safing;
 
         default:
-                Serial.println("got weird fire_state");
+                log_event(EV_BAD_STEP, SS_FIRE, fire_state);
                 goto out_end_state;
         }
 
 out_next_fire_state:
         ++fire_state;
-        state_start = time;
         return;
         
 out_end_state:
-        state_start = 0;
-        fire_state = 0;
-        update_sys_state(next_state);
+        update_sys_state(next_state, CAUSE_SEQUENCE, fire_state);
+        return;
+
+out_safing:
+        uint32_t burn_end = seq_base;
+        update_sys_state(SS_SAFING, CAUSE_SEQUENCE, fire_state);
+        safing_state = 1;
+        seq_base = burn_end;
 }
 
 static unsigned long depress_timeout;
 
-static void continue_depress(unsigned long time)
+static void continue_depress()
 {
-        static unsigned long state_start = 0;
-        static int depress_state = 0;
-
-        unsigned long time_this_state = state_start == 0 ? time
-                : time - state_start;
-
         switch (depress_state) {
         // step 0: open the fuel system
         case 0:
-                open_valve(N2_ON_OFF);
-                open_valve(FUEL_ON_OFF);
-                open_valve(FUEL_FLOW);
+                if (!seq_step(0, VALVE_BIT(N2_ON_OFF) | VALVE_BIT(FUEL_ON_OFF)
+                              | VALVE_BIT(FUEL_FLOW), 0, 0))
+                        return;
                 goto out_next_depress_state;
 
         // step 1: stop the nitrogen feed system after the specified timeout
         case 1:
-                if (time_this_state < depress_timeout)
+                if (!seq_step(depress_timeout, 0, VALVE_BIT(N2_ON_OFF), 0))
                         return;
-
-                close_valve(N2_ON_OFF);
                 goto out_next_depress_state;
 
-        // step 2: keep the fuel valves open for 30 seconds, then close then
-        // and start a nitrogen purge
+        // step 2: keep the fuel valves open for 30 seconds, or until the
+        // fuel tank has bled down, then close them and start a nitrogen
+        // purge
         case 2:
-                if (time_this_state < 30000)
+                if (!seq_step_until_empty(30000, PS_FUEL, VALVE_BIT(N2_PURGE),
+                                          VALVE_BIT(FUEL_ON_OFF)
+                                          | VALVE_BIT(FUEL_FLOW), 0))
                         return;
-
-                close_valve(FUEL_ON_OFF);
-                close_valve(FUEL_FLOW);
-                open_valve(N2_PURGE);
                 goto out_next_depress_state;
 
         // step 3: end the nitrogen purge after 5 seconds.
         case 3:
-                if (time_this_state < 5000)
+                if (!seq_step(5000, 0, VALVE_BIT(N2_PURGE), 0))
                         return;
-
-                close_valve(N2_PURGE);
+                log_event(EV_SEQ_SAVED, SS_DEPRESS, seq_saved_ms);
                 goto out_end_state;
         }
 
 out_next_depress_state:
         ++depress_state;
-        state_start = time;
         return;
         
 out_end_state:
-        state_start = 0;
-        depress_state = 0;
-        update_sys_state(SS_READY);
+        update_sys_state(SS_READY, CAUSE_SEQUENCE, depress_state);
+}
+
+// redlines: things that mean the burn has to stop right now. While firing,
+// every loop checks each rule against the readings gather_all_data() just
+// took. A rule has to hold for `debounce` readings in a row before it trips,
+// so one noisy sample doesn't end a burn. A tripped rule logs EV_REDLINE and
+// goes straight to SS_SAFING, whose first step runs later in the same loop.
+enum redline_kind {
+        RK_OVER,
+        RK_UNDER,
+
+        // the reading hasn't changed in `threshold` readings. A live
+        // sensor always has a bit of noise on it.
+        RK_STUCK,
+};
+
+// what a rule looks at, see redline_reading()
+enum redline_reading {
+        RR_OX,
+        RR_FUEL,
+        RR_THRUST,
+};
+
+struct redline_rule {
+        uint8_t kind;
+        uint8_t reading;
+
+        // only check this once the engine is burning, e.g. there's no
+        // thrust to speak of before that
+        bool burning_only;
+        uint8_t debounce;
+
+        // a raw reading, or for RK_STUCK a number of readings. 0 turns the
+        // rule off. REQ_CMD_REDLINE sets these.
+        uint32_t threshold;
+
+        // readings in a row the rule has held for, and for RK_STUCK the
+        // reading it's stuck at
+        uint8_t hits;
+        uint32_t last;
+};
+
+// the over pressure limit, converted to counts with the calibration like
+// SEQ_EMPTY_PSI. The under pressure and low thrust limits depend on the
+// engine and the load cell's zero, so those start off.
+#define REDLINE_OVER_PSI 875
+
+static struct redline_rule redline_rules[NR_REDLINES] = {
+        [RL_OX_OVER] = {RK_OVER, RR_OX, false, 3,
+                        PSI_COUNTS(PS_OXYGEN, REDLINE_OVER_PSI), 0, 0},
+        [RL_FUEL_OVER] = {RK_OVER, RR_FUEL, false, 3,
+                          PSI_COUNTS(PS_FUEL, REDLINE_OVER_PSI), 0, 0},
+        [RL_OX_UNDER] = {RK_UNDER, RR_OX, true, 10, 0, 0, 0},
+        [RL_FUEL_UNDER] = {RK_UNDER, RR_FUEL, true, 10, 0, 0, 0},
+        [RL_THRUST_LOW] = {RK_UNDER, RR_THRUST, true, 20, 0, 0, 0},
+        // ~1 second of loops
+        [RL_OX_STUCK] = {RK_STUCK, RR_OX, true, 0, 100, 0, 0},
+        [RL_FUEL_STUCK] = {RK_STUCK, RR_FUEL, true, 0, 100, 0, 0},
+        [RL_THRUST_STUCK] = {RK_STUCK, RR_THRUST, true, 0, 100, 0, 0},
+};
+
+static uint32_t redline_reading(uint8_t reading)
+{
+        switch (reading) {
+        case RR_OX:
+                return data_pkt.pressures[PS_OXYGEN];
+        case RR_FUEL:
+                return data_pkt.pressures[PS_FUEL];
+        default:
+                return data_pkt.thrust;
+        }
+}
+
+// does rule r hold for reading v?
+static bool redline_holds(struct redline_rule *r, uint32_t v)
+{
+        switch (r->kind) {
+        case RK_OVER:
+                return v > r->threshold;
+        case RK_UNDER:
+                return v < r->threshold;
+        default:
+                // the first reading of a run is never stuck, there's
+                // nothing to compare it to yet
+                return r->hits != 0 && v == r->last;
+        }
+}
+
+// check every rule against this loop's readings, and start safing if any
+// of them trips
+static void check_redlines()
+{
+        const bool firing = sys_state == SS_FIRE;
+        const bool burning = firing && fire_state == FIRE_BURN_STEP;
+
+        for (uint8_t i = FIRST_REDLINE; i < NR_REDLINES; ++i) {
+                struct redline_rule *r = &redline_rules[i];
+                const uint32_t v = redline_reading(r->reading);
+                uint8_t need;
+
+                if (!r->threshold || !firing || (r->burning_only && !burning)) {
+                        r->hits = 0;
+                        continue;
+                }
+
+                if (r->kind == RK_STUCK) {
+                        need = min(r->threshold, 0xffUL);
+                        if (redline_holds(r, v)) {
+                                if (r->hits < 0xff)
+                                        ++r->hits;
+                        } else {
+                                r->hits = 1;
+                        }
+                        r->last = v;
+                } else {
+                        need = r->debounce;
+                        if (redline_holds(r, v))
+                                ++r->hits;
+                        else
+                                r->hits = 0;
+                }
+
+                if (r->hits < need)
+                        continue;
+
+                log_event(EV_REDLINE, i, v);
+                update_sys_state(SS_SAFING, CAUSE_REDLINE, i);
+                return;
+        }
 }
 
 // this function is the meat of the arduino code. Here he handle a REQ
 // packet from the client.
-static bool handle_req_packet(struct req_packet *pkt, EthernetClient *client)
+static bool handle_req_packet(struct req_packet *pkt, struct client_slot *slot)
 {
         uint8_t valve;
         uint8_t val;
+        uint8_t before[NR_VALVES];
+
+        log_event(EV_REQ, pkt->cmd, pkt->arg);
 
-        Serial.println("handle_req_packet");
-        
         switch (pkt->cmd) {
         case REQ_CMD_STOP:
                 // make sure we're actually in the right state
                 if (sys_state != SS_FIRE && sys_state != SS_READY)
                         goto the_default_is_to_yell;
 
-                update_sys_state(SS_SAFING);
+                update_sys_state(SS_SAFING, CAUSE_COMMAND, pkt->header.seq);
                 break;
 
         case REQ_CMD_START:
@@ -423,7 +1350,7 @@ static bool handle_req_packet(struct req_packet *pkt, EthernetClient *client)
                     || pkt->arg > REQ_CMD_START_MAX_BURN_TIME)
                         goto the_default_is_to_yell;
 
-                update_sys_state(SS_FIRE);
+                update_sys_state(SS_FIRE, CAUSE_COMMAND, pkt->header.seq);
                 fire_timeout = pkt->arg * 1000UL;
                 break;
 
@@ -431,20 +1358,18 @@ static bool handle_req_packet(struct req_packet *pkt, EthernetClient *client)
                 if (sys_state != SS_READY)
                         goto the_default_is_to_yell;
 
-                valve = pkt->arg & 0xff;
-                val = (pkt->arg & 0xff00) >> 8;
+                valve = elet_valve_arg_valve(pkt->arg);
+                val = elet_valve_arg_value(pkt->arg);
+                memcpy(before, valve_states, sizeof before);
 
                 if (valve == 0xff) {
-                        for (enum valve v = FIRST_VALVE; v < NR_VALVES;
-                             v = next_valve(v))
-                                close_valve(v);
-
+                        set_valves(0, ALL_VALVES);
                 } else if (valve < NR_VALVES) {
                         enum valve v = (enum valve)valve;
-                        if (!valve_is_flow(v) && val != 0 && val != 1)
+                        if (!valve_is_flow_P(v) && val != 0 && val != 1)
                                 goto the_default_is_to_yell;
 
-                        if (valve_is_flow(v)) {
+                        if (valve_is_flow_P(v)) {
                                 open_valve_to(v, val);
                         } else {
                                 if (val == 1)
@@ -455,6 +1380,7 @@ static bool handle_req_packet(struct req_packet *pkt, EthernetClient *client)
                 } else {
                         goto the_default_is_to_yell;
                 }
+                log_valve_transitions(before, CAUSE_COMMAND, pkt->header.seq);
                 break;
 
         case REQ_CMD_DEPRESS:
@@ -465,84 +1391,236 @@ static bool handle_req_packet(struct req_packet *pkt, EthernetClient *client)
                     || pkt->arg > REQ_CMD_DEPRESS_MAX_TIMEOUT)
                         goto the_default_is_to_yell;
 
-                update_sys_state(SS_DEPRESS);
+                update_sys_state(SS_DEPRESS, CAUSE_COMMAND, pkt->header.seq);
                 depress_timeout = pkt->arg * 1000UL;
                 break;
 
+        case REQ_CMD_REDLINE:
+                if (sys_state != SS_READY)
+                        goto the_default_is_to_yell;
+
+                if (elet_redline_arg_rule(pkt->arg) >= NR_REDLINES)
+                        goto the_default_is_to_yell;
+
+                redline_rules[elet_redline_arg_rule(pkt->arg)].threshold =
+                        elet_redline_arg_value(pkt->arg);
+                log_event(EV_REDLINE_SET, elet_redline_arg_rule(pkt->arg),
+                          elet_redline_arg_value(pkt->arg));
+                break;
+
+        case REQ_CMD_RATE:
+                if (elet_rate_arg_state(pkt->arg) >= SS_NUM_STATES)
+                        goto the_default_is_to_yell;
+
+                data_interval_ms[elet_rate_arg_state(pkt->arg)] =
+                        elet_rate_arg_interval_ms(pkt->arg);
+                log_event(EV_RATE_SET, elet_rate_arg_state(pkt->arg),
+                          elet_rate_arg_interval_ms(pkt->arg));
+                break;
+
         the_default_is_to_yell:
         default:
-                ;
                 // XXX: the client sent us a command we don't know about.
                 // Send a message back and give them the bird
-                struct message_packet mpkt;
-                memset(&mpkt.header, 0, sizeof mpkt.header);
-
-                mpkt.header.len = sizeof mpkt;
-                mpkt.header.type = PT_MESSAGE;
-                mpkt.header.seq = pkt_seq;
-                mpkt.header.timestamp = millis();
-                strcpy((char*)mpkt.data, "processed bad command");
-
-                send_packet(client, &mpkt, sizeof mpkt);
+                log_event(EV_REQ_REJECTED, pkt->cmd, pkt->arg);
+                send_message(slot, MSG_BAD_COMMAND, NULL);
                 return false;
         }
 
         return true;
 }
 
-static void rx_continue(EthernetClient *client)
+static uint8_t pack_state()
+{
+        return elet_state_pack(last_ign_status, sys_state, 0);
+}
+
+static uint8_t backlog_first()
+{
+        return (backlog_next + BACKLOG_LEN - backlog_count) % BACKLOG_LEN;
+}
+
+// how many of the packets in the backlog a client with data up to
+// last_timestamp already has. The timestamps only go up, so the ones it
+// doesn't are all at the end of the ring.
+static uint8_t backlog_skip(uint32_t last_timestamp)
+{
+        uint8_t first = backlog_first();
+        uint8_t skip;
+
+        for (skip = 0; skip < backlog_count; ++skip) {
+                struct data_packet *d = &backlog[(first + skip) % BACKLOG_LEN];
+                if ((int32_t)(d->header.timestamp - last_timestamp) > 0)
+                        break;
+        }
+        return skip;
+}
+
+// how many backlog packets a client that's catching up gets in a loop. A
+// whole backlog is 1280 bytes, more than the 1K TX buffer the last few
+// sockets have, and a write per packet is 32 SPI bursts in one loop, so
+// it goes out a few at a time, in one write. While firing a new packet
+// comes in every loop, so a full backlog takes 5 loops to catch up on.
+#define RESEND_PER_LOOP 8
+
+// send a client that's catching up the next few data packets it missed.
+// Once it has all of them it gets broadcasts again from the next loop.
+static void resend_backlog(struct client_slot *slot)
+{
+        uint8_t skip = backlog_skip(slot->resend_ts);
+        uint8_t at = (backlog_first() + skip) % BACKLOG_LEN;
+        uint8_t n = min(backlog_count - skip, RESEND_PER_LOOP);
+
+        // one write has to be one piece of the ring
+        n = min(n, BACKLOG_LEN - at);
+        if (n > 0 && send_packet(slot, &backlog[at], n * sizeof backlog[0])) {
+                slot->resend_ts = backlog[at + n - 1].header.timestamp;
+                skip += n;
+        }
+
+        // send_packet() might have found it dead
+        if (!slot->in_use || skip == backlog_count)
+                slot->catching_up = false;
+}
+
+// after this loop's broadcasts, so the data packet this loop built, which
+// is in the backlog already, goes out once
+static void resend_backlogs()
+{
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+                if (clients[i].in_use && clients[i].catching_up)
+                        resend_backlog(&clients[i]);
+}
+
+// tell a client that just said hello where things stand. If it's
+// resuming, the data packets it missed follow over the next few loops.
+static void send_session(struct client_slot *slot, bool resumed,
+                         uint32_t last_timestamp)
 {
-        struct packet_header *hdr = (struct packet_header *)rx_state.buf;
+        struct session_packet spkt;
+        uint8_t nsend = 0;
+
+        if (resumed)
+                nsend = backlog_count - backlog_skip(last_timestamp);
+
+        memset(&spkt, 0, sizeof spkt);
+        spkt.header.len = sizeof spkt;
+        spkt.header.type = PT_SESSION;
+        spkt.header.seq = pkt_seq;
+        spkt.header.timestamp = millis();
+        spkt.session = session_token;
+        spkt.resumed = resumed;
+        spkt.state = pack_state();
+        spkt.seq_step = current_seq_step();
+        spkt.backlog = nsend;
+        spkt.commander = slot->commander ? commander_token : 0;
+        spkt.ready_ms = data_interval_ms[SS_READY];
+        elet_seal_packet(&spkt.header);
+
+        send_packet(slot, &spkt, sizeof spkt);
+
+        slot->catching_up = nsend > 0;
+        slot->resend_ts = last_timestamp;
+}
+
+// a client said hello. Figure out what it gets to do.
+static void handle_hello_packet(struct hello_packet *pkt,
+                                struct client_slot *slot)
+{
+        bool resumed = pkt->session == session_token;
+        bool takeback = resumed && commander_token
+                && pkt->commander == commander_token;
+        struct client_slot *cmdr = find_commander();
+
+        slot->said_hello = true;
+
+        if (pkt->role == HELLO_ROLE_COMMANDER && cmdr != slot) {
+                // the commander's old socket may not have timed out yet
+                // after a cable glitch. If it's the commander coming back,
+                // the new connection wins. Anyone else just observes.
+                if (cmdr && takeback) {
+                        log_event(EV_COMMANDER_RESUMED,
+                                  slot->client.getSocketNumber(), 0);
+                        handle_dead_client(cmdr);
+                        cmdr = NULL;
+                }
+
+                if (cmdr) {
+                        send_message(slot, MSG_OBSERVER, NULL);
+                } else {
+                        slot->commander = true;
+
+                        // the commander coming back keeps counting from
+                        // the last command we processed, someone new
+                        // starts over
+                        if (!takeback) {
+                                commander_token = new_token();
+                                pkt_seq = pkt->header.seq;
+                        }
+                }
+        }
+
+        send_session(slot, resumed, pkt->last_timestamp);
+}
+
+static void rx_continue(struct client_slot *slot)
+{
+        EthernetClient *client = &slot->client;
+        struct rx_state *rx = &slot->rx;
+        struct packet_header *hdr = (struct packet_header *)rx->buf;
         uint16_t hsize = sizeof *hdr;
         uint16_t avail = client->available();
-        uint16_t toread = min((sizeof rx_state.buf) - rx_state.nread,
-                              avail);
+        uint16_t toread = min((sizeof rx->buf) - rx->nread, avail);
 
         // XXX: don't call this function in this case
         if (avail == 0)
                 return;
 
-        int ret = client->read(rx_state.buf + rx_state.nread, toread);
+        int ret = client->read(rx->buf + rx->nread, toread);
         if (ret == -1) {
-                handle_dead_client(client);
+                handle_dead_client(slot);
                 return;
         }
 
-        rx_state.nread += ret;
+        rx->nread += ret;
 
         // we got at least a header, so validate it
-        if (rx_state.nread >= hsize) {          
+        if (rx->nread >= hsize) {          
                 uint16_t len = hdr->len;
                 uint8_t type = hdr->type;
 
                 // the client sent us some bullshit, so close the
                 // connection
-                if ((type != PT_REQ && type != PT_HELLO) ||
-                    (len != sizeof(struct req_packet)
-                     && len != sizeof(struct hello_packet))) {
-                        handle_dead_client(client);
+                if ((type != PT_REQ || len != sizeof(struct req_packet))
+                    && (type != PT_HELLO
+                        || len != sizeof(struct hello_packet))) {
+                        handle_dead_client(slot);
                         return;
                 }
 
                 // we got a whole packet -- sick! let's process it
-                if (rx_state.nread == len) {                  
-                        // XXX: packet CRCs
-                        // validate_pkt_ctc(&rx_state.pkt);
-
-                        // PT_HELLO packets have nothing in them, just update
-                        // the last seq
-                        if (type == PT_HELLO) {
-                                pkt_seq = hdr->seq;
+                if (rx->nread == len) {                  
+                        // the framing is fine but the contents got
+                        // mangled. Don't act on any of it, e.g. a flipped
+                        // bit in a REQ_MOD_VALVE arg could pick the wrong
+                        // valve.
+                        if (!elet_packet_crc_ok(hdr)) {
+                                ++crc_errors;
+                                send_message(slot, MSG_BAD_CRC, NULL);
+                        } else if (type == PT_HELLO) {
+                                handle_hello_packet((struct hello_packet *)rx->buf, slot);
+                        } else if (!slot->commander) {
+                                send_message(slot, MSG_OBSERVER_COMMAND, NULL);
                         } else {
-                                bool success = handle_req_packet((struct req_packet *)rx_state.buf, client);
+                                bool success = handle_req_packet((struct req_packet *)rx->buf, slot);
                                 if (success)
                                         pkt_seq = hdr->seq;
                         }
-                        reset_rx_state();
+                        reset_rx_state(rx);
 
                 // too much!!
-                } else if (rx_state.nread > len)
-                        handle_dead_client(client);
+                } else if (rx->nread > len)
+                        handle_dead_client(slot);
         }
 }
 
@@ -563,11 +1641,7 @@ static void gather_all_data()
         data_pkt.vlv_pwm_fuel = valve_states[FUEL_FLOW];
 
         // fill in system state
-        uint8_t state = 0;
-        state |= (uint8_t)last_ign_status & 0x7;
-        state |= ((uint8_t)sys_state & 0x7) << 3;
-
-        data_pkt.state = state;
+        data_pkt.state = pack_state();
 
         // fill in pressure sensor data
         for (enum pressure_sensor ps = FIRST_PSENSOR; ps < NR_PSENSORS;
@@ -582,54 +1656,151 @@ static void gather_all_data()
         data_pkt.temps[TC_OXYGEN] = 0.0;
 
         data_pkt.thrust = read_load_cell();
+
+        data_pkt.crc_errors = crc_errors;
+        elet_seal_packet(&data_pkt.header);
 }
 
-static EthernetClient client;
-static int loop_count = 0;
+// does the data packet we just gathered go out this loop?
+static bool data_due()
+{
+        if (data_pkt.vlv_states != last_vlv_states
+            || data_pkt.vlv_pwm_ox != last_vlv_pwm_ox
+            || data_pkt.vlv_pwm_fuel != last_vlv_pwm_fuel
+            || data_pkt.state != last_state)
+                return true;
+
+        return millis() - last_data_ms >= data_interval_ms[sys_state];
+}
+
+// remember the data packet we just sent, in case someone missed it
+static void record_backlog()
+{
+        last_data_ms = millis();
+        last_vlv_states = data_pkt.vlv_states;
+        last_vlv_pwm_ox = data_pkt.vlv_pwm_ox;
+        last_vlv_pwm_fuel = data_pkt.vlv_pwm_fuel;
+        last_state = data_pkt.state;
+
+        backlog[backlog_next] = data_pkt;
+        backlog_next = (backlog_next + 1) % BACKLOG_LEN;
+        if (backlog_count < BACKLOG_LEN)
+                ++backlog_count;
+}
+
+// pick up a client that connected since we last looked, if there is one
+static void accept_new_client()
+{
+        EthernetClient client = server.available();
+        struct client_slot *free_slot = NULL;
+
+        if (!client)
+                return;
+
+        // server.available() hands back any socket with unread data in it,
+        // including the ones we already own
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+                if (!clients[i].in_use) {
+                        if (!free_slot)
+                                free_slot = &clients[i];
+                        continue;
+                }
+
+                if (clients[i].client.getSocketNumber()
+                    == client.getSocketNumber())
+                        return;
+        }
+
+        // this can only happen if the library's idea of how many sockets
+        // there are disagrees with ours, but don't leak the socket if it
+        // does
+        if (!free_slot) {
+                client.stop();
+                return;
+        }
+
+        free_slot->client = client;
+        free_slot->in_use = true;
+        free_slot->said_hello = false;
+        free_slot->commander = false;
+        free_slot->catching_up = false;
+        reset_rx_state(&free_slot->rx);
+
+        log_event(EV_CLIENT_NEW, client.getSocketNumber(), 0);
+}
+
+static unsigned long last_accept_ms = 0;
 
 void loop()
 {
+        const uint32_t loop_start = micros();
+        uint32_t start = loop_start;
+
         gather_all_data();
+        record_time(LS_GATHER, start);
+
+        // right away, before anything else gets a chance to hold us up
+        check_redlines();
 
         // only re-try grabbing a client after a while, since it's
-        // expensive
-        if (++loop_count == 32) {
+        // expensive. We look in every state so that a client that dropped
+        // mid-burn can get back in.
+        if (millis() - last_accept_ms >= ACCEPT_INTERVAL_MS) {
+                last_accept_ms = millis();
+                accept_new_client();
+        }
 
-                loop_count = 0;
+        // receive and possibly process incoming packets
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+                struct client_slot *slot = &clients[i];
 
-                // only get new clinents in the SS_READY state because
-                // server.available() can be an expensive operation and
-                // we have other time-critical code
-                if (!client && sys_state == SS_READY) {
-                        client = server.available();
+                if (!slot->in_use)
+                        continue;
+
+                if (slot->client.connected()) {
+                        start = micros();
+                        rx_continue(slot);
+                        record_time(LS_RX, start);
+                } else {
+                        handle_dead_client(slot);
                 }
         }
 
-        if (client.connected()) {
-                // receive and possibly process an incoming packet
-                rx_continue(&client);
-        
-                // transmit data from all sensors
-                send_packet(&client, &data_pkt, sizeof data_pkt);
-        } else if (client) {
-                handle_dead_client(&client);
+        // transmit data from all sensors, if it's time. The packet is only
+        // built once, every client gets the same bytes, along with the rest
+        // of this loop's broadcasts
+        if (data_due()) {
+                broadcast_packet(&data_pkt, sizeof data_pkt);
+                record_backlog();
         }
        
-        unsigned long now = millis();
+        start = micros();
         switch (sys_state) {
         case SS_FIRE:
-                continue_fire(now);
+                continue_fire();
+                record_time(LS_FIRE, start);
                 break;
                 
         case SS_SAFING:
-                continue_safing(now);
+                continue_safing();
+                record_time(LS_SAFING, start);
                 break;
 
         case SS_DEPRESS:
-                continue_depress(now);
+                continue_depress();
+                record_time(LS_DEPRESS, start);
                 break;
 
         default:
                 break;
         }
+
+        send_stats();
+
+        // last, so whatever happened this loop goes out this loop
+        drain_transitions();
+        drain_events();
+        flush_broadcasts();
+        resend_backlogs();
+        record_time(LS_LOOP, loop_start);
 }
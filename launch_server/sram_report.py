@@ -0,0 +1,272 @@
+#!/usr/bin/env python
+#
+# how much of the mega's 8 KB of RAM a build of a sketch uses: what's in it
+# for good (.data and .bss, biggest first), the deepest the stack can get,
+# and what's left over. Give it the .elf, or the build directory it's in:
+#
+#   arduino-cli compile -b arduino:avr:mega --build-path /tmp/ls launch_server
+#   ./launch_server/sram_report.py /tmp/ls
+#
+# With -b old.elf it also says what changed since an older build, e.g. the
+# last commit's.
+#
+# The stack depth comes from the disassembly of the final binary, so it's
+# what LTO actually left: each function's frame is what its prologue pushes
+# and allocates, and calls, rcalls and tail jumps are followed from main()
+# and from every interrupt vector. Interrupts don't nest on the AVR, so the
+# worst case is main's deepest path plus the deepest handler. Calls through
+# a function pointer (icall/eicall, e.g. Print's virtual write()) can't be
+# followed; the report lists who makes them, and the real worst case is
+# that much deeper. malloc() isn't counted either, it says so if it's
+# linked in. Functions with big frames are listed whether or not they're on
+# the deepest path, since a big local array, e.g. a struct sweep_step with
+# its 256 byte transient, is usually a mistake.
+
+from __future__ import print_function
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+# where RAM starts in an AVR ELF's address space
+RAM_BASE = 0x800000
+
+# bytes a call pushes: the mega2560's program counter is 17 bits wide
+PC_BYTES = 3
+
+# frames this big or bigger get listed
+BIG_FRAME = 64
+
+PROLOGUE_OPS = ("push", "in", "out", "eor", "clr", "cli", "subi", "sbci",
+                "sbc", "sbiw", "movw", "mov")
+
+FUNC_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+INSN_RE = re.compile(r"^\s*([0-9a-f]+):\s+(?:[0-9a-f]{2} )+\s*(\S+)\s*(.*)$")
+TARGET_RE = re.compile(r";\s*0x([0-9a-f]+) <([^>+]+)>")
+
+
+def run(tool, *args):
+    try:
+        return subprocess.check_output((tool,) + args).decode()
+    except OSError as e:
+        sys.exit("can't run %s: %s" % (tool, e))
+
+
+def find_elf(path):
+    if os.path.isfile(path):
+        return path
+    elfs = glob.glob(os.path.join(path, "*.elf"))
+    if len(elfs) != 1:
+        sys.exit("%s: want exactly one .elf in there, found %d"
+                 % (path, len(elfs)))
+    return elfs[0]
+
+
+def sections(prefix, elf):
+    """sizes of the sections that live in RAM"""
+    out = {}
+    for line in run(prefix + "size", "-A", elf).splitlines():
+        f = line.split()
+        if len(f) == 3 and f[0] in (".data", ".bss", ".noinit"):
+            out[f[0]] = int(f[1])
+    return out
+
+
+def ram_symbols(prefix, elf):
+    """{name: size} of everything in RAM"""
+    out = {}
+    for line in run(prefix + "nm", "-S", "-C", elf).splitlines():
+        m = re.match(r"^([0-9a-f]+) ([0-9a-f]+) [bBdDvV] (.+)$", line)
+        if m and int(m.group(1), 16) >= RAM_BASE:
+            out[m.group(3)] = out.get(m.group(3), 0) + int(m.group(2), 16)
+    return out
+
+
+def frame_bytes(insns):
+    """what a function's prologue puts on the stack"""
+    n = 0
+    for op, args in insns:
+        if op == "rcall" and args.startswith(".+0"):
+            # gcc's cheap way to make a small frame
+            n += PC_BYTES
+            continue
+        if op not in PROLOGUE_OPS:
+            break
+        if op == "push":
+            n += 1
+        elif op == "sbiw" and args.startswith("r28"):
+            n += int(args.split(",")[1].split()[0], 0)
+        elif op == "subi" and args.startswith("r28"):
+            n += int(args.split(",")[1].split()[0], 0)
+        elif op == "sbci" and args.startswith("r29"):
+            n += int(args.split(",")[1].split()[0], 0) << 8
+    return n
+
+
+def call_graph(prefix, elf):
+    """{function: (frame bytes, [(callee, is_tail_jump)], makes
+    indirect calls)}"""
+    funcs = {}
+    starts = {}
+    cur = None
+    body = []
+
+    def finish():
+        if cur is not None:
+            funcs[cur] = body
+
+    for line in run(prefix + "objdump", "-d", "-C", elf).splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            finish()
+            cur = m.group(2)
+            starts[int(m.group(1), 16)] = cur
+            body = []
+            continue
+        m = INSN_RE.match(line)
+        if m and cur is not None:
+            body.append((m.group(2), m.group(3)))
+    finish()
+
+    graph = {}
+    for name, insns in funcs.items():
+        calls = []
+        indirect = False
+        for op, args in insns:
+            if op in ("icall", "eicall", "ijmp", "eijmp"):
+                indirect = True
+                continue
+            if op not in ("call", "rcall", "jmp", "rjmp"):
+                continue
+            t = TARGET_RE.search(args)
+            if not t:
+                continue
+            # a jump into the middle of ourselves is a loop, not a call
+            target = starts.get(int(t.group(1), 16))
+            if target is None or (target == name and op in ("jmp", "rjmp")):
+                continue
+            calls.append((target, op in ("jmp", "rjmp")))
+        graph[name] = (frame_bytes(insns), calls, indirect)
+    return graph
+
+
+def deepest(graph, root):
+    """(bytes, [path], functions on it that call through pointers,
+    recursive functions found)"""
+    memo = {}
+    recursive = set()
+
+    def walk(f, stack):
+        if f in memo:
+            return memo[f]
+        if f in stack:
+            recursive.add(f)
+            return (0, [], set())
+        frame, calls, indirect = graph.get(f, (0, [], False))
+        best = (0, [], set())
+        stack.add(f)
+        for callee, tail in calls:
+            d, path, ind = walk(callee, stack)
+            # a tail jump reuses our return address
+            d += 0 if tail else PC_BYTES
+            if d > best[0]:
+                best = (d, path, ind)
+        stack.discard(f)
+        res = (frame + best[0], [f] + best[1],
+               best[2] | ({f} if indirect else set()))
+        memo[f] = res
+        return res
+
+    d, path, ind = walk(root, set())
+    return d, path, ind, recursive
+
+
+def analyze(prefix, elf):
+    secs = sections(prefix, elf)
+    syms = ram_symbols(prefix, elf)
+    graph = call_graph(prefix, elf)
+    if "main" not in graph:
+        sys.exit("%s: no main() in the disassembly" % elf)
+
+    main = deepest(graph, "main")
+    worst_isr = (0, [], set(), set())
+    for f in sorted(graph):
+        if f.startswith("__vector_") and f != "__vector_default":
+            d = deepest(graph, f)
+            if d[0] > worst_isr[0]:
+                worst_isr = d
+    big = sorted((frame, f) for f, (frame, _, _) in graph.items()
+                 if frame >= BIG_FRAME)
+    return dict(static=sum(secs.values()), sections=secs, symbols=syms,
+                main=main, isr=worst_isr, big=big[::-1],
+                stack=main[0] + (PC_BYTES + worst_isr[0]
+                                 if worst_isr[1] else 0),
+                malloc="malloc" in graph)
+
+
+def report(r, ram, top):
+    secs = r["sections"]
+    print("static: %d bytes, %d%% of %d (.data %d, .bss %d, .noinit %d)" % (
+        r["static"], 100 * r["static"] // ram, ram, secs.get(".data", 0),
+        secs.get(".bss", 0), secs.get(".noinit", 0)))
+    for name, size in sorted(r["symbols"].items(),
+                             key=lambda kv: (-kv[1], kv[0]))[:top]:
+        print("    %6d  %s" % (size, name))
+
+    d, path, ind, rec = r["main"]
+    print("stack: %d bytes worst case" % r["stack"])
+    print("    main, %d: %s" % (d, " > ".join(path)))
+    if r["isr"][1]:
+        print("    + interrupt, %d: %s" % (r["isr"][0],
+                                           " > ".join(r["isr"][1])))
+    for f in sorted(ind | r["isr"][2]):
+        print("    + whatever %s calls through a pointer" % f)
+    for f in sorted(rec | r["isr"][3]):
+        print("    + %s is recursive, counted once" % f)
+    if r["malloc"]:
+        print("    + the heap, malloc() is linked in")
+    for frame, f in r["big"]:
+        print("    ! %s has a %d byte frame" % (f, frame))
+
+    print("free: %d of %d bytes" % (ram - r["static"] - r["stack"], ram))
+
+
+def report_change(new, old, top):
+    print("since the baseline: static %+d bytes, stack %+d bytes, "
+          "%+d bytes free" % (
+              new["static"] - old["static"], new["stack"] - old["stack"],
+              (old["static"] + old["stack"])
+              - (new["static"] + new["stack"])))
+    names = set(new["symbols"]) | set(old["symbols"])
+    deltas = [(new["symbols"].get(n, 0) - old["symbols"].get(n, 0), n)
+              for n in names]
+    deltas = [dn for dn in deltas if dn[0]]
+    for delta, name in sorted(deltas, key=lambda dn: (dn[0], dn[1]))[:top]:
+        print("    %+6d  %s" % (delta, name))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="RAM use of an AVR build")
+    ap.add_argument("build", help="the .elf, or the directory it's in")
+    ap.add_argument("-b", "--baseline", help="an older build to compare to")
+    ap.add_argument("-p", "--prefix", default="avr-",
+                    help="binutils prefix (default avr-)")
+    ap.add_argument("--ram", type=int, default=8192,
+                    help="bytes of RAM (default 8192, the mega's)")
+    ap.add_argument("-n", "--top", type=int, default=15,
+                    help="how many symbols to list (default 15)")
+    args = ap.parse_args()
+
+    new = analyze(args.prefix, find_elf(args.build))
+    report(new, args.ram, args.top)
+    if args.baseline:
+        old = analyze(args.prefix, find_elf(args.baseline))
+        report_change(new, old, args.top)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,1778 @@
+// host build of launch_server.ino. The sketch is compiled against the fake
+// arduino core in shim/ and driven from main() below, so we can poke at the
+// server logic without the hardware.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "sim.h"
+
+#include <Arduino.h>
+
+#include "../launch_server/launch_server.ino"
+
+#include "../launch_client/elet_log.h"
+#include "../launch_client/run_log.h"
+#include "../launch_client/run_stats.h"
+
+#include "plant.h"
+
+// one of the clients we connect to the server. This is the moral equivalent
+// of launch_client/client.c, minus the command line.
+struct vclient {
+        int sock;
+
+        // bytes received but not yet parsed into packets
+        std::vector<uint8_t> buf;
+
+        unsigned long data_pkts;
+        unsigned long msg_pkts;
+
+        // the last session packet we got, and the newest data packet
+        bool got_session;
+        struct session_packet session;
+        uint32_t last_ts;
+        uint32_t last_seq;
+        uint8_t last_vlv_states;
+
+        // data packets that went backwards in time, i.e. duplicates, and
+        // the biggest jump forward in time between two data packets
+        unsigned long dup_pkts;
+        uint32_t max_gap;
+
+        // ids of the events the server sent us, for comparing with what
+        // went out the serial port
+        std::vector<uint8_t> events;
+
+        // the events that say how late a sequence step was
+        std::vector<struct event_packet> steps;
+
+        // the state changes, with when they happened
+        std::vector<struct event_packet> states;
+
+        // valve, igniter and state changes from transition packets
+        std::vector<struct transition_packet> transitions;
+
+        // we've seen an EV_SEQ_SAVED, and how much sooner than their fixed
+        // waits the sequences finished, all told
+        bool seq_done;
+        uint32_t saved_ms;
+
+        // if not 0, every packet goes here the way client.c writes run.log
+        int logfd;
+
+        // the last redline the server said tripped
+        bool redline_tripped;
+        uint16_t redline;
+
+        // the worst time the server reported for each part of its loop,
+        // from its stats packets
+        unsigned long stats_pkts;
+        uint32_t max_us[NR_LOOP_SECTIONS];
+
+        // what client.c works out about the run as it goes, and its
+        // summary of the last one that finished. Reset run before using
+        // these.
+        struct run_stats run;
+        bool run_done;
+        struct run_stats last_run;
+};
+
+// connect to the server. If we've talked to it before, try to resume the
+// session.
+static void vclient_connect(struct vclient *c, uint8_t role, uint32_t seq)
+{
+        struct hello_packet pkt;
+
+        c->sock = sim_connect();
+        if (c->sock == -1) {
+                fprintf(stderr, "out of sockets\n");
+                exit(1);
+        }
+
+        c->buf.clear();
+        c->data_pkts = 0;
+        c->msg_pkts = 0;
+        c->dup_pkts = 0;
+        c->max_gap = 0;
+
+        memset(&pkt, 0, sizeof pkt);
+        pkt.header.len = sizeof pkt;
+        pkt.header.type = PT_HELLO;
+        pkt.header.seq = seq;
+        pkt.role = role;
+        pkt.session = c->got_session ? c->session.session : 0;
+        pkt.last_timestamp = c->last_ts;
+        pkt.commander = c->got_session ? c->session.commander : 0;
+        elet_seal_packet(&pkt.header);
+        sim_send(c->sock, &pkt, sizeof pkt);
+
+        c->got_session = false;
+}
+
+static void vclient_send_req(struct vclient *c, uint8_t cmd, uint32_t arg,
+                             uint32_t seq)
+{
+        struct req_packet pkt;
+
+        memset(&pkt, 0, sizeof pkt);
+        pkt.header.len = sizeof pkt;
+        pkt.header.type = PT_REQ;
+        pkt.header.seq = seq;
+        pkt.cmd = cmd;
+        pkt.arg = arg;
+        elet_seal_packet(&pkt.header);
+        sim_send(c->sock, &pkt, sizeof pkt);
+}
+
+// write the packet at off in a client's buffer to its log, with the same
+// generated formatters client.c uses for run.log
+static void vclient_log(struct vclient *c, size_t off, const struct
+                        packet_header *hdr)
+{
+        struct pkt_ring r;
+        struct pkt_view v;
+
+        // a ring that's just this packet, big enough that it never wraps
+        r.buf = &c->buf[off];
+        r.size = 1;
+        while (r.size < hdr->len)
+                r.size <<= 1;
+        r.rd = 0;
+        r.wr = hdr->len;
+
+        v.ring = &r;
+        v.start = 0;
+        v.len = hdr->len;
+
+        switch (hdr->type) {
+        case PT_DATA:
+                elet_log_data_packet(c->logfd, &v);
+                break;
+        case PT_SESSION:
+                elet_log_session_packet(c->logfd, &v);
+                break;
+        case PT_MESSAGE:
+                elet_log_message_packet(c->logfd, &v);
+                break;
+        case PT_EVENT:
+                elet_log_event_packet(c->logfd, &v);
+                break;
+        case PT_STATS:
+                elet_log_stats_packet(c->logfd, &v);
+                break;
+        case PT_TRANSITION:
+                elet_log_transition_packet(c->logfd, &v);
+                break;
+        }
+}
+
+// read everything the server sent us and count up whole packets
+static void vclient_drain(struct vclient *c)
+{
+        uint8_t tmp[4096];
+        size_t n;
+
+        while ((n = sim_recv(c->sock, tmp, sizeof tmp)) != 0)
+                c->buf.insert(c->buf.end(), tmp, tmp + n);
+
+        size_t off = 0;
+        while (c->buf.size() - off >= sizeof(struct packet_header)) {
+                struct packet_header hdr;
+                memcpy(&hdr, &c->buf[off], sizeof hdr);
+
+                if (hdr.len < sizeof hdr) {
+                        fprintf(stderr, "sock %d: bad packet len %u\n",
+                                c->sock, hdr.len);
+                        exit(1);
+                }
+
+                if (c->buf.size() - off < hdr.len)
+                        break;
+
+                if (!elet_packet_crc_ok((struct packet_header *)&c->buf[off])) {
+                        fprintf(stderr, "sock %d: bad crc\n", c->sock);
+                        exit(1);
+                }
+
+                if (c->logfd)
+                        vclient_log(c, off, &hdr);
+
+                if (hdr.type == PT_DATA) {
+                        ++c->data_pkts;
+                        if (c->last_ts
+                            && (int32_t)(hdr.timestamp - c->last_ts) <= 0)
+                                ++c->dup_pkts;
+                        else if (c->last_ts
+                                 && hdr.timestamp - c->last_ts > c->max_gap)
+                                c->max_gap = hdr.timestamp - c->last_ts;
+                        c->last_ts = hdr.timestamp;
+                        c->last_seq = hdr.seq;
+                        c->last_vlv_states =
+                                c->buf[off + offsetof(struct data_packet,
+                                                      vlv_states)];
+
+                        struct data_packet dpkt;
+                        memcpy(&dpkt, &c->buf[off], sizeof dpkt);
+                        if (run_stats_add(&c->run, hdr.timestamp,
+                                          elet_state_sys_state(dpkt.state),
+                                          dpkt.pressures[PS_OXYGEN],
+                                          dpkt.pressures[PS_FUEL],
+                                          dpkt.thrust)) {
+                                if (c->logfd)
+                                        run_stats_log(c->logfd, &c->run);
+                                c->last_run = c->run;
+                                c->run_done = true;
+                                run_stats_reset(&c->run);
+                        }
+                } else if (hdr.type == PT_SESSION) {
+                        memcpy(&c->session, &c->buf[off], sizeof c->session);
+                        c->got_session = true;
+                } else if (hdr.type == PT_MESSAGE) {
+                        struct message_packet mpkt;
+
+                        // only as long as its text
+                        if (hdr.len < MESSAGE_PACKET_MIN_LEN
+                            || hdr.len > sizeof mpkt) {
+                                fprintf(stderr, "sock %d: bad message "
+                                        "len %u\n", c->sock, hdr.len);
+                                exit(1);
+                        }
+                        memcpy(&mpkt, &c->buf[off], hdr.len);
+                        if (sim_verbose)
+                                fprintf(stderr, "sock %d: message: %s%.*s\n",
+                                        c->sock,
+                                        message_to_str((enum message)mpkt.id),
+                                        (int)(hdr.len - MESSAGE_PACKET_MIN_LEN),
+                                        (const char *)mpkt.text);
+                        ++c->msg_pkts;
+                } else if (hdr.type == PT_EVENT) {
+                        struct event_packet epkt;
+                        memcpy(&epkt, &c->buf[off], sizeof epkt);
+                        c->events.push_back(epkt.id);
+                        if (epkt.id == EV_REDLINE) {
+                                c->redline_tripped = true;
+                                c->redline = epkt.arg0;
+                        }
+                        if (epkt.id == EV_SEQ_SAVED) {
+                                c->seq_done = true;
+                                c->saved_ms += epkt.arg1;
+                        }
+                        if (epkt.id == EV_STATE)
+                                c->states.push_back(epkt);
+                        if (epkt.id == EV_FIRE_STEP
+                            || epkt.id == EV_SAFING_STEP
+                            || epkt.id == EV_DEPRESS_STEP)
+                                c->steps.push_back(epkt);
+                        if (sim_verbose) {
+                                char text[128];
+                                elet_event_format(text, sizeof text, epkt.id,
+                                                  epkt.arg0, epkt.arg1);
+                                fprintf(stderr, "sock %d: event: %s\n",
+                                        c->sock, text);
+                        }
+                } else if (hdr.type == PT_STATS) {
+                        struct stats_packet spkt;
+                        memcpy(&spkt, &c->buf[off], sizeof spkt);
+                        ++c->stats_pkts;
+                        if (spkt.section < NR_LOOP_SECTIONS)
+                                c->max_us[spkt.section] = max(
+                                        c->max_us[spkt.section], spkt.max_us);
+                } else if (hdr.type == PT_TRANSITION) {
+                        struct transition_packet tpkt;
+                        memcpy(&tpkt, &c->buf[off], sizeof tpkt);
+                        c->transitions.push_back(tpkt);
+                }
+
+                off += hdr.len;
+        }
+        c->buf.erase(c->buf.begin(), c->buf.begin() + off);
+}
+
+// is a solenoid valve's pin actually high? The sketch drives these through
+// the port registers, not digitalWrite()
+static bool valve_pin_open(enum valve v)
+{
+        return *mega_port_reg(valve_ports[v].port) & valve_ports[v].mask;
+}
+
+// do the transitions a client got account for every valve and state
+// change? Starting from everything closed in the ready state, playing them
+// back has to end up where the sketch is now, and every valve a sequence
+// moved has to have moved when that step says it ran. Returns how many of
+// those lined up, -1 if something doesn't add up.
+static long transitions_check(const struct vclient *c)
+{
+        uint8_t valves[NR_VALVES] = {0};
+        uint8_t state = SS_READY;
+        uint8_t igniter = 0;
+        long lined_up = 0;
+
+        for (size_t i = 0; i < c->transitions.size(); ++i) {
+                const struct transition_packet *t = &c->transitions[i];
+                uint8_t *now = t->what == TR_STATE ? &state
+                        : t->what == TR_IGNITER ? &igniter
+                        : t->what < NR_VALVES ? &valves[t->what] : NULL;
+
+                if (!now || *now != t->old_value || t->dropped)
+                        return -1;
+                *now = t->new_value;
+
+                if (t->cause != CAUSE_SEQUENCE || t->what >= NR_VALVES)
+                        continue;
+
+                bool found = false;
+                for (size_t j = 0; j < c->steps.size(); ++j)
+                        if (c->steps[j].arg0 == t->arg
+                            && c->steps[j].us - t->us + SCHED_US_PER_TICK
+                               <= 2 * SCHED_US_PER_TICK)
+                                found = true;
+                if (!found)
+                        return -1;
+                ++lined_up;
+        }
+
+        if (state != sys_state
+            || igniter != digitalRead(sys_igniter.igniter_fire_ctl_be_careful)
+            || memcmp(valves, valve_states, sizeof valves) != 0)
+                return -1;
+        return lined_up;
+}
+
+// do the pins agree with what the sketch thinks the solenoids are doing?
+static bool valve_pins_ok()
+{
+        for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v))
+                if (!valve_is_flow(v)
+                    && valve_pin_open(v) != (valve_states[v] != 0))
+                        return false;
+        return true;
+}
+
+// run one iteration of loop() and return how long it took in nanoseconds.
+// On the virtual clock that's only the time it spent waiting.
+static uint64_t timed_loop()
+{
+        uint64_t start = sim_now_ns();
+
+        loop();
+        return sim_now_ns() - start;
+}
+
+// connect up to nclients clients to the server, one at a time, and see how
+// loop() time grows with the number of clients attached. The first client
+// is the commander, the rest are observers.
+static int sim_clients(int nclients, int nloops)
+{
+        std::vector<struct vclient> vc(nclients);
+
+        printf("%8s %12s %12s %12s %12s %12s\n", "clients", "mean loop us",
+               "max loop us", "pkts/client", "writes/loop", "msgs");
+
+        for (int n = 0; n <= nclients; ++n) {
+                if (n > 0) {
+                        struct vclient *c = &vc[n - 1];
+                        vclient_connect(c, n == 1 ? HELLO_ROLE_COMMANDER
+                                        : HELLO_ROLE_OBSERVER, 1);
+
+                        // let the server pick the new client up, then
+                        // forget about everything so far
+                        while (!c->got_session) {
+                                loop();
+                                for (int j = 0; j < n; ++j)
+                                        vclient_drain(&vc[j]);
+                        }
+
+                        // we want what a client costs with a data packet
+                        // going out every loop, not the idle rate
+                        if (n == 1) {
+                                vclient_send_req(c, REQ_CMD_RATE,
+                                                 elet_rate_arg_pack(SS_READY,
+                                                                    0), 1);
+                                loop();
+                                vclient_drain(c);
+                        }
+
+                        for (int j = 0; j < n; ++j) {
+                                vc[j].data_pkts = 0;
+                                vc[j].msg_pkts = 0;
+                                sim_sockets[vc[j].sock].writes = 0;
+                        }
+                }
+
+                uint64_t total = 0;
+                uint64_t worst = 0;
+                for (int i = 0; i < nloops; ++i) {
+                        uint64_t t = timed_loop();
+                        total += t;
+                        if (t > worst)
+                                worst = t;
+
+                        for (int j = 0; j < n; ++j)
+                                vclient_drain(&vc[j]);
+                }
+
+                // each write is an SPI burst and a SEND command on the
+                // real thing
+                unsigned long pkts = 0;
+                unsigned long writes = 0;
+                unsigned long msgs = 0;
+                for (int j = 0; j < n; ++j) {
+                        pkts += vc[j].data_pkts;
+                        writes += sim_sockets[vc[j].sock].writes;
+                        msgs += vc[j].msg_pkts;
+                }
+
+                printf("%8d %12.2f %12.2f %12lu %12.2f %12lu\n", n,
+                       total / 1000.0 / nloops, worst / 1000.0,
+                       n ? pkts / n : 0, (double)writes / nloops, msgs);
+        }
+
+        // make sure the observers really are read-only: a valve command
+        // from one should bounce, the same command from the commander
+        // should go through
+        if (nclients >= 2) {
+                vclient_send_req(&vc[1], REQ_MOD_VALVE, OX_BLEED | 0x100, 7);
+                for (int i = 0; i < 64; ++i)
+                        loop();
+                vclient_drain(&vc[1]);
+                printf("observer command: %s, valve %s\n",
+                       vc[1].msg_pkts ? "rejected" : "accepted",
+                       valve_pin_open(OX_BLEED) ? "open" : "closed");
+
+                vclient_send_req(&vc[0], REQ_MOD_VALVE, OX_BLEED | 0x100, 2);
+                for (int i = 0; i < 64; ++i)
+                        loop();
+                vclient_drain(&vc[0]);
+                printf("commander command: seq %u, valve %s\n",
+                       data_pkt.header.seq,
+                       valve_pin_open(OX_BLEED) ? "open" : "closed");
+
+                // flip a bit in the valve number of an otherwise good
+                // command. It should be dropped, not open some other valve.
+                struct req_packet bad;
+                memset(&bad, 0, sizeof bad);
+                bad.header.len = sizeof bad;
+                bad.header.type = PT_REQ;
+                bad.header.seq = 3;
+                bad.cmd = REQ_MOD_VALVE;
+                bad.arg = elet_valve_arg_pack(OX_BLEED, 0);
+                elet_seal_packet(&bad.header);
+                bad.arg ^= 0x1;
+                sim_send(vc[0].sock, &bad, sizeof bad);
+                for (int i = 0; i < 64; ++i)
+                        loop();
+                vclient_drain(&vc[0]);
+                printf("corrupted command: crc errors %u, valve %s, "
+                       "valve %d %s\n", data_pkt.crc_errors,
+                       valve_pin_open(OX_BLEED) ? "open" : "closed",
+                       OX_BLEED ^ 1,
+                       valve_pin_open((enum valve)(OX_BLEED ^ 1))
+                       ? "open" : "closed");
+
+                // every observer knows the session token. Coming back
+                // with it as commander mustn't get one command.
+                struct client_slot *cmdr = find_commander();
+                const uint32_t seq = data_pkt.header.seq;
+
+                sim_disconnect(vc[1].sock);
+                vclient_connect(&vc[1], HELLO_ROLE_COMMANDER, seq + 100);
+                while (!vc[1].got_session) {
+                        loop();
+                        vclient_drain(&vc[0]);
+                        vclient_drain(&vc[1]);
+                }
+
+                bool refused = cmdr && find_commander() == cmdr
+                        && vc[1].session.resumed && !vc[1].session.commander
+                        && data_pkt.header.seq == seq;
+                printf("observer takeover: %s\n",
+                       refused ? "refused" : "FAIL, took command");
+                if (!refused)
+                        return 1;
+        }
+
+        return 0;
+}
+
+// run loop() about as often as the real thing does, which is every ~10ms
+// judging by the timestamps in the logs
+#define SIM_LOOP_PERIOD_US 10000
+
+// returns how long loop() took in nanoseconds
+static uint64_t paced_loop()
+{
+        uint64_t took_ns = timed_loop();
+
+        if (took_ns / 1000 < SIM_LOOP_PERIOD_US)
+                sim_sleep_ns(SIM_LOOP_PERIOD_US * 1000ULL - took_ns);
+        return took_ns;
+}
+
+// run paced loops for ms milliseconds, draining every client
+static void run_for(struct vclient *vc, int n, unsigned long ms)
+{
+        uint64_t end = sim_now_ns() + ms * 1000000ULL;
+
+        while (sim_now_ns() < end) {
+                paced_loop();
+                for (int i = 0; i < n; ++i)
+                        if (vc[i].sock != -1)
+                                vclient_drain(&vc[i]);
+        }
+}
+
+// a paced loop for a client that's resuming, keeping track of the most
+// writes the server did to its socket in one loop
+static void resume_loop(struct vclient *c, unsigned long *worst_writes)
+{
+        sim_sockets[c->sock].writes = 0;
+        paced_loop();
+        *worst_writes = max(*worst_writes, sim_sockets[c->sock].writes);
+        vclient_drain(c);
+}
+
+// drop the commander in the middle of a fire sequence, reconnect, and time
+// how long it takes until data starts flowing again. A "close" drop is the
+// client going away cleanly; an "abandon" drop is a cable glitch, where the
+// server never finds out the old socket is dead.
+static bool sim_reconnect_one(struct vclient *c, bool abandon)
+{
+        struct session_packet before = c->session;
+        uint32_t seq_before = c->last_seq;
+
+        if (abandon)
+                c->sock = -1;
+        else
+                sim_disconnect(c->sock);
+
+        // stay away for a bit; the arduino keeps gathering data
+        run_for(c, 1, 200);
+
+        unsigned long worst_writes = 0;
+        uint64_t start = sim_now_ns();
+        vclient_connect(c, HELLO_ROLE_COMMANDER, seq_before);
+        while (c->data_pkts == 0)
+                resume_loop(c, &worst_writes);
+        double ms = (sim_now_ns() - start) / 1e6;
+
+        // give the backlog a chance to arrive. If it covered the whole
+        // time we were gone, the biggest gap we saw is about one loop. It
+        // comes a few packets a loop in one write, so the loop never does
+        // more than that and the session packet.
+        uint64_t end = sim_now_ns() + 50 * 1000000ULL;
+        while (sim_now_ns() < end)
+                resume_loop(c, &worst_writes);
+
+        bool ok = c->got_session && c->session.resumed
+                && c->session.session == before.session
+                && c->session.header.seq == seq_before
+                && sys_state == SS_FIRE
+                && valve_pins_ok()
+                && find_commander() != NULL
+                && c->dup_pkts == 0
+                && c->max_gap < 2 * SIM_LOOP_PERIOD_US / 1000
+                && worst_writes <= 2
+                && sim_sockets[c->sock].tx_overruns == 0
+                && ms < 100.0;
+
+        printf("%-8s resumed %d, seq %u -> %u, step %u, backlog %u, "
+               "dups %lu, max gap %u ms, writes/loop %lu, "
+               "reconnect-to-first-data %.1f ms: %s\n",
+               abandon ? "abandon" : "close", c->session.resumed,
+               seq_before, c->session.header.seq, c->session.seq_step,
+               c->session.backlog, c->dup_pkts, c->max_gap, worst_writes,
+               ms, ok ? "ok" : "FAIL");
+
+        return ok;
+}
+
+static int sim_reconnect()
+{
+        struct vclient c = vclient();
+
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+
+        vclient_send_req(&c, REQ_CMD_START, 10, 2);
+        run_for(&c, 1, 1000);
+
+        if (sys_state != SS_FIRE) {
+                fprintf(stderr, "never started firing\n");
+                return 1;
+        }
+
+        bool ok = sim_reconnect_one(&c, false);
+        ok = sim_reconnect_one(&c, true) && ok;
+        return ok ? 0 : 1;
+}
+
+// what a run of loops that changed state cost
+struct transition_stats {
+        // state changes, and the loops they happened in. One loop can
+        // change state twice, e.g. starting to fire and bailing out
+        // because the igniter is bad.
+        unsigned transitions;
+        unsigned loops;
+
+        // the longest of those loops, and how much of all of them was spent
+        // waiting on the serial port
+        uint64_t worst_loop_ns;
+        uint64_t serial_stall_ns;
+};
+
+// run paced loops for ms milliseconds like run_for(), keeping track of the
+// ones where the system state changed. We find those by peeking at the
+// sketch's event ring, every state change logs an EV_STATE.
+static void run_transitions(struct vclient *c, unsigned long ms,
+                            struct transition_stats *st)
+{
+        uint64_t end = sim_now_ns() + ms * 1000000ULL;
+
+        while (sim_now_ns() < end) {
+                uint8_t wr_before = event_wr;
+                uint64_t stall_before = sim_serial_stall_ns;
+                uint64_t took_ns = paced_loop();
+                unsigned changes = 0;
+
+                vclient_drain(c);
+                for (uint8_t i = wr_before; i != event_wr; ++i)
+                        if (event_ring[i % EVENT_RING_LEN].id == EV_STATE)
+                                ++changes;
+                if (changes == 0)
+                        continue;
+
+                st->transitions += changes;
+                ++st->loops;
+                st->worst_loop_ns = max(st->worst_loop_ns, took_ns);
+                st->serial_stall_ns += sim_serial_stall_ns - stall_before;
+        }
+}
+
+// walk the state machine through a few transitions and check that none of
+// them waited on the serial port, and that what went out the serial port is
+// the same events the client got
+static int sim_serial()
+{
+        struct vclient c = vclient();
+        struct transition_stats st;
+        std::vector<uint8_t> serial_events;
+
+        memset(&st, 0, sizeof st);
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_transitions(&c, 100, &st);
+
+        // no continuity across the igniter: SS_READY -> SS_FIRE -> SS_READY
+        sim_analog[sys_igniter.igniter_cont_sense] = 0;
+        vclient_send_req(&c, REQ_CMD_START, 10, 2);
+        run_transitions(&c, 300, &st);
+
+        // SS_READY -> SS_FIRE, and then SS_FIRE -> SS_SAFING
+        sim_analog[sys_igniter.igniter_cont_sense] = 512;
+        vclient_send_req(&c, REQ_CMD_START, 10, 3);
+        run_transitions(&c, 300, &st);
+        vclient_send_req(&c, REQ_CMD_STOP, 0, 4);
+        run_transitions(&c, 300, &st);
+
+        // the serial port gets the exact same packets back to back
+        for (size_t off = 0; off + sizeof(struct event_packet)
+                     <= sim_serial_out.size();
+             off += sizeof(struct event_packet)) {
+                struct event_packet epkt;
+                memcpy(&epkt, &sim_serial_out[off], sizeof epkt);
+                if (epkt.header.type != PT_EVENT
+                    || epkt.header.len != sizeof epkt
+                    || !elet_packet_crc_ok(&epkt.header)) {
+                        fprintf(stderr, "garbage on the serial port at %zu\n",
+                                off);
+                        return 1;
+                }
+                serial_events.push_back(epkt.id);
+        }
+
+        bool ok = st.transitions == 4 && st.serial_stall_ns == 0
+                && sys_state == SS_SAFING
+                && valve_pins_ok()
+                && sim_serial_out.size() % sizeof(struct event_packet) == 0
+                && serial_events == c.events;
+
+        printf("transitions %u in %u loops, worst transition loop %.1f ms, serial stall "
+               "%.1f ms (%.1f ms total), events: serial %zu, client %zu: "
+               "%s\n",
+               st.transitions, st.loops, st.worst_loop_ns / 1e6,
+               st.serial_stall_ns / 1e6, sim_serial_stall_ns / 1e6,
+               serial_events.size(), c.events.size(), ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// fire with a slow load cell holding up every loop, and see how close to
+// their deadlines the sequence steps ran. Every step from opening the n2
+// feed through the igniter and going to full flow, then abort, so safing
+// step 0 too.
+static int sim_steps(unsigned long load_cell_ms)
+{
+        struct vclient c = vclient();
+        uint64_t loop_ns = 0, worst_loop_ns = 0;
+        unsigned long loops = 0;
+        long worst_us = 0;
+
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+
+        sim_load_cell_us = load_cell_ms * 1000;
+        vclient_send_req(&c, REQ_CMD_START, 10, 2);
+        while (sys_state != SS_FIRE || fire_state < 9) {
+                uint64_t took_ns = paced_loop();
+
+                vclient_drain(&c);
+                loop_ns += took_ns;
+                worst_loop_ns = max(worst_loop_ns, took_ns);
+                ++loops;
+        }
+        vclient_send_req(&c, REQ_CMD_STOP, 0, 3);
+        run_for(&c, 1, 200);
+        sim_load_cell_us = 0;
+
+        printf("%-8s %5s %10s\n", "sequence", "step", "late us");
+        for (size_t i = 0; i < c.steps.size(); ++i) {
+                const struct event_packet *ev = &c.steps[i];
+                long late = (int32_t)ev->arg1;
+
+                printf("%-8s %5u %10ld\n",
+                       ev->id == EV_FIRE_STEP ? "fire"
+                       : ev->id == EV_SAFING_STEP ? "safing" : "depress",
+                       ev->arg0, late);
+                if (labs(late) > labs(worst_us))
+                        worst_us = late;
+        }
+
+        // fire steps 1-8 and safing step 0. On the virtual clock the timer
+        // interrupt is never late, so a step can only be off by how the
+        // deadline rounds to a timer tick. The igniter has to be off, the
+        // pulse ends on its own. The server's own timing has to have seen
+        // the slow load cell too. The transitions have to tell the same
+        // story.
+        const long lined_up = transitions_check(&c);
+        bool ok = c.steps.size() == 9
+                && lined_up > 0
+                && c.stats_pkts > 0
+                && c.max_us[LS_GATHER] >= load_cell_ms * 1000
+                && c.max_us[LS_LOOP] >= c.max_us[LS_GATHER]
+                && labs(worst_us) < (long)SCHED_US_PER_TICK
+                && sys_state == SS_SAFING
+                && !digitalRead(sys_igniter.igniter_fire_ctl_be_careful)
+                && valve_pins_ok();
+
+        printf("load cell %lu ms, mean loop %.1f ms, worst loop %.1f ms "
+               "(server says %.1f ms), worst step %ld us late, %zu "
+               "transitions, %ld on a step: %s\n",
+               load_cell_ms, loop_ns / 1e6 / loops, worst_loop_ns / 1e6,
+               c.max_us[LS_LOOP] / 1e3, worst_us, c.transitions.size(),
+               lined_up, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// fire, and a little way in push the ox pressure over its redline. Time it
+// from the sensor reading high to the n2 feed closing, which is when safing
+// step 0 says it ran. A spike shorter than the debounce mustn't trip
+// anything.
+static int sim_redline()
+{
+        struct vclient c = vclient();
+        const uint8_t ox = pressure_sensor_properties[PS_OXYGEN].pin;
+        const int normal = sim_analog[ox];
+        const struct redline_rule *rl = &redline_rules[RL_OX_OVER];
+        const int high = rl->threshold + 1;
+        const double psi = rl->threshold * pressure_sensor_properties[
+                PS_OXYGEN].slope + pressure_sensor_properties[PS_OXYGEN].offset;
+        unsigned loops = 0;
+
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+        vclient_send_req(&c, REQ_CMD_START, 10, 2);
+        run_for(&c, 1, 300);
+
+        if (sys_state != SS_FIRE || !valve_pin_open(N2_ON_OFF)) {
+                fprintf(stderr, "n2 feed never opened\n");
+                return 1;
+        }
+
+        // one high reading
+        sim_analog[ox] = high;
+        paced_loop();
+        sim_analog[ox] = normal;
+        run_for(&c, 1, 100);
+        bool spike_ok = sys_state == SS_FIRE && !c.redline_tripped;
+
+        // and for real. The reading changes between loops, like it would
+        // between two analogRead()s.
+        uint32_t start = micros();
+        sim_analog[ox] = high;
+        while (valve_pin_open(N2_ON_OFF) && loops < 100) {
+                paced_loop();
+                ++loops;
+        }
+        sim_analog[ox] = normal;
+        run_for(&c, 1, 50);
+
+        double ms = -1;
+        for (size_t i = 0; i < c.steps.size(); ++i)
+                if (c.steps[i].id == EV_SAFING_STEP && c.steps[i].arg0 == 0)
+                        ms = (c.steps[i].us - start) / 1e3;
+
+        // it should trip on exactly the debounce'th reading, and go to
+        // safing in that same loop
+        // and the limit is where the calibration says, to within a count
+        bool ok = spike_ok
+                && fabs(psi - REDLINE_OVER_PSI)
+                        <= pressure_sensor_properties[PS_OXYGEN].slope
+                && loops == rl->debounce
+                && ms >= 0
+                && c.redline_tripped && c.redline == RL_OX_OVER
+                && sys_state == SS_SAFING
+                && valve_pins_ok();
+
+        printf("spike: %s; ox over pressure at %.1f psi: tripped %s after "
+               "%u loops (debounce %u), sensor-to-abort %.1f ms: %s\n",
+               spike_ok ? "ignored" : "TRIPPED", psi,
+               c.redline_tripped ? redline_to_str((enum redline)c.redline)
+               : "nothing", loops, rl->debounce, ms, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// data packets should go out at the rate for the state we're in, set with
+// REQ_CMD_RATE, and right away when a valve moves, whatever the rate
+static int sim_rate()
+{
+        struct vclient c = vclient();
+        const unsigned idle_ms = data_interval_ms[SS_READY];
+        unsigned long before;
+
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+
+        before = c.data_pkts;
+        run_for(&c, 1, 1000);
+        unsigned long idle = c.data_pkts - before;
+
+        // right after a data packet, so the next one isn't due for a while
+        before = c.data_pkts;
+        while (c.data_pkts == before)
+                run_for(&c, 1, SIM_LOOP_PERIOD_US / 1000);
+        before = c.data_pkts;
+        uint32_t start = millis();
+        vclient_send_req(&c, REQ_MOD_VALVE,
+                         elet_valve_arg_pack(OX_BLEED, 1), 2);
+        while (!(c.last_vlv_states & VALVE_BIT(OX_BLEED))
+               && millis() - start < 1000)
+                run_for(&c, 1, SIM_LOOP_PERIOD_US / 1000);
+        uint32_t valve_ms = millis() - start;
+
+        vclient_send_req(&c, REQ_CMD_RATE, elet_rate_arg_pack(SS_READY, 0),
+                         3);
+        run_for(&c, 1, 100);
+        before = c.data_pkts;
+        run_for(&c, 1, 1000);
+        unsigned long full = c.data_pkts - before;
+
+        vclient_send_req(&c, REQ_CMD_RATE,
+                         elet_rate_arg_pack(SS_READY, 1000), 4);
+        run_for(&c, 1, 100);
+        before = c.data_pkts;
+        run_for(&c, 1, 3000);
+        unsigned long slow = c.data_pkts - before;
+
+        // a loop for the command to land and one to send the packet
+        bool ok = c.session.ready_ms == idle_ms
+                && idle >= 9 && idle <= 11
+                && valve_ms <= 2 * SIM_LOOP_PERIOD_US / 1000
+                && full >= 95 && full <= 101
+                && slow >= 2 && slow <= 4
+                && c.last_seq == 4
+                && valve_pins_ok();
+
+        printf("ready: %lu pkts/s at %u ms, valve change out after %u ms, "
+               "%lu pkts/s at 0 ms, %lu in 3 s at 1000 ms: %s\n", idle,
+               idle_ms, valve_ms, full, slow, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// safe the engine with the ox tank full, and bleed it down through the ox
+// bleed valve like the real tank would: exponentially, towards atmospheric.
+// Safing should stop waiting once the reading has settled, SEQ_SETTLE_MS
+// into its last step, instead of the full 7 s.
+static int sim_bleed()
+{
+        struct vclient c = vclient();
+        const uint8_t ox = pressure_sensor_properties[PS_OXYGEN].pin;
+        const int atmospheric = sim_analog[ox];
+        const unsigned long bleed_tau_ms = 300;
+
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+
+        sim_analog[ox] = 600;
+        uint32_t start = micros();
+        vclient_send_req(&c, REQ_CMD_STOP, 0, 2);
+
+        uint32_t last = micros();
+        double p = sim_analog[ox];
+        while (!c.seq_done && micros() - start < 15000000UL) {
+                paced_loop();
+                vclient_drain(&c);
+
+                uint32_t now = micros();
+                if (valve_pin_open(OX_BLEED))
+                        p = atmospheric + (p - atmospheric)
+                                * exp(-(now - last) / 1e3 / bleed_tau_ms);
+                sim_analog[ox] = (int)p;
+                last = now;
+        }
+        double took = (micros() - start) / 1e6;
+        sim_analog[ox] = atmospheric;
+
+        // 1 + 1 + 3 s of fixed steps, then the settle window
+        double want = 5 + SEQ_SETTLE_MS / 1e3;
+        bool ok = c.seq_done
+                && took > want - 0.1 && took < want + 0.5
+                && c.saved_ms > 7000 - SEQ_SETTLE_MS - 100
+                && c.saved_ms <= 7000 - SEQ_SETTLE_MS
+                && sys_state == SS_READY
+                && valve_pins_ok();
+
+        printf("safing took %.2f s (fixed waits 12 s), server says %lu ms "
+               "saved: %s\n", took, (unsigned long)c.saved_ms,
+               ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+static void __attribute__((noreturn)) usage();
+
+// is every valve shut, flow valves included?
+static bool all_valves_closed()
+{
+        for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v))
+                if (plant_valve(v) != 0)
+                        return false;
+        return true;
+}
+
+// one trial in a campaign: a burn, safing, and a depress, against the plant
+// with one fault set up
+struct scenario {
+        unsigned burn_s;
+        uint8_t ox_pwm;
+        uint8_t fuel_pwm;
+        enum plant_fault fault;
+};
+
+// what came of a scenario. A child process fills this in and sends it back
+// up a pipe.
+struct scenario_result {
+        bool ok;
+
+        // "burned", "no continuity", or "redline <rule>"
+        char outcome[32];
+
+        // from the sketch's own event timestamps: the burn is from full
+        // flow to safing step 0, and the total is from going into SS_FIRE
+        // to the end of depress
+        double burn_s;
+        double safing_s;
+        double depress_s;
+        double total_s;
+        uint32_t saved_ms;
+        long worst_late_us;
+
+        double max_ox_psi;
+        double max_fuel_psi;
+        double max_lbf;
+
+        // from run_stats, like client.c would print
+        double impulse;
+        double peak_lbf;
+
+        // wall time the scenario took
+        double host_ms;
+};
+
+#define CAMPAIGN_DEPRESS_S 15
+
+// what safing's fixed waits add up to, if the ox line never reads empty
+#define CAMPAIGN_SAFING_S 12
+
+// the low thrust redline is off on the real thing until someone knows what
+// the engine makes, but it's the only one that catches a burn that never
+// lit. The plant makes a few hundred lbf when it's lit.
+#define CAMPAIGN_THRUST_LOW_LBF 50
+
+static void scenario_name(const struct scenario *sc, char *buf, size_t len)
+{
+        snprintf(buf, len, "b%u-ox%u-fu%u-%s", sc->burn_s, sc->ox_pwm,
+                 sc->fuel_pwm, plant_fault_names[sc->fault]);
+}
+
+// run paced loops until the server has gone back to SS_READY, giving up
+// after ms
+static bool run_until_ready(struct vclient *c, unsigned long ms)
+{
+        uint64_t end = sim_now_ns() + ms * 1000000ULL;
+
+        do {
+                paced_loop();
+                vclient_drain(c);
+        } while (sys_state != SS_READY && sim_now_ns() < end);
+
+        return sys_state == SS_READY;
+}
+
+// when the server went into state ss, the last time it did, 0 if never
+static uint32_t state_entered_us(const struct vclient *c, enum system_state ss)
+{
+        uint32_t us = 0;
+
+        for (size_t i = 0; i < c->states.size(); ++i)
+                if (c->states[i].arg1 == ss)
+                        us = c->states[i].us;
+        return us;
+}
+
+// when a sequence step ran, 0 if it didn't
+static uint32_t step_ran_us(const struct vclient *c, uint8_t id, uint8_t step)
+{
+        for (size_t i = 0; i < c->steps.size(); ++i)
+                if (c->steps[i].id == id && c->steps[i].arg0 == step)
+                        return c->steps[i].us;
+        return 0;
+}
+
+static void run_scenario(const struct scenario *sc, const char *dir,
+                         uint32_t seed, struct scenario_result *res)
+{
+        struct vclient c = vclient();
+        const uint64_t host_start = sim_wall_ns();
+        const char *expect;
+        char name[64];
+
+        memset(res, 0, sizeof *res);
+        scenario_name(sc, name, sizeof name);
+        if (dir) {
+                char path[PATH_MAX];
+                snprintf(path, sizeof path, "%s/%s.log", dir, name);
+                c.logfd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+                if (c.logfd == -1) {
+                        perror(path);
+                        c.logfd = 0;
+                }
+        }
+
+        fire_ox_pwm = sc->ox_pwm;
+        fire_fuel_pwm = sc->fuel_pwm;
+        plant_start(sc->fault, seed);
+
+        run_stats_reset(&c.run);
+        vclient_connect(&c, HELLO_ROLE_COMMANDER, 1);
+        run_for(&c, 1, 100);
+
+        const long thrust_low = lround((CAMPAIGN_THRUST_LOW_LBF
+                                        - load_cell_props.offset)
+                                       / load_cell_props.slope);
+        vclient_send_req(&c, REQ_CMD_REDLINE,
+                         elet_redline_arg_pack(RL_THRUST_LOW, thrust_low), 2);
+        run_for(&c, 1, 20);
+
+        vclient_send_req(&c, REQ_CMD_START, sc->burn_s, 3);
+        bool safed = run_until_ready(&c, (sc->burn_s + 60) * 1000UL);
+        uint32_t fire_us = state_entered_us(&c, SS_FIRE);
+        uint32_t ready_us = state_entered_us(&c, SS_READY);
+
+        vclient_send_req(&c, REQ_CMD_DEPRESS, CAMPAIGN_DEPRESS_S, 4);
+        bool depressed = run_until_ready(&c, (CAMPAIGN_DEPRESS_S + 60)
+                                         * 1000UL);
+        uint32_t depress_us = state_entered_us(&c, SS_DEPRESS);
+
+        // a burn that runs its course ends with the last fire step doing
+        // safing step 0, one that's cut short goes to safing step 0
+        uint32_t full_flow_us = step_ran_us(&c, EV_FIRE_STEP, 8);
+        uint32_t safing_us = step_ran_us(&c, EV_FIRE_STEP, FIRE_BURN_STEP);
+        if (!safing_us)
+                safing_us = step_ran_us(&c, EV_SAFING_STEP, 0);
+        if (full_flow_us && safing_us)
+                res->burn_s = (safing_us - full_flow_us) / 1e6;
+        if (safing_us)
+                res->safing_s = (ready_us - safing_us) / 1e6;
+        res->depress_s = (state_entered_us(&c, SS_READY) - depress_us) / 1e6;
+        res->total_s = (state_entered_us(&c, SS_READY) - fire_us) / 1e6;
+        res->saved_ms = c.saved_ms;
+        for (size_t i = 0; i < c.steps.size(); ++i)
+                res->worst_late_us = max(res->worst_late_us,
+                                         (long)(int32_t)c.steps[i].arg1);
+
+        res->max_ox_psi = plant.max_ox_psi;
+        res->max_fuel_psi = plant.max_fuel_psi;
+        res->max_lbf = plant.max_lbf;
+        res->impulse = c.last_run.impulse;
+        res->peak_lbf = c.last_run.peak_lbf;
+
+        if (c.redline_tripped)
+                snprintf(res->outcome, sizeof res->outcome, "redline %s",
+                         redline_to_short_str((enum redline)c.redline));
+        else if (!full_flow_us)
+                snprintf(res->outcome, sizeof res->outcome, "no continuity");
+        else
+                snprintf(res->outcome, sizeof res->outcome, "burned");
+
+        switch (sc->fault) {
+        case PF_NO_CONTINUITY:
+                expect = "no continuity";
+                break;
+        case PF_NO_IGNITION:
+                expect = "redline thrust_low";
+                break;
+        case PF_OX_REGULATOR:
+                expect = "redline ox_over";
+                break;
+        case PF_FUEL_SENSOR_STUCK:
+                expect = "redline fuel_stuck";
+                break;
+        default:
+                expect = "burned";
+                break;
+        }
+
+        // whatever happened, it has to end up safe: back in SS_READY with
+        // every valve shut and the igniter off. A burn that didn't abort
+        // has to have lasted as long as we asked, and made thrust. If it
+        // got as far as flowing, the client's summary has to have come out
+        // when safing finished, and its peak has to be the plant's, give
+        // or take the sensor noise and the load cell's resolution. Safing
+        // has to end as soon as the ox line has bled down, well before its
+        // fixed waits are up, unless the bleed is clogged.
+        const bool bleeds = sc->fault != PF_SLOW_BLEED;
+        res->ok = safed && depressed
+                && (!safing_us
+                    || (bleeds ? res->safing_s < CAMPAIGN_SAFING_S - 1
+                        : res->safing_s > CAMPAIGN_SAFING_S - 0.01))
+                && (c.run_done || !full_flow_us)
+                && fabs(res->peak_lbf - res->max_lbf) < 2 * PLANT_NOISE_COUNTS
+                                                        + 1
+                && strcmp(res->outcome, expect) == 0
+                && valve_pins_ok()
+                && all_valves_closed()
+                && !digitalRead(sys_igniter.igniter_fire_ctl_be_careful)
+                && labs(res->worst_late_us) < (long)SCHED_US_PER_TICK
+                && (strcmp(expect, "burned") != 0
+                    || (fabs(res->burn_s - sc->burn_s) < 0.001
+                        && res->max_lbf > 0));
+
+        res->host_ms = (sim_wall_ns() - host_start) / 1e6;
+        if (c.logfd)
+                close(c.logfd);
+}
+
+// split a comma separated list of numbers
+static std::vector<unsigned> parse_list(const char *arg)
+{
+        std::vector<unsigned> v;
+        char *end;
+
+        for (;;) {
+                v.push_back(strtoul(arg, &end, 10));
+                if (*end != ',')
+                        break;
+                arg = end + 1;
+        }
+        if (*end)
+                v.clear();
+        return v;
+}
+
+// sweep burn times, flow valve settings and faults, every combination of
+// them a scenario of its own. Each scenario runs in a child process forked
+// off before the sketch has run at all, so each one starts from a freshly
+// booted server, and up to `jobs` of them run at once. With -o, each
+// scenario's packets go to <dir>/<scenario>.log in run.log's format, for
+// post.py.
+static int sim_campaign(int argc, char **argv)
+{
+        long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        const char *dir = NULL;
+        std::vector<unsigned> burns = parse_list("2,10,30,60,120");
+        std::vector<unsigned> ox_pwms = parse_list("95,119,143");
+        std::vector<unsigned> fuel_pwms = parse_list("90,110,130");
+        std::vector<enum plant_fault> faults;
+        std::vector<struct scenario> scs;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "j:o:b:x:u:f:")) != -1) {
+                switch (opt) {
+                case 'j':
+                        jobs = atol(optarg);
+                        break;
+                case 'o':
+                        dir = optarg;
+                        break;
+                case 'b':
+                        burns = parse_list(optarg);
+                        break;
+                case 'x':
+                        ox_pwms = parse_list(optarg);
+                        break;
+                case 'u':
+                        fuel_pwms = parse_list(optarg);
+                        break;
+                case 'f':
+                        for (char *f = strtok(optarg, ","); f;
+                             f = strtok(NULL, ",")) {
+                                int i;
+                                for (i = 0; i < NR_PLANT_FAULTS; ++i)
+                                        if (!strcmp(f, plant_fault_names[i]))
+                                                break;
+                                if (i == NR_PLANT_FAULTS) {
+                                        fprintf(stderr, "no fault %s\n", f);
+                                        return 1;
+                                }
+                                faults.push_back((enum plant_fault)i);
+                        }
+                        break;
+                default:
+                        usage();
+                }
+        }
+
+        if (faults.empty())
+                for (int i = 0; i < NR_PLANT_FAULTS; ++i)
+                        faults.push_back((enum plant_fault)i);
+
+        if (jobs < 1 || burns.empty() || ox_pwms.empty()
+            || fuel_pwms.empty())
+                usage();
+
+        for (size_t b = 0; b < burns.size(); ++b) {
+                if (burns[b] < REQ_CMD_START_MIN_BURN_TIME
+                    || burns[b] > REQ_CMD_START_MAX_BURN_TIME) {
+                        fprintf(stderr, "burn time %u out of range\n",
+                                burns[b]);
+                        return 1;
+                }
+                for (size_t x = 0; x < ox_pwms.size(); ++x)
+                        for (size_t u = 0; u < fuel_pwms.size(); ++u)
+                                for (size_t f = 0; f < faults.size(); ++f)
+                                        scs.push_back({burns[b],
+                                                (uint8_t)ox_pwms[x],
+                                                (uint8_t)fuel_pwms[u],
+                                                faults[f]});
+        }
+
+        if (dir && mkdir(dir, 0755) == -1 && errno != EEXIST) {
+                perror(dir);
+                return 1;
+        }
+
+        std::vector<struct scenario_result> res(scs.size());
+        std::vector<pid_t> pids(jobs, 0);
+        std::vector<int> fds(jobs, -1);
+        std::vector<size_t> which(jobs, 0);
+        const uint64_t start = sim_wall_ns();
+        size_t next = 0, running = 0;
+
+        fflush(stdout);
+        while (next < scs.size() || running) {
+                // start as many as we have room for
+                for (long j = 0; j < jobs && next < scs.size(); ++j) {
+                        int p[2];
+
+                        if (pids[j])
+                                continue;
+                        if (pipe(p) == -1) {
+                                perror("pipe");
+                                return 1;
+                        }
+
+                        pid_t pid = fork();
+                        if (pid == -1) {
+                                perror("fork");
+                                return 1;
+                        }
+                        if (pid == 0) {
+                                struct scenario_result r;
+                                close(p[0]);
+                                run_scenario(&scs[next], dir, next + 1, &r);
+                                // small enough to go in one piece
+                                if (write(p[1], &r, sizeof r) != sizeof r)
+                                        _exit(1);
+                                _exit(0);
+                        }
+
+                        close(p[1]);
+                        pids[j] = pid;
+                        fds[j] = p[0];
+                        which[j] = next++;
+                        ++running;
+                }
+
+                pid_t pid = wait(NULL);
+                for (long j = 0; j < jobs; ++j) {
+                        if (pids[j] != pid)
+                                continue;
+
+                        struct scenario_result *r = &res[which[j]];
+                        if (read(fds[j], r, sizeof *r) != sizeof *r) {
+                                memset(r, 0, sizeof *r);
+                                snprintf(r->outcome, sizeof r->outcome,
+                                         "crashed");
+                        }
+                        close(fds[j]);
+                        pids[j] = 0;
+                        --running;
+                }
+        }
+        double wall_s = (sim_wall_ns() - start) / 1e9;
+
+        printf("%-36s %-20s %7s %7s %7s %7s %7s %5s %7s %7s %7s %8s %7s\n",
+               "scenario", "outcome", "burn s", "safe s", "depr s",
+               "total s", "saved", "late", "ox psi", "fu psi", "lbf",
+               "lbf s", "host ms");
+
+        unsigned failed = 0;
+        double sim_s = 0;
+        for (size_t i = 0; i < scs.size(); ++i) {
+                const struct scenario_result *r = &res[i];
+                char name[64];
+
+                scenario_name(&scs[i], name, sizeof name);
+                printf("%-36s %-20s %7.2f %7.2f %7.2f %7.2f %7.2f %5ld "
+                       "%7.0f %7.0f %7.0f %8.0f %7.1f%s\n",
+                       name, r->outcome, r->burn_s, r->safing_s,
+                       r->depress_s, r->total_s, r->saved_ms / 1e3,
+                       r->worst_late_us, r->max_ox_psi, r->max_fuel_psi,
+                       r->max_lbf, r->impulse, r->host_ms,
+                       r->ok ? "" : "  FAIL");
+                failed += !r->ok;
+                sim_s += r->total_s;
+        }
+
+        printf("%zu scenarios, %u failed: %.0f s of sequences in %.2f s on "
+               "%ld cores (%.0fx real time)\n", scs.size(), failed, sim_s,
+               wall_s, jobs, sim_s / wall_s);
+
+        return failed ? 1 : 0;
+}
+
+// serve the sketch on a TCP port so the real client can talk to it. If
+// drop_ms isn't 0, every drop_ms we yank the TCP connections out from
+// under the clients without telling the sketch, like a cable glitch.
+static int sim_serve(int port, unsigned long drop_ms)
+{
+        int fds[MAX_SOCK_NUM];
+        int lfd, one = 1;
+        struct sockaddr_in addr;
+        uint64_t next_drop = sim_wall_ns() + drop_ms * 1000000ULL;
+
+        for (int i = 0; i < MAX_SOCK_NUM; ++i)
+                fds[i] = -1;
+
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (lfd == -1) {
+                perror("socket");
+                return 1;
+        }
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (bind(lfd, (struct sockaddr *)&addr, sizeof addr) == -1
+            || listen(lfd, 8) == -1) {
+                perror("bind/listen");
+                return 1;
+        }
+        fcntl(lfd, F_SETFL, fcntl(lfd, F_GETFL) | O_NONBLOCK);
+
+        fprintf(stderr, "serving on 127.0.0.1:%d\n", port);
+
+        for (;;) {
+                int fd = accept(lfd, NULL, NULL);
+                if (fd != -1) {
+                        int sock = sim_connect();
+                        if (sock == -1) {
+                                close(fd);
+                        } else {
+                                fcntl(fd, F_SETFL,
+                                      fcntl(fd, F_GETFL) | O_NONBLOCK);
+                                fds[sock] = fd;
+                        }
+                }
+
+                if (drop_ms && sim_wall_ns() >= next_drop) {
+                        next_drop = sim_wall_ns() + drop_ms * 1000000ULL;
+                        for (int i = 0; i < MAX_SOCK_NUM; ++i) {
+                                if (fds[i] == -1)
+                                        continue;
+                                fprintf(stderr, "dropping socket %d\n", i);
+                                close(fds[i]);
+                                fds[i] = -1;
+                        }
+                }
+
+                for (int i = 0; i < MAX_SOCK_NUM; ++i) {
+                        uint8_t buf[4096];
+                        ssize_t n;
+
+                        if (fds[i] == -1)
+                                continue;
+
+                        // the sketch hung up on this one
+                        if (!sim_sockets[i].open) {
+                                close(fds[i]);
+                                fds[i] = -1;
+                                continue;
+                        }
+
+                        n = read(fds[i], buf, sizeof buf);
+                        if (n > 0) {
+                                sim_send(i, buf, n);
+                        } else if (n == 0 || errno != EAGAIN) {
+                                sim_disconnect(i);
+                                close(fds[i]);
+                                fds[i] = -1;
+                                continue;
+                        }
+
+                        // whatever the socket won't take right now stays
+                        // queued in the sim's TX buffer, just like on the
+                        // W5500
+                        while (!sim_sockets[i].tx.empty()) {
+                                std::deque<uint8_t> &tx = sim_sockets[i].tx;
+                                size_t len = min(tx.size(), sizeof buf);
+                                std::copy(tx.begin(), tx.begin() + len, buf);
+                                n = write(fds[i], buf, len);
+                                if (n <= 0)
+                                        break;
+                                tx.erase(tx.begin(), tx.begin() + n);
+                        }
+                }
+
+                paced_loop();
+        }
+}
+
+// stream every channel with the bench library in elet_arduino.h for a
+// second at 1 kHz, typing a setpoint half way through, and check what came
+// out the serial port: a sample every millisecond, none dropped, and the
+// setpoint on every one after it was typed
+static int sim_bench()
+{
+        const char *typed = "123.5\r";
+        unsigned long nr_samples = 0, off_grid = 0, bad = 0, dropped = 0;
+        unsigned long with_setpoint = 0, stale = 0;
+        uint32_t last_us = 0, last_seq = 0;
+        uint64_t start;
+
+        sim_serial_out.clear();
+        bench_stream_begin(BENCH_BIT(BENCH_OX) | BENCH_BIT(BENCH_FUEL)
+                           | BENCH_BIT(BENCH_LOAD_CELL), 1000);
+
+        start = sim_now_ns();
+        while (sim_now_ns() - start < 1000000000ULL) {
+                if (sim_now_ns() - start >= 500000000ULL && *typed)
+                        sim_serial_in.push_back(*typed++);
+                bench_stream_poll();
+
+                // whatever else the sketch's loop() does
+                sim_sleep_ns(50000);
+        }
+
+        for (size_t off = 0; off + sizeof(struct bench_packet)
+                     <= sim_serial_out.size();
+             off += sizeof(struct bench_packet)) {
+                struct bench_packet p;
+
+                memcpy(&p, &sim_serial_out[off], sizeof p);
+                if (p.header.type != PT_BENCH || p.header.len != sizeof p
+                    || !elet_packet_crc_ok(&p.header)) {
+                        ++bad;
+                        continue;
+                }
+
+                if (nr_samples && (p.us - last_us < 950 || p.us - last_us > 1050
+                                   || p.header.seq != last_seq + 1))
+                        ++off_grid;
+                if (p.fresh != p.channels)
+                        ++stale;
+                if (p.setpoint == 123.5f)
+                        ++with_setpoint;
+                dropped += p.dropped;
+                last_us = p.us;
+                last_seq = p.header.seq;
+                ++nr_samples;
+        }
+
+        // the setpoint goes in 500 ms in, and takes a few samples to type
+        bool ok = nr_samples >= 999 && nr_samples <= 1001 && !bad
+                && !off_grid && !dropped && !stale
+                && with_setpoint >= 490 && with_setpoint <= 500;
+
+        printf("bench: %lu samples, %lu with the setpoint, %lu off the 1 ms "
+               "grid, %lu dropped, %lu bad: %s\n", nr_samples, with_setpoint,
+               off_grid, dropped, bad, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// sweep the ox flow valve up and down like flow_control_calibration's
+// flow_sweep does, against the plant, and check that every step settled
+// where the plant says it should, and soon after it got there
+static int sim_sweep()
+{
+        static const uint8_t bins[] = {0, 34, 68, 102, 136, 170, 204, 238, 255};
+        const unsigned nr_bins = sizeof bins / sizeof bins[0];
+        const struct pressure_sensor_properties *props =
+                &pressure_sensor_properties[PS_OXYGEN];
+        unsigned long steps = 0, unsettled = 0, worst_settle_ms = 0;
+        double worst_err = 0, worst_hyst = 0;
+        struct sweep_step step;
+        float up[nr_bins];
+        uint32_t start;
+
+        plant_start(PF_NONE, 1);
+        set_valves(VALVE_BIT(OX_ON_OFF), 0);
+        delay(500);
+
+        start = millis();
+        for (unsigned n = 0; n < 2 * nr_bins - 1; ++n, ++steps) {
+                const unsigned i = n < nr_bins ? n : 2 * nr_bins - 2 - n;
+                const double k_out = PLANT_K_OX_FLOW * bins[i] / 255.0;
+                const double psi = PLANT_K_OX_ON_OFF * PLANT_OX_SUPPLY_PSI
+                        / (PLANT_K_OX_ON_OFF + k_out);
+                const double want = (psi - props->offset) / props->slope;
+
+                if (!sweep_settle(OX_FLOW, PS_OXYGEN, bins[i], &step))
+                        ++unsettled;
+                worst_err = max(worst_err, fabs(step.mean - want));
+                worst_settle_ms = max(worst_settle_ms,
+                                      (unsigned long)step.settle_ms);
+                if (n < nr_bins)
+                        up[i] = step.mean;
+                else
+                        worst_hyst = max(worst_hyst, fabs(up[i] - step.mean));
+        }
+        const unsigned long took_ms = millis() - start;
+        setup_all_valves();
+
+        bool ok = !unsettled && worst_err < 1.5 && worst_hyst < 1.5
+                && worst_settle_ms < 1000;
+
+        printf("sweep: %lu steps in %.2f s (%lu s at a fixed 60 s), worst "
+               "settle %lu ms, %lu unsettled, off by %.2f counts at worst, "
+               "hysteresis %.2f: %s\n", steps, took_ms / 1e3, steps * 60,
+               worst_settle_ms, unsettled, worst_err, worst_hyst,
+               ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+// real runs with numbers worked out by hand from reprocess's csv: the zero
+// is the mean of the SS_READY samples before the fire, and the rest adds up
+// the samples more than RUN_STATS_BURN_LBF over it in SS_FIRE and
+// SS_SAFING, each held until the next one
+struct known_run {
+        const char *log;
+        double zero_lbf;
+        double impulse;
+        double burn_s;
+        double peak_lbf;
+};
+
+static const struct known_run known_runs[] = {
+        {"real_run_2__5_seconds.log", 15.02, 67.0, 5.26, 16.8},
+        {"real_run_4__45_seconds.log", 16.63, 433.7, 39.06, 14.6},
+
+        // it never lit, the load cell moves by a pound or so. Going by the
+        // raw reading it "burned" for 109 s.
+        {"real_run_3__45_seconds.log", 24.2, 0, 0, 1.0},
+};
+
+// run the logs in dir through run_stats.h and check we get the known runs'
+// numbers back
+static int sim_stats(const char *dir)
+{
+        bool all_ok = true;
+
+        for (size_t i = 0; i < sizeof known_runs / sizeof known_runs[0]; ++i) {
+                const struct known_run *k = &known_runs[i];
+                struct pkt_stream stream;
+                struct run_stats run;
+                char path[PATH_MAX];
+                bool done = false;
+
+                memset(&stream, 0, sizeof stream);
+                snprintf(path, sizeof path, "%s/%s", dir, k->log);
+                if (pkt_stream_load(&stream, path) < 0) {
+                        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                        return 1;
+                }
+
+                // the first run in it
+                run_stats_reset(&run);
+                for (size_t off = 0; off < stream.len && !done; ) {
+                        struct data_packet d;
+                        struct packet_header hdr;
+
+                        memcpy(&hdr, stream.buf + off, sizeof hdr);
+                        off += hdr.len;
+                        if (hdr.type != PT_DATA)
+                                continue;
+
+                        memcpy(&d, stream.buf + off - hdr.len, sizeof d);
+                        done = run_stats_add(&run, d.header.timestamp,
+                                             elet_state_sys_state(d.state),
+                                             d.pressures[PS_OXYGEN],
+                                             d.pressures[PS_FUEL], d.thrust);
+                }
+                free(stream.buf);
+
+                bool ok = run.fired
+                        && fabs(run.zero_lbf - k->zero_lbf) < 0.1
+                        && fabs(run.impulse - k->impulse) < 0.5
+                        && fabs(run_stats_burn_duration(&run) - k->burn_s)
+                                < 0.05
+                        && fabs(run.peak_lbf - k->peak_lbf) < 0.1;
+
+                printf("%s: zero %.2f lbf, impulse %.1f lbf s, burned "
+                       "%.2f s, peak %.1f lbf: %s\n", k->log, run.zero_lbf,
+                       run.impulse, run_stats_burn_duration(&run),
+                       run.peak_lbf, ok ? "ok" : "FAIL");
+                all_ok &= ok;
+        }
+
+        return all_ok ? 0 : 1;
+}
+
+static void __attribute__((noreturn)) usage()
+{
+        fprintf(stderr,
+                "usage: launch_sim [-v] clients [nclients [nloops]]\n"
+                "       launch_sim [-v] reconnect\n"
+                "       launch_sim [-v] serial\n"
+                "       launch_sim [-v] steps [load_cell_ms]\n"
+                "       launch_sim [-v] redline\n"
+                "       launch_sim [-v] bleed\n"
+                "       launch_sim [-v] rate\n"
+                "       launch_sim [-v] bench\n"
+                "       launch_sim [-v] sweep\n"
+                "       launch_sim [-v] stats [log_dir]\n"
+                "       launch_sim [-v] campaign [-j jobs] [-o dir] "
+                "[-b burn_s,...] [-x ox_pwm,...]\n"
+                "                               [-u fuel_pwm,...] "
+                "[-f fault,...]\n"
+                "       launch_sim [-v] serve [port [drop_ms]]\n");
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i = 1;
+
+        if (i < argc && strcmp(argv[i], "-v") == 0) {
+                sim_verbose = true;
+                ++i;
+        }
+
+        if (i >= argc)
+                usage();
+
+        // plausible resting values: ~200 counts on the pressure sensors is
+        // atmospheric, and the igniter has continuity
+        sim_analog[pressure_sensor_properties[PS_OXYGEN].pin] = 199;
+        sim_analog[pressure_sensor_properties[PS_FUEL].pin] = 198;
+        sim_analog[sys_igniter.igniter_cont_sense] = 512;
+        sim_analog[sys_igniter.ignition_sense] = 512;
+
+        // interrupts wake us up from sleeping between loops, see
+        // sim_sleep_ns(). The default 50 us of timer slack would be most of
+        // what we're trying to measure.
+        prctl(PR_SET_TIMERSLACK, 1UL);
+
+        // everything but timing loop() itself and talking to a real client
+        // is about what the sketch does, not how fast the host is, so it
+        // runs on the virtual clock
+        sim_virtual_clock = strcmp(argv[i], "clients") != 0
+                && strcmp(argv[i], "serve") != 0;
+
+        setup();
+
+        if (strcmp(argv[i], "clients") == 0) {
+                int nclients = i + 1 < argc ? atoi(argv[i + 1]) : 4;
+                int nloops = i + 2 < argc ? atoi(argv[i + 2]) : 100000;
+
+                if (nclients < 1 || nclients > MAX_CLIENTS || nloops < 1)
+                        usage();
+
+                return sim_clients(nclients, nloops);
+        }
+
+        if (strcmp(argv[i], "reconnect") == 0)
+                return sim_reconnect();
+
+        if (strcmp(argv[i], "serial") == 0)
+                return sim_serial();
+
+        if (strcmp(argv[i], "steps") == 0)
+                return sim_steps(i + 1 < argc ? strtoul(argv[i + 1], NULL, 10)
+                                 : 40);
+
+        if (strcmp(argv[i], "redline") == 0)
+                return sim_redline();
+
+        if (strcmp(argv[i], "bleed") == 0)
+                return sim_bleed();
+
+        if (strcmp(argv[i], "rate") == 0)
+                return sim_rate();
+
+        if (strcmp(argv[i], "bench") == 0)
+                return sim_bench();
+
+        if (strcmp(argv[i], "sweep") == 0)
+                return sim_sweep();
+
+        if (strcmp(argv[i], "stats") == 0)
+                return sim_stats(i + 1 < argc ? argv[i + 1]
+                                 : "../launch_client");
+
+        if (strcmp(argv[i], "campaign") == 0)
+                return sim_campaign(argc - i, argv + i);
+
+        if (strcmp(argv[i], "serve") == 0) {
+                int port = i + 1 < argc ? atoi(argv[i + 1]) : 4200;
+                unsigned long drop_ms =
+                        i + 2 < argc ? strtoul(argv[i + 2], NULL, 10) : 0;
+
+                return sim_serve(port, drop_ms);
+        }
+
+        usage();
+}
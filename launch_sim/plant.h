@@ -0,0 +1,237 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+// a toy model of the test stand for the virtual clock: the ox line, the
+// fuel tank, and the engine's thrust, driven by the sketch's valve pins and
+// feeding its sensors.
+//
+// The ox pressure sensor sits between the ox on/off valve and the ox flow
+// valve. The regulated ox supply fills that stretch of line through the
+// on/off valve, and it drains into the engine through the flow valve and
+// out the bleed. The fuel tank is pressurized with nitrogen through the n2
+// on/off valve and drains into the engine through the fuel on/off and flow
+// valves, one after the other.
+//
+// Each of those is dP/dt = k_in (P_supply - P) - k_out P, where the k's are
+// how far open the valves are. As long as the valves stay put that has an
+// exact solution, and on the virtual clock the valves only ever move while
+// time is standing still, so plant_advance() steps straight from one of
+// those moments to the next instead of integrating in little steps.
+//
+// Pressures are psi gauge. This is included by launch_sim.cpp after the
+// sketch, so it can see the pin tables.
+
+#include <math.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+// the regulators, and the ox bottle, which is what a failed ox regulator
+// passes straight through
+#define PLANT_OX_SUPPLY_PSI 600.0
+#define PLANT_OX_BOTTLE_PSI 2000.0
+#define PLANT_N2_SUPPLY_PSI 550.0
+
+// how fast a wide open valve moves pressure, 1/s
+#define PLANT_K_OX_ON_OFF 20.0
+#define PLANT_K_OX_FLOW 10.0
+#define PLANT_K_OX_BLEED 3.0
+#define PLANT_K_N2_ON_OFF 5.0
+#define PLANT_K_FUEL_ON_OFF 2.0
+#define PLANT_K_FUEL_FLOW 1.0
+
+// thrust while lit, for each psi of whatever is flowing into the engine
+#define PLANT_LBF_PER_PSI 0.4
+
+// sensor noise, +- counts. Real sensors are never perfectly still, and the
+// stuck sensor redlines count on that.
+#define PLANT_NOISE_COUNTS 2
+
+enum plant_fault {
+        PF_NONE,
+
+        // the igniter has no continuity, so the fire sequence shouldn't
+        // get past step 0
+        PF_NO_CONTINUITY,
+
+        // the igniter fires, but nothing lights
+        PF_NO_IGNITION,
+
+        // a second into the burn, the ox regulator fails wide open
+        PF_OX_REGULATOR,
+
+        // the fuel pressure sensor freezes when the burn starts
+        PF_FUEL_SENSOR_STUCK,
+
+        // the ox bleed is mostly clogged, so safing has to wait it out
+        PF_SLOW_BLEED,
+
+        NR_PLANT_FAULTS
+};
+
+static const char *const plant_fault_names[NR_PLANT_FAULTS] = {
+        [PF_NONE] = "none",
+        [PF_NO_CONTINUITY] = "no_continuity",
+        [PF_NO_IGNITION] = "no_ignition",
+        [PF_OX_REGULATOR] = "ox_regulator",
+        [PF_FUEL_SENSOR_STUCK] = "fuel_sensor_stuck",
+        [PF_SLOW_BLEED] = "slow_bleed",
+};
+
+struct plant {
+        enum plant_fault fault;
+
+        // the time the state below is for
+        uint64_t now_ns;
+
+        double ox_psi;
+        double fuel_psi;
+        bool lit;
+
+        // when it lit, for PF_OX_REGULATOR, and the frozen fuel reading
+        // for PF_FUEL_SENSOR_STUCK, 0 until it freezes
+        uint64_t lit_ns;
+        int stuck_fuel;
+
+        // the worst of everything so far
+        double max_ox_psi;
+        double max_fuel_psi;
+        double max_lbf;
+
+        // for the sensor noise
+        uint32_t rng;
+};
+
+static struct plant plant;
+
+// how far open a valve is, 0 to 1
+static double plant_valve(enum valve v)
+{
+        if (valve_is_flow(v))
+                return digitalRead(valve_properties[v].pin) / 255.0;
+
+        return *mega_port_reg(valve_ports[v].port) & valve_ports[v].mask
+                ? 1.0 : 0.0;
+}
+
+static int plant_noise()
+{
+        plant.rng = plant.rng * 1103515245 + 12345;
+        return (int)((plant.rng >> 16) % (2 * PLANT_NOISE_COUNTS + 1))
+                - PLANT_NOISE_COUNTS;
+}
+
+static int plant_counts(enum pressure_sensor ps, double psi)
+{
+        const struct pressure_sensor_properties *props =
+                &pressure_sensor_properties[ps];
+        int counts = (int)lround((psi - props->offset) / props->slope)
+                + plant_noise();
+
+        return max(0, min(1023, counts));
+}
+
+// P after dt seconds of dP/dt = k_in (supply - P) - k_out P
+static double plant_settle(double p, double supply, double k_in, double k_out,
+                           double dt)
+{
+        const double k = k_in + k_out;
+
+        if (k == 0)
+                return p;
+
+        const double eq = k_in * supply / k;
+        return eq + (p - eq) * exp(-k * dt);
+}
+
+// what the sensors read right now
+static void plant_sense()
+{
+        double lbf = 0;
+
+        if (plant.lit)
+                lbf = PLANT_LBF_PER_PSI
+                        * (plant_valve(OX_FLOW) * plant.ox_psi
+                           + plant_valve(FUEL_FLOW) * plant.fuel_psi);
+
+        plant.max_ox_psi = max(plant.max_ox_psi, plant.ox_psi);
+        plant.max_fuel_psi = max(plant.max_fuel_psi, plant.fuel_psi);
+        plant.max_lbf = max(plant.max_lbf, lbf);
+
+        sim_analog[pressure_sensor_properties[PS_OXYGEN].pin] =
+                plant_counts(PS_OXYGEN, plant.ox_psi);
+        sim_analog[pressure_sensor_properties[PS_FUEL].pin] =
+                plant.stuck_fuel ? plant.stuck_fuel
+                : plant_counts(PS_FUEL, plant.fuel_psi);
+        sim_load_cell = lround((lbf + plant_noise() - load_cell_props.offset)
+                               / load_cell_props.slope);
+}
+
+// catch up to to_ns with the valves where they are now. This is
+// sim_on_advance.
+static void plant_advance(uint64_t to_ns)
+{
+        const double dt = (to_ns - plant.now_ns) / 1e9;
+        const double ox_in = plant_valve(OX_ON_OFF);
+        const double ox_flow = plant_valve(OX_FLOW);
+        const double fuel_flow = plant_valve(FUEL_FLOW);
+        const double fuel_on = plant_valve(FUEL_ON_OFF);
+        double ox_supply = PLANT_OX_SUPPLY_PSI;
+        double bleed = PLANT_K_OX_BLEED;
+
+        // it lights if the igniter's going with both propellants flowing,
+        // and goes out if either stops
+        if (!ox_in || !ox_flow || !fuel_on || !fuel_flow)
+                plant.lit = false;
+        else if (!plant.lit && plant.fault != PF_NO_IGNITION
+                 && digitalRead(sys_igniter.igniter_fire_ctl_be_careful)) {
+                plant.lit = true;
+                plant.lit_ns = plant.now_ns;
+        }
+
+        if (plant.fault == PF_OX_REGULATOR && plant.lit_ns
+            && plant.now_ns - plant.lit_ns >= 1000000000ULL)
+                ox_supply = PLANT_OX_BOTTLE_PSI;
+        if (plant.fault == PF_SLOW_BLEED)
+                bleed /= 20;
+
+        // the two fuel valves in a row let through less than either
+        double fuel_out = 0;
+        if (fuel_on && fuel_flow)
+                fuel_out = 1 / (1 / (PLANT_K_FUEL_ON_OFF * fuel_on)
+                                + 1 / (PLANT_K_FUEL_FLOW * fuel_flow));
+
+        plant.ox_psi = plant_settle(plant.ox_psi, ox_supply,
+                                    PLANT_K_OX_ON_OFF * ox_in,
+                                    PLANT_K_OX_FLOW * ox_flow
+                                    + bleed * plant_valve(OX_BLEED), dt);
+        plant.fuel_psi = plant_settle(plant.fuel_psi, PLANT_N2_SUPPLY_PSI,
+                                      PLANT_K_N2_ON_OFF
+                                      * plant_valve(N2_ON_OFF),
+                                      fuel_out, dt);
+
+        if (plant.fault == PF_FUEL_SENSOR_STUCK && plant.lit
+            && !plant.stuck_fuel)
+                plant.stuck_fuel = plant_counts(PS_FUEL, plant.fuel_psi);
+
+        plant.now_ns = to_ns;
+        plant_sense();
+}
+
+// hook the plant up to the sketch: everything starts at atmospheric, with
+// the given fault waiting to happen. seed picks the sensor noise.
+static void plant_start(enum plant_fault fault, uint32_t seed)
+{
+        memset(&plant, 0, sizeof plant);
+        plant.fault = fault;
+        plant.now_ns = sim_now_ns();
+        plant.rng = seed;
+
+        sim_analog[sys_igniter.igniter_cont_sense] =
+                fault == PF_NO_CONTINUITY ? 0 : 512;
+
+        sim_on_advance = plant_advance;
+        plant_sense();
+}
+
+#endif // PLANT_H
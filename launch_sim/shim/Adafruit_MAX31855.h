@@ -0,0 +1,20 @@
+#ifndef SIM_ADAFRUIT_MAX31855_H
+#define SIM_ADAFRUIT_MAX31855_H
+
+#include <Arduino.h>
+
+class Adafruit_MAX31855 {
+public:
+        Adafruit_MAX31855(int8_t sclk, int8_t cs, int8_t miso) : cs(cs)
+        {
+                (void)sclk;
+                (void)miso;
+        }
+
+        double readFarenheit();
+
+private:
+        int8_t cs;
+};
+
+#endif // SIM_ADAFRUIT_MAX31855_H
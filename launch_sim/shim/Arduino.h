@@ -0,0 +1,125 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// just enough of the arduino core to compile launch_server.ino on a unix
+// box. Everything here is backed by the simulator in sim.cpp, see sim.h
+// for the knobs the simulator exposes.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+#define F_CPU 16000000UL
+
+// strings in flash. The sim doesn't have separate program memory, so F()
+// just changes the type, which is enough for print() to pick the same
+// overload it would on the arduino.
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+#define PROGMEM
+#define PSTR(s) (s)
+#define strncpy_P strncpy
+
+#define _BV(bit) (1 << (bit))
+
+// the bits of the AVR the sketch pokes at directly: the IO port output
+// registers, the status register and timer 5. cli() and sei() flip the
+// interrupt enable bit in SREG like the real ones, and the sim only runs
+// interrupt handlers while it's set.
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG,
+        PORTH, PORTJ, PORTK, PORTL;
+extern volatile uint8_t SREG;
+
+#define SREG_I 7
+
+static inline void cli() { SREG &= ~_BV(SREG_I); }
+static inline void sei() { SREG |= _BV(SREG_I); }
+
+// an interrupt flag register: writing a 1 to a bit clears it
+class sim_flag_reg {
+public:
+        uint8_t flags;
+
+        void operator=(uint8_t v) { flags &= ~v; }
+        operator uint8_t() const { return flags; }
+};
+
+// timer 5 counts off the sim's clock at whatever rate the prescaler bits in
+// TCCR5B say, in normal mode whatever TCCR5A says. Only the compare A match
+// interrupt is there. TCNT5 can be read but not written.
+extern volatile uint8_t TCCR5A, TCCR5B, TIMSK5;
+extern volatile uint16_t OCR5A;
+extern sim_flag_reg TIFR5;
+
+uint16_t sim_tcnt5();
+#define TCNT5 sim_tcnt5()
+
+#define CS50 0
+#define CS51 1
+#define CS52 2
+#define OCIE5A 1
+#define OCF5A 1
+
+// an interrupt handler is a plain function, which the sim calls when its
+// interrupt would have gone off. The sim can't stop the sketch between any
+// two instructions like the real thing, so interrupts happen when the
+// sketch calls into the shim (delay(), millis(), micros(), the load cell)
+// or is between loops.
+#define ISR(vect) void vect()
+
+void TIMER5_COMPA_vect();
+
+class HardwareSerial {
+public:
+        void begin(unsigned long baud);
+        operator bool() { return true; }
+
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buf, size_t len);
+        int availableForWrite();
+        int read();
+
+        size_t print(const char *s);
+        size_t print(const __FlashStringHelper *s);
+        size_t print(char c);
+        size_t print(int n);
+        size_t print(unsigned int n);
+        size_t print(long n);
+        size_t print(unsigned long n);
+        size_t print(double d);
+
+        size_t println();
+        template <typename T> size_t println(T t)
+        {
+                size_t n = print(t);
+                return n + println();
+        }
+};
+
+extern HardwareSerial Serial;
+
+#endif // SIM_ARDUINO_H
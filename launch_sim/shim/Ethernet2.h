@@ -0,0 +1,71 @@
+#ifndef SIM_ETHERNET2_H
+#define SIM_ETHERNET2_H
+
+// a fake of the Ethernet2 library. Sockets are in-memory byte queues owned
+// by the simulator (see struct sim_socket in sim.h); the semantics of
+// available(), connected(), stop() etc. mirror the real library closely
+// enough that launch_server.ino can't tell the difference.
+
+#include <Arduino.h>
+#include <utility/w5500.h>
+
+class IPAddress {
+public:
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        {
+                addr[0] = a;
+                addr[1] = b;
+                addr[2] = c;
+                addr[3] = d;
+        }
+
+private:
+        uint8_t addr[4];
+};
+
+class EthernetClass {
+public:
+        int begin(uint8_t *mac, IPAddress ip);
+};
+
+extern EthernetClass Ethernet;
+
+class EthernetClient {
+public:
+        EthernetClient() : _sock(MAX_SOCK_NUM) {}
+        EthernetClient(uint8_t sock) : _sock(sock) {}
+
+        uint8_t connected();
+        int available();
+        int read();
+        int read(uint8_t *buf, size_t size);
+        size_t write(uint8_t b);
+        size_t write(const uint8_t *buf, size_t size);
+        void flush() {}
+        void stop();
+
+        uint8_t getSocketNumber() { return _sock; }
+
+        operator bool() { return _sock != MAX_SOCK_NUM; }
+        bool operator==(const EthernetClient &rhs)
+        {
+                return _sock == rhs._sock && _sock != MAX_SOCK_NUM;
+        }
+        bool operator!=(const EthernetClient &rhs) { return !(*this == rhs); }
+
+private:
+        uint8_t _sock;
+};
+
+class EthernetServer {
+public:
+        EthernetServer(uint16_t port) : _port(port) {}
+
+        void begin();
+        EthernetClient available();
+
+private:
+        uint16_t _port;
+};
+
+#endif // SIM_ETHERNET2_H
@@ -0,0 +1,20 @@
+#ifndef SIM_Q2HX711_H
+#define SIM_Q2HX711_H
+
+#include <Arduino.h>
+
+class Q2HX711 {
+public:
+        Q2HX711(byte output_pin, byte clock_pin)
+        {
+                (void)output_pin;
+                (void)clock_pin;
+        }
+
+        long read();
+
+        // the sim always has a reading ready
+        bool readyToSend() { return true; }
+};
+
+#endif // SIM_Q2HX711_H
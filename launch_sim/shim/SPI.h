@@ -0,0 +1,6 @@
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+// nothing to see here, the simulated W5500 doesn't talk SPI
+
+#endif // SIM_SPI_H
@@ -0,0 +1,25 @@
+#ifndef SIM_W5500_H
+#define SIM_W5500_H
+
+// the parts of Ethernet2's W5500 driver that launch_server.ino pokes at
+// directly
+
+#include <stdint.h>
+
+#define MAX_SOCK_NUM 8
+
+typedef uint8_t SOCKET;
+
+class W5500Class {
+public:
+        uint16_t getTXFreeSize(SOCKET s);
+
+        // socket memory sizes in K, the Sn_TXBUF_SIZE and Sn_RXBUF_SIZE
+        // registers
+        void writeSnTX_SIZE(SOCKET s, uint8_t kb);
+        void writeSnRX_SIZE(SOCKET s, uint8_t kb);
+};
+
+extern W5500Class w5500;
+
+#endif // SIM_W5500_H
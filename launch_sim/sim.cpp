@@ -0,0 +1,546 @@
+#include <deque>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <Arduino.h>
+#include <Adafruit_MAX31855.h>
+#include <Ethernet2.h>
+#include <Q2HX711.h>
+
+#include "sim.h"
+
+struct sim_socket sim_sockets[MAX_SOCK_NUM];
+
+int sim_analog[16];
+long sim_load_cell = 9654568;
+unsigned long sim_load_cell_us;
+bool sim_verbose = false;
+
+static uint8_t sim_pins[70];
+
+volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, PORTH,
+        PORTJ, PORTK, PORTL;
+volatile uint8_t SREG = _BV(SREG_I);
+
+volatile uint8_t TCCR5A, TCCR5B, TIMSK5;
+volatile uint16_t OCR5A;
+sim_flag_reg TIFR5;
+
+HardwareSerial Serial;
+EthernetClass Ethernet;
+W5500Class w5500;
+
+uint64_t sim_wall_ns()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t sim_start_ns = sim_wall_ns();
+
+bool sim_virtual_clock;
+void (*sim_on_advance)(uint64_t to_ns);
+
+// the virtual clock starts where the wall clock was, so the sketch's
+// millis() starts near 0 either way
+static uint64_t sim_virtual_ns = sim_start_ns;
+
+uint64_t sim_now_ns()
+{
+        return sim_virtual_clock ? sim_virtual_ns : sim_wall_ns();
+}
+
+// move the virtual clock forward to ns
+static void sim_advance(uint64_t ns)
+{
+        if (ns <= sim_virtual_ns)
+                return;
+
+        if (sim_on_advance)
+                sim_on_advance(ns);
+        sim_virtual_ns = ns;
+}
+
+// nanoseconds per timer 5 tick, 0 if it's stopped
+static uint64_t sim_timer5_tick_ns()
+{
+        static const unsigned prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+        const unsigned p = prescale[TCCR5B & 7];
+
+        return p ? p * 1000000000ULL / F_CPU : 0;
+}
+
+// ticks since we started, as if the timer had always been running
+static uint64_t sim_timer5_ticks(uint64_t ns)
+{
+        return (ns - sim_start_ns) / sim_timer5_tick_ns();
+}
+
+uint16_t sim_tcnt5()
+{
+        if (!sim_timer5_tick_ns())
+                return 0;
+
+        return sim_timer5_ticks(sim_now_ns());
+}
+
+// when the counter next gets to OCR5A
+static uint64_t sim_timer5_match_ns(uint64_t now)
+{
+        const uint64_t tick_ns = sim_timer5_tick_ns();
+
+        if (!tick_ns || !(TIMSK5 & _BV(OCIE5A)))
+                return UINT64_MAX;
+
+        uint64_t ticks = sim_timer5_ticks(now);
+        uint32_t to = (uint16_t)(OCR5A - ticks);
+        if (to == 0)
+                to = 0x10000;
+
+        return sim_start_ns + (ticks + to) * tick_ns;
+}
+
+void sim_poll_interrupts()
+{
+        // the tick we last looked at
+        static uint64_t last;
+        static bool in_isr;
+
+        if (in_isr || !sim_timer5_tick_ns())
+                return;
+
+        // did the counter land on OCR5A since we last looked? That sets the
+        // flag whether or not the interrupt is enabled
+        const uint64_t now = sim_timer5_ticks(sim_now_ns());
+        uint32_t to = (uint16_t)(OCR5A - last);
+        if (to == 0)
+                to = 0x10000;
+        if (now - last >= to)
+                TIFR5.flags |= _BV(OCF5A);
+        last = now;
+
+        if (!(SREG & _BV(SREG_I)) || !(TIMSK5 & _BV(OCIE5A))
+            || !(TIFR5 & _BV(OCF5A)))
+                return;
+
+        // like the real thing: the flag clears and interrupts are off while
+        // the handler runs
+        TIFR5.flags &= ~_BV(OCF5A);
+        in_isr = true;
+        cli();
+        TIMER5_COMPA_vect();
+        sei();
+        in_isr = false;
+}
+
+void sim_sleep_ns(uint64_t ns)
+{
+        const uint64_t end = sim_now_ns() + ns;
+
+        for (;;) {
+                sim_poll_interrupts();
+
+                uint64_t now = sim_now_ns();
+                if (now >= end)
+                        return;
+
+                uint64_t wake = min(end, sim_timer5_match_ns(now));
+                if (sim_virtual_clock) {
+                        sim_advance(wake);
+                        continue;
+                }
+
+                struct timespec ts;
+                ts.tv_sec = wake / 1000000000ULL;
+                ts.tv_nsec = wake % 1000000000ULL;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+}
+
+unsigned long millis()
+{
+        sim_poll_interrupts();
+        return (sim_now_ns() - sim_start_ns) / 1000000;
+}
+
+unsigned long micros()
+{
+        sim_poll_interrupts();
+        return (sim_now_ns() - sim_start_ns) / 1000;
+}
+
+void delay(unsigned long ms)
+{
+        sim_sleep_ns(ms * 1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+        sim_sleep_ns(us * 1000ULL);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+        (void)pin;
+        (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+        sim_pins[pin] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+        return sim_pins[pin];
+}
+
+int analogRead(uint8_t pin)
+{
+        return sim_analog[pin];
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+        sim_pins[pin] = val;
+}
+
+uint64_t sim_serial_stall_ns;
+std::vector<uint8_t> sim_serial_out;
+std::deque<uint8_t> sim_serial_in;
+
+// the baud rate from begin(), and how many bytes are in the TX buffer as of
+// sim_serial_last_ns
+static unsigned long sim_serial_baud;
+static unsigned sim_serial_fill;
+static uint64_t sim_serial_last_ns;
+
+// a byte is 10 bits on the wire, with the start and stop bits
+static uint64_t sim_serial_byte_ns()
+{
+        return 10 * 1000000000ULL / sim_serial_baud;
+}
+
+// let the bytes that went out on the wire since we last looked leave the
+// TX buffer
+static void sim_serial_drain()
+{
+        uint64_t now = sim_now_ns();
+
+        if (sim_serial_fill == 0) {
+                sim_serial_last_ns = now;
+                return;
+        }
+
+        uint64_t sent = (now - sim_serial_last_ns) / sim_serial_byte_ns();
+        if (sent >= sim_serial_fill) {
+                sim_serial_fill = 0;
+                sim_serial_last_ns = now;
+        } else {
+                sim_serial_fill -= sent;
+                sim_serial_last_ns += sent * sim_serial_byte_ns();
+        }
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+        sim_serial_baud = baud;
+        sim_serial_fill = 0;
+        sim_serial_last_ns = sim_now_ns();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+        return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len)
+{
+        if (sim_serial_baud == 0) {
+                fprintf(stderr, "serial write before Serial.begin()\n");
+                exit(1);
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+                sim_serial_drain();
+                if (sim_serial_fill == SIM_SERIAL_TX_SIZE) {
+                        uint64_t start = sim_now_ns();
+                        while (sim_serial_fill == SIM_SERIAL_TX_SIZE) {
+                                // nothing moves the virtual clock while
+                                // we spin, so skip to the next byte out
+                                if (sim_virtual_clock)
+                                        sim_advance(sim_serial_last_ns
+                                                    + sim_serial_byte_ns());
+                                sim_serial_drain();
+                        }
+                        sim_serial_stall_ns += sim_now_ns() - start;
+                }
+                ++sim_serial_fill;
+        }
+
+        sim_serial_out.insert(sim_serial_out.end(), buf, buf + len);
+        return len;
+}
+
+int HardwareSerial::read()
+{
+        if (sim_serial_in.empty())
+                return -1;
+
+        int c = sim_serial_in.front();
+        sim_serial_in.pop_front();
+        return c;
+}
+
+int HardwareSerial::availableForWrite()
+{
+        sim_serial_drain();
+        return SIM_SERIAL_TX_SIZE - sim_serial_fill;
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+        return write((const uint8_t *)s, strlen(s));
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *s)
+{
+        return print((const char *)s);
+}
+
+size_t HardwareSerial::print(char c)
+{
+        return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(int n)
+{
+        return print((long)n);
+}
+
+size_t HardwareSerial::print(unsigned int n)
+{
+        return print((unsigned long)n);
+}
+
+size_t HardwareSerial::print(long n)
+{
+        char buf[24];
+        snprintf(buf, sizeof buf, "%ld", n);
+        return print(buf);
+}
+
+size_t HardwareSerial::print(unsigned long n)
+{
+        char buf[24];
+        snprintf(buf, sizeof buf, "%lu", n);
+        return print(buf);
+}
+
+size_t HardwareSerial::print(double d)
+{
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.2f", d);
+        return print(buf);
+}
+
+size_t HardwareSerial::println()
+{
+        return print("\r\n");
+}
+
+double Adafruit_MAX31855::readFarenheit()
+{
+        return 70.0;
+}
+
+long Q2HX711::read()
+{
+        sim_sleep_ns(sim_load_cell_us * 1000ULL);
+        return sim_load_cell;
+}
+
+int EthernetClass::begin(uint8_t *mac, IPAddress ip)
+{
+        (void)mac;
+        (void)ip;
+
+        // Ethernet2's w5500.init() splits the memory evenly
+        for (int i = 0; i < MAX_SOCK_NUM; ++i)
+                sim_sockets[i].tx_size = 2048;
+        return 1;
+}
+
+uint8_t EthernetClient::connected()
+{
+        if (_sock == MAX_SOCK_NUM || !sim_sockets[_sock].open)
+                return 0;
+
+        // like the real thing, a socket in CLOSE_WAIT still counts as
+        // connected until we've read everything out of it
+        return !sim_sockets[_sock].peer_closed
+                || !sim_sockets[_sock].rx.empty();
+}
+
+int EthernetClient::available()
+{
+        if (_sock == MAX_SOCK_NUM)
+                return 0;
+
+        return sim_sockets[_sock].rx.size();
+}
+
+int EthernetClient::read()
+{
+        uint8_t b;
+
+        if (read(&b, 1) != 1)
+                return -1;
+        return b;
+}
+
+int EthernetClient::read(uint8_t *buf, size_t size)
+{
+        if (_sock == MAX_SOCK_NUM || sim_sockets[_sock].rx.empty())
+                return -1;
+
+        std::deque<uint8_t> &rx = sim_sockets[_sock].rx;
+        size_t n = min(size, rx.size());
+        for (size_t i = 0; i < n; ++i) {
+                buf[i] = rx.front();
+                rx.pop_front();
+        }
+        return n;
+}
+
+size_t EthernetClient::write(uint8_t b)
+{
+        return write(&b, 1);
+}
+
+size_t EthernetClient::write(const uint8_t *buf, size_t size)
+{
+        if (_sock == MAX_SOCK_NUM)
+                return 0;
+
+        struct sim_socket *s = &sim_sockets[_sock];
+        if (!s->open || s->peer_closed)
+                return 0;
+
+        if (s->tx.size() + size > s->tx_size)
+                ++s->tx_overruns;
+        ++s->writes;
+
+        s->tx.insert(s->tx.end(), buf, buf + size);
+        return size;
+}
+
+void EthernetClient::stop()
+{
+        if (_sock == MAX_SOCK_NUM)
+                return;
+
+        struct sim_socket *s = &sim_sockets[_sock];
+        s->open = false;
+        s->peer_closed = false;
+        s->rx.clear();
+        s->tx.clear();
+        _sock = MAX_SOCK_NUM;
+}
+
+void EthernetServer::begin()
+{
+}
+
+EthernetClient EthernetServer::available()
+{
+        // same as Ethernet2: hand back the lowest numbered connected socket
+        // with something to read
+        for (int sock = 0; sock < MAX_SOCK_NUM; ++sock) {
+                struct sim_socket *s = &sim_sockets[sock];
+                if (s->open && !s->rx.empty())
+                        return EthernetClient(sock);
+        }
+
+        return EthernetClient(MAX_SOCK_NUM);
+}
+
+uint16_t W5500Class::getTXFreeSize(SOCKET s)
+{
+        size_t used = sim_sockets[s].tx.size();
+        size_t size = sim_sockets[s].tx_size;
+
+        return used >= size ? 0 : size - used;
+}
+
+void W5500Class::writeSnTX_SIZE(SOCKET s, uint8_t kb)
+{
+        sim_sockets[s].tx_size = kb * 1024;
+}
+
+void W5500Class::writeSnRX_SIZE(SOCKET s, uint8_t kb)
+{
+        // the sim's RX side never fills up
+        (void)s;
+        (void)kb;
+}
+
+int sim_connect()
+{
+        int nopen = 0;
+        int sock = -1;
+
+        for (int i = 0; i < MAX_SOCK_NUM; ++i) {
+                if (sim_sockets[i].open)
+                        ++nopen;
+                else if (sock == -1)
+                        sock = i;
+        }
+
+        // one socket always has to be left over for the server to listen
+        // on, so the last one is unusable
+        if (sock == -1 || nopen == MAX_SOCK_NUM - 1)
+                return -1;
+
+        struct sim_socket *s = &sim_sockets[sock];
+        s->open = true;
+        s->peer_closed = false;
+        s->rx.clear();
+        s->tx.clear();
+        s->tx_overruns = 0;
+        s->writes = 0;
+        return sock;
+}
+
+void sim_disconnect(int sock)
+{
+        sim_sockets[sock].peer_closed = true;
+        sim_sockets[sock].tx.clear();
+}
+
+void sim_send(int sock, const void *buf, size_t len)
+{
+        const uint8_t *b = (const uint8_t *)buf;
+
+        sim_sockets[sock].rx.insert(sim_sockets[sock].rx.end(), b, b + len);
+}
+
+size_t sim_recv(int sock, void *buf, size_t len)
+{
+        std::deque<uint8_t> &tx = sim_sockets[sock].tx;
+        uint8_t *b = (uint8_t *)buf;
+        size_t n = len < tx.size() ? len : tx.size();
+
+        for (size_t i = 0; i < n; ++i) {
+                b[i] = tx.front();
+                tx.pop_front();
+        }
+        return n;
+}
@@ -0,0 +1,105 @@
+#ifndef SIM_H
+#define SIM_H
+
+// the simulator side of the arduino shim. launch_sim.cpp drives the sketch
+// through these.
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+#include <utility/w5500.h>
+
+struct sim_socket {
+        // a client is connected to this socket
+        bool open;
+
+        // the client hung up. The server still gets to read whatever the
+        // client sent before it left.
+        bool peer_closed;
+
+        // bytes sent from the client to the server
+        std::deque<uint8_t> rx;
+
+        // bytes sent from the server to the client
+        std::deque<uint8_t> tx;
+
+        // number of server writes that wouldn't have fit in the W5500 TX
+        // buffer. The real library blocks in this case.
+        unsigned long tx_overruns;
+
+        // how much TX memory the sketch gave this socket. The W5500 starts
+        // out with 2K for every socket.
+        size_t tx_size;
+
+        // and the number of writes, for working out how many SPI bursts
+        // the sketch would have done
+        unsigned long writes;
+};
+
+extern struct sim_socket sim_sockets[MAX_SOCK_NUM];
+
+// connect a new client to the server. Returns the socket number, or -1 if
+// the W5500 is out of sockets
+int sim_connect();
+
+// hang up from the client side of a socket
+void sim_disconnect(int sock);
+
+// send bytes from a client to the server
+void sim_send(int sock, const void *buf, size_t len);
+
+// pull at most len bytes the server sent to a client. Returns how many we
+// got.
+size_t sim_recv(int sock, void *buf, size_t len);
+
+// sensor values the sketch sees
+extern int sim_analog[16];
+extern long sim_load_cell;
+
+// print the sketch's diagnostics to stderr
+extern bool sim_verbose;
+
+// the serial port. Like the real HardwareSerial, writes go into a 64 byte
+// TX buffer (63 usable) that drains at the baud rate passed to begin(), and
+// a write that doesn't fit spins until there's room. sim_serial_stall_ns
+// adds up the time the sketch spent spinning, and sim_serial_out gets every
+// byte written.
+#define SIM_SERIAL_TX_SIZE 63
+
+extern uint64_t sim_serial_stall_ns;
+extern std::vector<uint8_t> sim_serial_out;
+
+// bytes waiting for the sketch to Serial.read()
+extern std::deque<uint8_t> sim_serial_in;
+
+// monotonic wall-clock time in nanoseconds, for timing the sketch
+uint64_t sim_wall_ns();
+
+// the clock the sketch sees, in nanoseconds. Normally that's the wall
+// clock. With sim_virtual_clock set before setup(), time only moves when
+// the sketch waits for it (delay(), a slow load cell, a full serial port,
+// the pause between loops), and then it jumps straight to the end of the
+// wait, running any interrupt that comes due on the way. Code takes no
+// time at all. A whole fire/safing/depress cycle runs in milliseconds, and
+// the same scenario always comes out the same.
+extern bool sim_virtual_clock;
+uint64_t sim_now_ns();
+
+// with the virtual clock, called with the time the clock is about to move
+// to, before it moves. The plant model catches up to there with whatever
+// the valves are doing now, see plant.h.
+extern void (*sim_on_advance)(uint64_t to_ns);
+
+// run any interrupt handler that's due, see ISR() in shim/Arduino.h
+void sim_poll_interrupts();
+
+// sleep, waking up on time for any interrupt that comes due in the
+// meantime. delay() is this.
+void sim_sleep_ns(uint64_t ns);
+
+// how long a load cell read takes. The real HX711 makes read() wait for its
+// next conversion, which at 10 samples a second can be up to 100 ms.
+extern unsigned long sim_load_cell_us;
+
+#endif // SIM_H
@@ -0,0 +1 @@
+../elet_arduino.h
\ No newline at end of file
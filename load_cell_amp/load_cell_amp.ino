@@ -1,35 +1,14 @@
 #include "elet_arduino.h"
 
-char buf[64];
-int i = 0;
-float mass = 0;
-long count = 0;
+// stream the load cell for calibrating it. Type the mass on the load cell
+// followed by a return, and run launch_client/bench_capture.py on the serial
+// port to get the readings as a CSV. The HX711 has a new reading at most 80
+// times a second, so sample a bit faster than that.
 
 void setup() {
-  Serial.begin(9600);
-  memset(buf, 0, sizeof buf);
+  bench_stream_begin(BENCH_BIT(BENCH_LOAD_CELL), 100);
 }
 
 void loop() {
-  Serial.print(count++);
-  Serial.print(", ");
-  Serial.print(mass, 3);
-  Serial.print(", ");
-  Serial.println(read_load_cell());
-  delay(1000);
-
-  int c;
-  while ((c = Serial.read()) != -1) {
-    if (c == '\r') {
-      mass = atof(buf);
-      i = 0;
-      memset(buf, 0, sizeof buf);
-    } else if (i == (sizeof buf) - 1) {
-      Serial.println("buffer overflow. resetting to beginning");
-      i = 0;
-      memset(buf, 0, sizeof buf);
-    } else {
-      buf[i++] = c;
-    }
-  }
+  bench_stream_poll();
 }
@@ -8,12 +8,12 @@ void setup() {
 
   Serial.begin(9600);
 
-  Serial.println("#######################################");
-  Serial.println("####### nitrogen flow test (N2) #######");
-  Serial.println("#######################################");
-  Serial.println("");
+  Serial.println(F("#######################################"));
+  Serial.println(F("####### nitrogen flow test (N2) #######"));
+  Serial.println(F("#######################################"));
+  Serial.println(F(""));
 
-  Serial.println("test name, open/closed");
+  Serial.println(F("test name, open/closed"));
 
   close_valve(v);
 }
@@ -34,10 +34,10 @@ void serialEvent() {
 
 void loop() {
   // put your main code here, to run repeatedly:
-  Serial.print("nitrogen, ");
+  Serial.print(F("nitrogen, "));
   if (is_open)
-    Serial.println("open");
+    Serial.println(F("open"));
   else
-    Serial.println("closed");
+    Serial.println(F("closed"));
   delay(500);
 }
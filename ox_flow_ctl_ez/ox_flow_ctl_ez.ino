@@ -13,12 +13,12 @@ void setup() {
 
   Serial.begin(9600);
 
-  Serial.println("############################################################");
-  Serial.println("####### flow control valve calibration test (OXYGEN) #######");
-  Serial.println("############################################################");
-  Serial.println("");
+  Serial.println(F("############################################################"));
+  Serial.println(F("####### flow control valve calibration test (OXYGEN) #######"));
+  Serial.println(F("############################################################"));
+  Serial.println(F(""));
 
-  Serial.println("test name, pwm value, digital pressure, analog pressure, temperature (F)");
+  Serial.println(F("test name, pwm value, digital pressure, analog pressure, temperature (F)"));
 
   close_valve(v);
   delay(500);
@@ -53,14 +53,14 @@ void serialEvent() {
 
 void loop() {
   struct pressure_reading r = read_pressure(PS_OXYGEN);
-  Serial.print("oxygen, ");
+  Serial.print(F("oxygen, "));
   Serial.print(pwm_bins[bin_idx]);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.print(r.digital);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.println(r.analog);
   /*
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.println(read_thermocouple_f(TC_OXYGEN));
   */
   delay(500);
@@ -1,28 +1,13 @@
 #include "elet_arduino.h"
 
-void setup() {
-  Serial.begin(9600);
-
-  Serial.println("######################################");
-  Serial.println("####### pressure sensor reader #######");
-  Serial.println("######################################");
-  Serial.println("");
-
-  Serial.println("test name, digital P (yellow), analog P (yellow), digital P (blue), analog P (blue)");
+// stream both pressure sensors for calibrating them. Type the pressure on the
+// gauge followed by a return, and run launch_client/bench_capture.py on the
+// serial port to get the readings as a CSV.
 
+void setup() {
+  bench_stream_begin(BENCH_BIT(BENCH_OX) | BENCH_BIT(BENCH_FUEL), 1000);
 }
 
 void loop() {
-  // yellow
-  struct pressure_reading r1 = read_pressure(PS_OXYGEN);
-
-  // blue
-  struct pressure_reading r2 = read_pressure(PS_FUEL);
-
-  Serial.print("ox=");
-  Serial.print(r1.analog);
-  Serial.print(", fuel=");
-  Serial.println(r2.analog);
-
-  delay(500);
+  bench_stream_poll();
 }
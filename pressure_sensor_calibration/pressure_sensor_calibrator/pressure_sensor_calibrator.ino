@@ -11,7 +11,7 @@ static float digital_to_psi(int digital)
 void loop() {
   int pressure = analogRead(0);
   Serial.print(pressure);
-  Serial.print(", ");
+  Serial.print(F(", "));
   Serial.println(digital_to_psi(pressure));
   delay(1000);
 }
@@ -0,0 +1,890 @@
+#!/usr/bin/env python
+#
+# generate the C and python protocol code from protocol.py. Run it from
+# anywhere:
+#
+#   ./protocol/gen_protocol.py          rewrite the generated files
+#   ./protocol/gen_protocol.py --check  exit non-zero if they're stale
+
+from __future__ import print_function
+
+import os
+import sys
+import textwrap
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+sys.path.insert(0, here)
+
+import protocol
+
+BANNER = ("generated by protocol/gen_protocol.py from protocol/protocol.py.\n"
+          "Don't edit by hand.")
+
+# size and alignment of the types we allow on the wire
+c_types = {
+    "uint8_t": (1, "B"),
+    "uint16_t": (2, "H"),
+    "uint32_t": (4, "I"),
+    "int8_t": (1, "b"),
+    "int16_t": (2, "h"),
+    "int32_t": (4, "i"),
+    "float": (4, "f"),
+}
+
+printf_to_py = {
+    "%u": "int", "%hu": "int", "%d": "int",
+    "0x%x": "hex", "%f": "float", "%s": "str",
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+def array_counts():
+    """names that can be used as an array length: enum counts and plain
+    constants"""
+    counts = {}
+    for e in protocol.enums:
+        counts[e["count"]] = len(e["values"])
+    for name, typ, val, doc in protocol.constants:
+        counts[name] = val
+    return counts
+
+
+def array_len(n, counts):
+    if n is None:
+        return 1
+    if isinstance(n, int):
+        return n
+    if n in counts:
+        return counts[n]
+    raise SchemaError("unknown array length %s" % n)
+
+
+def layout(s, structs, counts):
+    """work out (offset, size, align) of every field in s, yelling if the
+    struct would need any padding"""
+    off = 0
+    fields = []
+    struct_align = 1
+    for typ, name, n, doc in s["fields"]:
+        if typ.startswith("struct "):
+            inner = structs[typ[len("struct "):]]
+            size, align = inner["size"], inner["align"]
+        elif typ in c_types:
+            size = align = c_types[typ][0]
+        else:
+            raise SchemaError("%s.%s: unknown type %s"
+                              % (s["name"], name, typ))
+
+        count = array_len(n, counts)
+        if off % align:
+            raise SchemaError("%s.%s at offset %d isn't %d byte aligned, "
+                              "add a pad field before it"
+                              % (s["name"], name, off, align))
+        fields.append((typ, name, n, count, off))
+        off += size * count
+        struct_align = max(struct_align, align)
+
+    if off % struct_align:
+        raise SchemaError("%s is %d bytes, pad it out to a multiple of %d"
+                          % (s["name"], off, struct_align))
+    s["size"] = off
+    s["align"] = struct_align
+    s["layout"] = fields
+
+
+def to_str_enums():
+    return [e["name"] for e in protocol.enums if e.get("to_str")]
+
+
+def check_schema():
+    counts = array_counts()
+    structs = {}
+    for s in protocol.structs:
+        if s["name"] != "packet_header":
+            if s["fields"][0][:2] != ("struct packet_header", "header"):
+                raise SchemaError("%s doesn't start with a header"
+                                  % s["name"])
+        layout(s, structs, counts)
+        structs[s["name"]] = s
+
+        if "var_len" in s:
+            typ, name, n, count, off = s["layout"][-1]
+            if name != s["var_len"] or typ != "uint8_t" or n is None:
+                raise SchemaError("%s: var_len %s isn't the last field, "
+                                  "or isn't a byte array"
+                                  % (s["name"], s["var_len"]))
+            s["min_size"] = off
+        if "text_id" in s:
+            field, enum = s["text_id"]
+            if "var_len" not in s or enum not in to_str_enums() or \
+                    field not in [l[1] for l in s["layout"]]:
+                raise SchemaError("%s: bad text_id" % s["name"])
+
+    for b in protocol.bitfields:
+        width = c_types[b["type"]][0] * 8
+        used = 0
+        for name, bit, nbits, doc in b["fields"]:
+            mask = ((1 << nbits) - 1) << bit
+            if bit + nbits > width:
+                raise SchemaError("%s.%s doesn't fit in %s"
+                                  % (b["name"], name, b["type"]))
+            if used & mask:
+                raise SchemaError("%s.%s overlaps another field"
+                                  % (b["name"], name))
+            used |= mask
+
+    for e in protocol.enums:
+        shorts = [v[1] for v in e["values"]]
+        if len(set(shorts)) != len(shorts):
+            raise SchemaError("duplicate short names in enum %s" % e["name"])
+
+    to_str = to_str_enums()
+    for name, fmt, kinds in protocol.events:
+        convs = [c for c in fmt.replace("%%", "").split("%")[1:]]
+        used = [k for k in kinds if k is not None]
+        if len(convs) != len(used):
+            raise SchemaError("%s formats %d arguments but uses %d"
+                              % (name, len(convs), len(used)))
+        for k in used:
+            if k not in ("int", "sint") and k not in to_str:
+                raise SchemaError("%s: can't print a %s" % (name, k))
+
+
+def c_comment(text, indent=""):
+    out = []
+    for line in text.split("\n"):
+        line = line.rstrip()
+        out.append(indent + ("// " + line if line else "//"))
+    return out
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def gen_c_to_str(e, func, suffix, bad):
+    """the names of an enum's values all in one string, one after the other,
+    and where each one starts, so on the arduino they can live in flash
+    instead of a table of pointers to strings in RAM. The bad name goes
+    last, at the count."""
+    out = ["static inline elet_str_t",
+           "%s_%s(const enum %s v)" % (e["name"], func, e["name"]),
+           "{",
+           "        static const char names[] ELET_PROGMEM ="]
+    starts = []
+    start = 0
+    for cname, short, name in e["values"]:
+        out.append('                %s%s "\\0"' % (cname, suffix))
+        starts.append((cname, start))
+        start += len(short if suffix == "_SHORT_NAME" else name) + 1
+    out.append("                %s;" % c_string(bad))
+    starts.append((e["count"], start))
+    if start >= 1 << 16:
+        raise SchemaError("names of enum %s don't fit a uint16_t"
+                          % e["name"])
+
+    out.append("        static const uint16_t starts[] ELET_PROGMEM = {")
+    for cname, off in starts:
+        out.append("                [%s] = %d," % (cname, off))
+    out += ["        };",
+            "        int i = (int)v;",
+            "",
+            "        if (i < 0 || i >= %s)" % e["count"],
+            "                i = %s;" % e["count"],
+            "        return ELET_STR(names + elet_read_table_u16(&starts[i]));",
+            "}",
+            ""]
+    return out
+
+
+def gen_c_enums():
+    out = []
+    for e in protocol.enums:
+        if "doc" in e:
+            out += c_comment(e["doc"])
+        out.append("enum %s {" % e["name"])
+        for i, (cname, short, name) in enumerate(e["values"]):
+            out.append("        %s%s," % (cname, " = 0" if i == 0 else ""))
+            if i == 0 and "first" in e:
+                out.append("        %s = %s," % (e["first"], cname))
+        out.append("        %s" % e["count"])
+        out.append("};")
+        out.append("")
+
+        # names, for whoever needs to print these
+        for cname, short, name in e["values"]:
+            out.append("#define %s_NAME %s" % (cname, c_string(name)))
+            out.append("#define %s_SHORT_NAME %s" % (cname, c_string(short)))
+        out.append("")
+
+        if e.get("to_str"):
+            out += gen_c_to_str(e, "to_str", "_NAME",
+                                "bad " + e["name"].replace("_", " "))
+            out += gen_c_to_str(e, "to_short_str", "_SHORT_NAME", "bad")
+    return out
+
+
+def gen_c_constants():
+    out = []
+    for name, typ, val, doc in protocol.constants:
+        if doc:
+            if out:
+                out.append("")
+            out += c_comment(doc)
+        if typ:
+            out.append("#define %s ((%s)%d)" % (name, typ, val))
+        else:
+            out.append("#define %s %d" % (name, val))
+    out.append("")
+    return out
+
+
+def gen_c_events():
+    out = c_comment("diagnostic events, see struct event_packet")
+    out.append("enum event_id {")
+    for i, (name, fmt, kinds) in enumerate(protocol.events):
+        out.append("        %s%s," % (name, " = 0" if i == 0 else ""))
+    out.append("        EV_NUM_EVENTS")
+    out.append("};")
+    out.append("")
+    return out
+
+
+def gen_c_bitfields():
+    out = []
+    for b in protocol.bitfields:
+        t = b["type"]
+        pre = "elet_%s" % b["name"]
+        out += c_comment(textwrap.fill(
+                "accessors for the %s. These work on the raw value in place, "
+                "there's no unpacked copy to keep in sync." % b["doc"], 76))
+        out.append("")
+        args = []
+        for name, bit, nbits, doc in b["fields"]:
+            out += c_comment(doc)
+            mask = (1 << nbits) - 1
+            up = ("%s_%s" % (pre, name)).upper()
+            out.append("#define %s_SHIFT %d" % (up, bit))
+            out.append("#define %s_MASK 0x%x" % (up, mask))
+            out.append("")
+            out.append("static inline %s" % t)
+            out.append("%s_%s(const %s v)" % (pre, name, t))
+            out.append("{")
+            out.append("        return (v >> %s_SHIFT) & %s_MASK;" % (up, up))
+            out.append("}")
+            out.append("")
+            out.append("static inline %s" % t)
+            out.append("%s_set_%s(const %s v, const %s f)"
+                       % (pre, name, t, t))
+            out.append("{")
+            out.append("        return (v & ~((%s)%s_MASK << %s_SHIFT))"
+                       % (t, up, up))
+            out.append("                | ((f & %s_MASK) << %s_SHIFT);"
+                       % (up, up))
+            out.append("}")
+            out.append("")
+            if name != "reserved":
+                args.append(name)
+
+        out.append("static inline %s" % t)
+        sig = "%s_pack(" % pre
+        params = ["const %s %s" % (t, a) for a in args]
+        line = sig + ", ".join(params) + ")"
+        if len(line) > 80:
+            line = (",\n" + " " * len(sig)).join(params)
+            line = sig + line + ")"
+        out += line.split("\n")
+        out.append("{")
+        out.append("        %s v = 0;" % t)
+        for a in args:
+            out.append("        v = %s_set_%s(v, %s);" % (pre, a, a))
+        out.append("        return v;")
+        out.append("}")
+        out.append("")
+    return out
+
+
+def gen_c_structs():
+    out = []
+    for s in protocol.structs:
+        out += c_comment(s["doc"])
+        out.append("struct %s {" % s["name"])
+        first = True
+        for typ, name, n, doc in s["fields"]:
+            if doc:
+                if not first:
+                    out.append("")
+                out += c_comment(doc, "        ")
+            first = False
+            arr = "[%s]" % n if n is not None else ""
+            out.append("        %s %s%s;" % (typ, name, arr))
+        out.append("};")
+        out.append("")
+
+        # the arduino and the client must agree on these byte for byte
+        sname = "struct %s" % s["name"]
+        out.append("ELET_STATIC_ASSERT(sizeof(%s) == %d,"
+                   % (sname, s["size"]))
+        out.append("                   \"%s changed size\");" % sname)
+        for typ, name, n, count, off in s["layout"]:
+            if name.startswith("_pad"):
+                continue
+            out.append("ELET_STATIC_ASSERT(offsetof(%s, %s) == %d,"
+                       % (sname, name, off))
+            out.append("                   \"%s.%s moved\");" % (sname, name))
+        out.append("")
+
+        if "var_len" in s:
+            out.append("// the shortest a %s can be, with none of its %s"
+                       % (s["name"], s["var_len"]))
+            out.append("#define %s_MIN_LEN offsetof(%s, %s)"
+                       % (s["name"].upper(), sname, s["var_len"]))
+            out.append("")
+    return out
+
+
+def gen_c_header():
+    out = c_comment(BANNER) + ["",
+           "#ifndef ELET_PROTOCOL_H",
+           "#define ELET_PROTOCOL_H",
+           "",
+           "// the wire format shared by the arduino and the client: enums "
+           "that go over",
+           "// the wire, packet types and layouts, and accessors for the "
+           "bitfields in",
+           "// them. Everything here comes from protocol/protocol.py.",
+           "//",
+           "// Include elet.h rather than this, the *_to_str() functions "
+           "need its",
+           "// ELET_PROGMEM and elet_str_t.",
+           "",
+           "#include <stdint.h>",
+           "#include <stddef.h>",
+           "",
+           "// _Static_assert is C11, and the client tools are C99. For those "
+           "an array",
+           "// with a negative size does the same job, and redeclaring the "
+           "same extern",
+           "// array as often as we like is fine.",
+           "#if defined(__cplusplus)",
+           "#define ELET_STATIC_ASSERT(cond, msg) static_assert(cond, msg)",
+           "#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L",
+           "#define ELET_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)",
+           "#else",
+           "#define ELET_STATIC_ASSERT(cond, msg) \\",
+           "        extern char elet_static_assert[(cond) ? 1 : -1]",
+           "#endif",
+           ""]
+    out += gen_c_enums()
+    out.append("// network bullshittery begins here, continue at your own "
+               "risk")
+    out.append("")
+    out += gen_c_constants()
+    out += gen_c_events()
+    out += gen_c_bitfields()
+    out += gen_c_structs()
+    out.append("#endif // ELET_PROTOCOL_H")
+    return "\n".join(out) + "\n"
+
+
+def view_prefix(s):
+    name = s["name"]
+    if name == "packet_header":
+        return "elet_view_header"
+    if name.endswith("_packet"):
+        name = name[:-len("_packet")]
+    return "elet_view_" + name
+
+
+view_getters = {
+    "uint8_t": "pkt_view_u8",
+    "uint16_t": "pkt_view_u16",
+    "uint32_t": "pkt_view_u32",
+    "int8_t": "(int8_t)pkt_view_u8",
+    "int16_t": "(int16_t)pkt_view_u16",
+    "int32_t": "(int32_t)pkt_view_u32",
+    "float": "pkt_view_f32",
+}
+
+
+def gen_c_view():
+    out = c_comment(BANNER) + ["",
+           "#ifndef ELET_VIEW_H",
+           "#define ELET_VIEW_H",
+           "",
+           "// getters for the fields of packets sitting in a pkt_ring, see "
+           "pkt_ring.h.",
+           "// They don't check the packet type or length, do that first.",
+           "",
+           "#include \"pkt_ring.h\"",
+           ""]
+    for s in protocol.structs:
+        pre = view_prefix(s)
+        sname = "struct %s" % s["name"]
+        for typ, name, n, count, off in s["layout"]:
+            if name.startswith("_pad") or typ.startswith("struct "):
+                continue
+            if name == s.get("var_len"):
+                # only as much as the packet has, which is what we return
+                out.append("static inline size_t")
+                out.append("%s_%s(const struct pkt_view *v, void *dst)"
+                           % (pre, name))
+                out.append("{")
+                out.append("        size_t n = v->len - %s_MIN_LEN;"
+                           % s["name"].upper())
+                out.append("")
+                out.append("        if (n > %s)" % n)
+                out.append("                n = %s;" % n)
+                out.append("        pkt_view_copy(v, offsetof(%s, %s), dst, n);"
+                           % (sname, name))
+                out.append("        return n;")
+                out.append("}")
+                out.append("")
+                continue
+            if typ == "uint8_t" and n is not None:
+                # byte arrays get copied out whole
+                out.append("static inline void")
+                out.append("%s_%s(const struct pkt_view *v, void *dst)"
+                           % (pre, name))
+                out.append("{")
+                out.append("        pkt_view_copy(v, offsetof(%s, %s), dst, %s);"
+                           % (sname, name, n))
+                out.append("}")
+                out.append("")
+                continue
+
+            getter = view_getters[typ]
+            out.append("static inline %s" % typ)
+            if n is None:
+                out.append("%s_%s(const struct pkt_view *v)" % (pre, name))
+                out.append("{")
+                out.append("        return %s(v, offsetof(%s, %s));"
+                           % (getter, sname, name))
+            else:
+                out.append("%s_%s(const struct pkt_view *v, size_t i)"
+                           % (pre, name))
+                out.append("{")
+                out.append("        return %s(v, offsetof(%s, %s)"
+                           % (getter, sname, name))
+                out.append("                  + i * sizeof(%s));" % typ)
+            out.append("}")
+            out.append("")
+    out.append("#endif // ELET_VIEW_H")
+    return "\n".join(out) + "\n"
+
+
+def log_expr(s, field):
+    """C expression for a log column field of packet s, on a view `p`"""
+    if field.startswith("header."):
+        return "elet_view_header_%s(p)" % field[len("header."):]
+    pre = view_prefix(s)
+    if ":" in field:
+        field, bits = field.split(":")
+        return "elet_%s_%s(%s_%s(p))" % (field, bits, pre, field)
+    if "[" in field:
+        field, idx = field[:-1].split("[")
+        return "%s_%s(p, %s)" % (pre, field, idx)
+    return "%s_%s(p)" % (pre, field)
+
+
+def gen_c_log():
+    out = c_comment(BANNER) + ["",
+           "#ifndef ELET_LOG_H",
+           "#define ELET_LOG_H",
+           "",
+           "// run.log line formatters. post.py and friends parse these "
+           "lines with",
+           "// parse_log_line() from elet_protocol.py, which is generated "
+           "from the same",
+           "// description, so the two can't drift apart.",
+           "",
+           "#include <stdio.h>",
+           "",
+           "#include \"elet_view.h\"",
+           ""]
+    for s in protocol.structs:
+        if "log" not in s:
+            continue
+        tag, cols = s["log"]
+        fmt = ", ".join([tag] + [c[2] for c in cols])
+        out += c_comment(textwrap.fill(", ".join([tag] + [c[0] for c in cols]),
+                                       76))
+        out.append("static inline int")
+        out.append("elet_log_%s(int fd, const struct pkt_view *p)"
+                   % s["name"])
+        out.append("{")
+
+        # strings get copied out of the ring and terminated first
+        args = []
+        for c in cols:
+            if c[2] == "%s" and c[1] == s.get("var_len"):
+                out.append("        char %s[sizeof(((struct %s *)0)->%s) + 1];"
+                           % (c[1], s["name"], c[1]))
+                if "text_id" in s:
+                    # the id's text, then ours after it if there's any
+                    field, enum = s["text_id"]
+                    out.append("        const char *%s = %s_to_str("
+                               % (field, enum))
+                    out.append("                (enum %s)%s);" % (
+                        enum, log_expr(s, field)))
+                    fmt = fmt.replace("%s", "%s%s%s")
+                    args += [field, "*%s && *%s ? \": \" : \"\""
+                             % (field, c[1])]
+                out.append("")
+                out.append("        %s[%s_%s(p, %s)] = '\\0';"
+                           % (c[1], view_prefix(s), c[1], c[1]))
+                out.append("")
+                args.append(c[1])
+                continue
+            if c[2] == "%s":
+                out.append("        char %s[sizeof(((struct %s *)0)->%s) + 1];"
+                           % (c[1], s["name"], c[1]))
+                out.append("")
+                out.append("        %s_%s(p, %s);"
+                           % (view_prefix(s), c[1], c[1]))
+                out.append("        %s[sizeof %s - 1] = '\\0';"
+                           % (c[1], c[1]))
+                out.append("")
+                args.append(c[1])
+            else:
+                args.append(log_expr(s, c[1]))
+
+        out.append("        return dprintf(fd, \"%s\\n\"," % fmt)
+        for i, a in enumerate(args):
+            end = ");" if i == len(args) - 1 else ","
+            out.append("                       %s%s" % (a, end))
+        out.append("}")
+        out.append("")
+
+    out += c_comment("""\
+turn an event from an event_packet into text. Returns what snprintf
+would.""")
+    out.append("static inline int")
+    out.append("elet_event_format(char *buf, size_t n, uint8_t id, "
+               "uint16_t arg0,")
+    out.append("                  uint32_t arg1)")
+    out.append("{")
+    out.append("        switch (id) {")
+    for name, fmt, kinds in protocol.events:
+        args = []
+        for k, a, cast, scast in zip(kinds, ("arg0", "arg1"),
+                                     ("unsigned", "unsigned long"),
+                                     ("(int)(int16_t)", "(long)(int32_t)")):
+            if k is None:
+                continue
+            if k == "int":
+                args.append("(%s)%s" % (cast, a))
+            elif k == "sint":
+                args.append("%s%s" % (scast, a))
+            else:
+                args.append("%s_to_str((enum %s)%s)" % (k, k, a))
+        out.append("        case %s:" % name)
+        out.append("                return snprintf(buf, n, %s," % c_string(fmt))
+        for i, a in enumerate(args):
+            out.append("                                %s%s"
+                       % (a, ");" if i == len(args) - 1 else ","))
+    out.append("        default:")
+    out.append("                return snprintf(buf, n, \"unknown event %u, "
+               "args %u %lu\",")
+    out.append("                                (unsigned)id, (unsigned)arg0,")
+    out.append("                                (unsigned long)arg1);")
+    out.append("        }")
+    out.append("}")
+    out.append("")
+    out.append("#endif // ELET_LOG_H")
+    return "\n".join(out) + "\n"
+
+
+def header_struct():
+    return [s for s in protocol.structs if s["name"] == "packet_header"][0]
+
+
+def hdr_size():
+    return header_struct()["size"]
+
+
+def crc_off():
+    return [l[4] for l in header_struct()["layout"] if l[1] == "crc"][0]
+
+
+def fmt_count(n):
+    return "%d" % n if n > 1 else ""
+
+
+def py_list(name, items):
+    out = ["%s = [" % name]
+    for i in items:
+        out.append("    %r," % i)
+    out.append("]")
+    return out
+
+
+def gen_py():
+    out = ["# " + l for l in BANNER.split("\n")] + ["",
+           '"""names, run.log parsing and binary packet decoding for the '
+           'elet protocol"""',
+           "",
+           "import struct",
+           ""]
+
+    for e in protocol.enums:
+        up = e["name"].upper()
+        out += py_list("%s_SHORT_NAMES" % up, [v[1] for v in e["values"]])
+        names = [v[2] for v in e["values"]]
+        if "count_name" in e:
+            names.append(e["count_name"])
+        out += py_list("%s_NAMES" % up, names)
+        for i, v in enumerate(e["values"]):
+            out.append("%s = %d" % (v[0], i))
+        out.append("%s = %d" % (e["count"], len(e["values"])))
+        out.append("")
+
+    for name, typ, val, doc in protocol.constants:
+        out.append("%s = %d" % (name, val))
+    out.append("")
+
+    out += py_list("EVENT_NAMES", [ev[0] for ev in protocol.events])
+    for i, ev in enumerate(protocol.events):
+        out.append("%s = %d" % (ev[0], i))
+    out.append("EV_NUM_EVENTS = %d" % len(protocol.events))
+    out.append("")
+    out.append("# event id -> (printf format, (arg0 kind, arg1 kind))")
+    out.append("EVENT_FORMATS = [")
+    for name, fmt, kinds in protocol.events:
+        out.append("    (%r, %r)," % (fmt, kinds))
+    out.append("]")
+    out.append("")
+
+    for b in protocol.bitfields:
+        for name, bit, nbits, doc in b["fields"]:
+            out.append("")
+            out.append("")
+            out.append("def %s_%s(v):" % (b["name"], name))
+            out.append("    return (v >> %d) & 0x%x" % (bit, (1 << nbits) - 1))
+    out.append("")
+
+    # log lines
+    out.append("")
+    out.append("# tag -> [(column name, kind)] for every line the client logs "
+               "a packet as")
+    out.append("LOG_COLUMNS = {")
+    for s in protocol.structs:
+        if "log" not in s:
+            continue
+        tag, cols = s["log"]
+        out.append("    %r: [" % tag)
+        for c in cols:
+            out.append("        (%r, %r)," % (c[0], printf_to_py[c[2]]))
+        out.append("    ],")
+    out.append("}")
+    out += ["",
+            "",
+            "def _parse_col(kind, s):",
+            "    if kind == 'int':",
+            "        # some old logs have e.g. thrust as a float in lbf",
+            "        try:",
+            "            return int(s)",
+            "        except ValueError:",
+            "            return float(s)",
+            "    if kind == 'hex':",
+            "        return int(s, 16)",
+            "    if kind == 'float':",
+            "        return float(s)",
+            "    return s[1:] if s.startswith(' ') else s",
+            "",
+            "",
+            "def parse_log_line(line):",
+            '    """parse one run.log line, already split on commas (e.g. by',
+            "    csv.reader). Returns (tag, {column name: value}), or (tag, None)",
+            '    for lines that aren\'t a logged packet"""',
+            "    if not line:",
+            "        return None, None",
+            "    tag = line[0]",
+            "    cols = LOG_COLUMNS.get(tag)",
+            "    if cols is None:",
+            "        return tag, None",
+            "",
+            "    fields = line[1:]",
+            "    # a string column is last and may itself contain commas",
+            "    if cols[-1][1] == 'str' and len(fields) > len(cols):",
+            "        fields = fields[:len(cols) - 1] \\",
+            "            + [','.join(fields[len(cols) - 1:])]",
+            "    # logs from older clients are missing columns that were added on",
+            "    # the end since, those just aren't in the dict",
+            "    if len(fields) > len(cols):",
+            "        raise ValueError('%s line has %d columns, expected %d'",
+            "                         % (tag, len(fields), len(cols)))",
+            "",
+            "    return tag, dict((name, _parse_col(kind, f))",
+            "                     for (name, kind), f in zip(cols, fields))",
+            ""]
+
+    # binary decoders. Little endian, since that's what both the arduino
+    # and every client we run on are
+    out.append("")
+    out.append("# packet type -> (struct name, struct format, [(field, count)])")
+    out.append("PACKETS = {")
+    for s in protocol.structs:
+        if "type" not in s:
+            continue
+        fmt = "<"
+        fields = []
+        for typ, name, n, count, off in s["layout"]:
+            if typ == "struct packet_header":
+                hdr = [st for st in protocol.structs
+                       if st["name"] == "packet_header"][0]
+                for htyp, hname, hn, hcount, hoff in hdr["layout"]:
+                    fmt += fmt_count(hcount) + c_types[htyp][1]
+                    fields.append((hname, hcount))
+                continue
+            if typ == "uint8_t" and n is not None and not name.startswith(
+                    "_pad"):
+                # byte arrays come out as bytes
+                fmt += "%ds" % count
+                fields.append((name, 0))
+                continue
+            fmt += fmt_count(count) + c_types[typ][1]
+            fields.append((name, count))
+        out.append("    %s: (%r, %r, [" % (s["type"], s["name"], fmt))
+        for f in fields:
+            out.append("        (%r, %d)," % f)
+        out.append("    ]),")
+    out.append("}")
+    out.append("")
+    out.append("# packet type -> shortest length, for packets that are only "
+               "as long as what's")
+    out.append("# used of their last field")
+    out.append("VAR_LEN = {")
+    for s in protocol.structs:
+        if "var_len" in s:
+            out.append("    %s: %d," % (s["type"], s["min_size"]))
+    out.append("}")
+    out += ["",
+            "HEADER = struct.Struct(%r)" % "<HBB",
+            "",
+            "",
+            "def decode_packet(buf, offset=0):",
+            '    """decode the packet at buf[offset:]. Returns (struct name, '
+            '{field: value}),',
+            "    arrays come back as lists and byte arrays as bytes. Padding "
+            "is dropped.",
+            '    Raises ValueError on unknown packet types or bad lengths"""',
+            "    length, typ, _ = HEADER.unpack_from(buf, offset)",
+            "    if typ not in PACKETS:",
+            "        raise ValueError('unknown packet type %d' % typ)",
+            "",
+            "    name, fmt, fields = PACKETS[typ]",
+            "    st = struct.Struct(fmt)",
+            "    min_len = VAR_LEN.get(typ, st.size)",
+            "    if length < min_len or length > st.size:",
+            "        raise ValueError('%s with length %d, expected %d'",
+            "                         % (name, length, st.size))",
+            "",
+            "    # what a short packet doesn't have decodes as zeros, and gets "
+            "cut off",
+            "    # below",
+            "    pkt = bytes(buf[offset:offset + length])",
+            "    vals = st.unpack(pkt + b'\\0' * (st.size - len(pkt)))",
+            "    out = {}",
+            "    i = 0",
+            "    for field, count in fields:",
+            "        if count == 0 or count == 1:",
+            "            v = vals[i]",
+            "            i += 1",
+            "        else:",
+            "            v = list(vals[i:i + count])",
+            "            i += count",
+            "        if not field.startswith('_pad'):",
+            "            out[field] = v",
+            "    if typ in VAR_LEN:",
+            "        out[fields[-1][0]] = out[fields[-1][0]][:length - min_len]",
+            "    return name, out",
+            ""]
+    out += ["",
+            "",
+            "def format_event(id, arg0, arg1):",
+            '    """the text for an event from an event_packet"""',
+            "    if id >= len(EVENT_FORMATS):",
+            "        return 'unknown event %u, args %u %u' % (id, arg0, arg1)",
+            "    fmt, kinds = EVENT_FORMATS[id]",
+            "    args = []",
+            "    for kind, a, bits in zip(kinds, (arg0, arg1), (16, 32)):",
+            "        if kind is None:",
+            "            continue",
+            "        if kind == 'int':",
+            "            args.append(a)",
+            "        elif kind == 'sint':",
+            "            args.append(a - (1 << bits) if a >> (bits - 1) else a)",
+            "        else:",
+            "            names = globals()[kind.upper() + '_NAMES']",
+            "            args.append(names[a] if a < len(names)",
+            "                        else 'bad ' + kind.replace('_', ' '))",
+            "    return fmt % tuple(args)",
+            "",
+            "",
+            "def crc16(buf, crc=0xffff):",
+            '    """elet_crc16_update() from elet.h, a bit at a time"""',
+            "    for b in bytearray(buf):",
+            "        crc ^= b",
+            "        for _ in range(8):",
+            "            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1",
+            "    return crc",
+            "",
+            "",
+            "def packet_crc_ok(buf, offset=0):",
+            '    """elet_packet_crc_ok() for the packet at buf[offset:]"""',
+            "    length = HEADER.unpack_from(buf, offset)[0]",
+            "    pkt = bytearray(buf[offset:offset + length])",
+            "    if len(pkt) != length or length < %d:" % hdr_size(),
+            "        return False",
+            "    want = pkt[%d] | pkt[%d] << 8" % (crc_off(), crc_off() + 1),
+            "    pkt[%d:%d] = b'\\0\\0'" % (crc_off(), crc_off() + 2),
+            "    return crc16(pkt) == want",
+            ""]
+    return "\n".join(out) + "\n"
+
+
+outputs = [
+    ("elet_protocol.h", gen_c_header),
+    (os.path.join("launch_client", "elet_view.h"), gen_c_view),
+    (os.path.join("launch_client", "elet_log.h"), gen_c_log),
+    (os.path.join("launch_client", "elet_protocol.py"), gen_py),
+]
+
+
+def main():
+    check = "--check" in sys.argv[1:]
+    try:
+        check_schema()
+    except SchemaError as e:
+        print("protocol.py: %s" % e, file=sys.stderr)
+        return 1
+
+    stale = 0
+    for path, gen in outputs:
+        full = os.path.join(root, path)
+        text = gen()
+        try:
+            with open(full) as f:
+                old = f.read()
+        except IOError:
+            old = None
+        if old == text:
+            continue
+        if check:
+            print("%s is stale, rerun %s" % (path, sys.argv[0]),
+                  file=sys.stderr)
+            stale = 1
+        else:
+            with open(full, "w") as f:
+                f.write(text)
+            print("wrote %s" % path)
+    return stale
+
+
+if __name__ == "__main__":
+    sys.exit(main())
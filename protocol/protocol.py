@@ -0,0 +1,732 @@
+# The one description of the protocol between the launch server (arduino)
+# and the client. gen_protocol.py turns this into
+#
+#   elet_protocol.h                 enums, packet structs with checked
+#                                   layouts, bitfield accessors
+#   launch_client/elet_view.h       field getters for packets sitting in
+#                                   the client's receive ring
+#   launch_client/elet_log.h        run.log line and event formatters
+#   launch_client/elet_protocol.py  names, log line parsers, event text and
+#                                   binary packet decoders for the python
+#                                   scripts
+#
+# To change the protocol, edit this file, run protocol/gen_protocol.py, and
+# commit the generated files along with it. Nothing else should have to
+# know how many valves there are or which bits of data_packet.state mean
+# what.
+#
+# Types are the C fixed-width types, `enum foo` fields are stored as
+# uint8_t. Struct fields must be naturally aligned; the generator refuses
+# to emit a struct that would need padding.
+
+# enums. Each value is (C name, short name, human readable name). first and
+# count are extra enumerators for FIRST_x and NR_x style iteration; the
+# python side gets `count_name` as the name for the count value, since the
+# server uses that as "none yet".
+enums = [
+    dict(name="valve",
+         first="FIRST_VALVE",
+         count="NR_VALVES",
+         to_str=True,
+         values=[
+             ("OX_ON_OFF", "oxoo", "oxygen on/off"),
+             ("OX_BLEED", "oxbl", "oxygen bleed"),
+             ("OX_FLOW", "oxfl", "oxygen flow control"),
+             ("N2_PURGE", "n2pr", "nitrogen purge"),
+             ("N2_ON_OFF", "n2oo", "nitrogen on/off"),
+             ("FUEL_FLOW", "fufl", "fuel flow control"),
+             ("FUEL_ON_OFF", "fuoo", "fuel on/off"),
+         ]),
+
+    dict(name="pressure_sensor",
+         first="FIRST_PSENSOR",
+         count="NR_PSENSORS",
+         values=[
+             ("PS_OXYGEN", "ox", "oxygen (yellow)"),
+             ("PS_FUEL", "fuel", "fuel (blue)"),
+         ]),
+
+    dict(name="thermocouple",
+         first="FIRST_THERMOCOUPLE",
+         count="NR_THERMOCOUPLES",
+         values=[
+             ("TC_OXYGEN", "ox", "oxygen"),
+             ("TC_WATER", "water", "water"),
+         ]),
+
+    dict(name="ignition_status",
+         count="IGN_NUM_STATUSES",
+         count_name="no ignition attempted",
+         to_str=True,
+         values=[
+             ("IGN_SUCCESS", "success", "success"),
+             ("IGN_FAIL_NO_ISENSE_WIRE", "no_isense_wire",
+              "failed: no ignition sense wire present"),
+             ("IGN_FAIL_BAD_IGNITER", "bad_igniter",
+              "failed: no continuity across igniter"),
+             ("IGN_FAIL_NO_IGNITION", "no_ignition",
+              "failed: no ignition"),
+         ]),
+
+    dict(name="loop_section",
+         first="FIRST_LOOP_SECTION",
+         count="NR_LOOP_SECTIONS",
+         to_str=True,
+         doc="the parts of the server's loop() it times, see stats_packet",
+         values=[
+             ("LS_LOOP", "loop", "all of loop()"),
+             ("LS_GATHER", "gather", "gather_all_data()"),
+             ("LS_RX", "rx", "rx_continue()"),
+             ("LS_SEND", "send", "send_packet()"),
+             ("LS_FIRE", "fire", "continue_fire()"),
+             ("LS_SAFING", "safing", "continue_safing()"),
+             ("LS_DEPRESS", "depress", "continue_depress()"),
+         ]),
+
+    dict(name="redline",
+         first="FIRST_REDLINE",
+         count="NR_REDLINES",
+         to_str=True,
+         doc="""\
+rules the server checks every loop while firing. Any one of them tripping
+ends the burn, see REQ_CMD_REDLINE.""",
+         values=[
+             ("RL_OX_OVER", "ox_over", "oxygen over pressure"),
+             ("RL_FUEL_OVER", "fuel_over", "fuel over pressure"),
+             ("RL_OX_UNDER", "ox_under", "oxygen under pressure"),
+             ("RL_FUEL_UNDER", "fuel_under", "fuel under pressure"),
+             ("RL_THRUST_LOW", "thrust_low", "low thrust"),
+             ("RL_OX_STUCK", "ox_stuck", "oxygen pressure sensor stuck"),
+             ("RL_FUEL_STUCK", "fuel_stuck", "fuel pressure sensor stuck"),
+             ("RL_THRUST_STUCK", "thrust_stuck", "load cell stuck"),
+         ]),
+
+    dict(name="transition_cause",
+         count="NR_TRANSITION_CAUSES",
+         to_str=True,
+         doc="what made a valve, the igniter or the state change, see "
+             "transition_packet",
+         values=[
+             ("CAUSE_COMMAND", "command", "command"),
+             ("CAUSE_SEQUENCE", "sequence", "sequence step"),
+             ("CAUSE_REDLINE", "redline", "redline"),
+         ]),
+
+    dict(name="bench_channel",
+         first="FIRST_BENCH_CHANNEL",
+         count="NR_BENCH_CHANNELS",
+         doc="what a bench sketch can stream, see bench_packet",
+         values=[
+             ("BENCH_OX", "ox", "oxygen pressure"),
+             ("BENCH_FUEL", "fuel", "fuel pressure"),
+             ("BENCH_LOAD_CELL", "load_cell", "load cell"),
+         ]),
+
+    dict(name="message",
+         count="NR_MESSAGES",
+         to_str=True,
+         doc="""\
+the messages the server sends often enough that they're worth a number
+instead of their text, see message_packet. MSG_TEXT is none of them, the
+packet's text is the whole message.""",
+         values=[
+             ("MSG_TEXT", "text", ""),
+             ("MSG_BAD_COMMAND", "bad_command", "processed bad command"),
+             ("MSG_OBSERVER", "observer",
+              "commander already connected, attached as observer"),
+             ("MSG_BAD_CRC", "bad_crc", "dropped packet with bad crc"),
+             ("MSG_OBSERVER_COMMAND", "observer_command",
+              "observers can't send commands"),
+         ]),
+
+    dict(name="system_state",
+         count="SS_NUM_STATES",
+         count_name="num states (shouldn't happen)",
+         to_str=True,
+         doc="""\
+Current state of the entire system. Our state diagram is
+
+
+    SS_DEPRESS
+        ^
+  (7,8) |        (2)
+        |     ________
+ (1)    v    /        v
+ --->  SS_READY       SS_FIRE
+         ^   ^________/    /
+    (5,6) \\      (3)      / (4)
+           v             v
+              SS_SAFING
+
+The states have the following semantics and rules:
+
+  state       notes
+ -----------------------------------------------------------------------
+  SS_READY    This state is the only safe state. In this state it is safe
+              to approach the engine, but care should still be exercised
+              in case of other software bugs.
+
+              Valves can be be arbitrarily actuated in this state with
+              the REQ_MOD_VALVE command, but this should be done with
+              extreme caution, and only in the case of other software
+              bugs.
+
+  SS_FIRE     In this state the engine is firing or attempting to do so.
+              No one shall approach the engine when it is in this state.
+
+  SS_SAFING   In this state the system is shutting the engine off, purging
+              the engine with nitrogen, and de-pressurizing the oxygen
+              line. It is not safe to approach the engine in this state,
+              but this state should be brief.
+
+  SS_DEPRESS  In this state we're depressurizing and emptying the fuel
+              tank. This state is only entered manually, via a REQ_CMD_DEPRESS
+
+The state machine has the following transition table:
+
+  #    prev       next        reason
+ -----------------------------------------------------------------------
+  1    n/a        SS_READY    This is the default state on startup.
+
+  2    SS_READY   SS_FIRE     This state transition is triggered by a
+                              REQ_CMD_START command from the client to the
+                              system. This state transition represents a
+                              request to start the engine
+
+  3    SS_FIRE    SS_READY    This transition happens when the system is
+                              told to fire, but there is no continuity
+                              across the ingiter, so no ignition is
+                              attempted.
+
+  4    SS_FIRE    SS_SAFING   This transition happens when either the burn
+                              time runs out or someone issues an explicit
+                              REQ_CMD_STOP.
+
+  5    SS_SAFING  SS_READY    This transition happens once automated
+                              safing is complete.
+
+  6    SS_READY   SS_SAFING   This transition happens when someone sends
+                              a REQ_CMD_STOP while we're in the ready
+                              state. We might want to do this in the case
+                              of a power failure or something else weird.
+
+  7    SS_READY   SS_DEPRESS  This transitions happens when the arduino
+                              gets a REQ_CMD_DEPRESS command
+
+  8    SS_DEPRESS SS_READY    This transition when the depressurization
+                              finishes.""",
+         values=[
+             ("SS_READY", "ready", "ready"),
+             ("SS_FIRE", "fire", "firing"),
+             ("SS_SAFING", "safing", "safing"),
+             ("SS_DEPRESS", "depress", "fuel depressurization"),
+         ]),
+]
+
+# buckets in the stats_packet histograms
+stats_nr_bins = 8
+
+# plain constants. (name, C type, value, doc)
+constants = [
+    ("PT_DATA", "uint8_t", 1, "packet types"),
+    ("PT_REQ", "uint8_t", 2, None),
+    ("PT_MESSAGE", "uint8_t", 3, None),
+    ("PT_HELLO", "uint8_t", 4, None),
+    ("PT_SESSION", "uint8_t", 5, None),
+    ("PT_EVENT", "uint8_t", 6, None),
+    ("PT_STATS", "uint8_t", 7, None),
+    ("PT_TRANSITION", "uint8_t", 8, None),
+    ("PT_BENCH", "uint8_t", 9, None),
+
+    ("REQ_CMD_STOP", "uint8_t", 0,
+     "stop the engine. No arguments"),
+    ("REQ_CMD_START", "uint8_t", 1,
+     "start the engine. Argument is the length of the burn in seconds. Must\n"
+     "be between REQ_CMD_START_MIN_BURN_TIME and REQ_CMD_START_MAX_BURN_TIME"),
+    ("REQ_CMD_START_MIN_BURN_TIME", None, 2, None),
+    ("REQ_CMD_START_MAX_BURN_TIME", None, 120, None),
+    ("REQ_MOD_VALVE", "uint8_t", 2,
+     "do something with a valve. The argument is a valve_arg, see below. 0\n"
+     "means closed, 1 means open for solenoid, and 1-255 mean open to that\n"
+     "PWM value for flow ctl valves. If the valve is 0xff, the value is\n"
+     "ignored and all valves are turned off.\n"
+     "\n"
+     "This command is only valid in the SS_READY state."),
+    ("REQ_CMD_DEPRESS", "uint8_t", 3,
+     "depressurize the fuel pressure vessel. Argument is drain time in\n"
+     "seconds"),
+    ("REQ_CMD_DEPRESS_MIN_TIMEOUT", None, 15, None),
+    ("REQ_CMD_DEPRESS_MAX_TIMEOUT", None, 120, None),
+    ("REQ_CMD_REDLINE", "uint8_t", 4,
+     "set the threshold of one of the redline rules. The argument is a\n"
+     "redline_arg. For the over/under pressure and low thrust rules the\n"
+     "value is a raw reading, like in a data packet; for the stuck sensor\n"
+     "rules it's how many identical readings in a row count as stuck, at\n"
+     "most 255. 0 turns the rule off.\n"
+     "\n"
+     "This command is only valid in the SS_READY state."),
+    ("REQ_CMD_RATE", "uint8_t", 5,
+     "set how often data packets go out in one system state. The argument\n"
+     "is a rate_arg. An interval of 0 means every loop. Whatever the\n"
+     "interval, a data packet goes out as soon as a valve or the state\n"
+     "changes."),
+
+    ("HELLO_ROLE_COMMANDER", "uint8_t", 0,
+     "roles a client can ask for in a PT_HELLO packet. Only one client at a\n"
+     "time gets to be the commander, i.e. send PT_REQ packets; everyone else\n"
+     "is a read-only observer that just gets telemetry. If a client asks to\n"
+     "be the commander while someone else already is, it's attached as an\n"
+     "observer and told so with a PT_MESSAGE."),
+    ("HELLO_ROLE_OBSERVER", "uint8_t", 1, None),
+
+    ("TR_IGNITER", "uint8_t", 0xfe,
+     "transition_packet.what for the igniter and the system state. Anything\n"
+     "else there is an enum valve."),
+    ("TR_STATE", "uint8_t", 0xff, None),
+
+    ("STATS_NR_BINS", None, stats_nr_bins,
+     "buckets in a stats_packet histogram. Bucket 0 counts times under\n"
+     "64 us, and each bucket after that goes 4 times as far as the one\n"
+     "before: 256 us, 1 ms, 4 ms, 16 ms, 65 ms, 262 ms, and the last one\n"
+     "gets everything longer."),
+]
+
+# bitfields packed into integer fields. Each field is (name, first bit,
+# number of bits, doc). The generator emits elet_<name>_<field>() to pull a
+# field out and elet_<name>_set_<field>() to put one in, plus
+# elet_<name>_pack() taking every field in order.
+bitfields = [
+    dict(name="state",
+         type="uint8_t",
+         doc="system state, as sent in data_packet.state and "
+             "session_packet.state",
+         fields=[
+             ("ign_status", 0, 3,
+              "the result of the last ignition, aka an enum\n"
+              "ignition_status. (one extra bit in case we add more\n"
+              "ignition statuses)"),
+             ("sys_state", 3, 3,
+              "the system state, aka an enum system_state (again, one\n"
+              "extra bit in case we add states)"),
+             ("igniter_good", 6, 1,
+              "the \"igniter good\" bit. If we have continuity across the\n"
+              "igniter, this bit is 1, otherwise it is zero. This bit is\n"
+              "only valid when our system_state is SS_READY, otherwise it\n"
+              "is zero."),
+             ("reserved", 7, 1,
+              "reserved/always zero. If a client sees this bit as\n"
+              "non-zero, it should yell loudly."),
+         ]),
+
+    dict(name="valve_arg",
+         type="uint32_t",
+         doc="argument of a REQ_MOD_VALVE request",
+         fields=[
+             ("valve", 0, 8,
+              "which valve, an enum valve squashed into 8 bits, or 0xff\n"
+              "for all of them"),
+             ("value", 8, 8, "what to set it to"),
+         ]),
+
+    dict(name="redline_arg",
+         type="uint32_t",
+         doc="argument of a REQ_CMD_REDLINE request",
+         fields=[
+             ("rule", 0, 8, "which rule, an enum redline"),
+             ("value", 8, 24, "the new threshold"),
+         ]),
+
+    dict(name="rate_arg",
+         type="uint32_t",
+         doc="argument of a REQ_CMD_RATE request",
+         fields=[
+             ("state", 0, 8, "which state, an enum system_state"),
+             ("interval_ms", 8, 16,
+              "at least this long between data packets, in ms"),
+         ]),
+]
+
+# diagnostic events the server logs, see event_packet. The server only
+# records an id and two integer arguments; formatting happens on the host.
+# Each event is (C name, printf format, (arg0 kind, arg1 kind)). A kind is
+# None for an unused argument, "int" for a number, "sint" for a signed one,
+# or the name of a to_str enum to print by name. arg0 goes to the format as
+# an unsigned (%u) or int (%d), and arg1 as an unsigned long (%lu, %lx) or
+# long (%ld), or %s for enums.
+events = [
+    ("EV_BOOT", "launch server up, session 0x%lx", (None, "int")),
+    ("EV_STATE", "state %s -> %s", ("system_state", "system_state")),
+    ("EV_BAD_STEP", "got weird %s step %lu", ("system_state", "int")),
+    ("EV_CONTINUITY", "igniter continuity %lu", (None, "int")),
+    ("EV_IGNITION", "ignition %s", ("ignition_status", None)),
+    ("EV_REQ", "command %u, arg %lu", ("int", "int")),
+    ("EV_REQ_REJECTED", "rejected command %u, arg %lu", ("int", "int")),
+    ("EV_CLIENT_NEW", "new client on socket %u", ("int", None)),
+    ("EV_CLIENT_DEAD", "dropped client on socket %u", ("int", None)),
+    ("EV_COMMANDER_RESUMED", "commander resumed on socket %u",
+     ("int", None)),
+    ("EV_SHORT_WRITE", "socket %u: short write of a %lu byte packet",
+     ("int", "int")),
+
+    ("EV_REDLINE", "redline %s tripped, reading %lu", ("redline", "int")),
+    ("EV_REDLINE_SET", "redline %s set to %lu", ("redline", "int")),
+
+    # a sequence step's valve action ran. The event's timestamp is when it
+    # actually ran, and arg1 is how far past its deadline that was
+    ("EV_FIRE_STEP", "fire step %u ran %ld us late", ("int", "sint")),
+    ("EV_SAFING_STEP", "safing step %u ran %ld us late", ("int", "sint")),
+    ("EV_DEPRESS_STEP", "depress step %u ran %ld us late", ("int", "sint")),
+
+    # a safing or depress sequence finished, arg1 ms sooner than its fixed
+    # waits would have, because the tanks bled down early
+    ("EV_SEQ_SAVED", "%s finished %lu ms early", ("system_state", "int")),
+
+    ("EV_RATE_SET", "%s data every %lu ms", ("system_state", "int")),
+]
+
+# packets. Each field is (type, name, array length or None, doc). A field
+# of type "struct packet_header" must come first in every packet but
+# packet_header itself.
+#
+# log gives the run.log line for the packet: the tag that starts the line,
+# then (column name, field, printf format). A field is a field name,
+# optionally with an array index (`pressures[PS_FUEL]`), a header field
+# (`header.seq`), or a bitfield of a field (`state:ign_status`). The column
+# names are what the python side calls them.
+#
+# var_len names a packet's last field, a byte array, when the packet is
+# only as long as what's used of it: header.len says how much that is, and
+# the packet can be anywhere from the field's offset to the full struct.
+# text_id is (field, enum) for a var_len packet whose text is logged after
+# the to_str of that enum field.
+structs = [
+    dict(name="packet_header",
+         doc="""\
+this header is at the start of every packet we send over the wire.
+Packet parsing code should first parse the length and packet type out of
+this header, then parse the rest of the packet based on the type. Code
+should yell when it does not recognize the packet type.""",
+         fields=[
+             ("uint16_t", "len", None, "length of this packet in bytes"),
+             ("uint8_t", "type", None,
+              "type of this message. One of the PT_* constants."),
+             ("uint8_t", "_pad1", None, None),
+             ("uint32_t", "seq", None, """\
+The sequence number of this packet. This field exists so that we
+can provide an ordering between sent and recived packets. For
+example, when someone issues a PT_REQ packet with a REQ_CMD_START
+command (i.e. "start the damn engine"), we want to know when that
+command was processed so we can look at the result of the last
+ignition in subsequent data packets. However, we don't want to
+examine the result-of-last-ignition field until we know for sure
+that the command has been processed. This seems like it would be
+easy---just wait for the command to send and read the value out
+of the next data packet. Howevver, but due to packet buffering
+on both ends, "just wait" is not a viable option as the next
+data packet may have been sent before we sent our request. Thus
+we need a sequence number.
+
+For packets sent from the server (arduino) to the client (i.e.
+PT_DATA and PT_MESSAGE), this number is the sequence number of
+the last command processed from the commanding client. Observers
+see the same number. For packets sent from the client to
+the server (i.e. PT_REQ), this is a sequence number for the
+message. The server does not look at it at all, it just pastes
+it into all subsequent response headers until a new PT_REQ packet
+comes in, then starts using that value.
+
+Thus it is suggested that the client start with seq = 0 and
+increment it by one on every PT_REQ sent to the server. Then the
+client should wait until it sees a data packet with seq == seq
+of the last command"""),
+             ("uint32_t", "timestamp", None, """\
+this field is the 32 bit millisecond timestamp returned
+by millis() at the time this data was gathered. This field is
+ignored by the server."""),
+             ("uint16_t", "crc", None, """\
+CRC of the entire packet (len bytes), computed as if this field
+were zero. See elet_packet_crc(). Both ends drop packets that
+don't check out."""),
+             ("uint16_t", "_pad2", None, None),
+         ]),
+
+    dict(name="data_packet",
+         type="PT_DATA",
+         doc="""\
+this packet is sent from the arduino to the client. It contains the
+state of the entire system.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint8_t", "vlv_states", None, """\
+the state of each valve as a bitmap. Index into this bitmap with
+integer interpretation of the values of `enum valve`. 0 means
+the valve is closed, 1 means the valve is open. For pwm valves,
+consult the next two fields to find out how open they are.
+
+NB: right now we only have 7 valves. If we get more than 8, we
+need to change this to a uint16_t"""),
+             ("uint8_t", "vlv_pwm_ox", None, None),
+             ("uint8_t", "vlv_pwm_fuel", None, None),
+             ("uint8_t", "state", None,
+              "system state, see the state bitfield accessors"),
+             ("uint16_t", "pressures", "NR_PSENSORS",
+              "data from all of our sensors. Raw ADC readings."),
+             ("float", "temps", "NR_THERMOCOUPLES",
+              "thermocouple temperatures, IEEE floats."),
+             ("uint32_t", "thrust", None,
+              "thrust from the load cell, raw reading."),
+             ("uint16_t", "crc_errors", None, """\
+number of packets the server has thrown away because their CRC
+didn't match"""),
+             ("uint16_t", "_pad1", None, None),
+         ],
+         log=("data", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("valve states", "vlv_states", "0x%x"),
+             ("ox pwm", "vlv_pwm_ox", "%u"),
+             ("fuel pwm", "vlv_pwm_fuel", "%u"),
+             ("ign stat", "state:ign_status", "0x%x"),
+             ("state", "state:sys_state", "0x%x"),
+             ("igniter good", "state:igniter_good", "%d"),
+             ("ox pressure", "pressures[PS_OXYGEN]", "%hu"),
+             ("fuel pressure", "pressures[PS_FUEL]", "%hu"),
+             ("ox temp", "temps[TC_OXYGEN]", "%f"),
+             ("water temp", "temps[TC_WATER]", "%f"),
+             ("thrust", "thrust", "%u"),
+             ("crc errors", "crc_errors", "%hu"),
+         ])),
+
+    dict(name="req_packet",
+         type="PT_REQ",
+         doc="this packet is sent from the client to the arduino to tell "
+             "it to do things",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint8_t", "cmd", None,
+              "the command for this request. one of the REQ_CMD_* "
+              "constants."),
+             ("uint8_t", "_pad1", 3, None),
+             ("uint32_t", "arg", None, "argument See REQ_CMD_* for details"),
+         ]),
+
+    dict(name="message_packet",
+         type="PT_MESSAGE",
+         doc="""\
+this packet is sent from the arduino to the client to share diagnostic
+information in string formats. It's only as long as its text, and the
+common messages are just an id with no text at all.""",
+         var_len="text",
+         text_id=("id", "message"),
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint8_t", "id", None, """\
+one of the MSG_* messages. The text, if there is any, goes after
+it."""),
+             ("uint8_t", "text", 255, """\
+ascii, not null-terminated: it's header.len - MESSAGE_PACKET_MIN_LEN
+bytes long, and the packet ends there."""),
+         ],
+         log=("message", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("msg", "text", "%s"),
+         ])),
+
+    dict(name="event_packet",
+         type="PT_EVENT",
+         doc="""\
+this packet is sent from the arduino to the clients, and on its serial
+port, for every diagnostic event it logs. It's the compact sibling of
+PT_MESSAGE: an event id and two numbers, and the host turns that into
+text. See `events` in protocol/protocol.py.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint32_t", "us", None, """\
+micros() when the event happened. The header timestamp is when
+it was sent, which can be a good while later."""),
+             ("uint8_t", "id", None, "one of the EV_* events"),
+             ("uint8_t", "dropped", None, """\
+number of events that were thrown away since the last one sent
+this way, because the event ring filled up first. Saturates."""),
+             ("uint16_t", "arg0", None, None),
+             ("uint32_t", "arg1", None, None),
+         ],
+         log=("event", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("us", "us", "%u"),
+             ("id", "id", "%u"),
+             ("dropped", "dropped", "%u"),
+             ("arg0", "arg0", "%u"),
+             ("arg1", "arg1", "%u"),
+         ])),
+
+    dict(name="stats_packet",
+         type="PT_STATS",
+         doc="""\
+this packet is sent from the arduino to the clients every so often, one
+for each part of loop() it times that ran since the last time. The
+numbers start over after every packet.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint8_t", "section", None, "an enum loop_section"),
+             ("uint8_t", "_pad1", 3, None),
+             ("uint32_t", "count", None, "how many times it ran"),
+             ("uint32_t", "min_us", None, None),
+             ("uint32_t", "max_us", None, None),
+             ("uint32_t", "sum_us", None, None),
+             ("uint16_t", "hist", "STATS_NR_BINS",
+              "how many times took how long, see STATS_NR_BINS. Saturates."),
+         ],
+         log=("stats", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("section", "section", "%u"),
+             ("count", "count", "%u"),
+             ("min us", "min_us", "%u"),
+             ("max us", "max_us", "%u"),
+             ("sum us", "sum_us", "%u"),
+         ] + [("hist%d" % i, "hist[%d]" % i, "%hu") for i in range(stats_nr_bins)])),
+
+    dict(name="transition_packet",
+         type="PT_TRANSITION",
+         doc="""\
+this packet is sent from the arduino to the clients every time a valve,
+the igniter or the system state changes, stamped with micros() at the
+moment it changed. The data packets only show the valves as of the last
+sample, so this is the one to look at for when something happened and
+why.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint32_t", "us", None, """\
+micros() when it changed. The header timestamp is when this was
+sent."""),
+             ("uint8_t", "what", None, """\
+an enum valve, TR_IGNITER or TR_STATE"""),
+             ("uint8_t", "old_value", None, """\
+0 or 1 for solenoids and the igniter, the PWM value for flow
+control valves, an enum system_state for TR_STATE"""),
+             ("uint8_t", "new_value", None, None),
+             ("uint8_t", "cause", None, "an enum transition_cause"),
+             ("uint8_t", "state", None, """\
+the enum system_state it happened in. For CAUSE_SEQUENCE, that's the
+sequence."""),
+             ("uint8_t", "dropped", None, """\
+number of transitions thrown away since the last one sent, because
+they came faster than we could send them. Saturates."""),
+             ("uint8_t", "_pad2", 2, None),
+             ("uint32_t", "arg", None, """\
+for CAUSE_COMMAND the seq of the command, for CAUSE_SEQUENCE the step,
+and for CAUSE_REDLINE the enum redline that tripped"""),
+         ],
+         log=("transition", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("us", "us", "%u"),
+             ("what", "what", "%u"),
+             ("old", "old_value", "%u"),
+             ("new", "new_value", "%u"),
+             ("cause", "cause", "%u"),
+             ("state", "state", "%u"),
+             ("dropped", "dropped", "%u"),
+             ("arg", "arg", "%u"),
+         ])),
+
+    dict(name="bench_packet",
+         type="PT_BENCH",
+         doc="""\
+this packet is what the bench sketches stream out of their serial port
+while calibrating sensors, one per sample, see bench_stream_begin() in
+elet_arduino.h. launch_client/bench_capture.py turns them into a CSV.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint32_t", "us", None, "micros() when it was sampled"),
+             ("float", "setpoint", None, """\
+the last number typed into the serial port, e.g. the pressure on the
+gauge or the mass on the load cell"""),
+             ("uint8_t", "channels", None, """\
+bitmap of the enum bench_channels being streamed"""),
+             ("uint8_t", "fresh", None, """\
+bitmap of the channels read for this sample. The load cell only has
+a new reading 10 or 80 times a second; when it doesn't, the last one
+is repeated and its bit is clear."""),
+             ("uint16_t", "dropped", None, """\
+number of samples thrown away since the last one sent, because the
+serial port couldn't keep up. Saturates."""),
+             ("uint16_t", "pressures", "NR_PSENSORS", "raw ADC readings"),
+             ("uint32_t", "load_cell", None, "raw load cell reading"),
+         ]),
+
+    dict(name="hello_packet",
+         type="PT_HELLO",
+         doc="""\
+this packet is sent from the client to the arduino when it connects. The
+server doesn't send any telemetry to a client until it has said hello.
+
+A client that loses its connection can reconnect and pick up where it
+left off by putting the token from the last PT_SESSION packet it got in
+`session`. If the token matches, the data packets the client missed in
+the meantime are resent.
+
+The session token goes to everyone, so it can't be what lets a commander
+back in. A commander also sends back the `commander` token only it was
+given. If that matches, the server keeps the command sequence going
+instead of restarting it at the seq in this header, and the commander
+takes over from its own stale socket.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint8_t", "role", None, "one of the HELLO_ROLE_* constants"),
+             ("uint8_t", "_pad1", 3, None),
+             ("uint32_t", "session", None,
+              "session token to resume, or 0 to start a new session"),
+             ("uint32_t", "last_timestamp", None, """\
+timestamp of the last data packet this client got. When
+resuming, buffered data packets newer than this are resent."""),
+             ("uint32_t", "commander", None, """\
+commander token from the last PT_SESSION packet, to take command
+back, or 0"""),
+         ]),
+
+    dict(name="session_packet",
+         type="PT_SESSION",
+         doc="""\
+this packet is sent from the arduino to a client in response to every
+PT_HELLO. The seq in its header is the seq of the last command processed,
+just like a data packet.""",
+         fields=[
+             ("struct packet_header", "header", None, None),
+             ("uint32_t", "session", None, """\
+identifies this boot of the arduino. A client that sees this
+change knows the arduino reset."""),
+             ("uint8_t", "resumed", None, """\
+1 if the client's session token matched and it was resumed,
+otherwise 0"""),
+             ("uint8_t", "state", None, "packed exactly like data_packet.state"),
+             ("uint8_t", "seq_step", None, """\
+how far into the current sequence (fire, safing, depress) we are.
+Always 0 in SS_READY."""),
+             ("uint8_t", "backlog", None, """\
+number of buffered data packets the client missed. They follow this
+packet over the next few loops, along with any newer ones, before
+anything else is broadcast to it."""),
+             ("uint32_t", "commander", None, """\
+the commander's token for taking command back after a reconnect,
+see hello_packet. 0 for observers, only the commander gets it."""),
+             ("uint16_t", "ready_ms", None, """\
+how often data goes out in SS_READY, see REQ_CMD_RATE. A client
+expects the gaps there to be that long, and EV_RATE_SET events tell
+it when that changes."""),
+             ("uint8_t", "_pad2", 2, None),
+         ],
+         log=("session", [
+             ("time", "header.timestamp", "%u"),
+             ("seq", "header.seq", "%u"),
+             ("session", "session", "0x%x"),
+             ("resumed", "resumed", "%u"),
+             ("ign stat", "state:ign_status", "0x%x"),
+             ("state", "state:sys_state", "0x%x"),
+             ("step", "seq_step", "%u"),
+             ("backlog", "backlog", "%u"),
+         ])),
+]
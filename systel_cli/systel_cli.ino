@@ -28,10 +28,10 @@ void process_command()
 
   // process a help command
   if (strcmp(buf, "h") == 0) {
-    Serial.println("Valve control:      set all|<name> <value>");
-    Serial.println("Sensor reading:     read all|<name>");
-    Serial.println("List device names:  list");
-    Serial.println("Print help:         h");
+    Serial.println(F("Valve control:      set all|<name> <value>"));
+    Serial.println(F("Sensor reading:     read all|<name>"));
+    Serial.println(F("List device names:  list"));
+    Serial.println(F("Print help:         h"));
 
   // process a valve set command ('set' followed by a space)
   } else if (strncmp(buf, "set ", 4) == 0) {
@@ -81,7 +81,7 @@ void process_command()
   }
 
 invalid:
-  Serial.println("invalid command. Type h for help");
+  Serial.println(F("invalid command. Type h for help"));
 }
 
 void setup() {
@@ -90,7 +90,7 @@ void setup() {
   Serial.begin(9600);
   Serial.setTimeout(1000UL*60UL*60UL);
 
-  Serial.println("Welcome to the ELET system cli. Type 'h' for help");
+  Serial.println(F("Welcome to the ELET system cli. Type 'h' for help"));
   clear_buffer();
 }
 
@@ -100,7 +100,7 @@ void serialEvent() {
 
   while ((c = Serial.read()) != -1) {
     if (sz == 0) {
-      Serial.println("buffer overflow! emptying it now");
+      Serial.println(F("buffer overflow! emptying it now"));
       clear_buffer();
     }
 
@@ -18,9 +18,9 @@ void loop() {
   delay(10);
   float waterT = read_thermocouple_f(TC_WATER);
 
-  Serial.print("ox=");
+  Serial.print(F("ox="));
   Serial.print(oxT);
-  Serial.print(", water=");
+  Serial.print(F(", water="));
   Serial.println(waterT);
   delay(1000);
 }
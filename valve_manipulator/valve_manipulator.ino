@@ -10,10 +10,10 @@ void setup() {
 
   Serial.begin(9600);
 
-  Serial.println("#########################################");
-  Serial.println("####### valve mainpulator (SPRAY) #######");
-  Serial.println("#########################################");
-  Serial.println("");
+  Serial.println(F("#########################################"));
+  Serial.println(F("####### valve mainpulator (SPRAY) #######"));
+  Serial.println(F("#########################################"));
+  Serial.println(F(""));
 }
 
 void serialEvent() {
@@ -82,7 +82,7 @@ void serialEvent() {
       i = 0;
       memset(buf, 0, sizeof buf);
     } else if (i == (sizeof buf) - 1) {
-      Serial.println("buffer overflow. resetting to beginning");
+      Serial.println(F("buffer overflow. resetting to beginning"));
       i = 0;
       memset(buf, 0, sizeof buf);
     } else {
@@ -92,7 +92,7 @@ void serialEvent() {
   return;
   
 invalid:
-  Serial.println("Invalid command, resetting buffer");
+  Serial.println(F("Invalid command, resetting buffer"));
   i = 0;
   memset(buf, 0, sizeof buf);
 }
@@ -6,23 +6,23 @@ void setup() {
   setup_all_valves();
 
   // look all pretty n shit
-  Serial.println("***********************************************");
-  Serial.println("********** valve pin validation test **********");
-  Serial.println("***********************************************");
-  Serial.println("");
+  Serial.println(F("***********************************************"));
+  Serial.println(F("********** valve pin validation test **********"));
+  Serial.println(F("***********************************************"));
+  Serial.println(F(""));
   
   for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v)) {
     int pin = valve_pin(v);
 
     // "Validating oxygen on/off valve: the valve will be controlled by pin 0"
-    Serial.print("Validating ");
+    Serial.print(F("Validating "));
     Serial.print(valve_name(v));
-    Serial.print(" valve: the valve will be controlled by pin ");
+    Serial.print(F(" valve: the valve will be controlled by pin "));
     Serial.print(pin);
-    Serial.println(".");
+    Serial.println(F("."));
 
     // toggle the pin
-    Serial.println("Toggling pin, is the valve making noise/moving? (y/n)");
+    Serial.println(F("Toggling pin, is the valve making noise/moving? (y/n)"));
     for (;;) {
       open_valve(v);
       delay(1000);
@@ -41,7 +41,7 @@ void setup() {
 
       // otherwise, if the user didn't type 'n', be bitchy
       else if (data != 'n')
-        Serial.println("please enter 'y' or 'n'");
+        Serial.println(F("please enter 'y' or 'n'"));
 
       // clear any other bullshit the user may have typed
       while (Serial.read() != -1)
@@ -53,8 +53,8 @@ void setup() {
     }
   }
   // we're done
-  Serial.println("");
-  Serial.println("Finished testing all valves");
+  Serial.println(F(""));
+  Serial.println(F("Finished testing all valves"));
   Serial.end();
 }
 
@@ -0,0 +1,140 @@
+// how long does it take to move a valve, and how far apart do valves that
+// are supposed to move together actually move? Times digitalWrite() against
+// the port writes in elet_arduino.h, for each solenoid on its own and for
+// safing step 0 (close n2 on/off and fuel flow, open n2 purge), counting CPU
+// cycles on timer 1.
+//
+// THIS TOGGLES EVERY VALVE. Run it with the valves unplugged or the lines
+// empty.
+
+#include "elet_arduino.h"
+
+#define ITERS 100
+
+// timer 1 ticks once per CPU cycle once setup() is done with it
+static inline uint16_t cycles()
+{
+        return TCNT1;
+}
+
+// what it costs to read the timer twice with nothing in between
+static uint16_t overhead;
+
+static void print_cycles(const char *what, uint32_t total)
+{
+        float per = (float)total / ITERS;
+
+        Serial.print(what);
+        Serial.print(per);
+        Serial.print(F(" cycles ("));
+        Serial.print(per / (F_CPU / 1000000UL));
+        Serial.println(F(" us)"));
+}
+
+static void bench_valve(enum valve v)
+{
+        const uint8_t pin = valve_pin(v);
+        uint32_t dw = 0, port = 0;
+
+        for (int i = 0; i < ITERS; ++i) {
+                uint16_t start = cycles();
+                digitalWrite(pin, i & 1);
+                dw += (uint16_t)(cycles() - start) - overhead;
+
+                start = cycles();
+                if (i & 1)
+                        open_valve(v);
+                else
+                        close_valve(v);
+                port += (uint16_t)(cycles() - start) - overhead;
+        }
+        close_valve(v);
+
+        Serial.print(valve_name(v));
+        Serial.println(F(":"));
+        print_cycles("    digitalWrite():      ", dw);
+        print_cycles("    open/close_valve(): ", port);
+}
+
+// safing step 0 like it used to be, one call per valve. The time between
+// the n2 on/off pin and the n2 purge pin changing is the skew: the purge
+// opens as the third call finishes, the feed closes as the first one does.
+static void bench_safing_old()
+{
+        const uint8_t n2 = valve_pin(N2_ON_OFF);
+        const uint8_t purge = valve_pin(N2_PURGE);
+        const uint8_t fuel = valve_pin(FUEL_FLOW);
+        uint32_t skew = 0, total = 0;
+
+        for (int i = 0; i < ITERS; ++i) {
+                digitalWrite(n2, HIGH);
+                digitalWrite(purge, LOW);
+
+                uint16_t t0 = cycles();
+                digitalWrite(n2, LOW);
+                uint16_t t1 = cycles();
+                analogWrite(fuel, 0);
+                digitalWrite(purge, HIGH);
+                uint16_t t2 = cycles();
+
+                skew += (uint16_t)(t2 - t1) - overhead;
+                total += (uint16_t)(t2 - t0) - 2 * overhead;
+        }
+
+        print_cycles("    one call per valve, n2 skew: ", skew);
+        print_cycles("    one call per valve, whole step: ", total);
+}
+
+// and with set_valves(). The two n2 valves are on the same port, so they
+// change in the same instruction and there's no skew to measure.
+static void bench_safing_new()
+{
+        uint32_t total = 0;
+
+        for (int i = 0; i < ITERS; ++i) {
+                set_valves(VALVE_BIT(N2_ON_OFF), VALVE_BIT(N2_PURGE));
+
+                uint16_t t0 = cycles();
+                set_valves(VALVE_BIT(N2_PURGE),
+                           VALVE_BIT(N2_ON_OFF) | VALVE_BIT(FUEL_FLOW));
+                total += (uint16_t)(cycles() - t0) - overhead;
+        }
+
+        Serial.print(F("    set_valves(), n2 skew 0 (same port: "));
+        Serial.print(valve_ports[N2_ON_OFF].port == valve_ports[N2_PURGE].port
+                     ? "yes" : "NO");
+        Serial.println(F(")"));
+        print_cycles("    set_valves(), whole step: ", total);
+}
+
+void setup()
+{
+        Serial.begin(115200);
+        setup_all_valves();
+
+        // normal mode, no prescaler. Timer 1's PWM outputs are the ox and
+        // fuel on/off pins, but with TCCR1A cleared it leaves them alone.
+        TCCR1A = 0;
+        TCCR1B = _BV(CS10);
+
+        uint16_t start = cycles();
+        overhead = cycles() - start;
+
+        Serial.print(F("timer overhead "));
+        Serial.print(overhead);
+        Serial.println(F(" cycles"));
+
+        for (enum valve v = FIRST_VALVE; v < NR_VALVES; v = next_valve(v))
+                if (!valve_is_flow(v))
+                        bench_valve(v);
+
+        Serial.println(F("safing step 0:"));
+        bench_safing_old();
+        bench_safing_new();
+
+        set_valves(0, ALL_VALVES);
+}
+
+void loop()
+{
+}
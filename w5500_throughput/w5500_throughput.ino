@@ -0,0 +1,98 @@
+// how fast can the launch server push bytes at a client? Brings the W5500
+// up like the launch server does (eth_setup()), waits for a client, then
+// writes at it through eth_try_write(), which is what send_packet() does,
+// as fast as it'll go for a few seconds at each write size: one data
+// packet, a loop's worth of broadcasts, and on up to a whole socket's
+// worth. Prints writes/s, bytes/s, how many writes didn't fit because the
+// socket's TX buffer was full, and the time per write.
+//
+// On the host, something has to read as fast as it can:
+//
+//   nc 192.168.1.177 420 > /dev/null
+//
+// (ELET_NET_ADDR and ELET_NET_PORT). The client gets socket 0, so it gets
+// the biggest TX buffer, same as the commander would.
+
+#include "elet_arduino.h"
+
+#define SECONDS_PER_SIZE 3
+
+static EthernetServer server(ELET_NET_PORT);
+
+// the data packet with an event behind it is what a typical loop
+// broadcasts. 256 is TX_BATCH_LEN in launch_server.ino.
+static const uint16_t sizes[] = {
+        sizeof(struct data_packet),
+        sizeof(struct data_packet) + sizeof(struct event_packet),
+        256,
+        1024,
+        2048,
+};
+
+static uint8_t buf[2048];
+
+static void bench_size(EthernetClient *client, uint16_t len)
+{
+        const uint32_t start = millis();
+        uint32_t writes = 0, full = 0, busy_us = 0;
+
+        while (millis() - start < SECONDS_PER_SIZE * 1000UL) {
+                const uint32_t t = micros();
+                int ret = eth_try_write(client, buf, len);
+
+                if (ret == -1) {
+                        Serial.println(F("client went away"));
+                        return;
+                }
+                if (ret == 0) {
+                        ++full;
+                        continue;
+                }
+                busy_us += micros() - t;
+                ++writes;
+        }
+
+        const float secs = (millis() - start) / 1000.0;
+
+        Serial.print(len);
+        Serial.print(F(" bytes: "));
+        Serial.print(writes / secs);
+        Serial.print(F(" writes/s, "));
+        Serial.print(writes * (float)len / secs);
+        Serial.print(F(" bytes/s, "));
+        Serial.print(full);
+        Serial.print(F(" full, "));
+        Serial.print(writes ? (float)busy_us / writes : 0);
+        Serial.println(F(" us/write"));
+}
+
+void setup()
+{
+        Serial.begin(115200);
+
+        for (unsigned i = 0; i < sizeof buf; ++i)
+                buf[i] = i;
+
+        eth_setup();
+        server.begin();
+
+        Serial.print(F("socket 0 has "));
+        Serial.print(eth_tx_kb[0]);
+        Serial.println(F("K of TX memory, waiting for a client"));
+}
+
+void loop()
+{
+        // server.available() only hands back a client once it has sent
+        // something, and nc doesn't, so look at the socket it lands on
+        EthernetClient client(0);
+
+        if (!client.connected())
+                return;
+
+        for (unsigned i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+                bench_size(&client, sizes[i]);
+
+        client.stop();
+        Serial.println(F("done, waiting for another client"));
+}